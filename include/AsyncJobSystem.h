@@ -27,15 +27,37 @@
 #include <mutex>
 #include <thread>
 #include <condition_variable>
-#include <set>
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <algorithm>
 #include <chrono>
+#include <atomic>
+
+#include "MPSCQueue.h"
+
+//! Most worker threads the job system will start
+#define ASYNC_MAX_WORKERS 32
+
+//! How often the watchdog checks for jobs over their time limit
+#define ASYNC_WATCHDOG_PERIOD_MS 250
+
+//! Most job categories tracked separately, later ones are counted as "Other"
+#define ASYNC_MAX_CATEGORIES 64
+
+//! Buckets in the wait and run time histograms. Bucket 0 is under 1ms, bucket n
+//! under 2^n ms and the last bucket holds everything longer.
+#define ASYNC_HISTOGRAM_BUCKETS 16
 
 typedef std::function<void(std::shared_ptr<void>, std::timed_mutex&)> AsyncJobFunction;
 typedef std::function<void(std::shared_ptr<void>)> AsyncJobCallback;
 
+typedef std::chrono::steady_clock AsyncJobClock;
+
 /**
  * Enum marking possible states of queued jobs
  */
@@ -44,8 +66,60 @@ enum AsyncJobState
     JOB_READY,   //!< JOB_READY     Job is ready to run
     JOB_RUNNING, //!< JOB_RUNNING   Job is currently active
     JOB_COMPLETE,//!< JOB_COMPLETE  Job has finished and is awaiting callback
-    JOB_ERASE,   //!< JOB_ERASE     Job has run callback and can be erased
-    JOB_FAILED   //!< JOB_FAILED    Job threw an exception that was not handled
+    JOB_ERASE,   //!< JOB_ERASE     Job has run callback and will not run again
+    JOB_FAILED,  //!< JOB_FAILED    Job threw an exception that was not handled
+    JOB_WAITING, //!< JOB_WAITING   Job is on the timer heap waiting for its start time
+    JOB_CANCELLED,//!< JOB_CANCELLED Job was cancelled before it could run again
+    JOB_EXPIRED  //!< JOB_EXPIRED   Job missed its deadline and was not run
+};
+
+struct AsyncJobData;
+
+/**
+ * Live counters for one category of job. Updated by workers with relaxed
+ * atomics and read without locking, so a snapshot may be very slightly
+ * inconsistent between fields.
+ */
+struct AsyncJobCategory
+{
+    std::string m_name;                        //!< Set on creation and never changed
+    std::atomic<unsigned long> m_submitted;    //!< Runs made ready to run
+    std::atomic<long> m_queued;                //!< Runs waiting for a worker or their strand
+    std::atomic<long> m_running;               //!< Runs in progress
+    std::atomic<unsigned long> m_completed;    //!< Runs which returned normally
+    std::atomic<unsigned long> m_failed;       //!< Runs which threw an exception
+    std::atomic<unsigned long> m_expired;      //!< Runs dropped for missing their deadline
+    std::atomic<unsigned long> m_cancelled;    //!< Runs skipped because the job was cancelled while queued
+    std::atomic<unsigned long> m_waithistogram[ASYNC_HISTOGRAM_BUCKETS]; //!< Time from ready to started
+    std::atomic<unsigned long> m_runhistogram[ASYNC_HISTOGRAM_BUCKETS];  //!< Time from started to finished
+};
+
+/**
+ * Copy of the counters for one job category, see AsyncJobCategory
+ */
+struct AsyncJobMetrics
+{
+    std::string m_category;
+    unsigned long m_submitted = 0;
+    long m_queued = 0;
+    long m_running = 0;
+    unsigned long m_completed = 0;
+    unsigned long m_failed = 0;
+    unsigned long m_expired = 0;
+    unsigned long m_cancelled = 0;
+    std::vector<unsigned long> m_waithistogram;
+    std::vector<unsigned long> m_runhistogram;
+};
+
+/**
+ * A serial queue within the job pool. Jobs on the same strand run one at a
+ * time in the order they were queued; jobs on other strands run alongside.
+ */
+struct AsyncStrand
+{
+    std::mutex m_lock;
+    bool m_active;                                       //!< A job from this strand is queued or running
+    std::deque<std::shared_ptr<AsyncJobData>> m_pending; //!< Jobs waiting for the active one to finish
 };
 
 /**
@@ -57,43 +131,218 @@ struct AsyncJobData
     AsyncJobCallback m_completecallback; //!< Function to execute synchronously when job completes
     std::shared_ptr<void> m_data;        //!< Data to pass into and out of the job
     int m_priority;                      //!< Priority (higher is better)
-    AsyncJobState m_state;               //!< Flag to mark whether job has been run
+    std::atomic<AsyncJobState> m_state;  //!< Flag to mark whether job has been run
     bool m_repeat;                       //!< Flag to mark whether job shall run until cancelled
+    uint64_t m_sequence;                 //!< Order the job was last queued in, to break priority ties
+
+    AsyncJobClock::time_point m_runat;   //!< When the current run is due
+    AsyncJobClock::duration m_interval;  //!< Time between the start of each run, or zero
+    AsyncJobClock::duration m_deadline;  //!< Latest a run may start after m_runat, or zero for no limit
+
+    AsyncJobCategory *m_pcategory;       //!< Counters to update, owned by the job system
+    AsyncJobClock::time_point m_readyat; //!< When the current run was made ready, for wait times
+
+    std::shared_ptr<AsyncStrand> m_pstrand; //!< Strand to serialise with, or null
+    std::atomic<bool> m_strandheld;      //!< This job is the one currently let through its strand
+
+    std::atomic<long long> m_timeoutms;  //!< Longest one run may take before the watchdog steps in, or 0
+    std::function<void()> m_cancelhandler; //!< Set by a running job to be told it has been cancelled
+    std::mutex m_cancelhandlerlock;
+
+    std::atomic<bool> m_cancelled;       //!< Set by AsyncJobHandle::cancel()
+    std::atomic<bool> m_runcancelled;    //!< Set by the watchdog to stop the current run only
+    std::atomic<bool> m_finished;        //!< Set once the job will never run again
+    std::mutex m_finishedlock;
+    std::condition_variable m_finishedcv;
+};
 
-    // Sort operator to keep in priority order
-    bool operator< (AsyncJobData const &lhs) const
+/**
+ * Orders a heap of jobs so the highest priority is at the top, and equal
+ * priorities run in the order they were queued
+ */
+struct AsyncJobOrder
+{
+    bool operator() (const std::shared_ptr<AsyncJobData>& lhs, const std::shared_ptr<AsyncJobData>& rhs) const
     {
-        return (lhs.m_priority < m_priority);
+        if (lhs->m_priority != rhs->m_priority)
+        {
+            return lhs->m_priority < rhs->m_priority;
+        }
+
+        return lhs->m_sequence > rhs->m_sequence;
     }
 };
 
+/**
+ * Orders the timer heap so the job due soonest is at the top
+ */
+struct AsyncTimerOrder
+{
+    bool operator() (const std::shared_ptr<AsyncJobData>& lhs, const std::shared_ptr<AsyncJobData>& rhs) const
+    {
+        return lhs->m_runat > rhs->m_runat;
+    }
+};
+
+/**
+ * Lets the submitter of a job check on it and cancel it
+ */
+class AsyncJobHandle
+{
+public:
+    AsyncJobHandle ();
+    AsyncJobHandle (std::shared_ptr<AsyncJobData> pjob);
+
+    void cancel ();
+    void setTimeout (std::chrono::milliseconds timeout);
+    AsyncJobState getState () const;
+    bool isFinished () const;
+    void wait () const;
+    bool waitFor (std::chrono::milliseconds timeout) const;
+
+    explicit operator bool () const;
+
+private:
+    std::shared_ptr<AsyncJobData> m_pjob;
+};
+
+/**
+ * Runs jobs on a pool of worker threads. Each worker has its own queue of
+ * runnable jobs, and idle workers steal from the others so one slow job
+ * cannot hold up the rest. A worker always takes the highest priority job
+ * queued anywhere in the pool, oldest first among equals.
+ *
+ * Jobs due later sit on a timer heap, serviced by a separate thread which
+ * moves them onto the worker queues when they become due.
+ *
+ * Jobs given a strand name run one at a time, in order, with any others on
+ * the same strand. Use the name of the device, channel or database file the
+ * jobs work on. Priority only counts once a job reaches the front of its strand.
+ *
+ * A watchdog thread looks for jobs running longer than their timeout. It
+ * first cancels them, which a job can notice through isJobCancelled() or a
+ * cancel handler. If the job is still running after the same time again,
+ * its worker is abandoned and a new one started in its place, so a hung
+ * job only ever costs one thread.
+ *
+ * Each job may be given a category, usually the name of the plugin that
+ * submitted it. Counts and wait and run time histograms are kept for each
+ * category, and can be read at any time with getMetrics().
+ */
 class AsyncJobSystem
 {
 public:
     AsyncJobSystem ();
     virtual ~AsyncJobSystem ();
 
-    std::shared_ptr<AsyncJobData> newAsyncJob (AsyncJobFunction func, AsyncJobCallback cb,
-            const std::shared_ptr<void> data, int priority, bool repeat);
+    AsyncJobHandle newAsyncJob (AsyncJobFunction func, AsyncJobCallback cb,
+            const std::shared_ptr<void> data, int priority, bool repeat, const std::string& strand = "",
+            const std::string& category = "");
+
+    AsyncJobHandle newTimedJob (AsyncJobFunction func, AsyncJobCallback cb,
+            const std::shared_ptr<void> data, int priority, std::chrono::milliseconds delay,
+            std::chrono::milliseconds interval = std::chrono::milliseconds::zero(),
+            std::chrono::milliseconds deadline = std::chrono::milliseconds::zero(),
+            const std::string& strand = "", const std::string& category = "");
+
+    void runOnTick (std::function<void()> func);
 
     void completeAsyncJobs ();
 
+    void setWorkerCount (unsigned int workers);
+    unsigned int getWorkerCount ();
+
+    void setDefaultTimeout (std::chrono::milliseconds timeout);
+    unsigned long getTimedOutJobs ();
+    unsigned long getReplacedWorkers ();
+
+    int getQueuedJobs ();
+    std::vector<AsyncJobMetrics> getMetrics ();
+    static long getHistogramLimit (int bucket);
+
+    static bool isJobCancelled ();
+    static void setCancelHandler (std::function<void()> handler);
+
 private:
-    void asyncJobRunner ();
+    friend class AsyncJobHandle;
+
+    /**
+     * A worker thread and the jobs queued for it
+     */
+    struct AsyncWorker
+    {
+        std::vector<std::shared_ptr<AsyncJobData>> m_queue; //!< Heap of runnable jobs, see AsyncJobOrder
+        std::mutex m_queuelock;
+        std::thread m_thread;
+        std::atomic<unsigned int> m_generation; //!< Bumped when the thread is abandoned, telling it to exit
 
-    std::set<std::shared_ptr<AsyncJobData>> m_jobs; //! Async jobs queue
+        // The job being run, for the watchdog
+        std::mutex m_currentlock;
+        std::shared_ptr<AsyncJobData> m_pcurrent;
+        AsyncJobClock::time_point m_started;
+        bool m_overdue;                         //!< Watchdog has already cancelled the current job
+    };
 
-    // Condition variable (and mutex) for sleeping thread when no jobs are present
+    std::shared_ptr<AsyncJobData> makeJob (AsyncJobFunction& func, AsyncJobCallback& cb,
+            const std::shared_ptr<void>& data, int priority, const std::string& strand,
+            const std::string& category);
+    AsyncJobCategory* findCategory (const std::string& name);
+    static void recordTime (std::atomic<unsigned long> *histogram, AsyncJobClock::duration time);
+    void asyncJobRunner (unsigned int workerid, unsigned int generation);
+    void timerRunner ();
+    void watchdogRunner ();
+    void checkWorker (unsigned int workerid);
+    static void cancelRunningJob (std::shared_ptr<AsyncJobData> job);
+    void enqueueJob (std::shared_ptr<AsyncJobData> job);
+    void pushToWorker (std::shared_ptr<AsyncJobData> job);
+    void releaseStrand (std::shared_ptr<AsyncJobData> job);
+    void scheduleJob (std::shared_ptr<AsyncJobData> job);
+    void rescheduleJob (std::shared_ptr<AsyncJobData> job);
+    bool takeJob (unsigned int workerid, std::shared_ptr<AsyncJobData>& job);
+    static void finishJob (std::shared_ptr<AsyncJobData> job);
+
+    //! Jobs that have finished running, waiting for completeAsyncJobs() on the tick thread
+    MPSCQueue<std::shared_ptr<AsyncJobData>> m_completedjobs;
+
+    //! Functions to run on the next call to completeAsyncJobs()
+    MPSCQueue<std::function<void()>> m_tickfunctions;
+
+    // Condition variable (and mutex) for sleeping workers when no jobs are queued
     std::condition_variable m_async_cv;
     std::mutex m_async_cv_mx;
 
-    // Mutex for access to jobs queue
-    std::mutex m_jobqueue_mutex;
+    // Flag to stop the worker threads
+    std::atomic<bool> m_halt;
 
-    // Flag to stop the async thread
-    bool m_halt;
+    //! Worker slots. Only the first m_workercount are in use, and slots are never freed while running.
+    std::unique_ptr<AsyncWorker> m_workers[ASYNC_MAX_WORKERS];
+    std::atomic<unsigned int> m_workercount;
+    std::mutex m_workerstart_mutex;
 
-    // Thread to run jobs
-    std::thread m_async_thread;
-};
+    std::atomic<unsigned int> m_nextworker; //!< Round-robin target for jobs queued from outside the pool
+    std::atomic<int> m_queuedjobs;          //!< Jobs waiting in any worker queue
+    std::atomic<uint64_t> m_nextsequence;   //!< Sequence number for the next job queued
 
+    //! Heap of jobs waiting for their start time, see AsyncTimerOrder
+    std::vector<std::shared_ptr<AsyncJobData>> m_timers;
+    std::mutex m_timerlock;
+    std::condition_variable m_timercv;
+    std::thread m_timerthread;
+
+    //! Strands by name. Never removed, as there is one per device, channel or file at most.
+    std::unordered_map<std::string, std::shared_ptr<AsyncStrand>> m_strands;
+    std::mutex m_strandlock;
+
+    std::atomic<long long> m_defaulttimeoutms; //!< Timeout given to new jobs, or 0 for none
+    std::atomic<unsigned long> m_timedoutjobs;
+    std::atomic<unsigned long> m_replacedworkers;
+    std::mutex m_watchdoglock;
+    std::condition_variable m_watchdogcv;
+    std::thread m_watchdogthread;
+    std::atomic<unsigned int> m_abandonedworkers; //!< Replaced workers whose jobs have not returned yet
+
+    //! Job categories. Slots are filled in order and never freed, so readers need no lock.
+    std::unique_ptr<AsyncJobCategory> m_categories[ASYNC_MAX_CATEGORIES];
+    std::atomic<unsigned int> m_categorycount;
+    std::mutex m_categorylock; //!< Held only while adding a category
+};
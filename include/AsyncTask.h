@@ -0,0 +1,342 @@
+/******************************************************************************
+ *   Copyright (C) 2011 - 2013  York Student Television
+ *
+ *   Tarantula is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Tarantula is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *   Contact     : tarantula@ystv.co.uk
+ *
+ *   File Name   : AsyncTask.h
+ *   Version     : 1.0
+ *   Description : Typed results and continuations for async jobs
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "AsyncJobSystem.h"
+#include "Log.h"
+
+extern Log g_logger;
+
+/*
+ * A typed layer over AsyncJobSystem. A chain of stages is built with then(),
+ * each stage taking the previous result by value (moved, never copied) and
+ * running on a worker or on the tick thread:
+ *
+ *   makeAsyncTask(jobs, std::move(query), 5)
+ *       .then([] (Query q) { return runQuery(q); })
+ *       .then([] (Rows rows) { applyRows(rows); }, ASYNC_ON_TICK);
+ *
+ * An exception thrown by a stage skips the rest of the chain and is rethrown
+ * by get(), or logged if nothing ever looks at it.
+ */
+
+/**
+ * Where a stage of a task runs
+ */
+enum AsyncTaskThread
+{
+    ASYNC_ON_WORKER, //!< ASYNC_ON_WORKER On an AsyncJobSystem worker
+    ASYNC_ON_TICK    //!< ASYNC_ON_TICK   On the tick thread, holding the core lock
+};
+
+/**
+ * Result of a stage which returns nothing
+ */
+struct AsyncNothing
+{
+};
+
+/**
+ * Shared state between a stage and whatever follows it
+ */
+template <typename T>
+struct AsyncTaskState
+{
+    AsyncTaskState (AsyncJobSystem& jobs, int priority, const std::string& strand, const std::string& category) :
+            m_jobs(jobs), m_priority(priority), m_strand(strand), m_category(category), m_ready(false),
+            m_observed(false)
+    {
+    }
+
+    ~AsyncTaskState ()
+    {
+        if (m_error && !m_observed)
+        {
+            g_logger.warn("Async Task", "A task failed and nothing was waiting for its result");
+        }
+    }
+
+    void setValue (T&& value)
+    {
+        complete([this, &value] () { m_pvalue.reset(new T(std::move(value))); });
+    }
+
+    void setError (std::exception_ptr error)
+    {
+        complete([this, &error] () { m_error = error; });
+    }
+
+    /**
+     * Run a function once the result is ready, straight away if it already is
+     */
+    void onReady (std::function<void()> continuation)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_continuation || m_observed)
+            {
+                // A result can only be passed on once
+                throw std::exception();
+            }
+
+            m_observed = true;
+
+            if (!m_ready)
+            {
+                m_continuation = std::move(continuation);
+                return;
+            }
+        }
+
+        continuation();
+    }
+
+    template <typename F>
+    void complete (F store)
+    {
+        std::function<void()> continuation;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            store();
+            m_ready = true;
+            continuation = std::move(m_continuation);
+        }
+        m_readycv.notify_all();
+
+        if (continuation)
+        {
+            continuation();
+        }
+    }
+
+    AsyncJobSystem& m_jobs;
+    int m_priority;                     //!< Job priority for stages run on workers
+    std::string m_strand;               //!< Strand for stages run on workers
+    std::string m_category;             //!< Job category for stages run on workers
+    std::mutex m_lock;
+    std::condition_variable m_readycv;
+    bool m_ready;
+    bool m_observed;                    //!< Something has taken, or will take, the result
+    std::unique_ptr<T> m_pvalue;
+    std::exception_ptr m_error;
+    std::function<void()> m_continuation;
+};
+
+//! Maps a stage's return type to the type carried to the next stage
+template <typename R>
+struct AsyncTaskResult
+{
+    typedef R type;
+};
+
+template <>
+struct AsyncTaskResult<void>
+{
+    typedef AsyncNothing type;
+};
+
+//! Calls a stage, standing in an AsyncNothing for a void return
+template <typename R>
+struct AsyncTaskInvoke
+{
+    template <typename F, typename A>
+    static R run (F& func, A&& arg)
+    {
+        return func(std::forward<A>(arg));
+    }
+};
+
+template <>
+struct AsyncTaskInvoke<void>
+{
+    template <typename F, typename A>
+    static AsyncNothing run (F& func, A&& arg)
+    {
+        func(std::forward<A>(arg));
+        return AsyncNothing();
+    }
+};
+
+/**
+ * A result of type T which will be available some time later
+ */
+template <typename T>
+class AsyncTask
+{
+public:
+    explicit AsyncTask (std::shared_ptr<AsyncTaskState<T>> pstate) :
+            m_pstate(pstate)
+    {
+    }
+
+    /**
+     * Add a stage to run once this result is ready. The result is moved into
+     * the stage, so a task can only be followed by one then() or get().
+     *
+     * @param func   Function taking a T and returning the next result, or void
+     * @param thread Where to run func
+     * @return       Task for the result of func
+     */
+    template <typename F>
+    AsyncTask<typename AsyncTaskResult<typename std::result_of<F(T)>::type>::type> then (F func,
+            AsyncTaskThread thread = ASYNC_ON_WORKER)
+    {
+        typedef typename std::result_of<F(T)>::type R;
+        typedef typename AsyncTaskResult<R>::type U;
+
+        std::shared_ptr<AsyncTaskState<T>> pstate = m_pstate;
+        std::shared_ptr<AsyncTaskState<U>> pnext = std::make_shared<AsyncTaskState<U>>(pstate->m_jobs,
+                pstate->m_priority, pstate->m_strand, pstate->m_category);
+        std::shared_ptr<F> pfunc = std::make_shared<F>(std::move(func));
+
+        std::function<void()> stage = [pstate, pnext, pfunc] ()
+        {
+            if (pstate->m_error)
+            {
+                pnext->setError(pstate->m_error);
+                return;
+            }
+
+            try
+            {
+                pnext->setValue(AsyncTaskInvoke<R>::run(*pfunc, std::move(*pstate->m_pvalue)));
+            }
+            catch (...)
+            {
+                pnext->setError(std::current_exception());
+            }
+
+            pstate->m_pvalue.reset();
+        };
+
+        AsyncJobSystem& jobs = pstate->m_jobs;
+        int priority = pstate->m_priority;
+        std::string strand = pstate->m_strand;
+        std::string category = pstate->m_category;
+
+        pstate->onReady([&jobs, priority, strand, category, thread, stage] ()
+        {
+            if (ASYNC_ON_TICK == thread)
+            {
+                jobs.runOnTick(stage);
+            }
+            else
+            {
+                jobs.newAsyncJob([stage] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+                {
+                    stage();
+                }, nullptr, nullptr, priority, false, strand, category);
+            }
+        });
+
+        return AsyncTask<U>(pnext);
+    }
+
+    /**
+     * Block until the result is ready and take it. Never call on the tick thread
+     * for a chain with a tick stage in it, as that stage could never run.
+     *
+     * @return The result, or rethrows the exception from a failed stage
+     */
+    T get ()
+    {
+        std::unique_lock<std::mutex> lock(m_pstate->m_lock);
+        if (m_pstate->m_continuation || m_pstate->m_observed)
+        {
+            throw std::exception();
+        }
+
+        m_pstate->m_observed = true;
+        m_pstate->m_readycv.wait(lock, [this] { return m_pstate->m_ready; });
+
+        if (m_pstate->m_error)
+        {
+            std::rethrow_exception(m_pstate->m_error);
+        }
+
+        return std::move(*m_pstate->m_pvalue);
+    }
+
+    /**
+     * @return True once the result (or an error) is available
+     */
+    bool isReady ()
+    {
+        std::lock_guard<std::mutex> lock(m_pstate->m_lock);
+        return m_pstate->m_ready;
+    }
+
+private:
+    std::shared_ptr<AsyncTaskState<T>> m_pstate;
+};
+
+/**
+ * Start a chain from a value already to hand
+ *
+ * @param jobs     Job system to run worker stages on
+ * @param value    Value to pass to the first stage
+ * @param priority Job priority for worker stages in this chain
+ * @param strand   Strand for worker stages in this chain, see AsyncJobSystem
+ * @param category Job category for worker stages in this chain, see AsyncJobSystem
+ */
+template <typename T>
+AsyncTask<typename std::decay<T>::type> makeAsyncTask (AsyncJobSystem& jobs, T&& value, int priority,
+        const std::string& strand = "", const std::string& category = "")
+{
+    typedef typename std::decay<T>::type V;
+
+    std::shared_ptr<AsyncTaskState<V>> pstate = std::make_shared<AsyncTaskState<V>>(jobs, priority, strand,
+            category);
+    pstate->setValue(V(std::forward<T>(value)));
+    return AsyncTask<V>(pstate);
+}
+
+/**
+ * Start a chain by running a function on a worker
+ *
+ * @param jobs     Job system to run worker stages on
+ * @param func     Function taking no arguments
+ * @param priority Job priority for worker stages in this chain
+ * @param strand   Strand for worker stages in this chain, see AsyncJobSystem
+ * @param category Job category for worker stages in this chain, see AsyncJobSystem
+ */
+template <typename F>
+AsyncTask<typename AsyncTaskResult<typename std::result_of<F()>::type>::type> runAsyncTask (AsyncJobSystem& jobs,
+        F func, int priority, const std::string& strand = "", const std::string& category = "")
+{
+    return makeAsyncTask(jobs, AsyncNothing(), priority, strand, category).then([func] (AsyncNothing nothing) mutable
+    {
+        return func();
+    });
+}
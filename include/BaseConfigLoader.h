@@ -36,6 +36,8 @@ public:
     std::string m_channame;
     std::string m_xpname;
     std::string m_xpport;
+    std::string m_overlappolicy; //!< One of warn, reject or shunt
+    int m_recurrencelookahead; //!< Seconds ahead to add recurring events to the playlist
 };
 
 /**
@@ -63,6 +65,10 @@ public:
     std::string getDatabasePath ();
 
     int getMCDeletedEventCount ();
+    int getMCActionBudget ();
+
+    int getAsyncWorkers ();
+    int getAsyncJobTimeout ();
 
     std::vector<ChannelDetails> getLoadedChannels ();
 
@@ -78,6 +84,10 @@ private:
     std::vector<ChannelDetails> m_loadedchannels;
 
     int m_mcdeletedvents;
+    int m_mcactionbudget; //!< Milliseconds per tick for MouseCatcher actions
+
+    int m_asyncworkers; //!< Number of threads to run async jobs on
+    int m_asyncjobtimeout; //!< Seconds an async job may run before it is cancelled
 
     std::vector<int> m_pluginreloadpoints;
 
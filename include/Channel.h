@@ -47,7 +47,8 @@ class Channel
 {
 public:
     Channel ();
-    Channel (std::string name, std::string xpname, std::string xport);
+    Channel (std::string name, std::string xpname, std::string xport,
+            std::string overlappolicy = "warn", int recurrencelookahead = 172800);
     void init ();
     ~Channel ();
     void tick ();
@@ -59,23 +60,53 @@ public:
 
     PlaylistDB m_pl;
     std::string m_channame;
+    //! ID from g_channelids, which is also this channel's index in g_channels
+    int m_channelid;
     //! Crosspoint name for this channel
     std::string m_xpdevicename;
     //! Crosspoint port name for this channel
     std::string m_xpport;
+    //! What to do when a new top-level event overlaps the existing schedule
+    timeline_overlap_policy_t m_overlappolicy;
+    //! How far ahead, in seconds, recurring events are added to the playlist
+    int m_recurrencelookahead;
 
-    static int getChannelByName (std::string channelname);
+    static int getChannelByName (const std::string& channelname);
 
     static void manualHoldRelease (PlaylistEntry &event, Channel *pchannel);
 
+    void expandRecurrences ();
+
 private:
     void runEvent (PlaylistEntry& pevent);
 
     void periodicDatabaseSync (std::shared_ptr<void> data, std::timed_mutex &core_lock);
 
+    static void findRecurrenceOccurrences (std::shared_ptr<void> data, std::timed_mutex &core_lock);
+    void addRecurrenceOccurrences (std::shared_ptr<void> data);
+
     int m_sync_counter;
 
     int m_hold_event;
+
+    //! Last time finished events were dropped from the timeline
+    time_t m_lastprune;
+
+    //! Last time recurring events were expanded
+    time_t m_lastexpansion;
+    //! Set while an expansion job is running so only one runs at once
+    bool m_expansionpending;
+};
+
+/**
+ * Data passed through the recurring event expansion job
+ */
+struct RecurrenceExpansionData
+{
+    std::vector<RecurringEntry> m_rules;
+    time_t m_horizon; //!< Expand occurrences up to this time
+    time_t m_now;
+    std::vector<std::vector<time_t>> m_occurrences; //!< Occurrences found for each rule, same order as m_rules
 };
 
 /*
@@ -24,6 +24,7 @@
 
 #pragma once
 #include <string>
+#include <unordered_map>
 #include "TarantulaPlugin.h"
 #include "PluginConfig.h"
 #include "PlaylistDB.h"
@@ -41,6 +42,10 @@ public:
     void addPluginReference (std::shared_ptr<Plugin> thisplugin);
 
     playlist_device_type_t getType ();
+    int getDeviceId ();
+    int getActionId (const std::string& actionname);
+
+    static std::shared_ptr<Device> getDeviceById (int deviceid);
 
     //! Update status from device. Called once a tick.
     virtual void poll ();
@@ -60,6 +65,10 @@ protected:
     long int m_polltime;
 
 private:
+    //! ID from g_deviceids, set when the device is added to g_devices
+    int m_deviceid;
+    //! Index of m_actionlist by action name, built in addPluginReference() and read-only after
+    std::unordered_map<std::string, int> m_actionids;
 
 };
 
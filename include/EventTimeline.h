@@ -0,0 +1,129 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : EventTimeline.h
+*   Version     : 1.0
+*   Description : In-memory interval tree of top-level events on a channel
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * What a channel should do when a new top-level event overlaps an existing one
+ */
+enum timeline_overlap_policy_t
+{
+    OVERLAP_WARN,   //!< OVERLAP_WARN   Insert anyway and log a warning
+    OVERLAP_REJECT, //!< OVERLAP_REJECT Refuse to insert the new event
+    OVERLAP_SHUNT   //!< OVERLAP_SHUNT  Push later events back to make room
+};
+
+const std::map<timeline_overlap_policy_t, std::string> timeline_overlap_policy_vector =
+        { { OVERLAP_WARN, "warn" }, { OVERLAP_REJECT, "reject" }, { OVERLAP_SHUNT, "shunt" } };
+
+/**
+ * A single top-level event occupying [m_start, m_end) on the timeline
+ */
+struct TimelineInterval
+{
+    time_t m_start;
+    time_t m_end;
+    int m_eventid;
+};
+
+/**
+ * An unoccupied stretch of time [m_start, m_end) on the timeline
+ */
+struct TimelineGap
+{
+    time_t m_start;
+    time_t m_end;
+};
+
+/**
+ * Augmented AVL tree of event intervals, ordered by start time and tracking
+ * the latest end time in each subtree. Gives O(log n) insert, remove and
+ * overlap tests and O(log n + k) range queries.
+ */
+class EventTimeline
+{
+public:
+    EventTimeline ();
+    ~EventTimeline ();
+
+    void insert (int eventid, time_t start, time_t end);
+    bool remove (int eventid);
+    void clear ();
+    size_t size () const;
+
+    bool getInterval (int eventid, TimelineInterval& interval) const;
+    bool hasOverlap (time_t start, time_t end, int ignoreid = -1) const;
+    void findOverlapping (time_t start, time_t end, std::vector<TimelineInterval>& result,
+            int ignoreid = -1) const;
+    void findAt (time_t at, std::vector<TimelineInterval>& result) const;
+    void findGaps (time_t start, time_t end, int mingap, std::vector<TimelineGap>& gaps) const;
+
+    void shift (time_t from, time_t to, int offset);
+    void pruneBefore (time_t cutoff);
+
+    bool verify () const;
+
+private:
+    struct TimelineNode
+    {
+        TimelineInterval m_interval;
+        time_t m_maxend;                     //!< Latest end time anywhere in this subtree
+        int m_height;
+        std::unique_ptr<TimelineNode> m_left;
+        std::unique_ptr<TimelineNode> m_right;
+    };
+
+    typedef std::unique_ptr<TimelineNode> NodePtr;
+
+    static int height (const NodePtr& node);
+    static void update (NodePtr& node);
+    static void rotateLeft (NodePtr& node);
+    static void rotateRight (NodePtr& node);
+    static void rebalance (NodePtr& node);
+    static bool keyLess (const TimelineInterval& lhs, const TimelineInterval& rhs);
+
+    static void insertNode (NodePtr& node, const TimelineInterval& interval);
+    static void removeNode (NodePtr& node, const TimelineInterval& interval);
+    static NodePtr detachMin (NodePtr& node);
+
+    static void collectOverlapping (const NodePtr& node, time_t start, time_t end,
+            std::vector<TimelineInterval>& result, int ignoreid);
+    static bool anyOverlapping (const NodePtr& node, time_t start, time_t end, int ignoreid);
+    static void collectStarting (const NodePtr& node, time_t from, time_t to,
+            std::vector<TimelineInterval>& result);
+    static bool verifyNode (const NodePtr& node, const TimelineInterval* plower, const TimelineInterval* pupper,
+            size_t& count);
+
+    NodePtr m_root;
+
+    //! Lookup from event ID to interval so removal does not need the caller to know times
+    std::map<int, TimelineInterval> m_index;
+};
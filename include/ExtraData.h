@@ -0,0 +1,174 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : ExtraData.h
+*   Version     : 1.0
+*   Description : Compact key-value store for event extra data
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+
+/**
+ * IDs for the extra data keys used by the core and standard plugins. Keys not
+ * listed here are given IDs from EXTRA_COUNT upwards the first time they are used.
+ */
+enum extradata_key_t
+{
+    EXTRA_FILENAME,
+    EXTRA_HOSTLAYER,
+    EXTRA_GRAPHICNAME,
+    EXTRA_NOWTEXT,
+    EXTRA_NEXTTEXT,
+    EXTRA_INPUT,
+    EXTRA_OUTPUT,
+    EXTRA_DURATION,
+    EXTRA_TEMPLATEDATA,
+    EXTRA_PLACEHOLDERID,
+    EXTRA_COUNT
+};
+
+/**
+ * An interned extra data key. Holds only an integer, but converts to the key
+ * name so it can be used where a string is expected.
+ */
+class ExtraDataKey
+{
+public:
+    ExtraDataKey (extradata_key_t id) : m_id(id)
+    {
+    }
+
+    ExtraDataKey (const char *name) : m_id(intern(name))
+    {
+    }
+
+    ExtraDataKey (const std::string& name) : m_id(intern(name.c_str()))
+    {
+    }
+
+    int getId () const
+    {
+        return m_id;
+    }
+
+    const std::string& getName () const;
+
+    operator const std::string& () const
+    {
+        return getName();
+    }
+
+    int compare (const std::string& other) const
+    {
+        return getName().compare(other);
+    }
+
+    const char* c_str () const
+    {
+        return getName().c_str();
+    }
+
+    bool operator< (const ExtraDataKey& rhs) const
+    {
+        return m_id < rhs.m_id;
+    }
+
+    bool operator== (const ExtraDataKey& rhs) const
+    {
+        return m_id == rhs.m_id;
+    }
+
+private:
+    static int intern (const char *name);
+
+    int m_id;
+};
+
+/**
+ * Extra data attached to an event or action. Stored as a vector sorted by key
+ * ID, as events only carry a handful of entries. Has the parts of the
+ * std::map interface the rest of Tarantula uses, so entries are still
+ * reached with extras["filename"], count(), erase() and range-for.
+ */
+class ExtraData
+{
+public:
+    typedef std::pair<ExtraDataKey, std::string> value_type;
+    typedef std::vector<value_type>::iterator iterator;
+    typedef std::vector<value_type>::const_iterator const_iterator;
+
+    ExtraData ()
+    {
+    }
+
+    ExtraData (std::initializer_list<value_type> items);
+
+    std::string& operator[] (const ExtraDataKey& key);
+    std::string& at (const ExtraDataKey& key);
+    const std::string& at (const ExtraDataKey& key) const;
+
+    iterator find (const ExtraDataKey& key);
+    const_iterator find (const ExtraDataKey& key) const;
+    size_t count (const ExtraDataKey& key) const;
+    size_t erase (const ExtraDataKey& key);
+
+    iterator begin ()
+    {
+        return m_items.begin();
+    }
+
+    iterator end ()
+    {
+        return m_items.end();
+    }
+
+    const_iterator begin () const
+    {
+        return m_items.begin();
+    }
+
+    const_iterator end () const
+    {
+        return m_items.end();
+    }
+
+    size_t size () const
+    {
+        return m_items.size();
+    }
+
+    bool empty () const
+    {
+        return m_items.empty();
+    }
+
+    void clear ()
+    {
+        m_items.clear();
+    }
+
+private:
+    std::vector<value_type> m_items;
+};
@@ -0,0 +1,118 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : MPSCQueue.h
+*   Version     : 1.0
+*   Description : Lock-free queue with many producers and a single consumer
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * Unbounded lock-free FIFO queue. Any thread may push, but only one thread
+ * at a time may pop. Producers never wait for each other or for the consumer.
+ *
+ * The queue is a linked list with a dummy node at the tail. Producers swap
+ * themselves in at the head, then link the previous head to the new node, so
+ * a pop may briefly see the queue as empty while a push is half finished.
+ */
+template <typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue ()
+    {
+        Node *pstub = new Node;
+        m_head.store(pstub, std::memory_order_relaxed);
+        m_ptail = pstub;
+    }
+
+    ~MPSCQueue ()
+    {
+        T discard;
+        while (pop(discard))
+        {
+        }
+        delete m_ptail;
+    }
+
+    MPSCQueue (const MPSCQueue&) = delete;
+    MPSCQueue& operator= (const MPSCQueue&) = delete;
+
+    /**
+     * Add an item to the back of the queue. Safe to call from any thread.
+     *
+     * @param value Item to add
+     */
+    void push (T value)
+    {
+        Node *pnode = new Node;
+        pnode->m_value = std::move(value);
+
+        Node *pprev = m_head.exchange(pnode, std::memory_order_acq_rel);
+        pprev->m_pnext.store(pnode, std::memory_order_release);
+    }
+
+    /**
+     * Take the item at the front of the queue. Only call from the consumer thread.
+     *
+     * @param value Set to the item removed
+     * @return      False if the queue was empty
+     */
+    bool pop (T& value)
+    {
+        Node *pnext = m_ptail->m_pnext.load(std::memory_order_acquire);
+        if (!pnext)
+        {
+            return false;
+        }
+
+        // The next node becomes the new dummy once its value is taken
+        value = std::move(pnext->m_value);
+        delete m_ptail;
+        m_ptail = pnext;
+        return true;
+    }
+
+    /**
+     * Check for waiting items. Only meaningful on the consumer thread.
+     */
+    bool empty () const
+    {
+        return !m_ptail->m_pnext.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Node
+    {
+        Node () : m_pnext(nullptr)
+        {
+        }
+
+        std::atomic<Node*> m_pnext;
+        T m_value;
+    };
+
+    std::atomic<Node*> m_head; //!< Most recently pushed node, written by producers
+    Node *m_ptail; //!< Dummy node before the oldest item, only touched by the consumer
+};
@@ -28,6 +28,7 @@
 #include <map>
 #include <memory>
 #include <functional>
+#include <chrono>
 
 #include "PlaylistDB.h"
 
@@ -51,9 +52,28 @@ enum EventActionTypes {
     ACTION_UPDATE_DEVICES,
     ACTION_UPDATE_ACTIONS,
     ACTION_UPDATE_PROCESSORS,
-    ACTION_UPDATE_FILES
+    ACTION_UPDATE_FILES,
+    ACTION_UPDATE_GAPS,
+    ACTION_ADD_RECURRING,
+    ACTION_EDIT_RECURRING,
+    ACTION_REMOVE_RECURRING,
+    ACTION_SKIP_RECURRING
 };
 
+/**
+ * Order in which queued actions are run. Lower values run first.
+ */
+enum action_priority_t {
+    ACTIONPRIORITY_IMMEDIATE, //!< Someone is waiting on air for these, so they ignore the tick budget
+    ACTIONPRIORITY_EDIT,      //!< Changes to the playlist
+    ACTIONPRIORITY_REFRESH,   //!< Information requested by user interfaces
+    ACTIONPRIORITY_COUNT
+};
+
+const std::map<action_priority_t, std::string> action_priority_vector =
+        { { ACTIONPRIORITY_IMMEDIATE, "immediate" }, { ACTIONPRIORITY_EDIT, "edit" },
+                { ACTIONPRIORITY_REFRESH, "refresh" } };
+
 /**
  * A standard event structure to insert into the Channel playlist
  */
@@ -74,10 +94,14 @@ public:
 
     //! If set to zero duration is handled separately (ie video files or crosspoints with no duration). In seconds
     int m_duration;
-    std::map<std::string, std::string> m_extradata;
+    ExtraData m_extradata;
     std::vector<MouseCatcherEvent> m_childevents;
     std::string m_preprocessor;
 
+    //! Recurrence rule text, only used by recurring event actions
+    std::string m_recurrence;
+    //! Last time a recurring event may occur, or 0 for no end
+    long int m_recurrenceuntil = 0;
 };
 
 /**
@@ -94,16 +118,7 @@ struct EventAction {
     MouseCatcherSourcePlugin *thisplugin;
 
     std::shared_ptr<void> additionaldata;
-};
-
-class EventAction_check {
-public:
-    EventAction_check(EventAction& act) : m_action(act){};
-
-    inline bool operator() (MouseCatcherSourcePlugin* plugin) {
-        return (m_action.isprocessed) && (m_action.thisplugin == plugin);
-    }
 
-private:
-    EventAction m_action;
+    //! When the action was queued, to measure how long it waited
+    std::chrono::steady_clock::time_point queuedtime;
 };
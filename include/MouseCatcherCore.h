@@ -36,6 +36,20 @@
 //! All active source plugins
 extern std::vector<std::shared_ptr<MouseCatcherSourcePlugin>> g_mcsources;
 extern std::map<std::string, std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessors;
+//! Loaded EventProcessors by ID from g_deviceids
+extern std::vector<std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessortable;
+
+/**
+ * Queue statistics for one priority lane of MouseCatcher actions
+ */
+struct ActionLaneMetrics
+{
+    unsigned int m_depth = 0; //!< Actions waiting at the end of the last tick
+    unsigned long m_processed = 0; //!< Actions run since startup
+    double m_lastwait = 0; //!< Milliseconds the most recent action waited
+    double m_averagewait = 0; //!< Moving average of wait in milliseconds
+    double m_maxwait = 0; //!< Longest wait seen in milliseconds
+};
 
 /**
  * The MouseCatcher tool for event retrieval, mapping and processing and eventual insertion
@@ -43,14 +57,17 @@ extern std::map<std::string, std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcp
  */
 namespace MouseCatcherCore
 {
-    //! The queue of events to process
-    extern std::vector<EventAction>* g_pactionqueue;
+    //! Actions waiting for the core, pushed by sources from any thread
+    extern MPSCQueue<EventAction> g_actionqueue;
 
     void init (std::string sourcepath, std::string processorpath);
     void loadAllEventSourcePlugins (std::string path);
     void loadAllEventProcessorPlugins (std::string path);
     void eventSourcePluginTicks ();
     void eventQueueTicks ();
+    void pendingProcessorTicks ();
+    action_priority_t getActionPriority (EventActionTypes action);
+    ActionLaneMetrics getLaneMetrics (action_priority_t lane);
 
     // Playlist ActionQueue functions
     void removeEvent (EventAction& action);
@@ -59,18 +76,26 @@ namespace MouseCatcherCore
     void shuntEvents (EventAction& action);
     void triggerEvent (EventAction& action);
     void regenerateEvent (EventAction& action);
-    int processEvent (MouseCatcherEvent event, int lastid, bool ischild,
+    int processEvent (MouseCatcherEvent& event, int lastid, bool ischild,
             EventAction& action);
+    void addRecurringEvent (EventAction& action);
+    void removeRecurringEvent (EventAction& action);
+    void skipRecurringEvent (EventAction& action);
 
     // Devices ActionQueue functions
     void getLoadedDevices (EventAction& action);
     void getTypeActions (EventAction& action);
+    void getGaps (EventAction& action);
 
     // Convenience functions
     bool convertToPlaylistEvent (MouseCatcherEvent * const mcevent,
             int parentid, PlaylistEntry *playlistevent);
     bool convertToMCEvent (PlaylistEntry * const playlistevent,
             std::shared_ptr<Channel> channel, MouseCatcherEvent *generatedevent, Log *log);
+    void buildMCEventTrees (std::vector<PlaylistEntry>& playlistevents, const std::string& channelname,
+            std::vector<MouseCatcherEvent>& generatedevents);
     void getEvents (int channelid, time_t starttime, int length,
                 std::vector<MouseCatcherEvent>& eventvector, std::string action);
+    bool getScheduleGaps (std::string channelname, time_t starttime, int length, int mingap,
+            std::vector<TimelineGap>& gaps);
 }
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <future>
 #include <TarantulaPlugin.h>
 
 #include "MouseCatcherCommon.h"
@@ -50,11 +51,22 @@ public:
 
     void addPluginReference (std::shared_ptr<Plugin> thisplugin);
 
-    virtual void handleEvent (MouseCatcherEvent originalEvent,
+    virtual void handleEvent (MouseCatcherEvent& originalEvent,
             MouseCatcherEvent& resultingEvent);
 
+    virtual std::future<MouseCatcherEvent> handleEventAsync (MouseCatcherEvent originalEvent);
+
     //! Get information about processor used for EventSources
     ProcessorInformation getProcessorInformation ();
+
+    int getProcessorId ();
+    static std::shared_ptr<MouseCatcherProcessorPlugin> getProcessorById (int processorid);
 protected:
+    virtual bool checkRequirements ();
+
     ProcessorInformation m_processorinfo;
+
+private:
+    //! ID from g_deviceids, set when the processor is added to g_mcprocessors
+    int m_processorid;
 };
@@ -29,6 +29,7 @@
 
 #include "PluginConfig.h"
 #include "MouseCatcherProcessorPlugin.h"
+#include "MPSCQueue.h"
 
 /**
  * Base class for an EventSource Plugin
@@ -41,7 +42,9 @@ public:
 
     void addPluginReference (std::shared_ptr<Plugin> thisplugin);
 
-    virtual void tick (std::vector<EventAction> *ActionQueue)=0;
+    virtual void tick ()=0;
+
+    void completeAction (EventAction& action);
 
     // Callbacks used to update plugin from the core
     virtual void updatePlaylist (std::vector<MouseCatcherEvent>& playlist,
@@ -57,9 +60,9 @@ public:
     virtual void updateFiles (std::string device,
     		std::vector<std::pair<std::string, int>>& files,
             std::shared_ptr<void> additionaldata)=0;
+    virtual void updateGaps (std::string channel, std::vector<TimelineGap>& gaps,
+            std::shared_ptr<void> additionaldata);
 
-    static bool actionCompleteCheck (const EventAction &a,
-    		const MouseCatcherSourcePlugin *plugin);
 protected:
     void getEvents (int channelid, time_t since,
             std::vector<MouseCatcherEvent>* eventvector);
@@ -67,5 +70,12 @@ protected:
     bool deleteEvent (int eventid);
     bool editEvent (int eventid, MouseCatcherEvent event);
 
+    void queueAction (EventAction action);
+    bool getCompletedAction (EventAction& action);
+
+private:
+    //! Actions from this source which the core has finished with, consumed in tick()
+    MPSCQueue<EventAction> m_completedactions;
+
 };
 
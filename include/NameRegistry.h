@@ -0,0 +1,50 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : NameRegistry.h
+*   Version     : 1.0
+*   Description : Maps names of channels, devices and processors to small integer IDs
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * Gives each name a small, stable integer ID the first time it is seen, so
+ * hot paths can index arrays instead of searching by name. IDs count up from
+ * 0 and are never reused, but are only valid for the life of the process.
+ *
+ * There is no locking, so registries must only be used from the tick thread.
+ */
+class NameRegistry
+{
+public:
+    int intern (const std::string& name);
+    int find (const std::string& name) const;
+    const std::string& getName (int id) const;
+    size_t size () const;
+
+private:
+    std::unordered_map<std::string, int> m_ids;
+    std::vector<std::string> m_names;
+};
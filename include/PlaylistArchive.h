@@ -0,0 +1,101 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : PlaylistArchive.h
+*   Version     : 1.0
+*   Description : Compact binary file format for saving and loading event trees
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "PlaylistDB.h"
+
+/*
+ * File layout, all integers little-endian:
+ *
+ *   "TPLA" magic, uint16 version, uint16 flags (unused, 0)
+ *   Records: uint32 length, then one top-level event tree of that many bytes
+ *   A record length of 0 marks the end of the file
+ *
+ * Each event is: int32 id, uint8 type, int64 trigger, str device, uint8 devicetype,
+ * int32 action, int32 duration, str preprocessor, str description,
+ * uint32 extras count then str key/str value pairs, uint32 child count then child events.
+ * A str is a uint32 length followed by that many bytes.
+ */
+
+#define PLAYLISTARCHIVE_VERSION 1
+
+/**
+ * A playlist event together with all of its children
+ */
+struct ArchivedEvent
+{
+    PlaylistEntry m_event;
+    std::vector<ArchivedEvent> m_children;
+};
+
+/**
+ * Streams event trees out to an archive file one record at a time
+ */
+class PlaylistArchiveWriter
+{
+public:
+    PlaylistArchiveWriter (std::string filename);
+    ~PlaylistArchiveWriter ();
+
+    void writeEvent (const ArchivedEvent& event);
+    void close ();
+
+private:
+    static void encodeEvent (const ArchivedEvent& event, std::string& buffer);
+    static void encodeInt (uint64_t value, int bytes, std::string& buffer);
+    static void encodeString (const std::string& value, std::string& buffer);
+
+    std::ofstream m_file;
+    std::string m_buffer; //!< Reused between records to avoid reallocating
+    bool m_failed;        //!< A write has gone wrong, so the end marker must never be written
+};
+
+/**
+ * Reads event trees from an archive file, mapping the whole file into memory
+ */
+class PlaylistArchiveReader
+{
+public:
+    PlaylistArchiveReader (std::string filename);
+    ~PlaylistArchiveReader ();
+
+    bool readEvent (ArchivedEvent& event);
+
+private:
+    void decodeEvent (const uint8_t*& pos, const uint8_t* end, ArchivedEvent& event, int depth);
+    static uint64_t decodeInt (const uint8_t*& pos, const uint8_t* end, int bytes);
+    static std::string decodeString (const uint8_t*& pos, const uint8_t* end);
+
+    int m_fd;
+    const uint8_t* m_pdata;
+    size_t m_size;
+    const uint8_t* m_pos;
+};
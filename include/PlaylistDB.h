@@ -28,8 +28,14 @@
 #include <iostream>
 #include <cstdlib>
 #include <map>
+#include <set>
 #include <mutex>
 #include "SQLiteDB.h" //parent class
+#include "EventTimeline.h"
+#include "RecurrenceRule.h"
+#include "ExtraData.h"
+
+struct ArchivedEvent;
 
 
 enum playlist_event_type_t
@@ -63,7 +69,7 @@ public:
     int actionid;
     std::string name;
     std::string description;
-    std::map<std::string, std::string> extradata;
+    ExtraData extradata;
     operator int () const
     {
         return actionid;
@@ -114,6 +120,7 @@ public:
 
     int m_trigger; //! May be either a unix timestamp or a manual event something (see #3)
     std::string m_device;
+    int m_deviceid; //!< ID of m_device from g_deviceids, or -1 if no such device has been loaded
     playlist_device_type_t m_devicetype;
     int m_action;
 
@@ -121,11 +128,29 @@ public:
 
     int m_duration; //<! Duration of event measured in seconds
     int m_parent;
-    std::map<std::string, std::string> m_extras;
+    ExtraData m_extras;
     std::string m_preprocessor;
     PlaylistEntry ();
 };
 
+/**
+ * A rule for a repeating top-level event, stored once and expanded into
+ * PlaylistEntry rows a little ahead of time
+ */
+class RecurringEntry
+{
+public:
+    int m_ruleid;
+    RecurrenceRule m_rule;
+    PlaylistEntry m_template; //!< Event to create at each occurrence. Trigger is ignored
+    std::set<time_t> m_exceptions; //!< Occurrences which should be skipped
+    time_t m_until; //!< No occurrences after this time, or 0 for no end
+    time_t m_expandeduntil; //!< Occurrences up to here have already been added to the playlist
+    RecurringEntry ();
+
+    void getOccurrences (time_t from, time_t to, std::vector<time_t>& result) const;
+};
+
 /**
  * This is an extension of SQLiteDB to hold Playlist data in a playlist table,
  * with a structure corresponding to the playlist XML spec.
@@ -135,6 +160,7 @@ class PlaylistDB: public SQLiteDB
 public:
     PlaylistDB (std::string channel);
     int addEvent (PlaylistEntry *pobj);
+    bool updateEvent (PlaylistEntry *pobj);
 
     std::vector<PlaylistEntry> getEvents (playlist_event_type_t type,
             time_t trigger);
@@ -142,40 +168,88 @@ public:
     int getParentEventID (int eventID);
     bool getEventDetails (int eventID, PlaylistEntry &foundevent);
     std::vector<PlaylistEntry> getEventList (time_t starttime, int length);
+    std::vector<PlaylistEntry> getEventForest (time_t starttime, int length);
+    void getDescendants (std::vector<PlaylistEntry>& events);
     void processEvent (int eventID);
+    void setEventPending (int eventID, bool pending);
     void removeEvent (int eventID);
     int getActiveHold (time_t bytime);
     void shunt (time_t starttime, int shuntlength);
+    bool applyOverlapPolicy (time_t start, time_t end, timeline_overlap_policy_t policy, int ignoreid = -1);
 
     std::vector<PlaylistEntry> getExecutingEvents ();
     PlaylistEntry getNextEvent ();
 
+    const EventTimeline& getTimeline ();
+    void pruneTimeline (time_t cutoff);
+    static time_t getEndTime (time_t trigger, int duration);
+
+    int addRecurrence (RecurringEntry& rule);
+    bool updateRecurrence (RecurringEntry& rule);
+    void removeRecurrence (int ruleid);
+    bool addRecurrenceException (int ruleid, time_t occurrence);
+    std::vector<RecurringEntry> getRecurrences ();
+    void addRecurrenceInstance (int ruleid, int eventid, time_t trigger);
+    void setRecurrenceExpanded (int ruleid, time_t expandeduntil);
+
+    int exportRange (std::string file, time_t starttime, int length);
+    int importRange (std::string file, int timeoffset = 0);
+
     void writeToDisk (std::string file, std::string table, std::timed_mutex &core_lock);
 
 private:
     void populateEvent (sqlite3_stmt *pstmt, PlaylistEntry *pple);
     void getExtraData (PlaylistEntry *pple);
+    void readEventRows (sqlite3_stmt *pstmt, std::vector<PlaylistEntry>& eventlist);
+    std::vector<PlaylistEntry> readChildEvents (std::shared_ptr<DBQuery> query, int parentid);
 
     void readFromDisk (std::string file, std::string table);
 
+    void archiveChildren (ArchivedEvent& event);
+    int importArchivedEvent (ArchivedEvent& event, int parent, int timeoffset);
+
+    void removeRecurrenceInstances (int ruleid, time_t from, time_t to);
+    bool storeRecurrence (RecurringEntry& rule);
+    void writeRecurrenceExtras (RecurringEntry& rule);
+
     std::string m_channame;
 
+    //! Top-level events on this channel, kept in step with the database for fast overlap queries
+    EventTimeline m_timeline;
+
     std::shared_ptr<DBQuery> m_addevent_query;
     std::shared_ptr<DBQuery> m_getevent_query;
     std::shared_ptr<DBQuery> m_getchildevents_query;
+    std::shared_ptr<DBQuery> m_getremovechildren_query;
+    std::shared_ptr<DBQuery> m_getarchivechildren_query;
     std::shared_ptr<DBQuery> m_getparentevent_query;
     std::shared_ptr<DBQuery> m_geteventdetails_query;
     std::shared_ptr<DBQuery> m_removeevent_query;
     std::shared_ptr<DBQuery> m_processevent_query;
+    std::shared_ptr<DBQuery> m_setpending_query;
     std::shared_ptr<DBQuery> m_addextras_query;
+    std::shared_ptr<DBQuery> m_updateevent_query;
+    std::shared_ptr<DBQuery> m_removeextras_query;
     std::shared_ptr<DBQuery> m_getextras_query;
     std::shared_ptr<DBQuery> m_gethold_query;
     std::shared_ptr<DBQuery> m_geteventlist_query;
     std::shared_ptr<DBQuery> m_getdeletelist_query;
     std::shared_ptr<DBQuery> m_getupdatelist_query;
     std::shared_ptr<DBQuery> m_getextradata_query;
-    std::shared_ptr<DBQuery> m_shunt_eventcount_query;
     std::shared_ptr<DBQuery> m_shunt_eventupdate_query;
-    std::shared_ptr<DBQuery> m_getcurrent_toplevel_query;
     std::shared_ptr<DBQuery> m_getnext_toplevel_query;
+    std::shared_ptr<DBQuery> m_gettimeline_query;
+
+    // Queries for recurring events
+    std::shared_ptr<DBQuery> m_addrecurrence_query;
+    std::shared_ptr<DBQuery> m_updaterecurrence_query;
+    std::shared_ptr<DBQuery> m_removerecurrence_query;
+    std::shared_ptr<DBQuery> m_getrecurrences_query;
+    std::shared_ptr<DBQuery> m_setrecurrenceexpanded_query;
+    std::shared_ptr<DBQuery> m_addrecurrenceextras_query;
+    std::shared_ptr<DBQuery> m_getrecurrenceextras_query;
+    std::shared_ptr<DBQuery> m_removerecurrenceextras_query;
+    std::shared_ptr<DBQuery> m_addrecurrenceinstance_query;
+    std::shared_ptr<DBQuery> m_getrecurrenceinstances_query;
+    std::shared_ptr<DBQuery> m_removerecurrenceinstances_query;
 };
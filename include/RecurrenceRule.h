@@ -0,0 +1,75 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : RecurrenceRule.h
+*   Version     : 1.0
+*   Description : Parses and expands rules for recurring playlist events
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <bitset>
+#include <ctime>
+#include <string>
+#include <vector>
+
+enum recurrence_type_t
+{
+    RECUR_DAILY,  //!< RECUR_DAILY  "daily HH:MM[:SS]"
+    RECUR_WEEKLY, //!< RECUR_WEEKLY "weekly mon,wed,fri HH:MM[:SS]"
+    RECUR_CRON    //!< RECUR_CRON   "cron MIN HOUR DAY MONTH WEEKDAY", with *, lists, ranges and steps
+};
+
+/**
+ * A rule describing when a recurring event happens, in local time.
+ * Constructed from a short text specification, which is also how rules are stored.
+ */
+class RecurrenceRule
+{
+public:
+    RecurrenceRule ();
+    explicit RecurrenceRule (std::string spec);
+
+    std::string getSpec () const;
+    recurrence_type_t getType () const;
+
+    void getOccurrences (time_t from, time_t to, std::vector<time_t>& result) const;
+
+private:
+    static void parseField (std::string field, int min, int max, std::bitset<64>& bits);
+    static void parseTime (std::string field, int& hour, int& minute, int& second);
+    static int parseWeekday (std::string name);
+
+    bool matchesDay (const tm& day) const;
+
+    std::string m_spec;
+    recurrence_type_t m_type;
+
+    int m_second;
+    std::bitset<64> m_minutes;
+    std::bitset<64> m_hours;
+    std::bitset<64> m_days;     //!< Day of month, 1-31
+    std::bitset<64> m_months;   //!< 1-12
+    std::bitset<64> m_weekdays; //!< 0-6, Sunday is 0
+
+    // Cron matches either day field when both are restricted
+    bool m_daysrestricted;
+    bool m_weekdaysrestricted;
+};
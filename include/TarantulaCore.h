@@ -36,6 +36,7 @@
 #include "ErrorMacro.h"
 #include "BaseConfigLoader.h"
 #include "AsyncJobSystem.h"
+#include "NameRegistry.h"
 
 // Forward declarations to save on #includes
 class Log;
@@ -65,6 +66,10 @@ extern std::shared_ptr<BaseConfigLoader> g_pbaseconfig;
 extern std::shared_ptr<SQLiteDB> g_pcoredatabase;
 
 extern std::map<std::string, std::shared_ptr<Device>> g_devices;
+// ID registries and tables are unsynchronised, so only touch them from the tick thread
+extern NameRegistry g_channelids; //!< Channel IDs, which are also indices into g_channels
+extern NameRegistry g_deviceids; //!< Shared by devices and EventProcessors, as events may target either
+extern std::vector<std::shared_ptr<Device>> g_devicetable; //!< Loaded devices by ID from g_deviceids
 extern std::vector<PluginStateData> g_plugins;
 extern std::unordered_map<std::string, PreProcessorHandler> g_preprocessorlist;
 
@@ -30,6 +30,7 @@
 #include <vector>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <libCaspar/CasparResponse.h>
 
 enum CasparCommandType
 {
@@ -71,7 +72,7 @@ enum CasparCommandType
 };
 
 // Typedef for handler function
-typedef boost::function<void(std::vector<std::string>&)> ResponseHandler;
+typedef boost::function<void(CasparResponse&)> ResponseHandler;
 
 /**
  * This class is pretty dumb - it just strings commands together.
@@ -85,7 +86,8 @@ public:
     CasparCommand (CasparCommandType cct, ResponseHandler handler);
     void addParam (std::string param);
     void clearParams ();
-    std::string form (); // Form the command to a string
+    void form (std::string& buffer) const; // Append the command to a buffer
+    std::string form () const; // Form the command to a string
 
     ResponseHandler getHandler ();
 protected:
@@ -94,9 +96,7 @@ protected:
     void setType (CasparCommandType cct);
 private:
     std::vector<std::string> m_params; // Components of the command
-    std::map<CasparCommandType, std::string> CasparCommandTypeText;
-    std::string getCommandQuery (CasparCommandType command);
-    std::string m_commandquery;
+    const char *m_ptemplate; //!< Entry from the command table, with a ? for each parameter
 
     ResponseHandler m_handler;
 };
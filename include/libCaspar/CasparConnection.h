@@ -29,6 +29,8 @@
 #include <libCaspar/CasparCommand.h>
 #include <boost/asio.hpp>
 #include <string>
+#include <deque>
+#include <utility>
 #include <queue>
 #include <chrono>
 
@@ -48,6 +50,12 @@
 #define S_COMMAND_EXECUTED_WITH_DATA 201
 #define S_COMMAND_EXECUTED_WITH_MANY_DATA 200
 
+//! Commands written ahead of their responses unless set otherwise
+#define CASPAR_DEFAULT_PIPELINE_DEPTH 4
+
+//! Most bytes to take from the socket in one read
+#define CASPAR_READ_SIZE 4096
+
 /**
  * Handles connecting to and passing data to and from CasparCG
  */
@@ -57,10 +65,14 @@ public:
     CasparConnection (std::string host, std::string port, long int connecttimeout);
     ~CasparConnection ();
 
-    std::string receiveLine ();
     bool tick ();
     void run (int timeout = 1000);
-    void sendCommand (CasparCommand cmd);
+    void stop ();
+    bool waitForConnect (int timeout);
+    bool isIdle ();
+    void close ();
+    void sendCommand (CasparCommand cmd, bool urgent = false);
+    void setPipelineDepth (int depth);
 
     bool m_errorflag;      //! Connection error
     bool m_badcommandflag; //! Connection still good but CasparCG returned an error
@@ -68,8 +80,13 @@ public:
 
 private:
     std::string queryResponse (int responsecode);
-    std::vector <std::string> m_datalines;
-    std::queue <CasparCommand> m_commandqueue;
+    std::deque <CasparCommand> m_commandqueue; //!< Commands waiting to be written, urgent ones first
+    std::deque <CasparCommand> m_inflight;     //!< Commands written and awaiting a response, oldest first
+    unsigned int m_urgentcount;                //!< Number of urgent commands at the front of m_commandqueue
+    unsigned int m_pipelinedepth;              //!< Most commands allowed in m_inflight
+    std::string m_writebuffer;                 //!< Commands being written, reused for each write and untouched until it completes
+    bool m_writing;
+    bool m_reading;
 
     long int m_connecttimeout;
 
@@ -77,12 +94,24 @@ private:
     boost::asio::ip::tcp::socket m_socket;
     boost::asio::streambuf m_recvdata;
 
+    CasparResponse m_response;                               //!< Reused for every response to save allocating
+    bool m_statusread;                                       //!< First line of the current response is parsed
+    std::pair<size_t, size_t> m_statusline;                  //!< Start and length of the first line
+    std::vector<std::pair<size_t, size_t>> m_lineoffsets;    //!< Start and length of each line of data
+    size_t m_linestart;                                      //!< Start of the line being parsed
+    size_t m_parsepos;                                       //!< First byte not yet scanned for a newline
+
     void cb_connect (const boost::system::error_code& err);
     void cb_write (const boost::system::error_code& err);
-    void cb_firstread (const boost::system::error_code& err);
-    void cb_doneread (const boost::system::error_code& err);
-    void processData (std::istream& is);
-    void sendQueuedCommand ();
+    void cb_read (const boost::system::error_code& err, size_t length);
+    void readResponse ();
+    bool parseResponse ();
+    bool hasData (int responsecode);
+    void finishResponse ();
+    void resetResponse ();
+    void writeNext ();
+    void startRead ();
 
-    void runTimeout ();
+    void runTimeout (const boost::system::error_code& err);
+    void connectTimeout (const boost::system::error_code& err);
 };
@@ -35,13 +35,18 @@
 class CasparQueryResponseProcessor
 {
 public:
-    static void getMediaList (std::vector<std::string>& response,
+    static void getMediaList (const CasparResponse& response,
             std::vector<std::string>& medialist);
-    static void getTemplateList (std::vector<std::string>& response,
+    static void getTemplateList (const CasparResponse& response,
             std::vector<std::string>& templatelist);
-    static int readLayerStatus (std::vector<std::string>& response,
+    static int readLayerStatus (const CasparResponse& response,
             std::string& filename);
-    static int readFileFrames(std::vector<std::string>& response, int layer = -1);
+    static int readFileFrames(const CasparResponse& response, int layer = -1);
+
+private:
+    static int readLayerStatusDOM (const CasparResponse& response,
+            std::string& filename);
+    static int readFileFramesDOM (const CasparResponse& response, int layer);
 
 };
 
@@ -0,0 +1,68 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : CasparResponse.h
+*   Version     : 1.0
+*   Description : View of a response received from CasparCG
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A run of characters inside a response, pointing into the receive buffer
+ * rather than holding a copy. Line endings are not included.
+ */
+struct CasparLine
+{
+    const char *m_pdata;
+    size_t m_length;
+
+    std::string str () const;
+    bool operator== (const char *text) const;
+    bool operator!= (const char *text) const;
+};
+
+/**
+ * One complete response from CasparCG. The lines point straight into the
+ * connection's receive buffer, so are only valid until the handler returns.
+ * Copy out anything which is needed for longer with CasparLine::str().
+ */
+class CasparResponse
+{
+    friend class CasparConnection;
+
+public:
+    CasparResponse ();
+
+    int getCode () const;
+    const CasparLine& getStatus () const;
+    const std::vector<CasparLine>& getLines () const;
+    const CasparLine& getPayload () const;
+
+private:
+    int m_code;
+    CasparLine m_status;             //!< First line, such as "201 INFO OK"
+    std::vector<CasparLine> m_lines; //!< Lines of data after the status, without the blank line ending them
+    CasparLine m_payload;            //!< All the data lines as one block, line endings included
+};
@@ -0,0 +1,64 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : CasparSharedConnection.h
+*   Version     : 1.0
+*   Description : Long-lived background connection shared between plugins
+*
+*****************************************************************************/
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Only a declaration, as CasparConnection.h includes libCaspar.h which includes this file
+class CasparConnection;
+
+//! Longest to wait for a background connection to open, in milliseconds
+#define CASPAR_SHARED_CONNECT_TIMEOUT 5000
+
+/**
+ * A long-lived connection to a CasparCG server for background queries such
+ * as media rescans, kept apart from the playout connection so slow queries
+ * never hold up time-critical commands. Every plugin using the same server
+ * shares one, and it is only reopened after something goes wrong.
+ */
+class CasparSharedConnection
+{
+public:
+    typedef std::function<bool(std::shared_ptr<CasparConnection>)> CasparBatch;
+
+    static std::shared_ptr<CasparSharedConnection> get (std::string host, std::string port);
+
+    CasparSharedConnection (std::string host, std::string port);
+    ~CasparSharedConnection ();
+
+    bool runBatch (CasparBatch batch);
+
+private:
+    void drop ();
+
+    std::string m_host;
+    std::string m_port;
+    std::shared_ptr<CasparConnection> m_pconnection; //!< Open connection, or null until next needed
+    std::mutex m_lock; //!< Held for a whole batch, as CasparConnection is not thread safe
+};
@@ -34,4 +34,5 @@
 #include <libCaspar/CasparFlashCommand.h>
 #include <libCaspar/CasparQueryResponseProcessor.h>
 #include <libCaspar/CasparConnection.h>
+#include <libCaspar/CasparSharedConnection.h>
 
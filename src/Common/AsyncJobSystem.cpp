@@ -28,29 +28,341 @@
 
 extern std::timed_mutex g_core_lock;
 
+//! Which worker (if any) this thread is, so jobs queued from a job stay on the same worker
+static thread_local AsyncJobSystem *t_pjobsystem = nullptr;
+static thread_local unsigned int t_workerid = 0;
+
+//! Job being run by this thread, for isJobCancelled() and setCancelHandler()
+static thread_local AsyncJobData *t_pcurrentjob = nullptr;
+
+AsyncJobHandle::AsyncJobHandle ()
+{
+}
+
 /**
- * Constructor. Launches the job running thread
+ * @param pjob Job to refer to
+ */
+AsyncJobHandle::AsyncJobHandle (std::shared_ptr<AsyncJobData> pjob) :
+        m_pjob(pjob)
+{
+}
+
+/**
+ * Stop the job from running again. A run already in progress is asked to
+ * stop through its cancel handler, and its callback still runs.
+ */
+void AsyncJobHandle::cancel ()
+{
+    if (!m_pjob)
+    {
+        return;
+    }
+
+    m_pjob->m_cancelled = true;
+
+    // Only a job sat in a queue can be stopped here, running ones are dealt with when they finish
+    AsyncJobState expected = JOB_READY;
+    if (!m_pjob->m_state.compare_exchange_strong(expected, JOB_CANCELLED))
+    {
+        expected = JOB_WAITING;
+        if (!m_pjob->m_state.compare_exchange_strong(expected, JOB_CANCELLED))
+        {
+            if (JOB_RUNNING == expected)
+            {
+                AsyncJobSystem::cancelRunningJob(m_pjob);
+            }
+            return;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_pjob->m_finishedlock);
+        m_pjob->m_finished = true;
+    }
+    m_pjob->m_finishedcv.notify_all();
+}
+
+/**
+ * Change how long a single run of the job may take before the watchdog cancels it
+ *
+ * @param timeout Time limit, or zero for no limit
+ */
+void AsyncJobHandle::setTimeout (std::chrono::milliseconds timeout)
+{
+    if (m_pjob)
+    {
+        m_pjob->m_timeoutms = timeout.count();
+    }
+}
+
+AsyncJobState AsyncJobHandle::getState () const
+{
+    return m_pjob ? m_pjob->m_state.load() : JOB_ERASE;
+}
+
+/**
+ * @return True once the job will never run again. Its callback may still be waiting for the tick.
+ */
+bool AsyncJobHandle::isFinished () const
+{
+    return !m_pjob || m_pjob->m_finished;
+}
+
+/**
+ * Block until the job will never run again. Does not wait for the callback,
+ * so is safe to use from the tick thread, but a repeating job must be
+ * cancelled first or this never returns.
+ */
+void AsyncJobHandle::wait () const
+{
+    if (!m_pjob)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_pjob->m_finishedlock);
+    m_pjob->m_finishedcv.wait(lock, [this]{return m_pjob->m_finished.load();});
+}
+
+/**
+ * Block until the job will never run again, or a timeout passes
+ *
+ * @param timeout Longest time to wait
+ * @return        True if the job finished
+ */
+bool AsyncJobHandle::waitFor (std::chrono::milliseconds timeout) const
+{
+    if (!m_pjob)
+    {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(m_pjob->m_finishedlock);
+    return m_pjob->m_finishedcv.wait_for(lock, timeout, [this]{return m_pjob->m_finished.load();});
+}
+
+AsyncJobHandle::operator bool () const
+{
+    return static_cast<bool>(m_pjob);
+}
+
+/**
+ * Constructor. Launches the timer and watchdog threads and a single worker,
+ * more workers may be added by setWorkerCount()
  */
 AsyncJobSystem::AsyncJobSystem ():
         m_halt(false),
-        m_async_thread(std::bind(&AsyncJobSystem::asyncJobRunner, this))
+        m_workercount(0),
+        m_nextworker(0),
+        m_queuedjobs(0),
+        m_nextsequence(0),
+        m_defaulttimeoutms(0),
+        m_timedoutjobs(0),
+        m_replacedworkers(0),
+        m_abandonedworkers(0),
+        m_categorycount(0)
 {
+    // Slot 0 catches jobs without a category, and any beyond ASYNC_MAX_CATEGORIES
+    findCategory("Other");
 
+    setWorkerCount(1);
+    m_timerthread = std::thread(&AsyncJobSystem::timerRunner, this);
+    m_watchdogthread = std::thread(&AsyncJobSystem::watchdogRunner, this);
 }
 
 /**
- * Destructor. Stops the thread
+ * Destructor. Stops and joins all the worker threads
  */
 AsyncJobSystem::~AsyncJobSystem ()
 {
-    // Set the kill flag
-    m_halt = true;
+    {
+        std::lock_guard<std::mutex> lock(m_async_cv_mx);
+        m_halt = true;
+    }
+    m_async_cv.notify_all();
 
-    // Add a new empty job to force the wait to exit
-    m_jobs.insert(std::make_shared<AsyncJobData>());
-    m_async_cv.notify_one();
+    {
+        std::lock_guard<std::mutex> lock(m_timerlock);
+    }
+    m_timercv.notify_all();
+    m_timerthread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(m_watchdoglock);
+    }
+    m_watchdogcv.notify_all();
+    m_watchdogthread.join();
+
+    for (unsigned int i = 0; i < m_workercount; ++i)
+    {
+        if (m_workers[i]->m_thread.joinable())
+        {
+            m_workers[i]->m_thread.join();
+        }
+    }
+
+    // Give abandoned workers a moment to finish, but a truly hung one cannot hold up shutdown
+    for (int i = 0; i < 20 && m_abandonedworkers > 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+/**
+ * Grow the pool of worker threads. The pool never shrinks while running.
+ *
+ * @param workers Number of workers wanted, capped at ASYNC_MAX_WORKERS
+ */
+void AsyncJobSystem::setWorkerCount (unsigned int workers)
+{
+    std::lock_guard<std::mutex> lock(m_workerstart_mutex);
+
+    workers = std::min(workers, static_cast<unsigned int>(ASYNC_MAX_WORKERS));
+
+    for (unsigned int i = m_workercount; i < workers; ++i)
+    {
+        m_workers[i].reset(new AsyncWorker);
+        m_workers[i]->m_generation = 0;
+        m_workers[i]->m_overdue = false;
+        m_workers[i]->m_thread = std::thread(&AsyncJobSystem::asyncJobRunner, this, i, 0);
+
+        // Publish the slot only once it is fully set up, as other workers may steal from it straight away
+        m_workercount = i + 1;
+    }
+}
+
+/**
+ * @return Number of worker threads currently running
+ */
+unsigned int AsyncJobSystem::getWorkerCount ()
+{
+    return m_workercount;
+}
+
+/**
+ * Set the time limit given to jobs created from now on
+ *
+ * @param timeout Longest a single run may take, or zero for no limit
+ */
+void AsyncJobSystem::setDefaultTimeout (std::chrono::milliseconds timeout)
+{
+    m_defaulttimeoutms = timeout.count();
+}
+
+/**
+ * @return Number of runs the watchdog has cancelled for going over their time limit
+ */
+unsigned long AsyncJobSystem::getTimedOutJobs ()
+{
+    return m_timedoutjobs;
+}
+
+/**
+ * @return Number of workers abandoned to a hung job and replaced
+ */
+unsigned long AsyncJobSystem::getReplacedWorkers ()
+{
+    return m_replacedworkers;
+}
 
-    m_async_thread.join();
+/**
+ * @return Number of jobs waiting in the worker queues, not counting those held back by a strand
+ */
+int AsyncJobSystem::getQueuedJobs ()
+{
+    return m_queuedjobs;
+}
+
+/**
+ * Take a snapshot of the counters for every job category. Never blocks the
+ * workers, so is safe to call from anywhere at any time.
+ *
+ * @return Metrics for each category, "Other" first
+ */
+std::vector<AsyncJobMetrics> AsyncJobSystem::getMetrics ()
+{
+    std::vector<AsyncJobMetrics> result;
+    unsigned int categorycount = m_categorycount.load(std::memory_order_acquire);
+    result.resize(categorycount);
+
+    for (unsigned int i = 0; i < categorycount; ++i)
+    {
+        const AsyncJobCategory& category = *m_categories[i];
+        AsyncJobMetrics& metrics = result[i];
+
+        metrics.m_category = category.m_name;
+        metrics.m_submitted = category.m_submitted.load(std::memory_order_relaxed);
+        metrics.m_queued = category.m_queued.load(std::memory_order_relaxed);
+        metrics.m_running = category.m_running.load(std::memory_order_relaxed);
+        metrics.m_completed = category.m_completed.load(std::memory_order_relaxed);
+        metrics.m_failed = category.m_failed.load(std::memory_order_relaxed);
+        metrics.m_expired = category.m_expired.load(std::memory_order_relaxed);
+        metrics.m_cancelled = category.m_cancelled.load(std::memory_order_relaxed);
+
+        for (int bucket = 0; bucket < ASYNC_HISTOGRAM_BUCKETS; ++bucket)
+        {
+            metrics.m_waithistogram.push_back(category.m_waithistogram[bucket].load(std::memory_order_relaxed));
+            metrics.m_runhistogram.push_back(category.m_runhistogram[bucket].load(std::memory_order_relaxed));
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Get the upper limit of a histogram bucket in AsyncJobMetrics
+ *
+ * @param bucket Bucket number
+ * @return       Times in the bucket are under this many milliseconds, or -1 for the last bucket
+ */
+long AsyncJobSystem::getHistogramLimit (int bucket)
+{
+    if (bucket >= ASYNC_HISTOGRAM_BUCKETS - 1)
+    {
+        return -1;
+    }
+
+    return 1L << bucket;
+}
+
+/**
+ * Check whether the job running on this thread has been cancelled, either by
+ * its handle or by the watchdog. Long-running jobs should check this now and
+ * then and return early when it is set.
+ *
+ * @return True if the current job should stop. Always false outside a job.
+ */
+bool AsyncJobSystem::isJobCancelled ()
+{
+    return t_pcurrentjob && (t_pcurrentjob->m_cancelled || t_pcurrentjob->m_runcancelled);
+}
+
+/**
+ * Set a function to be called from another thread if the job running on this
+ * thread is cancelled. Use this to break out of blocking calls which cannot
+ * poll isJobCancelled(). The handler is cleared when the job returns.
+ *
+ * @param handler Function to call, which must be safe to call from any thread
+ */
+void AsyncJobSystem::setCancelHandler (std::function<void()> handler)
+{
+    if (!t_pcurrentjob)
+    {
+        return;
+    }
+
+    bool cancelled;
+    {
+        std::lock_guard<std::mutex> lock(t_pcurrentjob->m_cancelhandlerlock);
+        t_pcurrentjob->m_cancelhandler = handler;
+        cancelled = t_pcurrentjob->m_cancelled || t_pcurrentjob->m_runcancelled;
+    }
+
+    // Already too late, so stop straight away
+    if (cancelled && handler)
+    {
+        handler();
+    }
 }
 
 /**
@@ -61,124 +373,721 @@ AsyncJobSystem::~AsyncJobSystem ()
  * @param data      Data to pass to the job (void pointer)
  * @param priority  Numerical priority of the job, higher priorities will run first
  * @param repeat    Should the job repeat indefinitely?
- * @return          Pointer to the new job to allow later updates
+ * @param strand    Name of the strand to run the job on, or empty to run whenever a worker is free
+ * @param category  Category to count the job under in metrics, usually the plugin name
+ * @return          Handle to check on or cancel the job
  */
-std::shared_ptr<AsyncJobData> AsyncJobSystem::newAsyncJob (AsyncJobFunction func, AsyncJobCallback cb,
-        const std::shared_ptr<void> data, int priority, bool repeat)
+AsyncJobHandle AsyncJobSystem::newAsyncJob (AsyncJobFunction func, AsyncJobCallback cb,
+        const std::shared_ptr<void> data, int priority, bool repeat, const std::string& strand,
+        const std::string& category)
+{
+    std::shared_ptr<AsyncJobData> newjob = makeJob(func, cb, data, priority, strand, category);
+    newjob->m_repeat = repeat;
+    newjob->m_state = JOB_READY;
+
+    enqueueJob(newjob);
+
+    return AsyncJobHandle(newjob);
+}
+
+/**
+ * Add a job which runs after a delay, and optionally repeats at a fixed interval
+ *
+ * @param func      Function to call to run the job
+ * @param cb        Function to call synchronously after each run has completed
+ * @param data      Data to pass to the job (void pointer)
+ * @param priority  Numerical priority of the job once it is due
+ * @param delay     Time from now until the first run
+ * @param interval  Time between the start of each run, or zero to run once.
+ *                  Runs missed because the last one overran are skipped.
+ * @param deadline  Longest a run may wait past its due time before it is dropped,
+ *                  or zero to always run
+ * @param strand    Name of the strand to run the job on, or empty to run whenever a worker is free
+ * @param category  Category to count the job under in metrics, usually the plugin name
+ * @return          Handle to check on or cancel the job
+ */
+AsyncJobHandle AsyncJobSystem::newTimedJob (AsyncJobFunction func, AsyncJobCallback cb,
+        const std::shared_ptr<void> data, int priority, std::chrono::milliseconds delay,
+        std::chrono::milliseconds interval, std::chrono::milliseconds deadline, const std::string& strand,
+        const std::string& category)
+{
+    std::shared_ptr<AsyncJobData> newjob = makeJob(func, cb, data, priority, strand, category);
+    newjob->m_runat += delay;
+    newjob->m_interval = interval;
+    newjob->m_deadline = deadline;
+
+    if (delay > std::chrono::milliseconds::zero())
+    {
+        newjob->m_state = JOB_WAITING;
+        scheduleJob(newjob);
+    }
+    else
+    {
+        newjob->m_state = JOB_READY;
+        enqueueJob(newjob);
+    }
+
+    return AsyncJobHandle(newjob);
+}
+
+/**
+ * Run a function on the tick thread, the next time completeAsyncJobs() is called.
+ * Safe to call from any thread.
+ *
+ * @param func Function to run
+ */
+void AsyncJobSystem::runOnTick (std::function<void()> func)
+{
+    m_tickfunctions.push(std::move(func));
+}
+
+/**
+ * Run callbacks for jobs that have finished since the last call, requeue
+ * repeating jobs, and run anything passed to runOnTick(). Only call from one
+ * thread (the tick).
+ */
+void AsyncJobSystem::completeAsyncJobs ()
+{
+    std::shared_ptr<AsyncJobData> thisjob;
+
+    while (m_completedjobs.pop(thisjob))
+    {
+        bool repeating = thisjob->m_repeat || thisjob->m_interval > AsyncJobClock::duration::zero();
+
+        switch (thisjob->m_state)
+        {
+            case JOB_COMPLETE:
+                if (thisjob->m_completecallback)
+                {
+                    thisjob->m_completecallback(thisjob->m_data);
+                }
+
+                if (repeating && !thisjob->m_cancelled)
+                {
+                    rescheduleJob(thisjob);
+                }
+                else
+                {
+                    thisjob->m_state = JOB_ERASE;
+                    finishJob(thisjob);
+                }
+                break;
+            case JOB_EXPIRED:
+                g_logger.warn("Job Runner" + ERROR_LOC, "A job missed its deadline and was not run");
+
+                if (repeating && !thisjob->m_cancelled)
+                {
+                    rescheduleJob(thisjob);
+                }
+                else
+                {
+                    finishJob(thisjob);
+                }
+                break;
+            default:
+                // Failed jobs are dropped, even if they were set to repeat
+                g_logger.warn("Job Runner" + ERROR_LOC, "A job threw an unhandled exception");
+                break;
+        }
+    }
+    std::function<void()> tickfunction;
+    while (m_tickfunctions.pop(tickfunction))
+    {
+        tickfunction();
+    }
+}
+
+/**
+ * Create a job due to run now
+ */
+std::shared_ptr<AsyncJobData> AsyncJobSystem::makeJob (AsyncJobFunction& func, AsyncJobCallback& cb,
+        const std::shared_ptr<void>& data, int priority, const std::string& strand, const std::string& category)
 {
     std::shared_ptr<AsyncJobData> newjob = std::make_shared<AsyncJobData>();
 
-    newjob->m_jobfunction = func;
-    newjob->m_completecallback = cb;
+    newjob->m_jobfunction = std::move(func);
+    newjob->m_completecallback = std::move(cb);
     newjob->m_data = data;
     newjob->m_priority = priority;
-    newjob->m_repeat = repeat;
-    newjob->m_state = JOB_READY;
+    newjob->m_repeat = false;
+    newjob->m_runat = AsyncJobClock::now();
+    newjob->m_interval = AsyncJobClock::duration::zero();
+    newjob->m_deadline = AsyncJobClock::duration::zero();
+    newjob->m_timeoutms = m_defaulttimeoutms.load();
+    newjob->m_cancelled = false;
+    newjob->m_runcancelled = false;
+    newjob->m_finished = false;
+    newjob->m_strandheld = false;
+    newjob->m_pcategory = findCategory(category);
 
-    // Lock the job queue and add the new job
+    if (!strand.empty())
     {
-    	std::lock_guard<std::mutex> lock(m_jobqueue_mutex);
-    	m_jobs.insert(newjob);
+        std::lock_guard<std::mutex> lock(m_strandlock);
+        std::shared_ptr<AsyncStrand>& pstrand = m_strands[strand];
+        if (!pstrand)
+        {
+            pstrand = std::make_shared<AsyncStrand>();
+            pstrand->m_active = false;
+        }
+
+        newjob->m_pstrand = pstrand;
     }
 
-    // Wake the job runner
+    return newjob;
+}
+
+/**
+ * Find the counters for a job category, adding it if this is the first job in it
+ *
+ * @param name Category name, or empty for "Other"
+ * @return     Counters for the category, never null
+ */
+AsyncJobCategory* AsyncJobSystem::findCategory (const std::string& name)
+{
+    // Categories are only ever added, so any already published can be searched without the lock
+    unsigned int categorycount = m_categorycount.load(std::memory_order_acquire);
+    if (name.empty() && categorycount > 0)
+    {
+        return m_categories[0].get();
+    }
+
+    for (unsigned int i = 0; i < categorycount; ++i)
+    {
+        if (!m_categories[i]->m_name.compare(name))
+        {
+            return m_categories[i].get();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_categorylock);
+
+    // Check again in case another thread added it first
+    categorycount = m_categorycount.load(std::memory_order_relaxed);
+    for (unsigned int i = 0; i < categorycount; ++i)
+    {
+        if (!m_categories[i]->m_name.compare(name))
+        {
+            return m_categories[i].get();
+        }
+    }
+
+    if (ASYNC_MAX_CATEGORIES == categorycount)
+    {
+        return m_categories[0].get();
+    }
+
+    AsyncJobCategory *pcategory = new AsyncJobCategory;
+    pcategory->m_name = name;
+    pcategory->m_submitted = 0;
+    pcategory->m_queued = 0;
+    pcategory->m_running = 0;
+    pcategory->m_completed = 0;
+    pcategory->m_failed = 0;
+    pcategory->m_expired = 0;
+    pcategory->m_cancelled = 0;
+    for (int bucket = 0; bucket < ASYNC_HISTOGRAM_BUCKETS; ++bucket)
+    {
+        pcategory->m_waithistogram[bucket] = 0;
+        pcategory->m_runhistogram[bucket] = 0;
+    }
+
+    m_categories[categorycount].reset(pcategory);
+    m_categorycount.store(categorycount + 1, std::memory_order_release);
+
+    return pcategory;
+}
+
+/**
+ * Count a time in the right bucket of a histogram
+ *
+ * @param histogram Array of ASYNC_HISTOGRAM_BUCKETS counters
+ * @param time      Time to count
+ */
+void AsyncJobSystem::recordTime (std::atomic<unsigned long> *histogram, AsyncJobClock::duration time)
+{
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+
+    int bucket = 0;
+    while (bucket < ASYNC_HISTOGRAM_BUCKETS - 1 && ms >= (1LL << bucket))
+    {
+        ++bucket;
+    }
+
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Queue a runnable job, or hold it back if another job on its strand is ahead of it
+ *
+ * @param job Job to queue
+ */
+void AsyncJobSystem::enqueueJob (std::shared_ptr<AsyncJobData> job)
+{
+    job->m_readyat = AsyncJobClock::now();
+    job->m_pcategory->m_submitted.fetch_add(1, std::memory_order_relaxed);
+    job->m_pcategory->m_queued.fetch_add(1, std::memory_order_relaxed);
+
+    if (job->m_pstrand)
+    {
+        std::lock_guard<std::mutex> lock(job->m_pstrand->m_lock);
+        if (job->m_pstrand->m_active)
+        {
+            job->m_pstrand->m_pending.push_back(job);
+            return;
+        }
+
+        job->m_pstrand->m_active = true;
+        job->m_strandheld = true;
+    }
+
+    pushToWorker(job);
+}
+
+/**
+ * Let the next job on a strand go once the current one has finished with the
+ * worker. Does nothing if the job has already let its strand go, which
+ * happens when the watchdog abandons it.
+ *
+ * @param job Job which has just been run (or skipped) by a worker
+ */
+void AsyncJobSystem::releaseStrand (std::shared_ptr<AsyncJobData> job)
+{
+    if (!job->m_strandheld.exchange(false))
+    {
+        return;
+    }
+
+    std::shared_ptr<AsyncJobData> nextjob;
+    {
+        std::lock_guard<std::mutex> lock(job->m_pstrand->m_lock);
+        if (job->m_pstrand->m_pending.empty())
+        {
+            job->m_pstrand->m_active = false;
+            return;
+        }
+
+        nextjob = job->m_pstrand->m_pending.front();
+        job->m_pstrand->m_pending.pop_front();
+        nextjob->m_strandheld = true;
+    }
+
+    pushToWorker(nextjob);
+}
+
+/**
+ * Put a runnable job on a worker's queue and wake a sleeping worker.
+ * Jobs queued from a worker go to that worker, others are spread round-robin.
+ *
+ * @param job Job to queue
+ */
+void AsyncJobSystem::pushToWorker (std::shared_ptr<AsyncJobData> job)
+{
+    unsigned int target;
+    if (this == t_pjobsystem)
+    {
+        target = t_workerid;
+    }
+    else
+    {
+        target = m_nextworker++ % m_workercount;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_workers[target]->m_queuelock);
+        job->m_sequence = m_nextsequence++;
+        m_workers[target]->m_queue.push_back(job);
+        std::push_heap(m_workers[target]->m_queue.begin(), m_workers[target]->m_queue.end(), AsyncJobOrder());
+    }
+
+    // Hold the wait mutex so the count cannot change between a worker checking it and sleeping
+    {
+        std::lock_guard<std::mutex> lock(m_async_cv_mx);
+        ++m_queuedjobs;
+    }
     m_async_cv.notify_one();
+}
 
-    return newjob;
+/**
+ * Put a job on the timer heap to be queued at its m_runat time
+ *
+ * @param job Job to schedule, in JOB_WAITING
+ */
+void AsyncJobSystem::scheduleJob (std::shared_ptr<AsyncJobData> job)
+{
+    bool soonest;
+    {
+        std::lock_guard<std::mutex> lock(m_timerlock);
+        m_timers.push_back(job);
+        std::push_heap(m_timers.begin(), m_timers.end(), AsyncTimerOrder());
+        soonest = (m_timers.front() == job);
+    }
 
+    // The timer thread only needs waking if it is now sleeping for too long
+    if (soonest)
+    {
+        m_timercv.notify_one();
+    }
 }
 
 /**
- * Locate completed jobs in the queue, execute their callbacks and remove if necessary
+ * Set a repeating job up for its next run
+ *
+ * @param job Job which has finished a run
  */
-void AsyncJobSystem::completeAsyncJobs ()
+void AsyncJobSystem::rescheduleJob (std::shared_ptr<AsyncJobData> job)
 {
-    // Run callbacks and update job states
-    for (std::set<std::shared_ptr<AsyncJobData>>::iterator thisjob = m_jobs.begin(); thisjob != m_jobs.end(); )
+    AsyncJobClock::time_point now = AsyncJobClock::now();
+
+    if (job->m_interval > AsyncJobClock::duration::zero())
     {
-        if (JOB_COMPLETE == (*thisjob)->m_state)
+        // Keep to the original timing, skipping any runs already missed
+        job->m_runat += job->m_interval;
+        if (job->m_runat <= now)
         {
-            if ((*thisjob)->m_completecallback)
-            {
-                (*thisjob)->m_completecallback((*thisjob)->m_data);
-            }
+            job->m_runat += ((now - job->m_runat) / job->m_interval + 1) * job->m_interval;
+        }
 
-            if (true == (*thisjob)->m_repeat)
-            {
-                std::lock_guard<std::mutex> lock(m_jobqueue_mutex);
-                (*thisjob)->m_state = JOB_READY;
-            }
-            else
+        job->m_state = JOB_WAITING;
+        scheduleJob(job);
+    }
+    else
+    {
+        job->m_runat = now;
+        job->m_state = JOB_READY;
+        enqueueJob(job);
+    }
+
+    // Catch a cancel which arrived while the job was between states
+    if (job->m_cancelled)
+    {
+        AsyncJobHandle(job).cancel();
+    }
+}
+
+/**
+ * Mark a job as never running again and wake anything waiting for it
+ */
+void AsyncJobSystem::finishJob (std::shared_ptr<AsyncJobData> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(job->m_finishedlock);
+        job->m_finished = true;
+    }
+    job->m_finishedcv.notify_all();
+}
+
+/**
+ * Ask a running job to stop by calling its cancel handler, if it has one
+ *
+ * @param job Job to stop, already marked as cancelled
+ */
+void AsyncJobSystem::cancelRunningJob (std::shared_ptr<AsyncJobData> job)
+{
+    std::function<void()> handler;
+    {
+        std::lock_guard<std::mutex> lock(job->m_cancelhandlerlock);
+        handler = job->m_cancelhandler;
+    }
+
+    if (handler)
+    {
+        handler();
+    }
+}
+
+/**
+ * Take the best runnable job in the pool for a worker. The worker's own queue
+ * is checked first and wins ties, so jobs only move between workers when
+ * another queue holds something more urgent or this one is empty.
+ *
+ * @param workerid Worker looking for a job
+ * @param job      Set to the job taken
+ * @return         False if every queue was empty
+ */
+bool AsyncJobSystem::takeJob (unsigned int workerid, std::shared_ptr<AsyncJobData>& job)
+{
+    AsyncJobOrder order;
+    unsigned int workercount = m_workercount;
+
+    while (true)
+    {
+        // Find the queue with the best job at the top
+        std::shared_ptr<AsyncJobData> best;
+        unsigned int bestworker = 0;
+
+        for (unsigned int i = 0; i < workercount; ++i)
+        {
+            unsigned int thisworker = (workerid + i) % workercount;
+            AsyncWorker& candidate = *m_workers[thisworker];
+            std::lock_guard<std::mutex> lock(candidate.m_queuelock);
+
+            if (!candidate.m_queue.empty() && (!best || order(best, candidate.m_queue.front())))
             {
-                std::lock_guard<std::mutex> lock(m_jobqueue_mutex);
-                // Job does not repeat and should be erased. Loop will be advanced
-                thisjob = m_jobs.erase(thisjob);
-                continue;
+                best = candidate.m_queue.front();
+                bestworker = thisworker;
             }
         }
-        else if (JOB_FAILED == (*thisjob)->m_state)
+
+        if (!best)
         {
-            g_logger.warn("Job Runner" + ERROR_LOC, "A job threw an unhandled exception");
-            (*thisjob)->m_state = JOB_ERASE;
+            return false;
         }
 
-        ++thisjob;
+        // Take it, unless another worker got there first
+        AsyncWorker& victim = *m_workers[bestworker];
+        std::lock_guard<std::mutex> lock(victim.m_queuelock);
+        if (!victim.m_queue.empty() && victim.m_queue.front() == best)
+        {
+            std::pop_heap(victim.m_queue.begin(), victim.m_queue.end(), order);
+            victim.m_queue.pop_back();
+            --m_queuedjobs;
+            job = best;
+            return true;
+        }
     }
 }
 
 /**
- * Run asynchronous tasks in a separate thread
+ * Run asynchronous tasks on one worker thread
+ *
+ * @param workerid   Index of this worker's slot
+ * @param generation Slot generation this thread belongs to. If the watchdog
+ *                   moves the slot on, this thread exits after its current job.
  */
-void AsyncJobSystem::asyncJobRunner ()
+void AsyncJobSystem::asyncJobRunner (unsigned int workerid, unsigned int generation)
 {
-    // Template job for comparison
-    std::shared_ptr<AsyncJobData> template_job = std::make_shared<AsyncJobData>();
-    template_job->m_state = JOB_READY;
+    t_pjobsystem = this;
+    t_workerid = workerid;
+    AsyncWorker& worker = *m_workers[workerid];
 
-    while (!m_halt)
+    while (!m_halt && generation == worker.m_generation)
     {
-        if (m_jobs.size() > 0)
+        std::shared_ptr<AsyncJobData> runjob;
+
+        if (takeJob(workerid, runjob))
         {
-            // Get a reference to the job in question
-            std::shared_ptr<AsyncJobData> runjob;
+            AsyncJobCategory& category = *runjob->m_pcategory;
+            AsyncJobClock::time_point started = AsyncJobClock::now();
+            category.m_queued.fetch_sub(1, std::memory_order_relaxed);
 
-            // Lock the mutex to allow searching the job list
+            // Skip jobs cancelled while they were queued
+            AsyncJobState expected = JOB_READY;
+            if (!runjob->m_state.compare_exchange_strong(expected, JOB_RUNNING))
             {
-            	std::lock_guard<std::mutex> lock(m_jobqueue_mutex);
-
-				// Find a runnable job
-				for (std::shared_ptr<AsyncJobData> thisjob : m_jobs)
-				{
-					if (JOB_READY == thisjob->m_state)
-					{
-						runjob = thisjob;
-						break;
-					}
-				}
+                category.m_cancelled.fetch_add(1, std::memory_order_relaxed);
+
+                if (runjob->m_pstrand)
+                {
+                    releaseStrand(runjob);
+                }
+                continue;
             }
 
-            if (runjob)
+            bool repeating = runjob->m_repeat || runjob->m_interval > AsyncJobClock::duration::zero();
+
+            if (runjob->m_deadline > AsyncJobClock::duration::zero() &&
+                    started > runjob->m_runat + runjob->m_deadline)
             {
-                // Run the job
-                runjob->m_state = JOB_RUNNING;
+                runjob->m_state = JOB_EXPIRED;
+                category.m_expired.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                recordTime(category.m_waithistogram, started - runjob->m_readyat);
+                category.m_running.fetch_add(1, std::memory_order_relaxed);
+
+                // Let the watchdog see this run
+                {
+                    std::lock_guard<std::mutex> lock(worker.m_currentlock);
+                    worker.m_pcurrent = runjob;
+                    worker.m_started = started;
+                    worker.m_overdue = false;
+                }
+                runjob->m_runcancelled = false;
+                t_pcurrentjob = runjob.get();
 
                 try
                 {
                     runjob->m_jobfunction(runjob->m_data, g_core_lock);
                     runjob->m_state = JOB_COMPLETE;
+                    category.m_completed.fetch_add(1, std::memory_order_relaxed);
                 }
                 catch (...)
                 {
                     runjob->m_state = JOB_FAILED;
+                    category.m_failed.fetch_add(1, std::memory_order_relaxed);
+                    repeating = false;
+                }
+
+                category.m_running.fetch_sub(1, std::memory_order_relaxed);
+                recordTime(category.m_runhistogram, AsyncJobClock::now() - started);
+                t_pcurrentjob = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(runjob->m_cancelhandlerlock);
+                    runjob->m_cancelhandler = nullptr;
                 }
+
+                // An abandoned thread must leave the slot alone, it belongs to the replacement now
+                {
+                    std::lock_guard<std::mutex> lock(worker.m_currentlock);
+                    if (generation == worker.m_generation)
+                    {
+                        worker.m_pcurrent.reset();
+                    }
+                }
+            }
+
+            // Let waiters go now rather than after the callback, so the tick thread can wait on jobs
+            if (!repeating || runjob->m_cancelled)
+            {
+                finishJob(runjob);
+            }
+
+            if (runjob->m_pstrand)
+            {
+                releaseStrand(runjob);
             }
+
+            m_completedjobs.push(runjob);
         }
         else
         {
-            // Go to sleep until notified of new job by newAsyncJob()
+            // Go to sleep until notified of a new job by enqueueJob()
             std::unique_lock<std::mutex> lk(m_async_cv_mx);
-            m_async_cv.wait(lk, [this, template_job]{return m_jobs.size() > 0;});
+            m_async_cv.wait(lk, [this]{return m_halt || m_queuedjobs > 0;});
+        }
+    }
+
+    if (generation != worker.m_generation)
+    {
+        --m_abandonedworkers;
+    }
+}
+
+/**
+ * Move jobs from the timer heap onto the worker queues as they become due
+ */
+void AsyncJobSystem::timerRunner ()
+{
+    std::unique_lock<std::mutex> lock(m_timerlock);
+
+    while (!m_halt)
+    {
+        if (m_timers.empty())
+        {
+            m_timercv.wait(lock);
+            continue;
+        }
+
+        if (m_timers.front()->m_runat > AsyncJobClock::now())
+        {
+            m_timercv.wait_until(lock, m_timers.front()->m_runat);
+            continue;
+        }
+
+        std::pop_heap(m_timers.begin(), m_timers.end(), AsyncTimerOrder());
+        std::shared_ptr<AsyncJobData> duejob = m_timers.back();
+        m_timers.pop_back();
+
+        // Cancelled jobs are simply dropped here
+        AsyncJobState expected = JOB_WAITING;
+        if (duejob->m_state.compare_exchange_strong(expected, JOB_READY))
+        {
+            lock.unlock();
+            enqueueJob(duejob);
+            lock.lock();
+        }
+    }
+}
+
+/**
+ * Check every few hundred milliseconds for jobs running over their time limit
+ */
+void AsyncJobSystem::watchdogRunner ()
+{
+    std::unique_lock<std::mutex> lock(m_watchdoglock);
+
+    while (!m_halt)
+    {
+        m_watchdogcv.wait_for(lock, std::chrono::milliseconds(ASYNC_WATCHDOG_PERIOD_MS));
+
+        unsigned int workercount = m_workercount;
+        for (unsigned int i = 0; i < workercount && !m_halt; ++i)
+        {
+            checkWorker(i);
         }
     }
 }
 
+/**
+ * Deal with an over-running job on one worker. Once past its timeout the
+ * current run is cancelled, though a repeating job will still run again. Once past twice its timeout it is assumed hung, so its strand
+ * is let go and the worker's slot is handed to a new thread.
+ *
+ * @param workerid Worker slot to check
+ */
+void AsyncJobSystem::checkWorker (unsigned int workerid)
+{
+    AsyncWorker& worker = *m_workers[workerid];
+    std::shared_ptr<AsyncJobData> job;
+    bool cancel = false;
+
+    {
+        std::lock_guard<std::mutex> lock(worker.m_currentlock);
+
+        if (!worker.m_pcurrent || worker.m_pcurrent->m_timeoutms <= 0)
+        {
+            return;
+        }
+
+        job = worker.m_pcurrent;
+        std::chrono::milliseconds timeout(job->m_timeoutms);
+        AsyncJobClock::duration elapsed = AsyncJobClock::now() - worker.m_started;
+
+        if (elapsed < timeout)
+        {
+            return;
+        }
+
+        if (!worker.m_overdue)
+        {
+            worker.m_overdue = true;
+            cancel = true;
+        }
+        else if (elapsed >= timeout * 2)
+        {
+            // Move the slot on so the old thread exits when (if) the job ever returns
+            ++worker.m_generation;
+            worker.m_pcurrent.reset();
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    if (cancel)
+    {
+        ++m_timedoutjobs;
+        g_logger.warn("Job Runner" + ERROR_LOC, "A job has run for over " +
+                std::to_string(job->m_timeoutms / 1000.0) + " seconds and has been cancelled");
+
+        job->m_runcancelled = true;
+        cancelRunningJob(job);
+        return;
+    }
+
+    ++m_replacedworkers;
+    ++m_abandonedworkers;
+    g_logger.error("Job Runner" + ERROR_LOC, "A job is still running after being cancelled, "
+            "starting a new worker to replace the one it is stuck on");
+
+    if (job->m_pstrand)
+    {
+        releaseStrand(job);
+    }
+
+    std::lock_guard<std::mutex> lock(m_workerstart_mutex);
+    worker.m_thread.detach();
+    worker.m_thread = std::thread(&AsyncJobSystem::asyncJobRunner, this, workerid, worker.m_generation.load());
+}
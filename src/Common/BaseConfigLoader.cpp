@@ -172,6 +172,31 @@ void BaseConfigLoader::LoadConfig (std::string filename)
         }
     }
 
+    // Grab the MouseCatcher node, which is optional
+    pugi::xml_node mousecatchernode = m_configdata.document_element().child("MouseCatcher");
+    m_mcactionbudget = mousecatchernode.child("ActionBudget").text().as_int(10);
+    if (m_mcactionbudget < 1)
+    {
+        g_logger.warn("Base Config Loader", "MouseCatcher ActionBudget must be at least 1ms. Using 1ms");
+        m_mcactionbudget = 1;
+    }
+
+    // Grab the AsyncJobs node, which is optional
+    pugi::xml_node asyncnode = m_configdata.document_element().child("AsyncJobs");
+    m_asyncworkers = asyncnode.child("Workers").text().as_int(4);
+    if (m_asyncworkers < 1)
+    {
+        g_logger.warn("Base Config Loader", "AsyncJobs Workers must be at least 1. Using 1");
+        m_asyncworkers = 1;
+    }
+
+    m_asyncjobtimeout = asyncnode.child("JobTimeout").text().as_int(120);
+    if (m_asyncjobtimeout < 0)
+    {
+        g_logger.warn("Base Config Loader", "AsyncJobs JobTimeout cannot be negative. Disabling job timeouts");
+        m_asyncjobtimeout = 0;
+    }
+
     // Grab the Channels node and load channels
     pugi::xml_node channelsnode = m_configdata.document_element().child("Channels");
     if (channelsnode.empty())
@@ -187,6 +212,14 @@ void BaseConfigLoader::LoadConfig (std::string filename)
             thischannel.m_channame = it.child_value("Name");
             thischannel.m_xpname = it.child_value("CrosspointName");
             thischannel.m_xpport = it.child_value("CrosspointPort");
+            thischannel.m_overlappolicy = it.child_value("OverlapPolicy");
+
+            if (thischannel.m_overlappolicy.empty())
+            {
+                thischannel.m_overlappolicy = "warn";
+            }
+
+            thischannel.m_recurrencelookahead = it.child("RecurrenceLookahead").text().as_int(172800);
 
             if (thischannel.m_channame.empty() || thischannel.m_xpname.empty() ||
                     thischannel.m_xpport.empty())
@@ -286,3 +319,34 @@ int BaseConfigLoader::getMCDeletedEventCount (void)
     return m_mcdeletedvents;
 }
 
+/**
+ * Get the time MouseCatcher may spend on queued actions each tick. Urgent
+ * actions such as triggers ignore this and always run, and every other lane
+ * still gets one action per tick when over budget.
+ *
+ * @return Budget in milliseconds
+ */
+int BaseConfigLoader::getMCActionBudget (void)
+{
+    return m_mcactionbudget;
+}
+
+/**
+ * Get the number of worker threads to run async jobs on
+ *
+ * @return Number of workers
+ */
+int BaseConfigLoader::getAsyncWorkers (void)
+{
+    return m_asyncworkers;
+}
+
+/**
+ * Get the longest an async job may run before the watchdog cancels it
+ *
+ * @return Timeout in seconds, or 0 for no limit
+ */
+int BaseConfigLoader::getAsyncJobTimeout (void)
+{
+    return m_asyncjobtimeout;
+}
@@ -0,0 +1,197 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : ExtraData.cpp
+*   Version     : 1.0
+*   Description : Compact key-value store for event extra data
+*
+*****************************************************************************/
+
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "ExtraData.h"
+
+//! Names for extradata_key_t, in the same order
+static const char* g_extradatakeynames[EXTRA_COUNT] = { "filename", "hostlayer", "graphicname", "nowtext",
+        "nexttext", "input", "output", "duration", "templatedata", "placeholderID" };
+
+/**
+ * Keys outside extradata_key_t. Names are kept in a deque so references to them
+ * stay valid as more are added. Created on first use, as static ActionInformation
+ * definitions intern keys during static initialisation.
+ */
+struct ExtraDataKeyTable
+{
+    std::mutex m_lock;
+    std::deque<std::string> m_names;
+    std::unordered_map<std::string, int> m_ids;
+
+    static ExtraDataKeyTable& get ()
+    {
+        static ExtraDataKeyTable table;
+        return table;
+    }
+};
+
+/**
+ * Find the ID for a key name, giving it a new one if it has not been seen before.
+ * Safe to call from any thread.
+ *
+ * @param name Key name
+ * @return     Key ID
+ */
+int ExtraDataKey::intern (const char *name)
+{
+    for (int i = 0; i < EXTRA_COUNT; ++i)
+    {
+        if (!strcmp(name, g_extradatakeynames[i]))
+        {
+            return i;
+        }
+    }
+
+    ExtraDataKeyTable& table = ExtraDataKeyTable::get();
+    std::lock_guard<std::mutex> lock(table.m_lock);
+
+    std::unordered_map<std::string, int>::iterator it = table.m_ids.find(name);
+    if (table.m_ids.end() != it)
+    {
+        return it->second;
+    }
+
+    int id = EXTRA_COUNT + table.m_names.size();
+    table.m_names.push_back(name);
+    table.m_ids[name] = id;
+    return id;
+}
+
+/**
+ * @return The name of this key
+ */
+const std::string& ExtraDataKey::getName () const
+{
+    static const std::vector<std::string> fixednames(g_extradatakeynames, g_extradatakeynames + EXTRA_COUNT);
+
+    if (m_id < EXTRA_COUNT)
+    {
+        return fixednames[m_id];
+    }
+
+    ExtraDataKeyTable& table = ExtraDataKeyTable::get();
+    std::lock_guard<std::mutex> lock(table.m_lock);
+    return table.m_names.at(m_id - EXTRA_COUNT);
+}
+
+static bool itemKeyLess (const ExtraData::value_type& item, const ExtraDataKey& key)
+{
+    return item.first < key;
+}
+
+/**
+ * Construct from a list of key-value pairs, as used by the ActionInformation definitions
+ */
+ExtraData::ExtraData (std::initializer_list<value_type> items)
+{
+    for (const value_type& item : items)
+    {
+        (*this)[item.first] = item.second;
+    }
+}
+
+/**
+ * Get the value for a key, adding an empty one if it is missing
+ */
+std::string& ExtraData::operator[] (const ExtraDataKey& key)
+{
+    iterator it = std::lower_bound(m_items.begin(), m_items.end(), key, itemKeyLess);
+
+    if (m_items.end() == it || !(it->first == key))
+    {
+        it = m_items.insert(it, value_type(key, std::string()));
+    }
+
+    return it->second;
+}
+
+/**
+ * Get the value for a key, throwing std::out_of_range if it is missing
+ */
+std::string& ExtraData::at (const ExtraDataKey& key)
+{
+    iterator it = find(key);
+
+    if (m_items.end() == it)
+    {
+        throw std::out_of_range(key.getName());
+    }
+
+    return it->second;
+}
+
+const std::string& ExtraData::at (const ExtraDataKey& key) const
+{
+    const_iterator it = find(key);
+
+    if (m_items.end() == it)
+    {
+        throw std::out_of_range(key.getName());
+    }
+
+    return it->second;
+}
+
+ExtraData::iterator ExtraData::find (const ExtraDataKey& key)
+{
+    iterator it = std::lower_bound(m_items.begin(), m_items.end(), key, itemKeyLess);
+    return (m_items.end() != it && it->first == key) ? it : m_items.end();
+}
+
+ExtraData::const_iterator ExtraData::find (const ExtraDataKey& key) const
+{
+    const_iterator it = std::lower_bound(m_items.begin(), m_items.end(), key, itemKeyLess);
+    return (m_items.end() != it && it->first == key) ? it : m_items.end();
+}
+
+size_t ExtraData::count (const ExtraDataKey& key) const
+{
+    return (m_items.end() != find(key)) ? 1 : 0;
+}
+
+/**
+ * Remove a key
+ *
+ * @return Number of entries removed, 0 or 1
+ */
+size_t ExtraData::erase (const ExtraDataKey& key)
+{
+    iterator it = find(key);
+
+    if (m_items.end() == it)
+    {
+        return 0;
+    }
+
+    m_items.erase(it);
+    return 1;
+}
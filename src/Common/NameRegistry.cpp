@@ -0,0 +1,89 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : NameRegistry.cpp
+*   Version     : 1.0
+*   Description : Maps names of channels, devices and processors to small integer IDs
+*
+*****************************************************************************/
+
+
+#include <stdexcept>
+
+#include "NameRegistry.h"
+
+/**
+ * Get the ID for a name, assigning the next free one if it is new
+ *
+ * @param name Name to look up
+ * @return     ID for the name
+ */
+int NameRegistry::intern (const std::string& name)
+{
+    std::unordered_map<std::string, int>::iterator it = m_ids.find(name);
+    if (m_ids.end() != it)
+    {
+        return it->second;
+    }
+
+    int id = m_names.size();
+    m_ids[name] = id;
+    m_names.push_back(name);
+    return id;
+}
+
+/**
+ * Get the ID for a name without assigning one
+ *
+ * @param name Name to look up
+ * @return     ID for the name, or -1 if it has never been interned
+ */
+int NameRegistry::find (const std::string& name) const
+{
+    std::unordered_map<std::string, int>::const_iterator it = m_ids.find(name);
+    if (m_ids.end() == it)
+    {
+        return -1;
+    }
+
+    return it->second;
+}
+
+/**
+ * Get the name an ID was assigned to
+ *
+ * @param id ID from intern()
+ * @return   Name for that ID. Throws if the ID was never assigned.
+ */
+const std::string& NameRegistry::getName (int id) const
+{
+    if (id < 0 || id >= static_cast<int>(m_names.size()))
+    {
+        throw std::exception();
+    }
+
+    return m_names[id];
+}
+
+/**
+ * @return Number of IDs assigned so far
+ */
+size_t NameRegistry::size () const
+{
+    return m_names.size();
+}
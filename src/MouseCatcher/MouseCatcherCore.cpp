@@ -26,6 +26,9 @@
 #include <dirent.h> //for reading the directories
 #include <vector>
 #include <algorithm>
+#include <deque>
+#include <future>
+#include <set>
 
 #include "MouseCatcherCommon.h"
 #include "MouseCatcherCore.h"
@@ -39,10 +42,65 @@
 
 extern std::vector<std::shared_ptr<MouseCatcherSourcePlugin>> g_mcsources;
 extern std::map<std::string, std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessors;
+extern std::vector<std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessortable;
 
 namespace MouseCatcherCore
 {
-    std::vector<EventAction> *g_pactionqueue;
+    MPSCQueue<EventAction> g_actionqueue;
+
+    /**
+     * Actions taken from g_actionqueue and waiting to run, with statistics
+     */
+    struct ActionLane
+    {
+        std::deque<EventAction> m_actions;
+        ActionLaneMetrics m_metrics;
+    };
+
+    //! Waiting actions by priority, indexed by action_priority_t
+    static ActionLane g_actionlanes[ACTIONPRIORITY_COUNT];
+
+    /**
+     * Results of read-only actions already run this tick, so identical requests
+     * from several sources are only worked out once. Emptied at the start of each
+     * tick and whenever an action might have changed the playlist.
+     */
+    struct ReadActionCache
+    {
+        std::map<std::string, std::vector<MouseCatcherEvent>> m_playlists;
+        std::map<std::string, std::vector<std::pair<std::string, int>>> m_files;
+        std::map<std::string, std::string> m_devices;
+        bool m_hasdevices = false;
+
+        void clear ()
+        {
+            m_playlists.clear();
+            m_files.clear();
+            m_devices.clear();
+            m_hasdevices = false;
+        }
+    };
+
+    static ReadActionCache g_readcache;
+
+    /**
+     * An event waiting on an EventProcessor, with the placeholder standing in for it
+     */
+    struct PendingProcessorEvent
+    {
+        std::future<MouseCatcherEvent> m_result;
+        int m_placeholderid;
+        int m_channelid;
+        int m_parentid;
+        std::string m_processor;
+    };
+
+    static std::vector<std::shared_ptr<PendingProcessorEvent>> g_pendingprocessorevents;
+
+    static void processChildEvents (MouseCatcherEvent& event, int parentid, EventAction& action);
+    static int processorEvent (MouseCatcherEvent& event, int channelid, int lastid, EventAction& action);
+    static bool buildMCEvent (PlaylistEntry& playlistevent, std::map<int, std::vector<PlaylistEntry*>>& children,
+            const std::string& channelname, MouseCatcherEvent& generatedevent);
 
     /**
      * Encapsulates loading plugins, registering callbacks and logging activation
@@ -52,12 +110,12 @@ namespace MouseCatcherCore
      */
     void init (std::string sourcepath, std::string processorpath)
     {
-        g_pactionqueue = new std::vector<EventAction>;
         g_logger.info("MouseCatcherCore", "Now initialising MouseCatcher core");
         loadAllPlugins(sourcepath, "EventSource");
         loadAllPlugins(processorpath, "EventProcessor");
         g_tickcallbacks.push_back(MouseCatcherCore::eventSourcePluginTicks);
         g_tickcallbacks.push_back(MouseCatcherCore::eventQueueTicks);
+        g_tickcallbacks.push_back(MouseCatcherCore::pendingProcessorTicks);
     }
 
     /**
@@ -69,7 +127,7 @@ namespace MouseCatcherCore
         {
             if (thisplugin)
             {
-                thisplugin->tick(g_pactionqueue);
+                thisplugin->tick();
             }
         }
 
@@ -80,14 +138,15 @@ namespace MouseCatcherCore
     }
 
     /**
-     * Process an individual incoming event
+     * Process an individual incoming event. The event is worked on in place,
+     * so callers should not rely on its contents afterwards.
      *
-     * @param thisevent MouseCatcherEvent
-     * @param lastid int The id of the last inserted event, -1 for none
+     * @param event   MouseCatcherEvent to add
+     * @param lastid  int The id of the last inserted event, -1 for none
      * @param ischild bool
      * @return int The id of the inserted event for relative tails
      */
-    int processEvent (MouseCatcherEvent event, int lastid, bool ischild,
+    int processEvent (MouseCatcherEvent& event, int lastid, bool ischild,
             EventAction& action)
     {
         // Cursory check to make sure the given channel is actually real
@@ -103,7 +162,7 @@ namespace MouseCatcherCore
             return -1;
         }
 
-        if (event.m_extradata.count("duration") > 0)
+        if (event.m_extradata.count(EXTRA_DURATION) > 0)
 		{
 			try
 			{
@@ -114,24 +173,24 @@ namespace MouseCatcherCore
 
 				do
 				{
-					found = event.m_extradata["duration"].find(':', lastfind);
+					found = event.m_extradata[EXTRA_DURATION].find(':', lastfind);
 					if (std::string::npos == found)
 					{
-						found = event.m_extradata["duration"].length();
+						found = event.m_extradata[EXTRA_DURATION].length();
 					}
 
-					std::string sub = event.m_extradata["duration"].substr(lastfind, found - lastfind);
+					std::string sub = event.m_extradata[EXTRA_DURATION].substr(lastfind, found - lastfind);
 					lastfind = found + 1;
 
 					event.m_duration = event.m_duration * 60 +
 							ConvertType::stringToInt(sub);
 					i++;
 				}
-				while (found != event.m_extradata["duration"].length() && i < 3);
+				while (found != event.m_extradata[EXTRA_DURATION].length() && i < 3);
 			}
 			catch (std::exception &ex)
 			{
-				g_logger.warn("MouseCatcherCore " + ERROR_LOC, "Bad duration of " + event.m_extradata["duration"] +
+				g_logger.warn("MouseCatcherCore " + ERROR_LOC, "Bad duration of " + event.m_extradata[EXTRA_DURATION] +
 						" selecting 10s instead");
 				event.m_duration = 10;
 			}
@@ -139,24 +198,15 @@ namespace MouseCatcherCore
 			// Convert duration from seconds to frames
 			event.m_duration *= g_pbaseconfig->getFramerate();
 
-			event.m_extradata.erase("duration");
+			event.m_extradata.erase(EXTRA_DURATION);
 		}
 
-        // Process event through EventProcessors, then run this function on new events (ignore "special" manual events)
+        // Send the event to an EventProcessor, unless it is a "special" manual event
         if (0 == g_devices.count(event.m_targetdevice) && EVENT_MANUAL != event.m_eventtype)
         {
-            g_logger.info("MouseCatcherCore", "Scanning Event Processors");
-
-            // Run an EventProcessor
             if (1 == g_mcprocessors.count(event.m_targetdevice))
             {
-                // Create a variable to hold original event
-                MouseCatcherEvent originalevent = event;
-
-                // Action fields do not apply to processors, set it to -1
-                originalevent.m_action = -1;
-
-                g_mcprocessors[event.m_targetdevice]->handleEvent(originalevent, event);
+                return processorEvent(event, channelid, lastid, action);
             }
             else
             {
@@ -183,8 +233,27 @@ namespace MouseCatcherCore
 
         int eventid = g_channels[channelid]->createEvent(&playlistevent);
 
-        // Loop over and handle children
-        for (MouseCatcherEvent thischild : event.m_childevents)
+        if (eventid < 0)
+        {
+            action.returnmessage = "Event overlaps existing schedule on channel " + event.m_channel;
+            return -1;
+        }
+
+        processChildEvents(event, eventid, action);
+
+        return eventid;
+    }
+
+    /**
+     * Run the children of an event through processEvent()
+     *
+     * @param event    Parent event holding the children
+     * @param parentid Playlist ID of the parent
+     * @param action   Action to report problems through
+     */
+    static void processChildEvents (MouseCatcherEvent& event, int parentid, EventAction& action)
+    {
+        for (MouseCatcherEvent& thischild : event.m_childevents)
         {
             // Inherit parent descriptions
             if (thischild.m_description.empty())
@@ -192,11 +261,141 @@ namespace MouseCatcherCore
                 thischild.m_description = event.m_description;
             }
 
-            processEvent(thischild, eventid, true, action);
+            processEvent(thischild, parentid, true, action);
+        }
+    }
+
+    /**
+     * Start an EventProcessor on an event and hold its place in the playlist
+     * until the processor finishes. The placeholder keeps its ID when the result
+     * is swapped in by pendingProcessorTicks(), and is held back from running
+     * until then.
+     *
+     * @param event     Event to process
+     * @param channelid Channel the event is for
+     * @param lastid    Parent event ID, or -1 for a top-level event
+     * @param action    Action to report problems through
+     * @return          ID of the placeholder event, or -1 on failure
+     */
+    static int processorEvent (MouseCatcherEvent& event, int channelid, int lastid, EventAction& action)
+    {
+        g_logger.info("MouseCatcherCore", "Scanning Event Processors");
+
+        PlaylistEntry placeholder;
+        convertToPlaylistEvent(&event, lastid, &placeholder);
+
+        int eventid = g_channels[channelid]->createEvent(&placeholder);
+
+        if (eventid < 0)
+        {
+            action.returnmessage = "Event overlaps existing schedule on channel " + event.m_channel;
+            return -1;
         }
 
+        // Keep the placeholder from running until it has its children
+        g_channels[channelid]->m_pl.setEventPending(eventid, true);
+
+        // Action fields do not apply to processors, set it to -1
+        MouseCatcherEvent originalevent = event;
+        originalevent.m_action = -1;
+
+        std::shared_ptr<PendingProcessorEvent> ppending = std::make_shared<PendingProcessorEvent>();
+        ppending->m_placeholderid = eventid;
+        ppending->m_channelid = channelid;
+        ppending->m_parentid = lastid;
+        ppending->m_processor = event.m_targetdevice;
+        ppending->m_result = g_mcprocessors[event.m_targetdevice]->handleEventAsync(std::move(originalevent));
+
+        g_pendingprocessorevents.push_back(ppending);
+
         return eventid;
+    }
+
+    /**
+     * Swap the results of finished EventProcessors into their placeholders
+     */
+    void pendingProcessorTicks ()
+    {
+        for (std::vector<std::shared_ptr<PendingProcessorEvent>>::iterator it = g_pendingprocessorevents.begin();
+                it != g_pendingprocessorevents.end(); )
+        {
+            std::shared_ptr<PendingProcessorEvent> ppending = *it;
+
+            if (std::future_status::ready != ppending->m_result.wait_for(std::chrono::seconds(0)))
+            {
+                ++it;
+                continue;
+            }
+
+            it = g_pendingprocessorevents.erase(it);
+
+            std::shared_ptr<Channel> pchannel = g_channels[ppending->m_channelid];
+
+            MouseCatcherEvent result;
+            try
+            {
+                result = ppending->m_result.get();
+            }
+            catch (...)
+            {
+                g_logger.warn("MouseCatcherCore", "EventProcessor " + ppending->m_processor +
+                        " failed, removing placeholder event " + ConvertType::intToString(ppending->m_placeholderid));
+                pchannel->m_pl.removeEvent(ppending->m_placeholderid);
+                continue;
+            }
+
+            // The parent may have been removed while the processor ran, which leaves nothing to add to
+            PlaylistEntry parent;
+            if (ppending->m_parentid > -1 && !pchannel->m_pl.getEventDetails(ppending->m_parentid, parent))
+            {
+                g_logger.info("MouseCatcherCore", "Parent of placeholder event " +
+                        ConvertType::intToString(ppending->m_placeholderid) +
+                        " was removed before " + ppending->m_processor + " finished");
+                pchannel->m_pl.removeEvent(ppending->m_placeholderid);
+                continue;
+            }
 
+            PlaylistEntry playlistevent;
+            convertToPlaylistEvent(&result, ppending->m_parentid, &playlistevent);
+            playlistevent.m_eventid = ppending->m_placeholderid;
+
+            // A result running past the end of its placeholder has to be checked against the schedule again
+            PlaylistEntry placeholder;
+            time_t resultend = PlaylistDB::getEndTime(playlistevent.m_trigger, playlistevent.m_duration);
+            if (0 == playlistevent.m_parent &&
+                    pchannel->m_pl.getEventDetails(ppending->m_placeholderid, placeholder) &&
+                    (playlistevent.m_trigger < placeholder.m_trigger ||
+                            resultend > PlaylistDB::getEndTime(placeholder.m_trigger, placeholder.m_duration)) &&
+                    !pchannel->m_pl.applyOverlapPolicy(playlistevent.m_trigger, resultend,
+                            pchannel->m_overlappolicy, ppending->m_placeholderid))
+            {
+                g_logger.warn("MouseCatcherCore", "EventProcessor " + ppending->m_processor +
+                        " result no longer fits the schedule, removing placeholder event " +
+                        ConvertType::intToString(ppending->m_placeholderid));
+                pchannel->m_pl.removeEvent(ppending->m_placeholderid);
+                continue;
+            }
+
+            if (!pchannel->m_pl.updateEvent(&playlistevent))
+            {
+                g_logger.info("MouseCatcherCore", "Placeholder event " +
+                        ConvertType::intToString(ppending->m_placeholderid) +
+                        " was removed before " + ppending->m_processor + " finished");
+                continue;
+            }
+
+            pchannel->m_pl.setEventPending(ppending->m_placeholderid, false);
+
+            if (playlistevent.m_trigger <= time(NULL))
+            {
+                g_logger.warn("MouseCatcherCore", "EventProcessor " + ppending->m_processor +
+                        " finished after the start of event " + ConvertType::intToString(ppending->m_placeholderid) +
+                        ", children already due will not run");
+            }
+
+            EventAction action;
+            processChildEvents(result, ppending->m_placeholderid, action);
+        }
     }
 
     /**
@@ -230,15 +429,19 @@ namespace MouseCatcherCore
         for (std::vector<std::shared_ptr<Channel>>::iterator it = channelstart;
                 it != channelend; ++it)
         {
+            playlistevents.clear();
+
         	if (!action.compare("current"))
         	{
         		playlistevents = (*it)->m_pl.getExecutingEvents();
+        		(*it)->m_pl.getDescendants(playlistevents);
         	}
         	else if (!action.compare("next"))
         	{
         		try
         		{
         			playlistevents.push_back((*it)->m_pl.getNextEvent());
+        			(*it)->m_pl.getDescendants(playlistevents);
         		}
         		catch (std::exception&)
         		{
@@ -247,22 +450,138 @@ namespace MouseCatcherCore
         	}
         	else
         	{
-        		playlistevents = (*it)->m_pl.getEventList(starttime, length);
+        		playlistevents = (*it)->m_pl.getEventForest(starttime, length);
         	}
 
-            for (std::vector<PlaylistEntry>::iterator it2 =
-                    playlistevents.begin(); it2 != playlistevents.end(); ++it2)
+            buildMCEventTrees(playlistevents, (*it)->m_channame, eventvector);
+        }
+
+    }
+
+    /**
+     * Store a recurring event rule, or replace one when editing. The event in the action
+     * is the template for each occurrence and its trigger time is ignored.
+     *
+     * @param action EventAction with the template event and rule in m_recurrence. When editing,
+     *               eventid is the rule to replace. Set to the rule ID on success.
+     */
+    void addRecurringEvent (EventAction& action)
+    {
+        int channelid;
+
+        try
+        {
+            channelid = Channel::getChannelByName(action.event.m_channel);
+        }
+        catch (std::exception&)
+        {
+            action.returnmessage = "Attempted to add a recurring event to a nonexistent channel";
+            g_logger.warn("Event Queue", action.returnmessage);
+            return;
+        }
+
+        RecurringEntry rule;
+        try
+        {
+            rule.m_rule = RecurrenceRule(action.event.m_recurrence);
+        }
+        catch (std::exception&)
+        {
+            action.returnmessage = "Invalid recurrence rule " + action.event.m_recurrence;
+            g_logger.warn("Event Queue", action.returnmessage);
+            return;
+        }
+
+        // Resolve the template now so a bad device or action is reported straight away
+        if (!convertToPlaylistEvent(&action.event, 0, &rule.m_template))
+        {
+            action.returnmessage = "Unable to convert recurring event template";
+            g_logger.warn("Event Queue", action.returnmessage);
+            return;
+        }
+
+        rule.m_until = action.event.m_recurrenceuntil;
+
+        if (ACTION_EDIT_RECURRING == action.action)
+        {
+            // Keep any skipped occurrences from the old version of the rule
+            bool found = false;
+            for (const RecurringEntry& oldrule : g_channels[channelid]->m_pl.getRecurrences())
             {
-                std::vector<PlaylistEntry> playlistchildren = g_channels.at(
-                        it - channelstart)->m_pl.getChildEvents(it2->m_eventid);
+                if (oldrule.m_ruleid == action.eventid)
+                {
+                    rule.m_exceptions = oldrule.m_exceptions;
+                    found = true;
+                }
+            }
 
-                MouseCatcherEvent tempevent;
-                MouseCatcherCore::convertToMCEvent(it2.base(), *it,
-                        &tempevent, &g_logger);
-                eventvector.push_back(tempevent);
+            rule.m_ruleid = action.eventid;
+            if (!found || !g_channels[channelid]->m_pl.updateRecurrence(rule))
+            {
+                action.returnmessage = "Unable to locate recurring event to edit";
+                return;
             }
         }
+        else
+        {
+            action.eventid = g_channels[channelid]->m_pl.addRecurrence(rule);
+            if (action.eventid < 0)
+            {
+                action.returnmessage = "Unable to store recurring event";
+                return;
+            }
+        }
+
+        g_channels[channelid]->expandRecurrences();
+    }
+
+    /**
+     * Delete a recurring event rule along with its occurrences yet to play
+     *
+     * @param action EventAction with the channel and the rule ID in eventid
+     */
+    void removeRecurringEvent (EventAction& action)
+    {
+        int channelid;
+
+        try
+        {
+            channelid = Channel::getChannelByName(action.event.m_channel);
+        }
+        catch (std::exception&)
+        {
+            action.returnmessage = "Attempted to remove a recurring event from a nonexistent channel";
+            g_logger.warn("Event Queue", action.returnmessage);
+            return;
+        }
+
+        g_channels[channelid]->m_pl.removeRecurrence(action.eventid);
+    }
+
+    /**
+     * Skip a single occurrence of a recurring event
+     *
+     * @param action EventAction with the channel, rule ID in eventid and occurrence time in m_triggertime
+     */
+    void skipRecurringEvent (EventAction& action)
+    {
+        int channelid;
+
+        try
+        {
+            channelid = Channel::getChannelByName(action.event.m_channel);
+        }
+        catch (std::exception&)
+        {
+            action.returnmessage = "Attempted to skip a recurring event on a nonexistent channel";
+            g_logger.warn("Event Queue", action.returnmessage);
+            return;
+        }
 
+        if (!g_channels[channelid]->m_pl.addRecurrenceException(action.eventid, action.event.m_triggertime))
+        {
+            action.returnmessage = "Unable to locate recurring event to skip";
+        }
     }
 
     /**
@@ -427,8 +746,20 @@ namespace MouseCatcherCore
             return;
         }
 
-        getEvents(channelref, action.event.m_triggertime,
-        		action.event.m_duration, eventdata, action.event.m_action_name);
+        std::string cachekey = ConvertType::intToString(channelref) + ":" +
+                std::to_string(action.event.m_triggertime) + ":" +
+                ConvertType::intToString(action.event.m_duration) + ":" + action.event.m_action_name;
+
+        if (g_readcache.m_playlists.count(cachekey) > 0)
+        {
+            eventdata = g_readcache.m_playlists[cachekey];
+        }
+        else
+        {
+            getEvents(channelref, action.event.m_triggertime,
+                    action.event.m_duration, eventdata, action.event.m_action_name);
+            g_readcache.m_playlists[cachekey] = eventdata;
+        }
 
         action.thisplugin->updatePlaylist(eventdata, action.additionaldata);
     }
@@ -441,13 +772,18 @@ namespace MouseCatcherCore
      */
     void getLoadedDevices (EventAction& action)
     {
-        std::map<std::string, std::string> devices;
-        for(std::pair<std::string, std::shared_ptr<Device>> currentdevice :  g_devices)
+        if (!g_readcache.m_hasdevices)
         {
-            devices[currentdevice.first] =
-                    playlist_device_type_vector.at(currentdevice.second->getType());
+            for(std::pair<std::string, std::shared_ptr<Device>> currentdevice :  g_devices)
+            {
+                g_readcache.m_devices[currentdevice.first] =
+                        playlist_device_type_vector.at(currentdevice.second->getType());
+            }
+            g_readcache.m_hasdevices = true;
         }
 
+        std::map<std::string, std::string> devices = g_readcache.m_devices;
+
         action.thisplugin->updateDevices(devices, action.additionaldata);
     }
 
@@ -484,7 +820,13 @@ namespace MouseCatcherCore
      */
     void getDeviceFiles (EventAction& action)
     {
-        if (1 == g_devices.count(action.event.m_targetdevice))
+        if (g_readcache.m_files.count(action.event.m_targetdevice) > 0)
+        {
+            std::vector<std::pair<std::string, int>> files = g_readcache.m_files[action.event.m_targetdevice];
+            action.thisplugin->updateFiles(action.event.m_targetdevice, files,
+                    action.additionaldata);
+        }
+        else if (1 == g_devices.count(action.event.m_targetdevice))
         {
         	std::vector<std::pair<std::string, int>> files;
 
@@ -506,6 +848,7 @@ namespace MouseCatcherCore
                 action.returnmessage = "Unable to get files for invalid device " + action.event.m_targetdevice;
                 return;
             }
+            g_readcache.m_files[action.event.m_targetdevice] = files;
             action.thisplugin->updateFiles(action.event.m_targetdevice, files,
             		action.additionaldata);
         }
@@ -516,6 +859,61 @@ namespace MouseCatcherCore
         }
     }
 
+    /**
+     * Find the unscheduled stretches of a channel's timeline and pass them to the
+     * updateGaps() callback. Minimum gap length is read from the "mingap" extra data.
+     *
+     * @param action EventAction containing data for this event
+     */
+    void getGaps (EventAction& action)
+    {
+        int mingap = 0;
+        if (action.event.m_extradata.count("mingap") > 0)
+        {
+            mingap = ConvertType::stringToInt(action.event.m_extradata["mingap"]);
+        }
+
+        std::vector<TimelineGap> gaps;
+        if (!getScheduleGaps(action.event.m_channel, action.event.m_triggertime,
+                action.event.m_duration, mingap, gaps))
+        {
+            action.returnmessage = "Invalid channel name supplied";
+            return;
+        }
+
+        action.thisplugin->updateGaps(action.event.m_channel, gaps, action.additionaldata);
+    }
+
+    /**
+     * Find the unscheduled stretches of a channel's timeline. For use by EventProcessors
+     * generating fill as well as the gap update action.
+     *
+     * @param channelname Name of the channel to search
+     * @param starttime   Start of the range to search
+     * @param length      Length of the range to search in seconds
+     * @param mingap      Ignore gaps shorter than this many seconds
+     * @param gaps        Vector to append the gaps to
+     * @return            False if the channel was not found
+     */
+    bool getScheduleGaps (std::string channelname, time_t starttime, int length, int mingap,
+            std::vector<TimelineGap>& gaps)
+    {
+        int channelid;
+        try
+        {
+            channelid = Channel::getChannelByName(channelname);
+        }
+        catch (std::exception&)
+        {
+            g_logger.warn("MouseCatcherCore::getScheduleGaps", "Channel name " + channelname +
+                    " was not found in global channel list");
+            return false;
+        }
+
+        g_channels[channelid]->m_pl.getTimeline().findGaps(starttime, starttime + length, mingap, gaps);
+        return true;
+    }
+
     /**
      * Gets a list of eventprocessors.
      *
@@ -533,6 +931,7 @@ namespace MouseCatcherCore
             }
             else
             {
+                g_mcprocessortable[thisprocessor.second->getProcessorId()].reset();
                 g_mcprocessors.erase(thisprocessor.first);
             }
         }
@@ -541,106 +940,239 @@ namespace MouseCatcherCore
     }
 
     /**
-     * Converts and sets up new events from an EventSource, running EventProcessors.
+     * Decide which lane an action is queued in
+     *
+     * @param action Type of action
+     * @return       Priority lane for the action
      */
-    void eventQueueTicks ()
+    action_priority_t getActionPriority (EventActionTypes action)
     {
-        for (EventAction& thisaction : *g_pactionqueue)
+        switch (action)
         {
-            EventAction* p_action = &thisaction;
+            case ACTION_TRIGGER:
+                return ACTIONPRIORITY_IMMEDIATE;
+            case ACTION_UPDATE_PLAYLIST:
+            case ACTION_UPDATE_DEVICES:
+            case ACTION_UPDATE_ACTIONS:
+            case ACTION_UPDATE_PROCESSORS:
+            case ACTION_UPDATE_FILES:
+            case ACTION_UPDATE_GAPS:
+                return ACTIONPRIORITY_REFRESH;
+            default:
+                return ACTIONPRIORITY_EDIT;
+        }
+    }
 
-            if (p_action->isprocessed != true)
+    /**
+     * Get queue statistics for one priority lane
+     *
+     * @param lane Lane to get statistics for
+     * @return     Statistics as of the end of the last tick
+     */
+    ActionLaneMetrics getLaneMetrics (action_priority_t lane)
+    {
+        if (lane < 0 || lane >= ACTIONPRIORITY_COUNT)
+        {
+            return ActionLaneMetrics();
+        }
+
+        return g_actionlanes[lane].m_metrics;
+    }
+
+    /**
+     * Run a single action from the queue
+     *
+     * @param thisaction Action to run. Result fields are filled in.
+     */
+    static void runAction (EventAction& thisaction)
+    {
+        try
+        {
+            switch (thisaction.action)
             {
-                try
+                case ACTION_ADD:
+                {
+                    thisaction.eventid = processEvent(thisaction.event, -1, false, thisaction);
+                }
+                break;
+                case ACTION_REMOVE:
+                {
+                    removeEvent(thisaction);
+                }
+                break;
+                case ACTION_EDIT:
+                {
+                    editEvent(thisaction);
+                }
+                break;
+                case ACTION_SHUNT:
+                {
+                    shuntEvents(thisaction);
+                }
+                break;
+                case ACTION_TRIGGER:
+                {
+                    triggerEvent(thisaction);
+                }
+                break;
+                case ACTION_REGENERATE:
+                {
+                    regenerateEvent(thisaction);
+                }
+                break;
+                case ACTION_UPDATE_PLAYLIST:
+                {
+                    if (thisaction.thisplugin)
+                    {
+                        updateEvents(thisaction);
+                    }
+                }
+                break;
+                case ACTION_UPDATE_DEVICES:
+                {
+                    if (thisaction.thisplugin)
+                    {
+                        getLoadedDevices(thisaction);
+                    }
+                }
+                break;
+                case ACTION_UPDATE_ACTIONS:
+                {
+                    if (thisaction.thisplugin)
+                    {
+                        getTypeActions(thisaction);
+                    }
+                }
+                break;
+                case ACTION_UPDATE_PROCESSORS:
                 {
-                    switch (thisaction.action)
+                    if (thisaction.thisplugin)
                     {
-                        case ACTION_ADD:
-                        {
-                            thisaction.eventid = processEvent(thisaction.event, -1, false, *p_action);
-                        }
-                        break;
-                        case ACTION_REMOVE:
-                        {
-                            removeEvent(thisaction);
-                        }
-                        break;
-                        case ACTION_EDIT:
-                        {
-                            editEvent(thisaction);
-                        }
-                        break;
-                        case ACTION_SHUNT:
-                        {
-                            shuntEvents(thisaction);
-                        }
-                        break;
-                        case ACTION_TRIGGER:
-                        {
-                            triggerEvent(thisaction);
-                        }
-                        break;
-                        case ACTION_REGENERATE:
-                        {
-                            regenerateEvent(thisaction);
-                        }
-                        break;
-                        case ACTION_UPDATE_PLAYLIST:
-                        {
-                            if (thisaction.thisplugin)
-                            {
-                                updateEvents(thisaction);
-                            }
-                        }
-                        break;
-                        case ACTION_UPDATE_DEVICES:
-                        {
-                            if (thisaction.thisplugin)
-                            {
-                                getLoadedDevices(thisaction);
-                            }
-                        }
-                        break;
-                        case ACTION_UPDATE_ACTIONS:
-                        {
-                            if (thisaction.thisplugin)
-                            {
-                                getTypeActions(thisaction);
-                            }
-                        }
-                        break;
-                        case ACTION_UPDATE_PROCESSORS:
-                        {
-                            if (thisaction.thisplugin)
-                            {
-                                getEventProcessors(thisaction);
-                            }
-                        }
-                        break;
-                        case ACTION_UPDATE_FILES:
-                        {
-                        	if (thisaction.thisplugin)
-                        	{
-                        		getDeviceFiles(thisaction);
-                        	}
-                        }
-                        break;
-                        default:
-                        {
-                            throw std::exception();
-                        }
-                        break;
+                        getEventProcessors(thisaction);
                     }
                 }
-                catch (std::exception&)
+                break;
+                case ACTION_UPDATE_FILES:
+                {
+                	if (thisaction.thisplugin)
+                	{
+                		getDeviceFiles(thisaction);
+                	}
+                }
+                break;
+                case ACTION_ADD_RECURRING:
+                case ACTION_EDIT_RECURRING:
+                {
+                    addRecurringEvent(thisaction);
+                }
+                break;
+                case ACTION_REMOVE_RECURRING:
+                {
+                    removeRecurringEvent(thisaction);
+                }
+                break;
+                case ACTION_SKIP_RECURRING:
+                {
+                    skipRecurringEvent(thisaction);
+                }
+                break;
+                case ACTION_UPDATE_GAPS:
+                {
+                    if (thisaction.thisplugin)
+                    {
+                        getGaps(thisaction);
+                    }
+                }
+                break;
+                default:
+                {
+                    throw std::exception();
+                }
+                break;
+            }
+        }
+        catch (std::exception&)
+        {
+            g_logger.warn("MouseCatcherCore::eventQueueTicks " + ERROR_LOC,
+            		"Unknown Action returned from g_actionqueue. Action: " + std::to_string(thisaction.action));
+            thisaction.returnmessage = "Unknown Action type found";
+        }
+        thisaction.isprocessed = true;
+    }
+
+    /**
+     * Converts and sets up new events from an EventSource, running EventProcessors.
+     * Lanes are run in priority order until the tick budget runs out, and whatever
+     * is left waits for the next tick. Every lane gets at least one action each tick
+     * so a busy higher lane cannot starve the ones below it.
+     */
+    void eventQueueTicks ()
+    {
+        g_readcache.clear();
+
+        // Sort newly queued actions into lanes
+        EventAction newaction;
+        while (g_actionqueue.pop(newaction))
+        {
+            g_actionlanes[getActionPriority(newaction.action)].m_actions.push_back(std::move(newaction));
+        }
+
+        std::chrono::steady_clock::time_point tickstart = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = tickstart +
+                std::chrono::milliseconds(g_pbaseconfig->getMCActionBudget());
+
+        for (int lane = 0; lane < ACTIONPRIORITY_COUNT; ++lane)
+        {
+            ActionLane& thislane = g_actionlanes[lane];
+            bool ranaction = false;
+
+            while (!thislane.m_actions.empty())
+            {
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+                // Immediate actions always run, the rest wait for the next tick once over budget
+                if (ACTIONPRIORITY_IMMEDIATE != lane && ranaction && now >= deadline)
+                {
+                    break;
+                }
+                ranaction = true;
+
+                EventAction thisaction = std::move(thislane.m_actions.front());
+                thislane.m_actions.pop_front();
+
+                // Actions queued without a timestamp just count as not having waited
+                double wait = 0;
+                if (std::chrono::steady_clock::time_point() != thisaction.queuedtime)
+                {
+                    wait = std::chrono::duration<double, std::milli>(now - thisaction.queuedtime).count();
+                }
+
+                ActionLaneMetrics& metrics = thislane.m_metrics;
+                metrics.m_processed++;
+                metrics.m_lastwait = wait;
+                metrics.m_averagewait = (1 == metrics.m_processed) ? wait : 0.9 * metrics.m_averagewait + 0.1 * wait;
+                metrics.m_maxwait = std::max(metrics.m_maxwait, wait);
+
+                runAction(thisaction);
+
+                // Reads after this must see any changes it made
+                if (ACTIONPRIORITY_REFRESH != lane)
+                {
+                    g_readcache.clear();
+                }
+
+                // Deliver the result straight back to the source which asked for it
+                if (thisaction.thisplugin)
                 {
-                    g_logger.warn("MouseCatcherCore::eventQueueTicks " + ERROR_LOC,
-                    		"Unknown Action returned from g_pactionqueue. Action: " + std::to_string(thisaction.action));
-                    thisaction.returnmessage = "Unknown Action type found";
+                    thisaction.thisplugin->completeAction(thisaction);
                 }
-                thisaction.isprocessed = true;
             }
         }
+
+        for (ActionLane& thislane : g_actionlanes)
+        {
+            thislane.m_metrics.m_depth = thislane.m_actions.size();
+        }
     }
 
     /**
@@ -655,66 +1187,124 @@ namespace MouseCatcherCore
     bool convertToMCEvent (PlaylistEntry *pplaylistevent, std::shared_ptr<Channel> pchannel,
             MouseCatcherEvent *pgeneratedevent, Log *plog)
     {
-        try
+        // Fetch the whole tree below this event at once, then assemble it
+        std::vector<PlaylistEntry> tree;
+        tree.push_back(*pplaylistevent);
+        pchannel->m_pl.getDescendants(tree);
+
+        std::map<int, std::vector<PlaylistEntry*>> children;
+        for (size_t i = 1; i < tree.size(); ++i)
         {
-            pgeneratedevent->m_channel = pchannel->m_channame;
-            pgeneratedevent->m_targetdevice = pplaylistevent->m_device;
-            pgeneratedevent->m_duration = pplaylistevent->m_duration;
-            pgeneratedevent->m_eventtype = pplaylistevent->m_eventtype;
-            pgeneratedevent->m_triggertime = pplaylistevent->m_trigger;
-            pgeneratedevent->m_action = pplaylistevent->m_action;
-            pgeneratedevent->m_extradata = pplaylistevent->m_extras;
-            pgeneratedevent->m_eventid = pplaylistevent->m_eventid;
-            pgeneratedevent->m_preprocessor = pplaylistevent->m_preprocessor;
-            pgeneratedevent->m_description = pplaylistevent->m_description;
-
-            if (EVENT_MANUAL != pplaylistevent->m_eventtype)
-            {
-                // Check the device/processor is real and remains active
-                if ((0 == g_devices.count(pgeneratedevent->m_targetdevice)) &&
-                        (0 == g_mcprocessors.count(pgeneratedevent->m_targetdevice)))
-                {
-                    g_logger.warn("convertToMCEvent", "Got event for non-existent or unloaded device or processor: " +
-                            pgeneratedevent->m_targetdevice);
-                    throw std::exception();
-                }
+            children[tree[i].m_parent].push_back(&tree[i]);
+        }
 
-                // Get an action name if not an EP
-                if (pgeneratedevent->m_action > -1)
-                {
-                    try
-                    {
-                        pgeneratedevent->m_action_name = g_devices[pgeneratedevent->m_targetdevice]->m_actionlist->
-                                at(pgeneratedevent->m_action)->name;
-                    }
-                    catch (std::exception &ex)
-                    {
-                        g_logger.warn("convertToMCEvent", "Unable to locate action with index " +
-                                ConvertType::intToString(pgeneratedevent->m_action) + " on device " +
-                                pgeneratedevent->m_targetdevice);
-                    }
+        if (!buildMCEvent(tree[0], children, pchannel->m_channame, *pgeneratedevent))
+        {
+            plog->error("convert_to_mc_event", "Failed to convert event " +
+                    ConvertType::intToString(pplaylistevent->m_eventid) +
+                    " to MouseCatcher event");
+            return false;
+        }
 
-                }
+        return true;
+    }
+
+    /**
+     * Assemble MouseCatcher event trees from a flat list of playlist events. Strings
+     * and extradata are moved out of the playlist events rather than copied.
+     *
+     * @param playlistevents  Events and their descendants, such as from PlaylistDB::getEventForest()
+     * @param channelname     Name of the channel the events are on
+     * @param generatedevents Vector to append one tree for each event whose parent is not in the list
+     */
+    void buildMCEventTrees (std::vector<PlaylistEntry>& playlistevents, const std::string& channelname,
+            std::vector<MouseCatcherEvent>& generatedevents)
+    {
+        std::set<int> ids;
+        for (PlaylistEntry& thisevent : playlistevents)
+        {
+            ids.insert(thisevent.m_eventid);
+        }
+
+        // Children stay in list order, which is trigger order within each level
+        std::map<int, std::vector<PlaylistEntry*>> children;
+        for (PlaylistEntry& thisevent : playlistevents)
+        {
+            if (ids.count(thisevent.m_parent) > 0)
+            {
+                children[thisevent.m_parent].push_back(&thisevent);
             }
+        }
 
-            // Recursively grab child events
-            std::vector<PlaylistEntry> eventchildren =
-                    pchannel->m_pl.getChildEvents(pplaylistevent->m_eventid);
+        for (PlaylistEntry& thisevent : playlistevents)
+        {
+            if (0 == ids.count(thisevent.m_parent))
+            {
+                generatedevents.emplace_back();
+                buildMCEvent(thisevent, children, channelname, generatedevents.back());
+            }
+        }
+    }
 
-            for (PlaylistEntry thischild : eventchildren)
+    /**
+     * Convert one playlist event and, recursively, its children
+     *
+     * @param playlistevent  Event to convert. Its strings are moved out.
+     * @param children       Child events of each event, by parent ID
+     * @param channelname    Name of the channel the event is on
+     * @param generatedevent Event to populate
+     * @return               False if the event's device or processor no longer exists
+     */
+    static bool buildMCEvent (PlaylistEntry& playlistevent, std::map<int, std::vector<PlaylistEntry*>>& children,
+            const std::string& channelname, MouseCatcherEvent& generatedevent)
+    {
+        generatedevent.m_channel = channelname;
+        generatedevent.m_targetdevice = std::move(playlistevent.m_device);
+        std::shared_ptr<Device> pdevice = Device::getDeviceById(playlistevent.m_deviceid);
+        generatedevent.m_duration = playlistevent.m_duration;
+        generatedevent.m_eventtype = playlistevent.m_eventtype;
+        generatedevent.m_triggertime = playlistevent.m_trigger;
+        generatedevent.m_action = playlistevent.m_action;
+        generatedevent.m_extradata = std::move(playlistevent.m_extras);
+        generatedevent.m_eventid = playlistevent.m_eventid;
+        generatedevent.m_preprocessor = std::move(playlistevent.m_preprocessor);
+        generatedevent.m_description = std::move(playlistevent.m_description);
+
+        if (EVENT_MANUAL != playlistevent.m_eventtype)
+        {
+            // Check the device/processor is real and remains active
+            if (!pdevice && !MouseCatcherProcessorPlugin::getProcessorById(playlistevent.m_deviceid))
             {
-                MouseCatcherEvent tempchild;
-                MouseCatcherCore::convertToMCEvent(&thischild, pchannel, &tempchild, plog);
+                g_logger.warn("convertToMCEvent", "Got event for non-existent or unloaded device or processor: " +
+                        generatedevent.m_targetdevice);
+                return false;
+            }
 
-                pgeneratedevent->m_childevents.push_back(tempchild);
+            // Get an action name if not an EP
+            if (pdevice && generatedevent.m_action > -1)
+            {
+                try
+                {
+                    generatedevent.m_action_name = pdevice->m_actionlist->at(generatedevent.m_action)->name;
+                }
+                catch (std::exception &ex)
+                {
+                    g_logger.warn("convertToMCEvent", "Unable to locate action with index " +
+                            ConvertType::intToString(generatedevent.m_action) + " on device " +
+                            generatedevent.m_targetdevice);
+                }
             }
         }
-        catch (...)
+
+        std::map<int, std::vector<PlaylistEntry*>>::iterator found = children.find(playlistevent.m_eventid);
+        if (children.end() != found)
         {
-            plog->error("convert_to_mc_event", "Failed to convert event " +
-                    ConvertType::intToString(pplaylistevent->m_eventid) +
-                    " to MouseCatcher event");
-            return false;
+            generatedevent.m_childevents.resize(found->second.size());
+
+            for (size_t i = 0; i < found->second.size(); ++i)
+            {
+                buildMCEvent(*found->second[i], children, channelname, generatedevent.m_childevents[i]);
+            }
         }
 
         return true;
@@ -731,21 +1321,17 @@ namespace MouseCatcherCore
     bool convertToPlaylistEvent (MouseCatcherEvent *pmcevent, int parentid,
             PlaylistEntry *pplaylistevent)
     {
-        if (1 == g_devices.count(pmcevent->m_targetdevice) && EVENT_MANUAL != pmcevent->m_eventtype)
+        // Names are only resolved here, the playlist carries the ID from then on
+        int deviceid = g_deviceids.find(pmcevent->m_targetdevice);
+        std::shared_ptr<Device> pdevice = Device::getDeviceById(deviceid);
+
+        if (pdevice && EVENT_MANUAL != pmcevent->m_eventtype)
         {
-            pplaylistevent->m_devicetype = g_devices[pmcevent->m_targetdevice]->getType();
+            pplaylistevent->m_devicetype = pdevice->getType();
 
             if (-1 == pmcevent->m_action)
             {
-                // Lookup the action ID from the list
-                for (const ActionInformation *thisaction : *(g_devices[pmcevent->m_targetdevice]->m_actionlist))
-                {
-                    if (!thisaction->name.compare(pmcevent->m_action_name))
-                    {
-                        pmcevent->m_action = thisaction->actionid;
-                        break;
-                    }
-                }
+                pmcevent->m_action = pdevice->getActionId(pmcevent->m_action_name);
 
                 // Check we got an ID number
                 if (-1 == pmcevent->m_action)
@@ -758,7 +1344,7 @@ namespace MouseCatcherCore
         }
         else if (EVENT_MANUAL != pmcevent->m_eventtype)
         {
-            if (1 == g_mcprocessors.count(pmcevent->m_targetdevice))
+            if (MouseCatcherProcessorPlugin::getProcessorById(deviceid))
             {
                 pplaylistevent->m_devicetype = EVENTDEVICE_PROCESSOR;
             }
@@ -771,6 +1357,7 @@ namespace MouseCatcherCore
         }
 
         pplaylistevent->m_device = pmcevent->m_targetdevice;
+        pplaylistevent->m_deviceid = deviceid;
         pplaylistevent->m_duration = pmcevent->m_duration;
         pplaylistevent->m_trigger = pmcevent->m_triggertime;
         pplaylistevent->m_action = pmcevent->m_action;
@@ -25,9 +25,11 @@
 
 #include "MouseCatcherProcessorPlugin.h"
 #include "PluginConfig.h"
+#include "AsyncJobSystem.h"
 #include "Log.h"
 
 extern std::map<std::string, std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessors;
+extern std::vector<std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessortable;
 
 /**
  * Load a Processor plugin and set the base config up
@@ -39,6 +41,7 @@ MouseCatcherProcessorPlugin::MouseCatcherProcessorPlugin (PluginConfig config, H
         Plugin(config, h)
 {
     m_processorinfo.name = config.m_name;
+    m_processorid = -1;
 
     if (config.m_plugindata_map.count("Description"))
     {
@@ -69,6 +72,37 @@ void MouseCatcherProcessorPlugin::addPluginReference (std::shared_ptr<Plugin> th
     std::shared_ptr<MouseCatcherProcessorPlugin> thisproc =
             std::dynamic_pointer_cast<MouseCatcherProcessorPlugin>(thisplugin);
     g_mcprocessors[thisproc->getPluginName()] = std::shared_ptr<MouseCatcherProcessorPlugin>(thisproc);
+
+    thisproc->m_processorid = g_deviceids.intern(thisproc->getPluginName());
+    if (g_mcprocessortable.size() <= static_cast<size_t>(thisproc->m_processorid))
+    {
+        g_mcprocessortable.resize(thisproc->m_processorid + 1);
+    }
+    g_mcprocessortable[thisproc->m_processorid] = thisproc;
+}
+
+/**
+ * @return This processor's ID from g_deviceids
+ */
+int MouseCatcherProcessorPlugin::getProcessorId ()
+{
+    return m_processorid;
+}
+
+/**
+ * Find a loaded EventProcessor from its ID
+ *
+ * @param processorid ID from g_deviceids
+ * @return            The processor, or an empty pointer if no processor with that ID is loaded
+ */
+std::shared_ptr<MouseCatcherProcessorPlugin> MouseCatcherProcessorPlugin::getProcessorById (int processorid)
+{
+    if (processorid < 0 || static_cast<size_t>(processorid) >= g_mcprocessortable.size())
+    {
+        return std::shared_ptr<MouseCatcherProcessorPlugin>();
+    }
+
+    return g_mcprocessortable[processorid];
 }
 
 /**
@@ -84,11 +118,70 @@ ProcessorInformation MouseCatcherProcessorPlugin::getProcessorInformation ()
 /**
  * Placeholder function.
  *
- * @param originalEvent
+ * @param originalEvent  Event to process. Owned by the caller for this call only, so may be modified.
  * @param resultingEvent
  */
-void MouseCatcherProcessorPlugin::handleEvent(MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent)
+void MouseCatcherProcessorPlugin::handleEvent(MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent)
 {
 
 }
 
+/**
+ * Check the devices and processors this processor generates events for are
+ * available. Runs on the tick thread with the core lock held, so this is the
+ * place to read shared state that handleEvent() would otherwise need.
+ *
+ * @return True if handleEvent() can go ahead
+ */
+bool MouseCatcherProcessorPlugin::checkRequirements ()
+{
+    return true;
+}
+
+/**
+ * Run the processor away from the tick thread. MouseCatcher holds a placeholder
+ * in the playlist until the returned future is ready.
+ *
+ * The default calls checkRequirements() straight away, then runs handleEvent()
+ * as an async job without the core lock, so handleEvent() must only use the
+ * event and this processor's configuration. Processors with their own
+ * asynchronous work should override this.
+ *
+ * @param originalEvent Event to process
+ * @return              Future holding the generated event tree
+ */
+std::future<MouseCatcherEvent> MouseCatcherProcessorPlugin::handleEventAsync (MouseCatcherEvent originalEvent)
+{
+    std::shared_ptr<std::promise<MouseCatcherEvent>> presult = std::make_shared<std::promise<MouseCatcherEvent>>();
+    std::future<MouseCatcherEvent> result = presult->get_future();
+
+    if (!checkRequirements())
+    {
+        presult->set_exception(std::make_exception_ptr(std::exception()));
+        return result;
+    }
+
+    // Hold a reference so the processor outlives an unload while the job waits
+    std::shared_ptr<MouseCatcherProcessorPlugin> pprocessor = g_mcprocessors[m_pluginname];
+
+    // Hand the event to the job as its data so it is moved rather than copied into the capture
+    std::shared_ptr<MouseCatcherEvent> poriginal = std::make_shared<MouseCatcherEvent>(std::move(originalEvent));
+
+    m_hook.gs->Async->newAsyncJob(
+            [pprocessor, presult] (std::shared_ptr<void> data, std::timed_mutex &core_lock)
+            {
+                try
+                {
+                    MouseCatcherEvent& originalevent = *std::static_pointer_cast<MouseCatcherEvent>(data);
+                    MouseCatcherEvent resultingevent = originalevent;
+                    pprocessor->handleEvent(originalevent, resultingevent);
+                    presult->set_value(std::move(resultingevent));
+                }
+                catch (...)
+                {
+                    presult->set_exception(std::current_exception());
+                }
+            }, nullptr, poriginal, 0, false, "", m_pluginname);
+
+    return result;
+}
@@ -64,14 +64,49 @@ void MouseCatcherSourcePlugin::addPluginReference (std::shared_ptr<Plugin> thisp
 }
 
 /**
- * Static predicate used to erase completed items from the ActionQueue
- * @param a		 The EventAction checked
- * @param plugin The plugin running the queue checks
- * @return		 True if the EventAction is processed and owned by the plugin
+ * Default handler for schedule gap updates, for sources which never ask for them
+ *
+ * @param channel        Channel the gaps were found on
+ * @param gaps           Unscheduled periods on the channel
+ * @param additionaldata Data passed in with the original request
+ */
+void MouseCatcherSourcePlugin::updateGaps (std::string channel, std::vector<TimelineGap>& gaps,
+        std::shared_ptr<void> additionaldata)
+{
+    m_hook.gs->L->warn(m_pluginname, "Received schedule gaps but this EventSource does not handle them");
+}
+
+/**
+ * Hand a finished action back to this source. Called by the core.
+ *
+ * @param action The completed action, moved into the completion queue
+ */
+void MouseCatcherSourcePlugin::completeAction (EventAction& action)
+{
+    m_completedactions.push(std::move(action));
+}
+
+/**
+ * Send an action to the core for processing. May be called from any thread.
+ *
+ * @param action The action to queue. Completion is reported back to this source.
+ */
+void MouseCatcherSourcePlugin::queueAction (EventAction action)
+{
+    action.thisplugin = this;
+    action.isprocessed = false;
+    action.queuedtime = std::chrono::steady_clock::now();
+    MouseCatcherCore::g_actionqueue.push(std::move(action));
+}
+
+/**
+ * Take the next action the core has finished processing for this source
+ *
+ * @param action Set to the completed action
+ * @return       False if there are no completed actions waiting
  */
-bool MouseCatcherSourcePlugin::actionCompleteCheck (const EventAction &a,
-		const MouseCatcherSourcePlugin *plugin)
+bool MouseCatcherSourcePlugin::getCompletedAction (EventAction& action)
 {
-	return (a.isprocessed) && (a.thisplugin == plugin);
+    return m_completedactions.pop(action);
 }
 
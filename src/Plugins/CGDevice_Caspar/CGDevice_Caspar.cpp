@@ -37,6 +37,7 @@ CGDevice_Caspar::CGDevice_Caspar (PluginConfig config, Hook h) :
 {
     // Pull server name, port and layer from configuration data
     long int connecttimeout;
+    int pipelinedepth = CASPAR_DEFAULT_PIPELINE_DEPTH;
 
     try
     {
@@ -45,6 +46,11 @@ CGDevice_Caspar::CGDevice_Caspar (PluginConfig config, Hook h) :
         m_layer = ConvertType::stringToInt(config.m_plugindata_map.at("Layer"));
 
         connecttimeout = ConvertType::stringToInt(config.m_plugindata_map.at("ConnectTimeout"));
+
+        if (config.m_plugindata_map.count("PipelineDepth"))
+        {
+            pipelinedepth = ConvertType::stringToInt(config.m_plugindata_map.at("PipelineDepth"));
+        }
     }
     catch (std::exception& ex)
     {
@@ -58,6 +64,7 @@ CGDevice_Caspar::CGDevice_Caspar (PluginConfig config, Hook h) :
     try
     {
         m_pcaspcon = std::make_shared<CasparConnection>(m_hostname, m_port, connecttimeout);
+        m_pcaspcon->setPipelineDepth(pipelinedepth);
     }
     catch (...)
     {
@@ -168,7 +175,7 @@ void CGDevice_Caspar::add (std::string graphicname, int layer,
     }
 
     com.play(graphicname);
-    m_pcaspcon->sendCommand(com);
+    m_pcaspcon->sendCommand(com, true);
 
 }
 
@@ -197,7 +204,7 @@ void CGDevice_Caspar::remove (int layer)
         com.setHostLayer(layer);
 
         com.stop();
-        m_pcaspcon->sendCommand(com);
+        m_pcaspcon->sendCommand(com, true);
     }
 }
 
@@ -220,7 +227,7 @@ void CGDevice_Caspar::play (int layer)
         com.setHostLayer(layer);
 
         com.next();
-        m_pcaspcon->sendCommand(com);
+        m_pcaspcon->sendCommand(com, true);
     }
     else
     {
@@ -254,7 +261,7 @@ void CGDevice_Caspar::update (int layer, std::map<std::string, std::string> *pda
         }
 
         com.update();
-        m_pcaspcon->sendCommand(com);
+        m_pcaspcon->sendCommand(com, true);
     }
     else
     {
@@ -269,7 +276,7 @@ void CGDevice_Caspar::update (int layer, std::map<std::string, std::string> *pda
  *
  * @param resp  Lines of data from CasparCG
  */
-void CGDevice_Caspar::cb_info (std::vector<std::string>& resp)
+void CGDevice_Caspar::cb_info (CasparResponse& resp)
 {
     // Nothing to do!
 }
@@ -277,9 +284,9 @@ void CGDevice_Caspar::cb_info (std::vector<std::string>& resp)
 /**
  * Callback to handle files update
  *
- * @param resp Vector filled with lines from CasparCG
+ * @param resp Response from CasparCG
  */
-void CGDevice_Caspar::cb_updatetemplates (std::vector<std::string>& resp)
+void CGDevice_Caspar::cb_updatetemplates (CasparResponse& resp)
 {
     //Call the processor
     CasparQueryResponseProcessor::getTemplateList(resp, m_templatelist);
@@ -55,7 +55,7 @@ private:
     int m_layer;
 
     // Callback functions for CasparCG commands
-    void cb_info (std::vector<std::string>& resp);
-    void cb_updatetemplates (std::vector<std::string>& resp);
+    void cb_info (CasparResponse& resp);
+    void cb_updatetemplates (CasparResponse& resp);
 };
 
@@ -50,19 +50,29 @@ EventProcessor_Demo::~EventProcessor_Demo ()
 }
 
 /**
- * Handle an incoming event directed at this plugin
- * @param originalEvent MouseCatcherEvent The event which spawned this plugin call
- * @param resultingEvents vector<MouseCatcherEvent>* A pointer to a vector of events generated by this call
+ * Refuse to process events unless the plugin loaded cleanly
+ *
+ * @return True if the plugin is ready
  */
-void EventProcessor_Demo::handleEvent (MouseCatcherEvent originalEvent,
-        MouseCatcherEvent& resultingEvent)
+bool EventProcessor_Demo::checkRequirements ()
 {
     if (READY != m_status)
     {
         m_hook.gs->L->error(m_pluginname, "Plugin not in ready state");
-        return;
+        return false;
     }
 
+    return true;
+}
+
+/**
+ * Handle an incoming event directed at this plugin
+ * @param originalEvent MouseCatcherEvent The event which spawned this plugin call
+ * @param resultingEvents vector<MouseCatcherEvent>* A pointer to a vector of events generated by this call
+ */
+void EventProcessor_Demo::handleEvent (MouseCatcherEvent& originalEvent,
+        MouseCatcherEvent& resultingEvent)
+{
     resultingEvent = originalEvent;
 
     // Create a child
@@ -70,8 +80,8 @@ void EventProcessor_Demo::handleEvent (MouseCatcherEvent originalEvent,
     childevent.m_channel = "Default";
     childevent.m_duration = 1;
     childevent.m_action = 0;
-    childevent.m_extradata["output"] = "Default";
-    childevent.m_extradata["input"] = "Inform";
+    childevent.m_extradata[EXTRA_OUTPUT] = "Default";
+    childevent.m_extradata[EXTRA_INPUT] = "Inform";
     childevent.m_targetdevice = "Demo Crosspoint 1";
     childevent.m_triggertime = originalEvent.m_triggertime;
     childevent.m_preprocessor = "EventProcessor_Demo::demoPreProcessor";
@@ -34,6 +34,7 @@
 #include "Misc.h"
 #include "MouseCatcherCore.h"
 #include "DateConversions.h"
+#include "AsyncTask.h"
 
 
 
@@ -60,8 +61,6 @@ EventProcessor_Fill::EventProcessor_Fill (PluginConfig config, Hook h) :
     // Create database connection
     m_pdb = std::shared_ptr<FillDB>(new FillDB(m_dbfile, m_weightpoints, m_fileweight));
 
-    m_placeholderid = 0;
-
     // Populate information array
     m_processorinfo.data["duration"] = "int";
 
@@ -71,8 +70,7 @@ EventProcessor_Fill::EventProcessor_Fill (PluginConfig config, Hook h) :
     g_preprocessorlist.emplace("EventProcessor_Fill::populateCGNowNext", &EventProcessor_Fill::populateCGNowNext);
     g_preprocessorlist.emplace("EventProcessor_Fill::singleShotMode_" + config.m_instance,
             std::bind(&EventProcessor_Fill::singleShotMode, std::placeholders::_1, std::placeholders::_2,
-                    m_structuredata, m_filler, m_continuityfill, m_continuitymin, m_offset, m_jobpriority,
-                    m_pdb, m_pluginname));
+                    getJobSettings(), m_jobpriority));
 
 }
 
@@ -171,11 +169,11 @@ void EventProcessor_Fill::readConfig (PluginConfig config)
         return;
     }
 
-    m_continuityfill.m_extradata["hostlayer"] = continuitynode.child_value("HostLayer");
-    if (m_continuityfill.m_extradata["hostlayer"].empty())
+    m_continuityfill.m_extradata[EXTRA_HOSTLAYER] = continuitynode.child_value("HostLayer");
+    if (m_continuityfill.m_extradata[EXTRA_HOSTLAYER].empty())
     {
         m_hook.gs->L->warn(config.m_instance, "ContinuityFill HostLayer not set, selecting 1");
-        m_continuityfill.m_extradata["hostlayer"] = "1";
+        m_continuityfill.m_extradata[EXTRA_HOSTLAYER] = "1";
         return;
     }
 
@@ -184,8 +182,8 @@ void EventProcessor_Fill::readConfig (PluginConfig config)
     // Create the "Add" event
     MouseCatcherEvent continuitychild = m_continuityfill;
 
-    continuitychild.m_extradata["graphicname"] = continuitynode.child_value("GraphicName");
-    if (continuitychild.m_extradata["graphicname"].empty())
+    continuitychild.m_extradata[EXTRA_GRAPHICNAME] = continuitynode.child_value("GraphicName");
+    if (continuitychild.m_extradata[EXTRA_GRAPHICNAME].empty())
     {
         m_hook.gs->L->warn(config.m_instance, "ContinuityFill graphic name not set, disabling plugin");
         m_status = FAILED;
@@ -197,7 +195,7 @@ void EventProcessor_Fill::readConfig (PluginConfig config)
 
     continuitychild.m_action_name = "Add";
     continuitychild.m_duration = 1;
-    continuitychild.m_extradata["nexttext"] = "ppfill";
+    continuitychild.m_extradata[EXTRA_NEXTTEXT] = "ppfill";
     continuitychild.m_extradata["thentext"] = "ppfill";
 
     m_continuityfill.m_childevents.push_back(continuitychild);
@@ -206,58 +204,78 @@ void EventProcessor_Fill::readConfig (PluginConfig config)
     continuitychild.m_action_name = "Remove";
     continuitychild.m_preprocessor = "";
     continuitychild.m_extradata.clear();
-    continuitychild.m_extradata["hostlayer"] = m_continuityfill.m_extradata["hostlayer"];
+    continuitychild.m_extradata[EXTRA_HOSTLAYER] = m_continuityfill.m_extradata[EXTRA_HOSTLAYER];
     m_continuityfill.m_childevents.push_back(continuitychild);
 
     m_continuityfill.m_action_name = "Parent";
 }
 
 /**
- * Set up an async job to fill the schedule automatically by generating events.
- * Will return a placeholder event with an ID marker, to be populated when the
- * async job completes in populatePlaceholderEvent().
+ * Fill the schedule straight away, generating the children of the event.
+ * This writes plays to the database under the core lock, so must not be called
+ * while holding it.
  *
  * @param originalEvent  Event handle to use a base and duration
- * @param resultingEvent Placeholder event to be populated with generated children
+ * @param resultingEvent Event to be populated with generated children
  */
-void EventProcessor_Fill::handleEvent(MouseCatcherEvent originalEvent,
+void EventProcessor_Fill::handleEvent(MouseCatcherEvent& originalEvent,
         MouseCatcherEvent& resultingEvent)
 {
-    // Sort out durations
-    if (originalEvent.m_duration <= 0)
-    {
-        m_hook.gs->L->warn(m_pluginname, "No duration given, selecting 10s instead");
-        originalEvent.m_duration = 10 * g_pbaseconfig->getFramerate();
-    }
+    setDefaultDuration(originalEvent);
 
-    // Copy the input event onto the output placeholder
     resultingEvent = originalEvent;
+    generateFilledEvents(resultingEvent, getJobSettings(), m_singleshot, g_core_lock);
+}
 
-    int currentplaceholder;
+/**
+ * Fill the schedule as an async job, handing the generated events straight back
+ * to MouseCatcher to replace its placeholder. In single shot mode only the first
+ * event comes back, and the rest are generated under the same parent as each one plays.
+ *
+ * @param originalEvent Event to use as a base and duration
+ * @return              Future holding the event with generated children
+ */
+std::future<MouseCatcherEvent> EventProcessor_Fill::handleEventAsync (MouseCatcherEvent originalEvent)
+{
+    setDefaultDuration(originalEvent);
 
-    if (!m_singleshot)
-    {
-        currentplaceholder = ++m_placeholderid;
-    }
-    else
-    {
-        currentplaceholder = -1;
-    }
+    std::shared_ptr<MouseCatcherEvent> pfilledevent = std::make_shared<MouseCatcherEvent>(std::move(originalEvent));
+    std::shared_ptr<std::promise<MouseCatcherEvent>> presult = std::make_shared<std::promise<MouseCatcherEvent>>();
+    std::future<MouseCatcherEvent> result = presult->get_future();
 
-    // Add a placeholder ID to identify this event later
-    resultingEvent.m_extradata["placeholderID"] = ConvertType::intToString(currentplaceholder);
+    FillJobSettings settings = getJobSettings();
+    bool singleshot = m_singleshot;
 
-    // Create a new async job to actually run the processor
-    std::shared_ptr<MouseCatcherEvent> pfilledevent = std::make_shared<MouseCatcherEvent>(resultingEvent);
+    // Fills from this processor run in order so each sees the plays recorded by the last
+    m_hook.gs->Async->newAsyncJob(
+            [=] (std::shared_ptr<void> data, std::timed_mutex &core_lock)
+            {
+                try
+                {
+                    generateFilledEvents(*pfilledevent, settings, singleshot, core_lock);
+                    presult->set_value(std::move(*pfilledevent));
+                }
+                catch (...)
+                {
+                    presult->set_exception(std::current_exception());
+                }
+            }, nullptr, pfilledevent, m_jobpriority, false, m_pluginname, m_pluginname);
 
+    return result;
+}
 
-    m_hook.gs->Async->newAsyncJob(
-            std::bind(&EventProcessor_Fill::generateFilledEvents, pfilledevent, m_pdb, m_structuredata, m_filler,
-                    m_singleshot, m_continuityfill, m_continuitymin, g_pbaseconfig->getFramerate(),
-                    std::placeholders::_1, std::placeholders::_2, m_offset, m_pluginname),
-            std::bind(&EventProcessor_Fill::populatePlaceholderEvent, pfilledevent, currentplaceholder,
-                    std::placeholders::_1),
-            pfilledevent, m_jobpriority, false);
+/**
+ * Pick a duration for events which came without one
+ *
+ * @param event Event to check and update
+ */
+void EventProcessor_Fill::setDefaultDuration (MouseCatcherEvent& event)
+{
+    if (event.m_duration <= 0)
+    {
+        m_hook.gs->L->warn(m_pluginname, "No duration given, selecting 10s instead");
+        event.m_duration = 10 * g_pbaseconfig->getFramerate();
+    }
 }
 
 /**
@@ -275,39 +293,49 @@ void EventProcessor_Fill::addFile (std::string filename, std::string device, std
     m_pdb->addFile(filename, device, type, duration, weight);
 }
 
+/**
+ * Take copies of everything a fill job needs, as this plugin could be unloaded before it runs
+ *
+ * @return Settings to hand to generateFilledEvents()
+ */
+FillJobSettings EventProcessor_Fill::getJobSettings ()
+{
+    FillJobSettings settings;
+    settings.m_pdb = m_pdb;
+    settings.m_structuredata = m_structuredata;
+    settings.m_filler = m_filler;
+    settings.m_continuityfill = m_continuityfill;
+    settings.m_continuitymin = m_continuitymin;
+    settings.m_framerate = g_pbaseconfig->getFramerate();
+    settings.m_offset = m_offset;
+    settings.m_pluginname = m_pluginname;
+    return settings;
+}
+
 /**
  * Generates a series of events based on configuration file, to fill a chunk
  * of time in the schedule. Uses the Duration field of the original event but
  * devices to operate on and the types to form are based on config file.
  *
- * Designed to run as an async job so takes copies of all the class members it needs
+ * Designed to run as an async job so works from copies of the class members it needs
  * to save on a long core lock
  *
- * @param event          Pointer to an event which will be filled with generated data
- * @param db             Pointer to m_pdb
- * @param structuredata  m_structuredata from the calling class
- * @param filler         m_filler from the calling class
- * @param singleshot     m_singleshot from the calling class
- * @param continuityfill m_continuityfill from the calling class
- * @param continuitymin  m_continuitymin from the calling class
- * @param framerate      System frame rate
- * @param data           Unused pointer to async data struct
- * @param core_lock      Reference to core locking mutex
- * @param offset         Timings offset for events
+ * @param event      Event which will be filled with generated data
+ * @param settings   Copies of the plugin settings from getJobSettings()
+ * @param singleshot Generate one event at a time instead of the whole block
+ * @param core_lock  Reference to core locking mutex
  */
-void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEvent> event, std::shared_ptr<FillDB> db,
-        std::vector<std::pair<std::string, std::string>> structuredata, bool filler, bool singleshot,
-        MouseCatcherEvent continuityfill, int continuitymin, float framerate, std::shared_ptr<void> data,
-        std::timed_mutex &core_lock, int offset, std::string pluginname)
+void EventProcessor_Fill::generateFilledEvents (MouseCatcherEvent& event, const FillJobSettings& settings,
+        bool singleshot, std::timed_mutex &core_lock)
 {
 	g_logger.info("generateFilledEvents " + ERROR_LOC, "Running fill algorithm...");
 
-    int duration = event->m_duration;
+    int duration = event.m_duration;
 
     // Knock off a few seconds for minimum continuity time
-    if ((duration - offset) > continuitymin)
+    if ((duration - settings.m_offset) > settings.m_continuitymin)
     {
-        duration = duration - continuitymin - offset;
+        duration = duration - settings.m_continuitymin - settings.m_offset;
     }
     else
     {
@@ -318,8 +346,8 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
     // Assemble a template event to populate with filename
     MouseCatcherEvent templateevent;
     templateevent.m_action = 0;
-    templateevent.m_channel = event->m_channel;
-    templateevent.m_triggertime = event->m_triggertime;
+    templateevent.m_channel = event.m_channel;
+    templateevent.m_triggertime = event.m_triggertime;
     templateevent.m_eventtype = EVENT_FIXED;
 
     // Temporary storage for played file data
@@ -333,9 +361,9 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
     int id;
 
     // Is a list of IDs to avoid already set?
-    if (event->m_extradata.count("blacklistids") > 0)
+    if (event.m_extradata.count("blacklistids") > 0)
     {
-        pastids = event->m_extradata["blacklistids"];
+        pastids = event.m_extradata["blacklistids"];
     }
     else
     {
@@ -343,9 +371,9 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
     }
 
     // Loop over each type in m_structuredata and generate an event
-    for (std::pair<std::string, std::string> thistype : structuredata)
+    for (std::pair<std::string, std::string> thistype : settings.m_structuredata)
     {
-        id = db->getBestFile(filename, event->m_triggertime,
+        id = settings.m_pdb->getBestFile(filename, event.m_triggertime,
                 duration, thistype.second, thistype.first, resultduration, description, pastids);
 
         if (id > 0)
@@ -354,7 +382,7 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
             duration -= resultduration;
 
             // Add an event for this file
-            templateevent.m_extradata["filename"] = filename;
+            templateevent.m_extradata[EXTRA_FILENAME] = filename;
             templateevent.m_duration = resultduration;
             templateevent.m_targetdevice = thistype.second;
             templateevent.m_description = description;
@@ -362,25 +390,23 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
             if (true == singleshot)
             {
                 // Set the preprocessor to generate the next event
-                templateevent.m_preprocessor = "EventProcessor_Fill::singleShotMode_" + pluginname;
+                templateevent.m_preprocessor = "EventProcessor_Fill::singleShotMode_" + settings.m_pluginname;
 
                 // Set remaining time for the benefit of the preprocessor
                 templateevent.m_extradata["remainingtime"] = std::to_string(duration);
 
-                // Propagate the placeholder ID
-                templateevent.m_extradata["placeholderID"] = event->m_extradata["placeholderID"];
-
                 // Set blacklisted IDs
                 templateevent.m_extradata["blacklistids"] = pastids;
             }
 
-            event->m_childevents.push_back(templateevent);
+            event.m_childevents.push_back(templateevent);
 
             // Mark the play
             playdata.push_back(std::make_pair(id, templateevent.m_triggertime));
 
             // Update template triggertime
-            templateevent.m_triggertime += static_cast<int>(resultduration / framerate) + offset;
+            templateevent.m_triggertime += static_cast<int>(resultduration / settings.m_framerate) +
+                    settings.m_offset;
 
         }
         else
@@ -395,29 +421,30 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
     }
 
     // Now fill the remaining time with whatever type was tagged as filler
-    if (filler && !singleshot)
+    if (settings.m_filler && !singleshot)
     {
         while (duration > 0)
         {
-            id = db->getBestFile(filename, event->m_triggertime,
-                    duration, structuredata.back().second,
-                    structuredata.back().first, resultduration, description, pastids);
+            id = settings.m_pdb->getBestFile(filename, event.m_triggertime,
+                    duration, settings.m_structuredata.back().second,
+                    settings.m_structuredata.back().first, resultduration, description, pastids);
 
             if (id > 0)
             {
                 // Add an event for this file
-                templateevent.m_extradata["filename"] = filename;
+                templateevent.m_extradata[EXTRA_FILENAME] = filename;
                 templateevent.m_duration = resultduration;
-                templateevent.m_targetdevice = structuredata.front().second;
+                templateevent.m_targetdevice = settings.m_structuredata.front().second;
                 templateevent.m_description = description;
 
-                event->m_childevents.push_back(templateevent);
+                event.m_childevents.push_back(templateevent);
 
                 // Mark the play
                 playdata.push_back(std::make_pair(id, templateevent.m_triggertime));
 
                 // Update template triggertime
-                templateevent.m_triggertime += static_cast<int>(resultduration / framerate) + offset;
+                templateevent.m_triggertime += static_cast<int>(resultduration / settings.m_framerate) +
+                        settings.m_offset;
 
                 // Reduce remaining duration
                 duration -= resultduration;
@@ -435,28 +462,29 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
     {
     	std::lock_guard<std::timed_mutex> lock(core_lock);
 
-		db->beginTransaction();
+		settings.m_pdb->beginTransaction();
 		for (std::pair<int, int> thisplay : playdata)
 		{
-			db->addPlay(thisplay.first, thisplay.second);
+			settings.m_pdb->addPlay(thisplay.first, thisplay.second);
 		}
-		db->endTransaction();
+		settings.m_pdb->endTransaction();
     }
 
-    if (!singleshot || 0 == event->m_childevents.size())
+    if (!singleshot || 0 == event.m_childevents.size())
     {
         // Generate the continuity event for the rest
-        continuityfill.m_channel = event->m_channel;
-        continuityfill.m_duration = static_cast<int>((continuitymin + duration) / framerate);
+        MouseCatcherEvent continuityfill = settings.m_continuityfill;
+        continuityfill.m_channel = event.m_channel;
+        continuityfill.m_duration = static_cast<int>((settings.m_continuitymin + duration) / settings.m_framerate);
         continuityfill.m_triggertime = templateevent.m_triggertime;
 
-        continuityfill.m_childevents[0].m_extradata["nowtext"] = "Now: " + event->m_description;
-        continuityfill.m_childevents[0].m_channel = event->m_channel;
-        continuityfill.m_childevents[1].m_channel = event->m_channel;
+        continuityfill.m_childevents[0].m_extradata[EXTRA_NOWTEXT] = "Now: " + event.m_description;
+        continuityfill.m_childevents[0].m_channel = event.m_channel;
+        continuityfill.m_childevents[1].m_channel = event.m_channel;
         continuityfill.m_childevents[0].m_triggertime = templateevent.m_triggertime;
         continuityfill.m_childevents[1].m_triggertime = templateevent.m_triggertime +
-                static_cast<int>((continuitymin + duration) / framerate);
-        event->m_childevents.push_back(continuityfill);
+                static_cast<int>((settings.m_continuitymin + duration) / settings.m_framerate);
+        event.m_childevents.push_back(continuityfill);
     }
 }
 
@@ -464,53 +492,17 @@ void EventProcessor_Fill::generateFilledEvents (std::shared_ptr<MouseCatcherEven
  * Adds child events generated by async job to the playlist,
  * attached to the appropriate parent.
  *
- * @param event          Pointer to top level event containing children to add
- * @param placeholder_id ID number inside placeholder event to identify it
- * @param data           Unused data struct
+ * @param event    Top level event containing children to add
+ * @param parentid ID of the event to add the children under, or -1 for top-level
  */
-void EventProcessor_Fill::populatePlaceholderEvent (std::shared_ptr<MouseCatcherEvent> event,
-        int placeholder_id, std::shared_ptr<void> data)
+void EventProcessor_Fill::addFilledEvents (MouseCatcherEvent& event, int parentid)
 {
-    // Find the events in the playlist matching this time
-	int channelid = Channel::getChannelByName(event->m_channel);
-
-    std::vector<PlaylistEntry> eventlist;
-
-    eventlist = g_channels[channelid]->m_pl.getEvents(event->m_eventtype, event->m_triggertime);
-
-    // Look for the correct data tag
-    int eventid = -1;
-
-    // If a parentid was provided, skip playlist search
-    if (placeholder_id != -1)
-    {
-        for (PlaylistEntry &ev : eventlist)
-        {
-            if (ev.m_extras.count("placeholderID"))
-            {
-                try
-                {
-                    if (std::stoi(ev.m_extras["placeholderID"]) == placeholder_id &&
-                            !ev.m_device.compare(event->m_targetdevice))
-                    {
-                        eventid = ev.m_eventid;
-                        break;
-                    }
-                }
-                catch (...)
-                {
-                    eventid = -1;
-                }
-            }
-        }
-    }
-
     // Add each child to the playlist using the normal processEvent() mechanism
     EventAction action;
 
-    for (MouseCatcherEvent child : event->m_childevents)
+    for (MouseCatcherEvent& child : event.m_childevents)
     {
-        MouseCatcherCore::processEvent(child, eventid, eventid > -1, action);
+        MouseCatcherCore::processEvent(child, parentid, parentid > -1, action);
     }
 }
 
@@ -544,15 +536,15 @@ void EventProcessor_Fill::populateCGNowNext (PlaylistEntry &event, Channel *pcha
     if (!followlist.empty())
     {
         // Populate "next" from the description of next event if required
-        if (!event.m_extras["nexttext"].compare("ppfill"))
+        if (!event.m_extras[EXTRA_NEXTTEXT].compare("ppfill"))
         {
             if (!followlist[0].m_description.empty())
             {
-                event.m_extras["nexttext"] = "Next: " + followlist[0].m_description;
+                event.m_extras[EXTRA_NEXTTEXT] = "Next: " + followlist[0].m_description;
             }
             else
             {
-                event.m_extras["nexttext"] = "";
+                event.m_extras[EXTRA_NEXTTEXT] = "";
             }
         }
 
@@ -575,32 +567,22 @@ void EventProcessor_Fill::populateCGNowNext (PlaylistEntry &event, Channel *pcha
         }
     }
 
-    if (!event.m_extras["nexttext"].compare("ppfill"))
+    if (!event.m_extras[EXTRA_NEXTTEXT].compare("ppfill"))
     {
-        event.m_extras["nexttext"] = "";
+        event.m_extras[EXTRA_NEXTTEXT] = "";
     }
 }
 
 /**
  * Generate another EP_Fill event immediately after this one
  *
- * @param event          The current event about to be run
- * @param pchannel       Pointer to the calling channel
- * @param newevent       Copy of original MC event sent to EP
- * @param structuredata  m_structuredata from the calling class
- * @param filler         m_filler from the calling class
- * @param continuityfill m_continuityfill from the calling class
- * @param continuitymin  m_continuitymin from the calling class
- * @param framerate      System frame rate
- * @param offset         Timings offset for events
- * @param jobpriority    Priority setting for async jobs
- * @param pdb            Pointer to database
- * @param pluginname     Instance name for this file
+ * @param event       The current event about to be run
+ * @param pchannel    Pointer to the calling channel
+ * @param settings    Copies of the plugin settings from getJobSettings()
+ * @param jobpriority Priority setting for async jobs
  */
-void EventProcessor_Fill::singleShotMode (PlaylistEntry &event, Channel *pchannel,
-        std::vector<std::pair<std::string, std::string>> structuredata, bool filler,
-        MouseCatcherEvent continuityfill, int continuitymin, int offset,
-        int jobpriority, std::shared_ptr<FillDB> pdb, std::string pluginname)
+void EventProcessor_Fill::singleShotMode (PlaylistEntry &event, Channel *pchannel, FillJobSettings settings,
+        int jobpriority)
 {
     MouseCatcherEvent newevent;
     newevent.m_action = -1;
@@ -608,7 +590,7 @@ void EventProcessor_Fill::singleShotMode (PlaylistEntry &event, Channel *pchanne
     newevent.m_description = event.m_description;
     newevent.m_duration = std::stoi(event.m_extras["remainingtime"]);
     newevent.m_eventtype = EVENT_FIXED;
-    newevent.m_preprocessor = "EventProcessor_Fill::singleShotMode_" + pluginname;
+    newevent.m_preprocessor = "EventProcessor_Fill::singleShotMode_" + settings.m_pluginname;
     newevent.m_targetdevice = event.m_device;
     newevent.m_triggertime = event.m_trigger +
             static_cast<int>(event.m_duration / g_pbaseconfig->getFramerate());
@@ -617,16 +599,20 @@ void EventProcessor_Fill::singleShotMode (PlaylistEntry &event, Channel *pchanne
     g_logger.info("Single Shot Preprocessor" + ERROR_LOC, "Now generating new event with " +
             std::to_string(newevent.m_duration / g_pbaseconfig->getFramerate()) + " seconds left.");
 
-    // Create a new async job to actually run the processor
-    std::shared_ptr<MouseCatcherEvent> pfilledevent = std::make_shared<MouseCatcherEvent>(newevent);
+    // Keep the next event alongside this one, under the same fill event
+    int parentid = pchannel->m_pl.getParentEventID(event.m_eventid);
 
-    g_async.newAsyncJob(
-            std::bind(&EventProcessor_Fill::generateFilledEvents, pfilledevent, pdb, structuredata, filler,
-                    true, continuityfill, continuitymin, g_pbaseconfig->getFramerate(),
-                    std::placeholders::_1, std::placeholders::_2, offset, pluginname),
-            std::bind(&EventProcessor_Fill::populatePlaceholderEvent, pfilledevent,
-                    -1, std::placeholders::_1),
-            pfilledevent, jobpriority, false);
+    // Generate the events on a worker, then add them to the playlist on the tick
+    makeAsyncTask(g_async, std::move(newevent), jobpriority, settings.m_pluginname, settings.m_pluginname)
+    .then([=] (MouseCatcherEvent filledevent)
+            {
+                generateFilledEvents(filledevent, settings, true, g_core_lock);
+                return filledevent;
+            })
+    .then([parentid] (MouseCatcherEvent filledevent)
+            {
+                addFilledEvents(filledevent, parentid);
+            }, ASYNC_ON_TICK);
 }
 
 /*****************************************************************************
@@ -60,6 +60,21 @@ private:
     std::shared_ptr<DBQuery> m_paddfile_query;
 };
 
+/**
+ * Copies of the settings a fill job needs, as the plugin could be unloaded before the job runs
+ */
+struct FillJobSettings
+{
+    std::shared_ptr<FillDB> m_pdb;
+    std::vector<std::pair<std::string, std::string>> m_structuredata;
+    bool m_filler;
+    MouseCatcherEvent m_continuityfill;
+    int m_continuitymin;
+    float m_framerate;
+    int m_offset;
+    std::string m_pluginname;
+};
+
 /**
  * EventProcessor to automatically fill time with idents, trailers and
  * continuity blocks.
@@ -69,26 +84,24 @@ public:
     EventProcessor_Fill (PluginConfig config, Hook h);
     ~EventProcessor_Fill ();
     void readConfig (PluginConfig config);
-    void handleEvent (MouseCatcherEvent originalEvent,
+    void handleEvent (MouseCatcherEvent& originalEvent,
             MouseCatcherEvent& resultingEvent);
+    std::future<MouseCatcherEvent> handleEventAsync (MouseCatcherEvent originalEvent);
     void addFile (std::string filename, std::string device, std::string type,
             int duration, int weight);
 
     static void populateCGNowNext (PlaylistEntry& event, Channel *pchannel);
 
-    static void singleShotMode (PlaylistEntry &event, Channel *pchannel,
-            std::vector<std::pair<std::string, std::string>> structuredata, bool filler,
-            MouseCatcherEvent continuityfill, int continuitymin, int offset,
-            int jobpriority, std::shared_ptr<FillDB> pdb, std::string pluginname);
+    static void singleShotMode (PlaylistEntry &event, Channel *pchannel, FillJobSettings settings,
+            int jobpriority);
 
     std::shared_ptr<FillDB> m_pdb;
 private:
-    static void generateFilledEvents (std::shared_ptr<MouseCatcherEvent> event, std::shared_ptr<FillDB> db,
-            std::vector<std::pair<std::string, std::string>> structuredata, bool singleshot, bool gencontinuity,
-            MouseCatcherEvent continuityfill, int continuitymin, float framerate, std::shared_ptr<void> data,
-            std::timed_mutex &core_lock, int offset, std::string pluginname);
-    static void populatePlaceholderEvent (std::shared_ptr<MouseCatcherEvent> event, int placeholder_id,
-            std::shared_ptr<void> data);
+    FillJobSettings getJobSettings ();
+    static void generateFilledEvents (MouseCatcherEvent& event, const FillJobSettings& settings,
+            bool singleshot, std::timed_mutex &core_lock);
+    static void addFilledEvents (MouseCatcherEvent& event, int parentid);
+    void setDefaultDuration (MouseCatcherEvent& event);
 
     // Data from configuration file
     std::string m_dbfile;
@@ -103,6 +116,4 @@ private:
 
     MouseCatcherEvent m_continuityfill; ///< Event to tack on the end to fill remaining time
     int m_continuitymin; ///< Minimum length for continuity fill
-
-    int m_placeholderid; //!< Next ID of a placeholder event
 };
@@ -61,16 +61,16 @@ EventProcessor_GFXHelper::~EventProcessor_GFXHelper ()
  * Generate events. Generates an Add event at the start time set, and a Remove event at
  * start time + duration
  */
-void EventProcessor_GFXHelper::handleEvent (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent)
+void EventProcessor_GFXHelper::handleEvent (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent)
 {
     // Handle the slightly broken web UI
-    if (originalEvent.m_extradata.count("duration") > 0)
+    if (originalEvent.m_extradata.count(EXTRA_DURATION) > 0)
     {
-        originalEvent.m_duration = std::stoi(originalEvent.m_extradata["duration"]);
+        originalEvent.m_duration = std::stoi(originalEvent.m_extradata[EXTRA_DURATION]);
     }
 
     // Validate
-    if (originalEvent.m_extradata.count("hostlayer") == 0)
+    if (originalEvent.m_extradata.count(EXTRA_HOSTLAYER) == 0)
     {
         m_hook.gs->L->error(m_pluginname + ERROR_LOC, "No hostlayer set for event");
         return;
@@ -101,7 +101,7 @@ void EventProcessor_GFXHelper::handleEvent (MouseCatcherEvent originalEvent, Mou
 
     // Finish Remove event
     removeChild.m_action_name = "Remove";
-    removeChild.m_extradata["hostlayer"] = originalEvent.m_extradata["hostlayer"];
+    removeChild.m_extradata[EXTRA_HOSTLAYER] = originalEvent.m_extradata[EXTRA_HOSTLAYER];
     removeChild.m_triggertime = originalEvent.m_triggertime +
             static_cast<int>(originalEvent.m_duration / g_pbaseconfig->getFramerate());
 
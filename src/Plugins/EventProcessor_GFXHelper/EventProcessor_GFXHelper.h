@@ -36,7 +36,7 @@ public:
     EventProcessor_GFXHelper (PluginConfig config, Hook h);
     virtual ~EventProcessor_GFXHelper ();
 
-    void handleEvent (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent);
+    void handleEvent (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent);
 
 private:
     std::string m_gfxdevice;
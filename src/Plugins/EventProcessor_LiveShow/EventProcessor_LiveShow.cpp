@@ -80,12 +80,31 @@ EventProcessor_LiveShow::~EventProcessor_LiveShow ()
 {
 }
 
-void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent)
+/**
+ * Check the devices and the continuity generator are loaded before generating a show
+ *
+ * @return True if all the required devices are available
+ */
+bool EventProcessor_LiveShow::checkRequirements ()
+{
+    if (0 == m_hook.gs->Devices->count(m_crosspointdevice) ||
+            0 == g_mcprocessors.count(m_continuitygenerator) ||
+            (m_enableoverlay && 0 == m_hook.gs->Devices->count(m_cgdevice)))
+    {
+        m_hook.gs->L->error(m_pluginname, "One of the required devices (" + m_crosspointdevice + ", " + m_cgdevice + ", " +
+                m_continuitygenerator + ") is not available.");
+        return false;
+    }
+
+    return true;
+}
+
+void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent)
 {
     // Handle the slightly broken web UI
-    if (originalEvent.m_extradata.count("duration") > 0)
+    if (originalEvent.m_extradata.count(EXTRA_DURATION) > 0)
     {
-        originalEvent.m_duration = std::stoi(originalEvent.m_extradata["duration"]);
+        originalEvent.m_duration = std::stoi(originalEvent.m_extradata[EXTRA_DURATION]);
     }
 
     // Set some top-level defaults
@@ -97,16 +116,6 @@ void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, Mous
     resultingEvent.m_duration = originalEvent.m_duration + m_continuitylength;
     resultingEvent.m_action = -1;
 
-    // Run some checks
-    if (0 == m_hook.gs->Devices->count(m_crosspointdevice) ||
-            0 == g_mcprocessors.count(m_continuitygenerator) ||
-            (m_enableoverlay && 0 == m_hook.gs->Devices->count(m_cgdevice)))
-    {
-        m_hook.gs->L->error(m_pluginname, "One of the required devices (" + m_crosspointdevice + ", " + m_cgdevice + ", " +
-                m_continuitygenerator + ") is not available.");
-        return;
-    }
-
     // Template event for rest of children
     MouseCatcherEvent tempevent;
     tempevent.m_channel = originalEvent.m_channel;
@@ -133,7 +142,7 @@ void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, Mous
     MouseCatcherEvent clockevent = tempevent;
     clockevent.m_triggertime = holdevent.m_triggertime - m_vtduration;
     clockevent.m_targetdevice = m_vtdevice;
-    clockevent.m_extradata["filename"] = m_vtfile;
+    clockevent.m_extradata[EXTRA_FILENAME] = m_vtfile;
     clockevent.m_action_name = "Play";
     clockevent.m_duration = m_vtduration * g_pbaseconfig->getFramerate();
     resultingEvent.m_childevents.push_back(clockevent);
@@ -142,8 +151,8 @@ void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, Mous
     MouseCatcherEvent xpevent = tempevent;
     xpevent.m_triggertime = holdevent.m_triggertime;
     xpevent.m_targetdevice = m_crosspointdevice;
-    xpevent.m_extradata["output"] = m_xpoutput;
-    xpevent.m_extradata["input"] = m_liveinput;
+    xpevent.m_extradata[EXTRA_OUTPUT] = m_xpoutput;
+    xpevent.m_extradata[EXTRA_INPUT] = m_liveinput;
     xpevent.m_action_name = "Switch";
     xpevent.m_duration = 1;
     // Child of the hold to ensure it runs.
@@ -157,7 +166,7 @@ void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, Mous
         cgparent.m_targetdevice = m_cgdevice;
         cgparent.m_action_name = "Parent";
         cgparent.m_duration = 1;
-        cgparent.m_extradata["hostlayer"] = ConvertType::intToString(m_nownextlayer);
+        cgparent.m_extradata[EXTRA_HOSTLAYER] = ConvertType::intToString(m_nownextlayer);
 
         int runningtrigtime;
         if (holdevent.m_duration > m_nownextminimum && holdevent.m_duration < (m_nownextperiod * 1.25))
@@ -177,12 +186,12 @@ void EventProcessor_LiveShow::handleEvent (MouseCatcherEvent originalEvent, Mous
             cgparent.m_triggertime = runningtrigtime;
             MouseCatcherEvent cgchild = cgparent;
             cgchild.m_action_name = "Add";
-            cgchild.m_extradata["graphicname"] = m_nownextname;
+            cgchild.m_extradata[EXTRA_GRAPHICNAME] = m_nownextname;
             if (!originalEvent.m_description.empty())
             {
-                cgchild.m_extradata["nowtext"] = originalEvent.m_description;
+                cgchild.m_extradata[EXTRA_NOWTEXT] = originalEvent.m_description;
             }
-            cgchild.m_extradata["nexttext"] = "ppfill"; //Checked if not blank and filled by PP
+            cgchild.m_extradata[EXTRA_NEXTTEXT] = "ppfill"; //Checked if not blank and filled by PP
 
             // Hijack a preprocessor from EP_Fill
             cgchild.m_preprocessor = "EventProcessor_Fill::populateCGNowNext";
@@ -33,7 +33,10 @@ public:
     EventProcessor_LiveShow (PluginConfig config, Hook h);
     virtual ~EventProcessor_LiveShow ();
 
-    void handleEvent(MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent);
+    void handleEvent(MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent);
+
+protected:
+    bool checkRequirements ();
 
 private:
     bool m_enableoverlay; //!< Should periodic Now/Next overlay graphics be shown?
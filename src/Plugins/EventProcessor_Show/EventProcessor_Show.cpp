@@ -80,18 +80,37 @@ EventProcessor_Show::~EventProcessor_Show ()
 
 }
 
+/**
+ * Check the devices and the continuity generator are loaded before generating a show
+ *
+ * @return True if all the required devices are available
+ */
+bool EventProcessor_Show::checkRequirements ()
+{
+    if (0 == m_hook.gs->Devices->count(m_videodevice) ||
+            0 == g_mcprocessors.count(m_continuitygenerator) ||
+            (m_enableoverlay && 0 == m_hook.gs->Devices->count(m_cgdevice)))
+    {
+        m_hook.gs->L->error(m_pluginname, "One of the required devices (" + m_videodevice + ", " + m_cgdevice + ", " +
+                m_continuitygenerator + ") is not available.");
+        return false;
+    }
+
+    return true;
+}
+
 /**
  * Generate a set of child events to run a show
  *
  * @param originalEvent  Template event containing a file name and description for the show to play
  * @param resultingEvent Generated event with child events to run aspects of the show
  */
-void EventProcessor_Show::handleEvent (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent)
+void EventProcessor_Show::handleEvent (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent)
 {
     // Handle the slightly broken web UI
-    if (originalEvent.m_extradata.count("duration") > 0)
+    if (originalEvent.m_extradata.count(EXTRA_DURATION) > 0)
     {
-        originalEvent.m_duration = ConvertType::stringToInt(originalEvent.m_extradata["duration"]);
+        originalEvent.m_duration = ConvertType::stringToInt(originalEvent.m_extradata[EXTRA_DURATION]);
     }
 
     // Set some top-level defaults
@@ -103,16 +122,6 @@ void EventProcessor_Show::handleEvent (MouseCatcherEvent originalEvent, MouseCat
     resultingEvent.m_duration = originalEvent.m_duration + m_continuitylength;
     resultingEvent.m_action = -1;
 
-    // Run some checks
-    if (0 == m_hook.gs->Devices->count(m_videodevice) ||
-            0 == g_mcprocessors.count(m_continuitygenerator) ||
-            (m_enableoverlay && 0 == m_hook.gs->Devices->count(m_cgdevice)))
-    {
-        m_hook.gs->L->error(m_pluginname, "One of the required devices (" + m_videodevice + ", " + m_cgdevice + ", " +
-                m_continuitygenerator + ") is not available.");
-        return;
-    }
-
     // Template event for rest of children
     MouseCatcherEvent tempevent;
     tempevent.m_channel = originalEvent.m_channel;
@@ -133,9 +142,9 @@ void EventProcessor_Show::handleEvent (MouseCatcherEvent originalEvent, MouseCat
     videoevent.m_targetdevice = m_videodevice;
     videoevent.m_action_name = "Play";
 
-    if (originalEvent.m_extradata.count("filename") > 0)
+    if (originalEvent.m_extradata.count(EXTRA_FILENAME) > 0)
     {
-        videoevent.m_extradata["filename"] = originalEvent.m_extradata["filename"];
+        videoevent.m_extradata[EXTRA_FILENAME] = originalEvent.m_extradata[EXTRA_FILENAME];
     }
     else
     {
@@ -155,7 +164,7 @@ void EventProcessor_Show::handleEvent (MouseCatcherEvent originalEvent, MouseCat
         cgparent.m_targetdevice = m_cgdevice;
         cgparent.m_action_name = "Parent";
         cgparent.m_duration = 1;
-        cgparent.m_extradata["hostlayer"] = ConvertType::intToString(m_nownextlayer);
+        cgparent.m_extradata[EXTRA_HOSTLAYER] = ConvertType::intToString(m_nownextlayer);
 
         int runningtrigtime;
         if (videoevent.m_duration > m_nownextminimum && videoevent.m_duration < (m_nownextperiod * 1.25))
@@ -175,12 +184,12 @@ void EventProcessor_Show::handleEvent (MouseCatcherEvent originalEvent, MouseCat
             cgparent.m_triggertime = runningtrigtime;
             MouseCatcherEvent cgchild = cgparent;
             cgchild.m_action_name = "Add";
-            cgchild.m_extradata["graphicname"] = m_nownextname;
+            cgchild.m_extradata[EXTRA_GRAPHICNAME] = m_nownextname;
             if (!originalEvent.m_description.empty())
             {
-                cgchild.m_extradata["nowtext"] = "Now: " + originalEvent.m_description;
+                cgchild.m_extradata[EXTRA_NOWTEXT] = "Now: " + originalEvent.m_description;
             }
-            cgchild.m_extradata["nexttext"] = "ppfill"; //Checked if not blank and filled by PP
+            cgchild.m_extradata[EXTRA_NEXTTEXT] = "ppfill"; //Checked if not blank and filled by PP
 
             // Hijack a preprocessor from EP_Fill
             cgchild.m_preprocessor = "EventProcessor_Fill::populateCGNowNext";
@@ -35,7 +35,10 @@ public:
     EventProcessor_Show (PluginConfig config, Hook h);
     virtual ~EventProcessor_Show ();
 
-    void handleEvent (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent);
+    void handleEvent (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent);
+
+protected:
+    bool checkRequirements ();
 
 private:
     bool m_enableoverlay; //!< Should periodic Now/Next overlay graphics be shown?
@@ -63,7 +63,7 @@ EventSource_Demo::~EventSource_Demo ()
 /**
  * If a pollperiod has passed since we last did this, throw some more events in
  */
-void EventSource_Demo::tick (std::vector<EventAction> *peventqueue)
+void EventSource_Demo::tick ()
 {
     if (READY != m_status)
     {
@@ -71,10 +71,11 @@ void EventSource_Demo::tick (std::vector<EventAction> *peventqueue)
         return;
     }
 
-    //Add events generated in the callbacks to the queue
-    peventqueue->insert(peventqueue->end(), m_tempactionqueue.begin(),
-            m_tempactionqueue.end());
-    m_tempactionqueue.clear();
+    // Nothing to report back, so just clear out finished actions
+    EventAction completedaction;
+    while (getCompletedAction(completedaction))
+    {
+    }
 
     if (time(NULL) > m_polltime)
     {
@@ -91,10 +92,7 @@ void EventSource_Demo::tick (std::vector<EventAction> *peventqueue)
 
         action.action = ACTION_ADD;
         action.event = (mev);
-        action.thisplugin = this;
-        action.isprocessed = false;
-
-        peventqueue->push_back(action);
+        queueAction(action);
 
         m_polltime = time(NULL) + m_pollperiod;
 
@@ -103,23 +101,20 @@ void EventSource_Demo::tick (std::vector<EventAction> *peventqueue)
         action2.action = ACTION_UPDATE_PLAYLIST;
         action2.event.m_triggertime = m_lastupdate;
         action2.event.m_duration = m_pollperiod + 100;
-        action2.thisplugin = this;
         action2.event.m_channel = "Default";
-        action2.isprocessed = false;
 
         m_lastupdate = time(NULL);
 
-        peventqueue->push_back(action2);
+        queueAction(action2);
 
         if (m_enablesystemdata)
         {
             EventAction systemdata_action;
             systemdata_action.action = ACTION_UPDATE_DEVICES;
-            systemdata_action.thisplugin = this;
-            peventqueue->push_back(systemdata_action);
+            queueAction(systemdata_action);
 
             systemdata_action.action = ACTION_UPDATE_PROCESSORS;
-            peventqueue->push_back(systemdata_action);
+            queueAction(systemdata_action);
         }
     }
 }
@@ -144,8 +139,7 @@ void EventSource_Demo::updateDevices (
         EventAction typeaction;
         typeaction.action = ACTION_UPDATE_ACTIONS;
         typeaction.event.m_targetdevice = device.first;
-        typeaction.thisplugin = this;
-        m_tempactionqueue.push_back(typeaction);
+        queueAction(typeaction);
     }
     m_hook.gs->L->info(m_pluginname, datadump.str());
 }
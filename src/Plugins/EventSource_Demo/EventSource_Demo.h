@@ -43,7 +43,7 @@ class EventSource_Demo: public MouseCatcherSourcePlugin
 public:
     EventSource_Demo (PluginConfig config, Hook h);
     virtual ~EventSource_Demo ();
-    virtual void tick (std::vector<EventAction> *EventQueue);
+    virtual void tick ();
 
     void updatePlaylist (std::vector<MouseCatcherEvent>& playlist,
             std::shared_ptr<void> additionaldata);
@@ -62,7 +62,5 @@ private:
     int m_pollperiod;
     time_t m_lastupdate;
     bool m_enablesystemdata;
-
-    std::vector<EventAction> m_tempactionqueue;
 };
 
@@ -156,10 +156,8 @@ void EventSource_Web::handleAccept (
 
 /**
  * Plugin processing routine.
- *
- * @param ActionQueue Pointer to the central queue of event actions.
  */
-void EventSource_Web::tick (std::vector<EventAction>* ActionQueue)
+void EventSource_Web::tick ()
 {
     if (READY != m_status)
     {
@@ -188,19 +186,16 @@ void EventSource_Web::tick (std::vector<EventAction>* ActionQueue)
             [](const std::shared_ptr<WebSource::WaitingRequest> &req)
             { return req->complete == true; }), m_sharedata->m_requests.end());
 
-    // Process the local action queue
-    std::vector<EventAction>::iterator it = std::remove_if(ActionQueue->begin(),
-		ActionQueue->end(),
-		boost::bind(&MouseCatcherSourcePlugin::actionCompleteCheck, _1,
-				dynamic_cast<MouseCatcherSourcePlugin*>(this)));
-
-    ActionQueue->erase(it, ActionQueue->end());
+    // Results were delivered through the update callbacks, so completed actions can be dropped
+    EventAction completedaction;
+    while (getCompletedAction(completedaction))
+    {
+    }
 
+    // Process the local action queue
     for (auto thisaction : m_sharedata->m_localqueue)
     {
-    	thisaction.thisplugin = this;
-    	thisaction.isprocessed = false;
-    	ActionQueue->push_back(thisaction);
+    	queueAction(thisaction);
     }
 
     m_sharedata->m_localqueue.clear();
@@ -228,7 +223,7 @@ void EventSource_Web::updatePlaylist (
 
     // Generate and format XHTML for the playlist
     pugi::xml_node schedulenode = ead->data.document_element();
-    for (MouseCatcherEvent currentevent : playlist)
+    for (MouseCatcherEvent& currentevent : playlist)
     {
         generateScheduleSegment(currentevent, schedulenode);
     }
@@ -374,7 +369,7 @@ void EventSource_Web::updateDeviceActions (std::string device,
     	subform.append_attribute("class").set_value("action-form");
 
     	// Add the action options
-    	for (auto thisoption : thisaction.extradata)
+    	for (const ExtraData::value_type& thisoption : thisaction.extradata)
     	{
     		if (!thisoption.second.substr(thisoption.second.length()-3, 3).compare("..."))
     		{
@@ -390,13 +385,13 @@ void EventSource_Web::updateDeviceActions (std::string device,
 				label.append_attribute("for").set_value(
 						std::string("action-" +
 								ConvertType::intToString(thisaction.actionid) +
-								"-" + thisoption.first).c_str());
+								"-" + thisoption.first.getName()).c_str());
 
 				item = para.append_child("select");
 				item.append_attribute("name").set_value(
 						std::string("action-" +
 								ConvertType::intToString(thisaction.actionid) +
-								"-" + thisoption.first).c_str());
+								"-" + thisoption.first.getName()).c_str());
 				item.append_attribute("class").set_value("action-filename action-data-input");
     		}
     		else
@@ -409,13 +404,13 @@ void EventSource_Web::updateDeviceActions (std::string device,
     			label.append_attribute("for").set_value(
     					std::string("action-" +
     							ConvertType::intToString(thisaction.actionid) +
-    							"-" + thisoption.first).c_str());
+    							"-" + thisoption.first.getName()).c_str());
 
     			item = para.append_child("input");
     			item.append_attribute("name").set_value(
     					std::string("action-" +
     							ConvertType::intToString(thisaction.actionid) +
-    							"-" + thisoption.first).c_str());
+    							"-" + thisoption.first.getName()).c_str());
     			item.append_attribute("class").set_value(
     					std::string("actioninput-" + thisoption.second +
     							"action-data-input").c_str());
@@ -542,6 +537,50 @@ void EventSource_Web::updateFiles (std::string device,
 
 }
 
+/**
+ * Send the list of unscheduled periods back to the client
+ *
+ * @param channel        Channel the gaps were found on
+ * @param gaps           Unscheduled periods on the channel
+ * @param additionaldata EventActionData for the waiting connection
+ */
+void EventSource_Web::updateGaps (std::string channel, std::vector<TimelineGap>& gaps,
+        std::shared_ptr<void> additionaldata)
+{
+    if (READY != m_status)
+    {
+        m_hook.gs->L->error(m_pluginname, "Plugin not in ready state for updateGaps");
+        return;
+    }
+
+    // Extract the additionaldata structure into a real form
+    std::shared_ptr<WebSource::EventActionData> ead = std::static_pointer_cast <WebSource::EventActionData> (additionaldata);
+
+    pugi::xml_node rootnode = ead->data.document_element();
+
+    for (TimelineGap gap : gaps)
+    {
+        char gapstart_buffer[10];
+        strftime(gapstart_buffer, 10, "%H:%M:%S", localtime(&gap.m_start));
+        char gapend_buffer[10];
+        strftime(gapend_buffer, 10, "%H:%M:%S", localtime(&gap.m_end));
+
+        pugi::xml_node thisgap = rootnode.append_child("li");
+        thisgap.append_attribute("class").set_value("schedule-gap");
+        thisgap.append_attribute("tar-start").set_value(static_cast<int>(gap.m_start));
+        thisgap.append_attribute("tar-length").set_value(static_cast<int>(gap.m_end - gap.m_start));
+        thisgap.text().set(std::string(std::string(gapstart_buffer) + " - " + gapend_buffer).c_str());
+    }
+
+    std::stringstream html;
+    rootnode.print(html);
+    ead->connection->m_reply.content = html.str();
+    ead->connection->m_reply.status = http::server3::reply::ok;
+    ead->connection->commitResponse();
+
+    ead->complete = true;
+}
+
 /**
  * Free function generates a table row from a key-value pair
  *
@@ -631,7 +670,7 @@ void EventSource_Web::generateScheduleSegment(MouseCatcherEvent& targetevent,
     datadiv.append_child("h4").text().set("Additional Data");
     pugi::xml_node additionaltable = datadiv.append_child("table");
 
-    for (auto dataline : targetevent.m_extradata)
+    for (const ExtraData::value_type& dataline : targetevent.m_extradata)
     {
         rowgenerate(additionaltable, dataline.first, dataline.second);
     }
@@ -640,7 +679,7 @@ void EventSource_Web::generateScheduleSegment(MouseCatcherEvent& targetevent,
     pugi::xml_node childevents = datadiv.append_child("div");
     childevents.append_attribute("class").set_value("accordion");
 
-    for (auto child : targetevent.m_childevents)
+    for (MouseCatcherEvent& child : targetevent.m_childevents)
     {
         generateScheduleSegment(child, childevents);
     }
@@ -43,7 +43,7 @@ public:
 	EventSource_Web (PluginConfig config, Hook h);
     ~EventSource_Web ();
 
-    void tick (std::vector<EventAction> *ActionQueue);
+    void tick ();
 
     // Callbacks used to update plugin from the core
     void updatePlaylist (std::vector<MouseCatcherEvent>& playlist,
@@ -58,6 +58,8 @@ public:
             std::shared_ptr<void> additionaldata);
     void updateFiles (std::string device, std::vector<std::pair<std::string, int>>& files,
             std::shared_ptr<void> additionaldata);
+    void updateGaps (std::string channel, std::vector<TimelineGap>& gaps,
+            std::shared_ptr<void> additionaldata);
 
 private:
     std::shared_ptr<boost::asio::io_service> m_io_service;
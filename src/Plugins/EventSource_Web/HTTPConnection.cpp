@@ -27,6 +27,7 @@
 #include "DateConversions.h"
 
 #include "HTTPConnection.h"
+#include "AsyncJobSystem.h"
 #include "Misc.h"
 
 namespace WebSource
@@ -209,6 +210,57 @@ void HTTPConnection::requestFilesUpdate (std::string device)
 
 }
 
+/**
+ * Insert a request for the unscheduled periods on a day to be sent to the client
+ *
+ * @param requesteddate Date to find gaps for, blank for today
+ */
+void HTTPConnection::requestGapsUpdate (std::string requesteddate)
+{
+    EventAction gapsupdate;
+
+    gapsupdate.action = ACTION_UPDATE_GAPS;
+
+    if (requesteddate.empty())
+    {
+        requesteddate = boost::gregorian::to_simple_string(boost::gregorian::day_clock::local_day());
+    }
+
+    try
+    {
+        gapsupdate.event.m_triggertime = DateConversions::datetimeToTimeT(requesteddate, "%Y-%b-%d");
+    }
+    catch (std::exception&)
+    {
+        m_reply = http::server3::reply::stock_reply(
+                http::server3::reply::internal_server_error);
+        commitResponse("text/plain");
+        return;
+    }
+
+    // Search the whole day on this channel
+    gapsupdate.event.m_duration = 60*60*24;
+    gapsupdate.event.m_channel = m_config.m_channel;
+
+    // Prepare additional data
+    std::shared_ptr<EventActionData> ead = std::make_shared<EventActionData>();
+    ead->complete = false;
+    ead->connection = shared_from_this();
+    ead->type = WEBACTION_GAPS;
+    ead->attachedrequest.reset();
+
+    // Assemble the XHTML node to go back to the client
+    pugi::xml_node rootnode = ead->data.append_child("ul");
+    rootnode.append_attribute("id").set_value("schedulegaps");
+
+    // Add additional data to the request
+    gapsupdate.additionaldata.reset();
+    gapsupdate.additionaldata = std::shared_ptr<EventActionData>(ead);
+
+    // Add to local queue (to be added globally in tick())
+    m_sharedata->m_localqueue.push_back(gapsupdate);
+}
+
 /**
  * Decode a string encoded using URL encoding.
  *
@@ -233,6 +285,74 @@ static std::string urlDecode (std::string& src)
     return (ret);
 }
 
+/**
+ * Reply with the async job system's metrics as XML, followed by the depth and
+ * wait times of MouseCatcher's action lanes. Reading them never blocks the job
+ * workers, so this is answered straight away.
+ */
+void HTTPConnection::sendJobMetrics ()
+{
+    AsyncJobSystem *pasync = m_config.m_hook.gs->Async;
+
+    pugi::xml_document doc;
+    pugi::xml_node rootnode = doc.append_child("asyncjobs");
+    rootnode.append_attribute("workers").set_value(pasync->getWorkerCount());
+    rootnode.append_attribute("queued").set_value(pasync->getQueuedJobs());
+    rootnode.append_attribute("timedout").set_value(static_cast<unsigned int>(pasync->getTimedOutJobs()));
+    rootnode.append_attribute("replacedworkers").set_value(static_cast<unsigned int>(pasync->getReplacedWorkers()));
+
+    for (AsyncJobMetrics& metrics : pasync->getMetrics())
+    {
+        pugi::xml_node categorynode = rootnode.append_child("category");
+        categorynode.append_attribute("name").set_value(metrics.m_category.c_str());
+        categorynode.append_attribute("submitted").set_value(static_cast<unsigned int>(metrics.m_submitted));
+        categorynode.append_attribute("queued").set_value(static_cast<int>(metrics.m_queued));
+        categorynode.append_attribute("running").set_value(static_cast<int>(metrics.m_running));
+        categorynode.append_attribute("completed").set_value(static_cast<unsigned int>(metrics.m_completed));
+        categorynode.append_attribute("failed").set_value(static_cast<unsigned int>(metrics.m_failed));
+        categorynode.append_attribute("expired").set_value(static_cast<unsigned int>(metrics.m_expired));
+        categorynode.append_attribute("cancelled").set_value(static_cast<unsigned int>(metrics.m_cancelled));
+
+        // Buckets are labelled with their upper limit in milliseconds
+        pugi::xml_node waitnode = categorynode.append_child("wait");
+        pugi::xml_node runnode = categorynode.append_child("run");
+        for (int bucket = 0; bucket < ASYNC_HISTOGRAM_BUCKETS; ++bucket)
+        {
+            long limit = AsyncJobSystem::getHistogramLimit(bucket);
+            std::string label = limit < 0 ? "inf" : std::to_string(limit);
+
+            pugi::xml_node waitbucket = waitnode.append_child("bucket");
+            waitbucket.append_attribute("under").set_value(label.c_str());
+            waitbucket.text().set(static_cast<unsigned int>(metrics.m_waithistogram[bucket]));
+
+            pugi::xml_node runbucket = runnode.append_child("bucket");
+            runbucket.append_attribute("under").set_value(label.c_str());
+            runbucket.text().set(static_cast<unsigned int>(metrics.m_runhistogram[bucket]));
+        }
+    }
+
+    // The web server is polled from tick(), so the lanes can be read directly. Waits are in milliseconds.
+    for (int lane = 0; lane < ACTIONPRIORITY_COUNT; ++lane)
+    {
+        action_priority_t priority = static_cast<action_priority_t>(lane);
+        ActionLaneMetrics lanemetrics = MouseCatcherCore::getLaneMetrics(priority);
+
+        pugi::xml_node lanenode = rootnode.append_child("actionlane");
+        lanenode.append_attribute("name").set_value(action_priority_vector.at(priority).c_str());
+        lanenode.append_attribute("depth").set_value(lanemetrics.m_depth);
+        lanenode.append_attribute("processed").set_value(static_cast<unsigned int>(lanemetrics.m_processed));
+        lanenode.append_attribute("lastwait").set_value(lanemetrics.m_lastwait);
+        lanenode.append_attribute("averagewait").set_value(lanemetrics.m_averagewait);
+        lanenode.append_attribute("maxwait").set_value(lanemetrics.m_maxwait);
+    }
+
+    std::stringstream xml;
+    doc.print(xml);
+    m_reply.content = xml.str();
+    m_reply.status = http::server3::reply::ok;
+    commitResponse("application/xml");
+}
+
 /**
  * Finalise and send the response held in m_reply, then close the connection
  *
@@ -425,6 +545,14 @@ void HTTPConnection::handleIncomingData (
 				{
 				    requestPlaylistUpdate(data);
 				}
+				else if (!base.compare("gaps"))
+				{
+				    requestGapsUpdate(data);
+				}
+				else if (!base.compare("jobs"))
+				{
+				    sendJobMetrics();
+				}
 				else if (!base.compare("index.html"))
 				{
 				    // Set up the request
@@ -53,6 +53,7 @@ enum WebActionType
 {
 	WEBACTION_PLAYLIST,//!< WEBACTION_PLAYLIST Request for playlist from client
 	WEBACTION_FILES,   //!< WEBACTION_FILES    Request for device files
+	WEBACTION_GAPS,    //!< WEBACTION_GAPS     Request for unscheduled periods in the playlist
 	WEBACTION_ALL      //!< WEBACTION_ALL	   Request for a full update of playlist, actions, devices, etc
 };
 
@@ -173,5 +174,7 @@ public:
 private:
 	void requestPlaylistUpdate (std::string requesteddates, std::shared_ptr<WaitingRequest> req = NULL);
 	void requestFilesUpdate (std::string device);
+	void requestGapsUpdate (std::string requesteddate);
+	void sendJobMetrics ();
 };
 }
@@ -474,6 +474,92 @@ bool EventSource_XML_Network::processIncoming (XML_Incoming& newdata,
         newaction.eventid = xml.child("eventid").text().as_int(-1);
         newaction.event.m_channel = xml.child_value("channel");
     }
+    else if (!action.compare("AddRecurring") || !action.compare("EditRecurring"))
+    {
+        bool isedit = !action.compare("EditRecurring");
+
+        if (xml.child("MCEvent").empty() || xml.child("recurrence").empty() ||
+                (isedit && -1 == xml.child("eventid").text().as_int(-1)))
+        {
+            try
+            {
+                boost::asio::write(newdata.m_conn->socket(),
+                        boost::asio::buffer("400 NO DATA\r\n"));
+            }
+            catch (std::exception &e)
+            {
+
+            }
+            return false;
+        }
+
+        if (!parseEvent(xml.child("MCEvent"), newaction.event))
+        {
+            try
+            {
+                boost::asio::write(newdata.m_conn->socket(),
+                        boost::asio::buffer("400 BAD DATA\r\n"));
+            }
+            catch (std::exception &e)
+            {
+
+            }
+            return false;
+        }
+
+        newaction.event.m_recurrence = xml.child_value("recurrence");
+
+        std::string until = xml.child_value("until");
+        if (!until.empty())
+        {
+            tm untiltime = boost::posix_time::to_tm(
+                boost::posix_time::time_from_string(until));
+            newaction.event.m_recurrenceuntil = mktime(&untiltime);
+        }
+
+        if (isedit)
+        {
+            newaction.action = ACTION_EDIT_RECURRING;
+            newaction.eventid = xml.child("eventid").text().as_int(-1);
+        }
+        else
+        {
+            newaction.action = ACTION_ADD_RECURRING;
+        }
+    }
+    else if (!action.compare("RemoveRecurring") || !action.compare("SkipRecurring"))
+    {
+        bool isskip = !action.compare("SkipRecurring");
+
+        if (-1 == xml.child("eventid").text().as_int(-1) || (isskip && xml.child("time").empty()))
+        {
+            try
+            {
+                boost::asio::write(newdata.m_conn->socket(),
+                        boost::asio::buffer("400 NO DATA\r\n"));
+            }
+            catch (std::exception &e)
+            {
+
+            }
+            return false;
+        }
+
+        if (isskip)
+        {
+            tm skiptime = boost::posix_time::to_tm(
+                boost::posix_time::time_from_string(xml.child_value("time")));
+            newaction.event.m_triggertime = mktime(&skiptime);
+            newaction.action = ACTION_SKIP_RECURRING;
+        }
+        else
+        {
+            newaction.action = ACTION_REMOVE_RECURRING;
+        }
+
+        newaction.eventid = xml.child("eventid").text().as_int(-1);
+        newaction.event.m_channel = xml.child_value("channel");
+    }
     else if (!action.compare("UpdatePlaylist"))
     {
         newaction.action = ACTION_UPDATE_PLAYLIST;
@@ -565,10 +651,8 @@ bool EventSource_XML_Network::processIncoming (XML_Incoming& newdata,
 
 /**
  * Run the plugin main loop
- *
- * @param ActionQueue Pointer to central queue of MouseCatcher actions
  */
-void EventSource_XML_Network::tick (std::vector<EventAction>* ActionQueue)
+void EventSource_XML_Network::tick ()
 {
     if (READY != m_status)
     {
@@ -579,43 +663,38 @@ void EventSource_XML_Network::tick (std::vector<EventAction>* ActionQueue)
     // Process ready asynchronous tasks
     m_io_service->poll();
 
-    // Find processed queue events and report back
-    for (EventAction thisaction : (*ActionQueue))
+    // Report back on actions the core has finished with
+    EventAction thisaction;
+    while (getCompletedAction(thisaction))
     {
-        if (thisaction.isprocessed
-                && thisaction.thisplugin
-                        == dynamic_cast<MouseCatcherSourcePlugin*>(this))
+        std::string responsemessage;
+        if (thisaction.returnmessage.empty())
         {
-            std::string responsemessage;
-            if (thisaction.returnmessage.empty())
-            {
-                responsemessage = "200 SUCCESS";
-            }
-            else
-            {
-                responsemessage = "500 " + thisaction.returnmessage;
-            }
-            std::shared_ptr<XML_Incoming> plugindata = std::static_pointer_cast
-                    < XML_Incoming > (thisaction.additionaldata);
-            try
+            responsemessage = "200 SUCCESS";
+
+            // Clients need the rule ID to edit or remove a recurring event later
+            if (ACTION_ADD_RECURRING == thisaction.action)
             {
-                boost::asio::write(plugindata->m_conn->socket(),
-                        boost::asio::buffer(responsemessage + "\r\n"));
+                responsemessage += " " + ConvertType::intToString(thisaction.eventid);
             }
-            catch (std::exception &e)
-            {
+        }
+        else
+        {
+            responsemessage = "500 " + thisaction.returnmessage;
+        }
+        std::shared_ptr<XML_Incoming> plugindata = std::static_pointer_cast
+                < XML_Incoming > (thisaction.additionaldata);
+        try
+        {
+            boost::asio::write(plugindata->m_conn->socket(),
+                    boost::asio::buffer(responsemessage + "\r\n"));
+        }
+        catch (std::exception &e)
+        {
 
-            }
         }
     }
 
-    std::vector<EventAction>::iterator it = std::remove_if(ActionQueue->begin(),
-            ActionQueue->end(),
-            boost::bind(&MouseCatcherSourcePlugin::actionCompleteCheck, _1,
-                    dynamic_cast<MouseCatcherSourcePlugin*>(this)));
-
-    ActionQueue->erase(it, ActionQueue->end());
-
     // Process everything in m_incoming
     for (XML_Incoming newdata : m_incoming)
     {
@@ -623,7 +702,7 @@ void EventSource_XML_Network::tick (std::vector<EventAction>* ActionQueue)
 
         if (processIncoming(newdata, newaction))
         {
-            ActionQueue->push_back(newaction);
+            queueAction(newaction);
         }
     }
     m_incoming.clear();
@@ -679,13 +758,13 @@ void converteventtoxml (pugi::xml_node& parent,
     addchildwithvalue(eventdata, "preprocessor", event.m_preprocessor);
 
     pugi::xml_node actiondata = eventdata.append_child("actiondata");
-    for (auto data : event.m_extradata)
+    for (const ExtraData::value_type& data : event.m_extradata)
     {
         addchildwithvalue(actiondata, data.first, data.second);
     }
 
     pugi::xml_node childnode = eventdata.append_child("childevents");
-    for (MouseCatcherEvent childevent : event.m_childevents)
+    for (const MouseCatcherEvent& childevent : event.m_childevents)
     {
         converteventtoxml(childnode, childevent);
     }
@@ -710,7 +789,7 @@ void EventSource_XML_Network::updatePlaylist (
     pugi::xml_document document;
     pugi::xml_node rootnode = document.append_child("TarantulaPlaylistData");
 
-    for (MouseCatcherEvent event : playlist)
+    for (const MouseCatcherEvent& event : playlist)
     {
         converteventtoxml(rootnode, event);
     }
@@ -814,7 +893,7 @@ void EventSource_XML_Network::updateDeviceActions (std::string device,
 
         pugi::xml_node datanode = actionnode.append_child("Data");
 
-        for (auto dataitem : item.extradata)
+        for (const ExtraData::value_type& dataitem : item.extradata)
         {
             pugi::xml_node itemnode = datanode.append_child("DataItem");
             itemnode.append_attribute("type").set_value(
@@ -82,7 +82,7 @@ public:
     EventSource_XML_Network (PluginConfig config, Hook h);
     ~EventSource_XML_Network ();
 
-    void tick (std::vector<EventAction> *ActionQueue);
+    void tick ();
 
     // Callbacks used to update plugin from the core
     void updatePlaylist (std::vector<MouseCatcherEvent>& playlist,
@@ -27,6 +27,7 @@
 #include "VideoDevice_Caspar.h"
 #include "Misc.h"
 #include "PluginConfig.h"
+#include "AsyncTask.h"
 #include <unistd.h>
 #include <mutex>
 #include <algorithm>
@@ -77,8 +78,7 @@ void CasparFileList::readFileList (std::map<std::string, VideoFile>& filelist)
 
 void CasparFileList::updateFileList (
         std::shared_ptr<std::map<std::string, VideoFile> > newfiles,
-        std::shared_ptr<std::vector<std::string> > deletedfiles,
-        std::timed_mutex &core_lock)
+        std::shared_ptr<std::vector<std::string> > deletedfiles)
 {
     std::string deletedquery;
     std::string addquery;
@@ -138,12 +138,18 @@ VideoDevice_Caspar::VideoDevice_Caspar (PluginConfig config, Hook h) :
 {
     // Pull server name and port from configuration data
     long int connecttimeout = 10;
+    int pipelinedepth = CASPAR_DEFAULT_PIPELINE_DEPTH;
     try
     {
         m_hostname = config.m_plugindata_map.at("Host");
         m_port = config.m_plugindata_map.at("Port");
 
         connecttimeout = ConvertType::stringToInt(config.m_plugindata_map.at("ConnectTimeout"));
+
+        if (config.m_plugindata_map.count("PipelineDepth"))
+        {
+            pipelinedepth = ConvertType::stringToInt(config.m_plugindata_map.at("PipelineDepth"));
+        }
     }
     catch (std::exception& ex)
     {
@@ -157,6 +163,7 @@ VideoDevice_Caspar::VideoDevice_Caspar (PluginConfig config, Hook h) :
     try
     {
         m_pcaspcon = std::make_shared<CasparConnection>(m_hostname, m_port, connecttimeout);
+        m_pcaspcon->setPipelineDepth(pipelinedepth);
     }
     catch (...)
     {
@@ -166,6 +173,8 @@ VideoDevice_Caspar::VideoDevice_Caspar (PluginConfig config, Hook h) :
         return;
     }
 
+    m_prescancon = CasparSharedConnection::get(m_hostname, m_port);
+
     try
     {
         m_pfiledb = std::shared_ptr<CasparFileList>(new CasparFileList(g_pbaseconfig->getDatabasePath(), m_pluginname));
@@ -261,20 +270,31 @@ void VideoDevice_Caspar::getFiles ()
     std::transform(m_files.begin(), m_files.end(), std::back_inserter(*transformed_files),
             [] (const std::pair<std::string, VideoFile> &item) { return item.first; });
 
-    // Schedule async update job
-    std::shared_ptr<std::map<std::string, VideoFile>> pnewfiles = std::make_shared<std::map<std::string, VideoFile>>();
-    std::shared_ptr<std::vector<std::string>> pdeletedfiles = std::make_shared<std::vector<std::string>>();
-
     std::shared_ptr<VideoDevice_Caspar> pthisdev =
             std::dynamic_pointer_cast<VideoDevice_Caspar>(m_hook.gs->Devices->at(m_pluginname));
-
-    m_hook.gs->Async->newAsyncJob(
-            std::bind(&VideoDevice_Caspar::fileUpdateJob, pthisdev, pnewfiles, pdeletedfiles,
-                    std::placeholders::_1, std::placeholders::_2, m_hostname, m_port, transformed_files,
-                    m_pfiledb),
-            std::bind(&VideoDevice_Caspar::fileUpdateComplete, pthisdev, pnewfiles, pdeletedfiles,
-                    std::placeholders::_1),
-            NULL, 10, false);
+    std::shared_ptr<CasparFileList> pfiledb = m_pfiledb;
+    std::shared_ptr<CasparSharedConnection> prescancon = m_prescancon;
+
+    // Query the server, store the changes, then apply them to our list on the tick.
+    // Updates for every device on this server share a strand, so a second update cannot rewrite
+    // the file database alongside this one or sit blocked waiting for the shared connection.
+    runAsyncTask(*m_hook.gs->Async,
+            [pthisdev, prescancon, transformed_files] ()
+            {
+                return fileUpdateJob(pthisdev, prescancon, transformed_files);
+            }, 10, "Caspar " + m_hostname + ":" + m_port, m_pluginname)
+    .then([pfiledb] (CasparFileChanges changes)
+            {
+                if (changes.m_pnewfiles->size() > 0 || changes.m_pdeletedfiles->size() > 0)
+                {
+                    pfiledb->updateFileList(changes.m_pnewfiles, changes.m_pdeletedfiles);
+                }
+                return changes;
+            })
+    .then([pthisdev] (CasparFileChanges changes)
+            {
+                fileUpdateComplete(pthisdev, changes);
+            }, ASYNC_ON_TICK);
 }
 
 /**
@@ -307,7 +327,7 @@ void VideoDevice_Caspar::cue (std::string clip)
         cc1.addParam("1");
         cc1.addParam("1");
         cc1.addParam(clip);
-        m_pcaspcon->sendCommand(cc1);
+        m_pcaspcon->sendCommand(cc1, true);
     }
     else
     {
@@ -338,7 +358,7 @@ void VideoDevice_Caspar::play ()
     CasparCommand cc1(CASPAR_COMMAND_PLAY);
     cc1.addParam("1");
     cc1.addParam("1");
-    m_pcaspcon->sendCommand(cc1);
+    m_pcaspcon->sendCommand(cc1, true);
 
 }
 
@@ -367,7 +387,7 @@ void VideoDevice_Caspar::immediatePlay (std::string clip)
         cc1.addParam("1");
         cc1.addParam("1");
         cc1.addParam(clip);
-        m_pcaspcon->sendCommand(cc1);
+        m_pcaspcon->sendCommand(cc1, true);
     }
     else
     {
@@ -396,81 +416,85 @@ void VideoDevice_Caspar::stop ()
     CasparCommand cc1(CASPAR_COMMAND_STOP);
     cc1.addParam("1");
     cc1.addParam("1");
-    m_pcaspcon->sendCommand(cc1);
+    m_pcaspcon->sendCommand(cc1, true);
 }
 
 /**
- * Asynchronous task to kickoff a new CG connection and update the file list
+ * Asynchronous task to find changes to the file list over the shared background connection
  *
  * @param thisdev           Pointer to the calling class, shared_ptr variant of this keyword
- * @param newfiles          Pointer to a map of new media files
- * @param deletedfiles      Pointer to a vector of deleted file names
- * @param data              Unused.
- * @param core_lock         Mutex to lock exclusive access to Tarantula core.
- * @param hostname          CasparCG server hostname
- * @param port              CasparCG server port
+ * @param prescancon        Background connection to the server
  * @param transformed_files File list in vector form
+ * @return                  New and deleted files, both empty if the server could not be reached
  */
-void VideoDevice_Caspar::fileUpdateJob (std::shared_ptr<VideoDevice_Caspar> thisdev,
-        std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
-        std::shared_ptr<std::vector<std::string>> deletedfiles, std::shared_ptr<void> data,
-        std::timed_mutex &core_lock, std::string hostname, std::string port,
-        std::shared_ptr<std::vector<std::string>> transformed_files,
-        std::shared_ptr<CasparFileList> pfiledb)
+CasparFileChanges VideoDevice_Caspar::fileUpdateJob (std::shared_ptr<VideoDevice_Caspar> thisdev,
+        std::shared_ptr<CasparSharedConnection> prescancon, std::shared_ptr<std::vector<std::string>> transformed_files)
 {
-    // Start a new connection to the server
-    std::shared_ptr<CasparConnection> pccon;
-    try
-    {
-        pccon = std::make_shared<CasparConnection>(hostname, port, 10);
-    }
-    catch (...)
+    CasparFileChanges changes;
+    changes.m_pnewfiles = std::make_shared<std::map<std::string, VideoFile>>();
+    changes.m_pdeletedfiles = std::make_shared<std::vector<std::string>>();
+
+    bool success = prescancon->runBatch([&] (std::shared_ptr<CasparConnection> pccon)
     {
-        return;
-    }
+        // Start again if this is a retry on a fresh connection
+        changes.m_pnewfiles->clear();
+        changes.m_pdeletedfiles->clear();
+
+        // A server which stops answering would otherwise hold this worker forever
+        AsyncJobSystem::setCancelHandler(boost::bind(&CasparConnection::stop, pccon));
+
+        if (!pccon->waitForConnect(CASPAR_SHARED_CONNECT_TIMEOUT))
+        {
+            return false;
+        }
+
+        CasparCommand query(CASPAR_COMMAND_CLS, boost::bind(&VideoDevice_Caspar::cb_updatefiles, thisdev, _1,
+                pccon, changes.m_pnewfiles, changes.m_pdeletedfiles, transformed_files));
+        pccon->sendCommand(query);
+
+        pccon->run(-1);
 
-    // Send the query
-    CasparCommand query(CASPAR_COMMAND_CLS, boost::bind(&VideoDevice_Caspar::cb_updatefiles, thisdev, _1, pccon,
-            newfiles, deletedfiles, transformed_files));
-    pccon->sendCommand(query);
+        return !AsyncJobSystem::isJobCancelled();
+    });
 
-    pccon->run(-1);
+    AsyncJobSystem::setCancelHandler(nullptr);
 
-    if (newfiles->size() > 0 || deletedfiles->size() > 0)
+    // Results may be incomplete, so leave the file list as it was
+    if (!success)
     {
-        pfiledb->updateFileList(newfiles, deletedfiles, core_lock);
+        changes.m_pnewfiles->clear();
+        changes.m_pdeletedfiles->clear();
     }
+
+    return changes;
 }
 
 /**
- * File update job completion callback - updates the file list with results from the update
+ * Last stage of a file update, run on the tick - updates the file list with results from the update
  *
- * @param thisdev           Pointer to the calling class, shared_ptr variant of this keyword
- * @param newfiles     Map of new files to be inserted into the map
- * @param deletedfiles Names of deleted files to be removed
- * @param data         Unused.
+ * @param thisdev Pointer to the calling class, shared_ptr variant of this keyword
+ * @param changes New files to be inserted into the map and names of deleted files to be removed
  */
-void VideoDevice_Caspar::fileUpdateComplete(std::shared_ptr<VideoDevice_Caspar> thisdev,
-        std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
-  std::shared_ptr<std::vector<std::string>> deletedfiles, std::shared_ptr<void> data)
+void VideoDevice_Caspar::fileUpdateComplete(std::shared_ptr<VideoDevice_Caspar> thisdev, CasparFileChanges& changes)
 {
     if (READY != thisdev->m_status && WAITING != thisdev->m_status)
     {
         return;
     }
 
-    for (std::string thisfile : *deletedfiles)
+    for (const std::string& thisfile : *changes.m_pdeletedfiles)
     {
         thisdev->m_files.erase(thisfile);
     }
 
-    for (std::pair<std::string, VideoFile> thisfile : *newfiles)
+    for (std::pair<const std::string, VideoFile>& thisfile : *changes.m_pnewfiles)
     {
-        thisdev->m_files[thisfile.first] = thisfile.second;
+        thisdev->m_files[thisfile.first] = std::move(thisfile.second);
     }
 
-    thisdev->m_hook.gs->L->info("Caspar File Update", "Got " + ConvertType::intToString(newfiles->size()) +
-            " additions and " + ConvertType::intToString(deletedfiles->size()) + " deletions.");
+    thisdev->m_hook.gs->L->info("Caspar File Update", "Got " +
+            ConvertType::intToString(changes.m_pnewfiles->size()) + " additions and " +
+            ConvertType::intToString(changes.m_pdeletedfiles->size()) + " deletions.");
 }
 
 /**
@@ -518,14 +542,14 @@ void VideoDevice_Caspar::batchFileLengths (std::shared_ptr<VideoDevice_Caspar> t
  * Callback to handle files update
  *
  * @param thisdev           Pointer to the calling class, shared_ptr variant of this keyword
- * @param resp              Vector filled with lines from CasparCG
+ * @param resp              Response from CasparCG
  * @param pccon             Pointer to new CG connection
  * @param newfiles          Pointer to a map of new media files
  * @param deletedfiles      Pointer to a vector of deleted file names
  * @param transformed_files Current file list in vector form
  */
 void VideoDevice_Caspar::cb_updatefiles (std::shared_ptr<VideoDevice_Caspar> thisdev,
-        std::vector<std::string>& resp, std::shared_ptr<CasparConnection> pccon,
+        CasparResponse& resp, std::shared_ptr<CasparConnection> pccon,
         std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
                 std::shared_ptr<std::vector<std::string>> deletedfiles,
                 std::shared_ptr<std::vector<std::string>> transformed_files)
@@ -584,7 +608,7 @@ std::vector<std::string> VideoDevice_Caspar::get_missing_items(std::vector<std::
  * @param newfiles      Pointer to a map of new media files
  */
 void VideoDevice_Caspar::cb_updatelength (std::shared_ptr<VideoDevice_Caspar> thisdev,
-        std::vector<std::string>& medialist, std::vector<std::string>& resp,
+        std::vector<std::string>& medialist, CasparResponse& resp,
         std::shared_ptr<CasparConnection> pccon, std::shared_ptr<std::map<std::string, VideoFile>> newfiles)
 {
     std::vector<std::string>::iterator iter = medialist.end();
@@ -635,10 +659,10 @@ void VideoDevice_Caspar::cb_updatelength (std::shared_ptr<VideoDevice_Caspar> th
  *
  * @param resp  Lines of data from CasparCG
  */
-void VideoDevice_Caspar::cb_info (std::vector<std::string>& resp)
+void VideoDevice_Caspar::cb_info (CasparResponse& resp)
 {
     // Detect response type and process appropriately
-    if (resp[0] == "201 INFO OK")
+    if (resp.getStatus() == "201 INFO OK")
     {
         std::string filename;
         int frames = CasparQueryResponseProcessor::readLayerStatus(resp, filename);
@@ -59,7 +59,7 @@ public:
 
     void readFileList (std::map<std::string, VideoFile> &filelist);
     void updateFileList (std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
-        std::shared_ptr<std::vector<std::string>> deletedfiles, std::timed_mutex &core_lock);
+        std::shared_ptr<std::vector<std::string>> deletedfiles);
 
 private:
     std::shared_ptr<DBQuery> m_pgetfilelist_query;
@@ -67,6 +67,15 @@ private:
     std::string m_table;
     std::mutex m_list_lock;
 };
+
+/**
+ * Differences between the server's media list and ours, found by a file update job
+ */
+struct CasparFileChanges
+{
+    std::shared_ptr<std::map<std::string, VideoFile>> m_pnewfiles;
+    std::shared_ptr<std::vector<std::string>> m_pdeletedfiles;
+};
 
 /**
  * Caspar supports both CG and media. This plugin works with Media.
@@ -94,32 +103,30 @@ private:
     std::string m_hostname;
     std::string m_port;
 
+    //! Background connection for file list updates, shared with other plugins on the same server
+    std::shared_ptr<CasparSharedConnection> m_prescancon;
+
     //! Database file name
     std::shared_ptr<CasparFileList> m_pfiledb;
 
-    void cb_info (std::vector<std::string>& resp);
+    void cb_info (CasparResponse& resp);
 
     // Static functions for async files update job
-    static void fileUpdateJob (std::shared_ptr<VideoDevice_Caspar> thisdev,
-            std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
-            std::shared_ptr<std::vector<std::string>> deletedfiles, std::shared_ptr<void> data,
-            std::timed_mutex &core_lock, std::string hostname, std::string port,
-            std::shared_ptr<std::vector<std::string>> transformed_files,
-            std::shared_ptr<CasparFileList> pfiledb);
-    static void fileUpdateComplete (std::shared_ptr<VideoDevice_Caspar> thisdev,
-            std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
-            std::shared_ptr<std::vector<std::string>> deletedfiles, std::shared_ptr<void> data);
+    static CasparFileChanges fileUpdateJob (std::shared_ptr<VideoDevice_Caspar> thisdev,
+            std::shared_ptr<CasparSharedConnection> prescancon,
+            std::shared_ptr<std::vector<std::string>> transformed_files);
+    static void fileUpdateComplete (std::shared_ptr<VideoDevice_Caspar> thisdev, CasparFileChanges& changes);
     static void batchFileLengths (std::shared_ptr<VideoDevice_Caspar> thisdev,
             std::vector<std::string>& medialist, std::shared_ptr<CasparConnection> pccon,
             std::shared_ptr<std::map<std::string, VideoFile>> newfiles);
 
     static void cb_updatefiles (std::shared_ptr<VideoDevice_Caspar> thisdev,
-            std::vector<std::string>& resp, std::shared_ptr<CasparConnection> pccon,
+            CasparResponse& resp, std::shared_ptr<CasparConnection> pccon,
             std::shared_ptr<std::map<std::string, VideoFile>> newfiles,
             std::shared_ptr<std::vector<std::string>> deletedfiles,
             std::shared_ptr<std::vector<std::string>> transformed_files);
     static void cb_updatelength (std::shared_ptr<VideoDevice_Caspar> thisdev,
-            std::vector<std::string>& medialist, std::vector<std::string>& resp,
+            std::vector<std::string>& medialist, CasparResponse& resp,
             std::shared_ptr<CasparConnection> pccon, std::shared_ptr<std::map<std::string, VideoFile>> newfiles);
 
     static std::vector<std::string> get_missing_items(std::vector<std::string> largelist,
@@ -64,13 +64,13 @@ void parseExtraData (PlaylistEntry& event, std::string *pgraphicname,
         *pgraphicname = "";
     }
 
-    for (std::pair<std::string, std::string> thiselement : event.m_extras)
+    for (const ExtraData::value_type& thiselement : event.m_extras)
     {
-        if (!thiselement.first.compare("graphicname") && pgraphicname)
+        if (EXTRA_GRAPHICNAME == thiselement.first.getId() && pgraphicname)
         {
             *pgraphicname = thiselement.second;
         }
-        else if (!thiselement.first.compare("hostlayer") && playernumber)
+        else if (EXTRA_HOSTLAYER == thiselement.first.getId() && playernumber)
         {
             try
             {
@@ -23,6 +23,8 @@
 *****************************************************************************/
 
 
+#include <algorithm>
+
 #include "Channel.h"
 #include "CrosspointDevice.h"
 #include "VideoDevice.h"
@@ -43,8 +45,11 @@ int end = 0;
 Channel::Channel () : m_pl("Unknown")
 {
     m_channame = "Unnamed Channel";
+    m_channelid = -1;
     m_xpport = "YSTV Stream";
     m_xpdevicename = "DemoXpointDefaultName";
+    m_overlappolicy = OVERLAP_WARN;
+    m_recurrencelookahead = 172800;
     //try and get a more sensible default XP name
     for (std::pair<std::string, std::shared_ptr<Device>> currentdevice : g_devices)
     {
@@ -62,12 +67,34 @@ Channel::Channel () : m_pl("Unknown")
  * @param name   The name of the channel to initialize
  * @param xpname The name of the crosspoint for this channel
  * @param xport  The name of this channel's crosspoint port (as in crosspoint device file)
+ * @param overlappolicy What to do with overlapping events: warn, reject or shunt
+ * @param recurrencelookahead How far ahead to add recurring events to the playlist, in seconds
  */
-Channel::Channel (std::string name, std::string xpname, std::string xport) : m_pl(name)
+Channel::Channel (std::string name, std::string xpname, std::string xport,
+        std::string overlappolicy, int recurrencelookahead) : m_pl(name)
 {
     m_channame = name;
+    m_channelid = -1;
     m_xpdevicename = xpname;
     m_xpport = xport;
+    m_recurrencelookahead = recurrencelookahead;
+
+    m_overlappolicy = OVERLAP_WARN;
+    bool foundpolicy = false;
+    for (const std::pair<const timeline_overlap_policy_t, std::string>& policy : timeline_overlap_policy_vector)
+    {
+        if (!overlappolicy.compare(policy.second))
+        {
+            m_overlappolicy = policy.first;
+            foundpolicy = true;
+        }
+    }
+
+    if (!foundpolicy)
+    {
+        g_logger.warn("Channel " + m_channame, "Unknown overlap policy " + overlappolicy + ", using warn");
+    }
+
     init();
 }
 
@@ -105,6 +132,12 @@ void Channel::init ()
     // Disable manual hold
     m_hold_event = -1;
 
+    m_lastprune = time(NULL);
+
+    // Expand recurring events on the first tick
+    m_lastexpansion = 0;
+    m_expansionpending = false;
+
     // Register the preprocessor
     g_preprocessorlist.emplace("Channel::manualHoldRelease", &Channel::manualHoldRelease);
 }
@@ -117,11 +150,24 @@ void Channel::tick ()
     // Update hold flag
     m_hold_event = m_pl.getActiveHold(time(NULL));
 
+    // Drop long-finished events from the timeline once a minute, keeping an hour for late shunts
+    if (time(NULL) - m_lastprune >= 60)
+    {
+        m_lastprune = time(NULL);
+        m_pl.pruneTimeline(m_lastprune - 3600);
+    }
+
+    // Keep the recurring event lookahead window filled
+    if (!m_expansionpending && time(NULL) - m_lastexpansion >= 60)
+    {
+        expandRecurrences();
+    }
+
     //Pull all the time triggered events at the current time
     std::vector<PlaylistEntry> events = m_pl.getEvents(EVENT_FIXED, (time(NULL)));
 
     //Execute events on devices
-    for (PlaylistEntry thisevent : events)
+    for (PlaylistEntry& thisevent : events)
     {
         // Only run events if the channel is not in hold, or the event is a child of the hold
         if (0 == m_hold_event || thisevent.m_parent == m_hold_event)
@@ -181,7 +227,7 @@ void Channel::begunPlaying (std::string name, int id)
 {
     std::vector<PlaylistEntry> childevents = m_pl.getChildEvents(id);
     // Run the child events
-    for (PlaylistEntry thisevent : childevents)
+    for (PlaylistEntry& thisevent : childevents)
     {
         runEvent(thisevent);
     }
@@ -218,7 +264,9 @@ void Channel::runEvent (PlaylistEntry& event)
         }
     }
 
-    if ((0 == g_devices.count(event.m_device)) && (event.m_devicetype != EVENTDEVICE_PROCESSOR))
+    std::shared_ptr<Device> pdevice = Device::getDeviceById(event.m_deviceid);
+
+    if (!pdevice && (event.m_devicetype != EVENTDEVICE_PROCESSOR))
     {
         g_logger.warn("Channel Runner",
                 "Device " + event.m_device + " not found for event ID " + ConvertType::intToString(event.m_eventid));
@@ -233,17 +281,17 @@ void Channel::runEvent (PlaylistEntry& event)
     {
         case EVENTDEVICE_CROSSPOINT:
         {
-            CrosspointDevice::runDeviceEvent(g_devices[event.m_device], event);
+            CrosspointDevice::runDeviceEvent(pdevice, event);
             break;
         }
         case EVENTDEVICE_VIDEODEVICE:
         {
-            VideoDevice::runDeviceEvent(g_devices[event.m_device], event);
+            VideoDevice::runDeviceEvent(pdevice, event);
             break;
         }
         case EVENTDEVICE_CGDEVICE:
         {
-            CGDevice::runDeviceEvent(g_devices[event.m_device], event);
+            CGDevice::runDeviceEvent(pdevice, event);
             break;
         }
         case EVENTDEVICE_PROCESSOR:
@@ -254,12 +302,145 @@ void Channel::runEvent (PlaylistEntry& event)
     m_pl.processEvent(event.m_eventid);
 }
 
+/**
+ * Add an event to the playlist, checking top-level events against the channel's
+ * overlap policy first.
+ *
+ * @param pev The event to add
+ * @return    ID of the new event, or -1 if it was rejected
+ */
 int Channel::createEvent (PlaylistEntry *pev)
 {
+    if (0 == pev->m_parent && !m_pl.applyOverlapPolicy(pev->m_trigger,
+            PlaylistDB::getEndTime(pev->m_trigger, pev->m_duration), m_overlappolicy))
+    {
+        return -1;
+    }
+
     int ret = m_pl.addEvent(pev);
     return ret;
 }
 
+/**
+ * Start a background job to find recurring event occurrences which are due to enter the playlist
+ */
+void Channel::expandRecurrences ()
+{
+    if (m_expansionpending)
+    {
+        return;
+    }
+
+    m_lastexpansion = time(NULL);
+
+    std::shared_ptr<RecurrenceExpansionData> pdata = std::make_shared<RecurrenceExpansionData>();
+    pdata->m_rules = m_pl.getRecurrences();
+
+    if (pdata->m_rules.empty())
+    {
+        return;
+    }
+
+    pdata->m_now = m_lastexpansion;
+    pdata->m_horizon = m_lastexpansion + m_recurrencelookahead;
+
+    m_expansionpending = true;
+
+    g_async.newAsyncJob(&Channel::findRecurrenceOccurrences,
+            std::bind(&Channel::addRecurrenceOccurrences, this, std::placeholders::_1),
+            pdata, 0, false, "", "Recurrence");
+}
+
+/**
+ * Work out occurrences for a set of recurring rules. Runs as an async job so only touches the job data.
+ *
+ * @param data      Pointer to a RecurrenceExpansionData
+ * @param core_lock Unused
+ */
+void Channel::findRecurrenceOccurrences (std::shared_ptr<void> data, std::timed_mutex &core_lock)
+{
+    std::shared_ptr<RecurrenceExpansionData> pdata = std::static_pointer_cast<RecurrenceExpansionData>(data);
+
+    for (const RecurringEntry& rule : pdata->m_rules)
+    {
+        // Never go back and fill in occurrences which have already passed
+        time_t from = std::max(rule.m_expandeduntil, pdata->m_now);
+
+        std::vector<time_t> occurrences;
+        rule.getOccurrences(from, pdata->m_horizon, occurrences);
+        pdata->m_occurrences.push_back(occurrences);
+    }
+}
+
+/**
+ * Add the occurrences found by findRecurrenceOccurrences to the playlist. Runs in the
+ * main thread as an async job callback.
+ *
+ * @param data Pointer to a RecurrenceExpansionData
+ */
+void Channel::addRecurrenceOccurrences (std::shared_ptr<void> data)
+{
+    std::shared_ptr<RecurrenceExpansionData> pdata = std::static_pointer_cast<RecurrenceExpansionData>(data);
+    m_expansionpending = false;
+
+    std::shared_ptr<Channel> pthischannel;
+    try
+    {
+        pthischannel = g_channels.at(m_channelid);
+    }
+    catch (std::exception&)
+    {
+        g_logger.error("Channel " + m_channame + ERROR_LOC, "Unable to find own channel to expand recurring events");
+        return;
+    }
+
+    // Rules edited or removed while the job ran will be picked up next time
+    std::map<int, time_t> currentrules;
+    for (const RecurringEntry& rule : m_pl.getRecurrences())
+    {
+        currentrules[rule.m_ruleid] = rule.m_expandeduntil;
+    }
+
+    for (size_t i = 0; i < pdata->m_rules.size() && i < pdata->m_occurrences.size(); ++i)
+    {
+        RecurringEntry& rule = pdata->m_rules[i];
+
+        if (0 == currentrules.count(rule.m_ruleid) || currentrules[rule.m_ruleid] != rule.m_expandeduntil)
+        {
+            continue;
+        }
+
+        for (time_t occurrence : pdata->m_occurrences[i])
+        {
+            PlaylistEntry instance = rule.m_template;
+            instance.m_trigger = occurrence;
+
+            // Go back through MouseCatcher so EventProcessors get to run on each occurrence
+            MouseCatcherEvent mcevent;
+            if (!MouseCatcherCore::convertToMCEvent(&instance, pthischannel, &mcevent, &g_logger))
+            {
+                g_logger.warn("Channel " + m_channame, "Unable to create occurrence of recurring event " +
+                        ConvertType::intToString(rule.m_ruleid));
+                continue;
+            }
+
+            EventAction action;
+            int eventid = MouseCatcherCore::processEvent(mcevent, -1, false, action);
+
+            if (eventid < 0)
+            {
+                g_logger.warn("Channel " + m_channame, "Occurrence of recurring event " +
+                        ConvertType::intToString(rule.m_ruleid) + " was not added: " + action.returnmessage);
+                continue;
+            }
+
+            m_pl.addRecurrenceInstance(rule.m_ruleid, eventid, occurrence);
+        }
+
+        m_pl.setRecurrenceExpanded(rule.m_ruleid, pdata->m_horizon);
+    }
+}
+
 /**
  *  Because you cannot add member function pointers to the callbacks, here is a workaround:
  *  We go through and call the tick function of each Channel class in the host's stack.
@@ -303,29 +484,23 @@ void channelEndPlaying (std::string name, int id)
 }
 
 /**
- * Loop over the channel list and return the index of a channel from its name.
+ * Look up the index of a channel from its name.
  *
  * @param channelname Name of the channel to find
  *
  * @return Index of the located channel
  */
-int Channel::getChannelByName (std::string channelname)
+int Channel::getChannelByName (const std::string& channelname)
 {
-    for (std::vector<std::shared_ptr<Channel>>::iterator it = g_channels.begin();
-            it != g_channels.end(); ++it)
+    int channelid = g_channelids.find(channelname);
+
+    if (channelid < 0)
     {
-        if (*it)
-        {
-            if (!channelname.compare((*it)->m_channame))
-            {
-                return it - g_channels.begin();
-            }
-        }
+        // No channel was loaded with that name
+        throw std::exception();
     }
 
-    // At this point no channel was found with that name
-    throw std::exception();
-    return -1;
+    return channelid;
 }
 
 /**
@@ -356,8 +531,8 @@ void Channel::manualHoldRelease (PlaylistEntry &event, Channel *pchannel)
     xpswitch.m_eventtype = EVENT_FIXED;
     xpswitch.m_targetdevice = pchannel->m_xpdevicename;
     xpswitch.m_triggertime = time(NULL);
-    xpswitch.m_extradata["output"] = pchannel->m_xpport;
-    xpswitch.m_extradata["input"] = event.m_extras["switchchannel"];
+    xpswitch.m_extradata[EXTRA_OUTPUT] = pchannel->m_xpport;
+    xpswitch.m_extradata[EXTRA_INPUT] = event.m_extras["switchchannel"];
 
     EventAction action;
     MouseCatcherCore::processEvent(xpswitch, event.m_parent, true, action);
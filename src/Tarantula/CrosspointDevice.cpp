@@ -242,18 +242,18 @@ void CrosspointDevice::runDeviceEvent (std::shared_ptr<Device> pdevice, Playlist
 
     if (event.m_action == CROSSPOINTACTION_SWITCH)
     {
-        if (1 == event.m_extras.count("input") && 1 == event.m_extras.count("output"))
+        if (1 == event.m_extras.count(EXTRA_INPUT) && 1 == event.m_extras.count(EXTRA_OUTPUT))
         {
             try
             {
-                g_logger.info(event.m_device, "Now switching output " + event.m_extras["output"] + " to input "
-                        + event.m_extras["input"]);
-                peventdevice->switchOP(event.m_extras["output"], event.m_extras["input"]);
+                g_logger.info(event.m_device, "Now switching output " + event.m_extras[EXTRA_OUTPUT] + " to input "
+                        + event.m_extras[EXTRA_INPUT]);
+                peventdevice->switchOP(event.m_extras[EXTRA_OUTPUT], event.m_extras[EXTRA_INPUT]);
             } catch (...)
             {
                 g_logger.warn(event.m_device + ERROR_LOC,
-                        "An error occurred switching output " + event.m_extras["output"] + " to input "
-                                + event.m_extras["input"]);
+                        "An error occurred switching output " + event.m_extras[EXTRA_OUTPUT] + " to input "
+                                + event.m_extras[EXTRA_INPUT]);
             }
         }
         else
@@ -41,6 +41,7 @@ Device::Device (PluginConfig config, playlist_device_type_t type, Hook h) :
 {
     this->m_type = type;
     m_event = -1;
+    m_deviceid = -1;
 
     pugi::xml_node pollchild = config.m_plugindata_xml.child("PollPeriod");
     pollperiod = pollchild.text().as_int(0);
@@ -89,6 +90,61 @@ void Device::addPluginReference (std::shared_ptr<Plugin> thisplugin)
     std::shared_ptr<Device> thisdevice = std::dynamic_pointer_cast<Device>(thisplugin);
 
     g_devices[thisdevice->getPluginName()] = std::shared_ptr<Device>(thisdevice);
+
+    thisdevice->m_deviceid = g_deviceids.intern(thisdevice->getPluginName());
+    if (g_devicetable.size() <= static_cast<size_t>(thisdevice->m_deviceid))
+    {
+        g_devicetable.resize(thisdevice->m_deviceid + 1);
+    }
+    g_devicetable[thisdevice->m_deviceid] = thisdevice;
+
+    // Build the action index now, so lookups afterwards only ever read it
+    thisdevice->m_actionids.clear();
+    for (const ActionInformation *thisaction : *thisdevice->m_actionlist)
+    {
+        thisdevice->m_actionids[thisaction->name] = thisaction->actionid;
+    }
+}
+
+/**
+ * Find a loaded device from its ID
+ *
+ * @param deviceid ID from g_deviceids
+ * @return         The device, or an empty pointer if no device with that ID is loaded
+ */
+std::shared_ptr<Device> Device::getDeviceById (int deviceid)
+{
+    if (deviceid < 0 || static_cast<size_t>(deviceid) >= g_devicetable.size())
+    {
+        return std::shared_ptr<Device>();
+    }
+
+    return g_devicetable[deviceid];
+}
+
+/**
+ * @return This device's ID from g_deviceids
+ */
+int Device::getDeviceId ()
+{
+    return m_deviceid;
+}
+
+/**
+ * Look up the ID of one of this device's actions from its name
+ *
+ * @param actionname Name of the action
+ * @return           Action ID, or -1 if this device has no such action
+ */
+int Device::getActionId (const std::string& actionname)
+{
+    std::unordered_map<std::string, int>::iterator it = m_actionids.find(actionname);
+    if (m_actionids.end() == it)
+    {
+        return -1;
+    }
+
+    return it->second;
 }
 
 
@@ -126,6 +182,7 @@ void deviceTicks ()
         }
         else
         {
+            g_devicetable[thisdevice.second->getDeviceId()].reset();
             g_devices.erase(thisdevice.first);
         }
     }
@@ -0,0 +1,555 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : EventTimeline.cpp
+*   Version     : 1.0
+*   Description : In-memory interval tree of top-level events on a channel
+*
+*****************************************************************************/
+
+
+#include <algorithm>
+
+#include "EventTimeline.h"
+
+EventTimeline::EventTimeline ()
+{
+}
+
+EventTimeline::~EventTimeline ()
+{
+}
+
+/**
+ * Add an event to the timeline, replacing any existing entry for the same ID
+ *
+ * @param eventid ID of the event in the playlist database
+ * @param start   Time the event is triggered
+ * @param end     Time the event finishes (exclusive)
+ */
+void EventTimeline::insert (int eventid, time_t start, time_t end)
+{
+    remove(eventid);
+
+    TimelineInterval interval;
+    interval.m_start = start;
+    interval.m_end = std::max(start, end);
+    interval.m_eventid = eventid;
+
+    insertNode(m_root, interval);
+    m_index[eventid] = interval;
+}
+
+/**
+ * Remove an event from the timeline
+ *
+ * @param eventid ID of the event to remove
+ * @return        True if the event was on the timeline
+ */
+bool EventTimeline::remove (int eventid)
+{
+    std::map<int, TimelineInterval>::iterator it = m_index.find(eventid);
+    if (it == m_index.end())
+    {
+        return false;
+    }
+
+    removeNode(m_root, it->second);
+    m_index.erase(it);
+    return true;
+}
+
+/**
+ * Empty the timeline
+ */
+void EventTimeline::clear ()
+{
+    m_root.reset();
+    m_index.clear();
+}
+
+/**
+ * @return Number of events on the timeline
+ */
+size_t EventTimeline::size () const
+{
+    return m_index.size();
+}
+
+/**
+ * Look up the interval held for an event
+ *
+ * @param eventid  ID of the event to find
+ * @param interval Populated with the event's interval if found
+ * @return         True if the event was on the timeline
+ */
+bool EventTimeline::getInterval (int eventid, TimelineInterval& interval) const
+{
+    std::map<int, TimelineInterval>::const_iterator it = m_index.find(eventid);
+    if (it == m_index.end())
+    {
+        return false;
+    }
+
+    interval = it->second;
+    return true;
+}
+
+/**
+ * Check whether anything on the timeline overlaps [start, end)
+ *
+ * @param start    Start of the range to test
+ * @param end      End of the range to test (exclusive)
+ * @param ignoreid Event ID to disregard, for checking an event against everything but itself
+ * @return         True if at least one event overlaps
+ */
+bool EventTimeline::hasOverlap (time_t start, time_t end, int ignoreid) const
+{
+    if (end <= start)
+    {
+        return false;
+    }
+
+    return anyOverlapping(m_root, start, end, ignoreid);
+}
+
+/**
+ * Find every event overlapping [start, end), in start time order
+ *
+ * @param start    Start of the range to search
+ * @param end      End of the range to search (exclusive)
+ * @param result   Vector to append matching intervals to
+ * @param ignoreid Event ID to disregard
+ */
+void EventTimeline::findOverlapping (time_t start, time_t end,
+        std::vector<TimelineInterval>& result, int ignoreid) const
+{
+    if (end <= start)
+    {
+        return;
+    }
+
+    collectOverlapping(m_root, start, end, result, ignoreid);
+}
+
+/**
+ * Find every event on air at a given instant
+ *
+ * @param at     Time to search at
+ * @param result Vector to append matching intervals to
+ */
+void EventTimeline::findAt (time_t at, std::vector<TimelineInterval>& result) const
+{
+    collectOverlapping(m_root, at, at + 1, result, -1);
+}
+
+/**
+ * Find unoccupied stretches of the timeline between start and end
+ *
+ * @param start  Start of the range to search
+ * @param end    End of the range to search (exclusive)
+ * @param mingap Ignore gaps shorter than this many seconds
+ * @param gaps   Vector to append the gaps to, in time order
+ */
+void EventTimeline::findGaps (time_t start, time_t end, int mingap,
+        std::vector<TimelineGap>& gaps) const
+{
+    if (end <= start)
+    {
+        return;
+    }
+
+    std::vector<TimelineInterval> occupied;
+    collectOverlapping(m_root, start, end, occupied, -1);
+
+    // Walk forward through the occupied intervals, tracking how far the range is covered
+    time_t cursor = start;
+    for (const TimelineInterval& interval : occupied)
+    {
+        if (interval.m_start > cursor && interval.m_start - cursor >= mingap)
+        {
+            TimelineGap gap;
+            gap.m_start = cursor;
+            gap.m_end = interval.m_start;
+            gaps.push_back(gap);
+        }
+
+        cursor = std::max(cursor, interval.m_end);
+    }
+
+    if (end > cursor && end - cursor >= mingap)
+    {
+        TimelineGap gap;
+        gap.m_start = cursor;
+        gap.m_end = end;
+        gaps.push_back(gap);
+    }
+}
+
+/**
+ * Move every event starting in [from, to) by offset seconds, matching a playlist shunt
+ *
+ * @param from   Earliest start time to move
+ * @param to     Start times at or after this are left alone
+ * @param offset Number of seconds to move events by
+ */
+void EventTimeline::shift (time_t from, time_t to, int offset)
+{
+    std::vector<TimelineInterval> moving;
+    collectStarting(m_root, from, to, moving);
+
+    for (TimelineInterval& interval : moving)
+    {
+        insert(interval.m_eventid, interval.m_start + offset, interval.m_end + offset);
+    }
+}
+
+/**
+ * Drop events which finished before a given time
+ *
+ * @param cutoff Events ending at or before this are removed
+ */
+void EventTimeline::pruneBefore (time_t cutoff)
+{
+    std::vector<int> expired;
+    for (const std::pair<const int, TimelineInterval>& entry : m_index)
+    {
+        if (entry.second.m_end <= cutoff)
+        {
+            expired.push_back(entry.first);
+        }
+    }
+
+    for (int eventid : expired)
+    {
+        remove(eventid);
+    }
+}
+
+/**
+ * Check the tree is ordered and balanced, that cached heights and end times
+ * are right and that it holds the same events as the index. Walks every node,
+ * so is meant for tests rather than normal use.
+ *
+ * @return True if everything is consistent
+ */
+bool EventTimeline::verify () const
+{
+    size_t count = 0;
+    if (!verifyNode(m_root, NULL, NULL, count) || count != m_index.size())
+    {
+        return false;
+    }
+
+    for (const std::pair<const int, TimelineInterval>& entry : m_index)
+    {
+        if (entry.first != entry.second.m_eventid)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int EventTimeline::height (const NodePtr& node)
+{
+    return node ? node->m_height : 0;
+}
+
+/**
+ * Recalculate the cached height and latest end time of a node from its children
+ */
+void EventTimeline::update (NodePtr& node)
+{
+    node->m_height = 1 + std::max(height(node->m_left), height(node->m_right));
+    node->m_maxend = node->m_interval.m_end;
+
+    if (node->m_left)
+    {
+        node->m_maxend = std::max(node->m_maxend, node->m_left->m_maxend);
+    }
+
+    if (node->m_right)
+    {
+        node->m_maxend = std::max(node->m_maxend, node->m_right->m_maxend);
+    }
+}
+
+void EventTimeline::rotateLeft (NodePtr& node)
+{
+    NodePtr pivot = std::move(node->m_right);
+    node->m_right = std::move(pivot->m_left);
+    update(node);
+    pivot->m_left = std::move(node);
+    node = std::move(pivot);
+    update(node);
+}
+
+void EventTimeline::rotateRight (NodePtr& node)
+{
+    NodePtr pivot = std::move(node->m_left);
+    node->m_left = std::move(pivot->m_right);
+    update(node);
+    pivot->m_right = std::move(node);
+    node = std::move(pivot);
+    update(node);
+}
+
+void EventTimeline::rebalance (NodePtr& node)
+{
+    update(node);
+    int balance = height(node->m_left) - height(node->m_right);
+
+    if (balance > 1)
+    {
+        if (height(node->m_left->m_left) < height(node->m_left->m_right))
+        {
+            rotateLeft(node->m_left);
+        }
+        rotateRight(node);
+    }
+    else if (balance < -1)
+    {
+        if (height(node->m_right->m_right) < height(node->m_right->m_left))
+        {
+            rotateRight(node->m_right);
+        }
+        rotateLeft(node);
+    }
+}
+
+/**
+ * Tree ordering. Ties on start time are broken by event ID so every key is unique.
+ */
+bool EventTimeline::keyLess (const TimelineInterval& lhs, const TimelineInterval& rhs)
+{
+    if (lhs.m_start != rhs.m_start)
+    {
+        return lhs.m_start < rhs.m_start;
+    }
+    return lhs.m_eventid < rhs.m_eventid;
+}
+
+void EventTimeline::insertNode (NodePtr& node, const TimelineInterval& interval)
+{
+    if (!node)
+    {
+        node.reset(new TimelineNode());
+        node->m_interval = interval;
+        node->m_maxend = interval.m_end;
+        node->m_height = 1;
+        return;
+    }
+
+    if (keyLess(interval, node->m_interval))
+    {
+        insertNode(node->m_left, interval);
+    }
+    else
+    {
+        insertNode(node->m_right, interval);
+    }
+
+    rebalance(node);
+}
+
+void EventTimeline::removeNode (NodePtr& node, const TimelineInterval& interval)
+{
+    if (!node)
+    {
+        return;
+    }
+
+    if (keyLess(interval, node->m_interval))
+    {
+        removeNode(node->m_left, interval);
+    }
+    else if (keyLess(node->m_interval, interval))
+    {
+        removeNode(node->m_right, interval);
+    }
+    else
+    {
+        if (!node->m_left)
+        {
+            node = std::move(node->m_right);
+        }
+        else if (!node->m_right)
+        {
+            node = std::move(node->m_left);
+        }
+        else
+        {
+            // Replace with the in-order successor
+            NodePtr successor = detachMin(node->m_right);
+            successor->m_left = std::move(node->m_left);
+            successor->m_right = std::move(node->m_right);
+            node = std::move(successor);
+        }
+
+        if (!node)
+        {
+            return;
+        }
+    }
+
+    rebalance(node);
+}
+
+/**
+ * Unlink and return the leftmost node of a subtree, rebalancing on the way back up
+ */
+EventTimeline::NodePtr EventTimeline::detachMin (NodePtr& node)
+{
+    if (!node->m_left)
+    {
+        NodePtr min = std::move(node);
+        node = std::move(min->m_right);
+        return min;
+    }
+
+    NodePtr min = detachMin(node->m_left);
+    rebalance(node);
+    return min;
+}
+
+void EventTimeline::collectOverlapping (const NodePtr& node, time_t start, time_t end,
+        std::vector<TimelineInterval>& result, int ignoreid)
+{
+    // Nothing in this subtree runs past the start of the range
+    if (!node || node->m_maxend <= start)
+    {
+        return;
+    }
+
+    collectOverlapping(node->m_left, start, end, result, ignoreid);
+
+    const TimelineInterval& interval = node->m_interval;
+    if (interval.m_start >= end)
+    {
+        // Everything to the right starts later still
+        return;
+    }
+
+    if (interval.m_end > start && interval.m_end > interval.m_start && interval.m_eventid != ignoreid)
+    {
+        result.push_back(interval);
+    }
+
+    collectOverlapping(node->m_right, start, end, result, ignoreid);
+}
+
+bool EventTimeline::anyOverlapping (const NodePtr& node, time_t start, time_t end, int ignoreid)
+{
+    if (!node || node->m_maxend <= start)
+    {
+        return false;
+    }
+
+    const TimelineInterval& interval = node->m_interval;
+    if (interval.m_start < end && interval.m_end > start &&
+            interval.m_end > interval.m_start && interval.m_eventid != ignoreid)
+    {
+        return true;
+    }
+
+    if (anyOverlapping(node->m_left, start, end, ignoreid))
+    {
+        return true;
+    }
+
+    if (interval.m_start >= end)
+    {
+        return false;
+    }
+
+    return anyOverlapping(node->m_right, start, end, ignoreid);
+}
+
+/**
+ * Check one subtree for verify()
+ *
+ * @param node   Root of the subtree
+ * @param plower Every key in the subtree must sort after this, or NULL for no limit
+ * @param pupper Every key in the subtree must sort before this, or NULL for no limit
+ * @param count  Incremented by the number of nodes in the subtree
+ * @return       True if the subtree is consistent
+ */
+bool EventTimeline::verifyNode (const NodePtr& node, const TimelineInterval* plower, const TimelineInterval* pupper,
+        size_t& count)
+{
+    if (!node)
+    {
+        return true;
+    }
+
+    const TimelineInterval& interval = node->m_interval;
+    if ((plower && !keyLess(*plower, interval)) || (pupper && !keyLess(interval, *pupper)))
+    {
+        return false;
+    }
+
+    if (!verifyNode(node->m_left, plower, &interval, count) || !verifyNode(node->m_right, &interval, pupper, count))
+    {
+        return false;
+    }
+
+    count++;
+
+    int balance = height(node->m_left) - height(node->m_right);
+    time_t maxend = interval.m_end;
+    if (node->m_left)
+    {
+        maxend = std::max(maxend, node->m_left->m_maxend);
+    }
+    if (node->m_right)
+    {
+        maxend = std::max(maxend, node->m_right->m_maxend);
+    }
+
+    return balance >= -1 && balance <= 1 && maxend == node->m_maxend &&
+            node->m_height == 1 + std::max(height(node->m_left), height(node->m_right));
+}
+
+/**
+ * Collect every interval whose start lies in [from, to), in start order
+ */
+void EventTimeline::collectStarting (const NodePtr& node, time_t from, time_t to,
+        std::vector<TimelineInterval>& result)
+{
+    if (!node)
+    {
+        return;
+    }
+
+    if (node->m_interval.m_start >= from)
+    {
+        collectStarting(node->m_left, from, to, result);
+    }
+
+    if (node->m_interval.m_start >= from && node->m_interval.m_start < to)
+    {
+        result.push_back(node->m_interval);
+    }
+
+    if (node->m_interval.m_start < to)
+    {
+        collectStarting(node->m_right, from, to, result);
+    }
+}
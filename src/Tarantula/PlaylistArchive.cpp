@@ -0,0 +1,335 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : PlaylistArchive.cpp
+*   Version     : 1.0
+*   Description : Compact binary file format for saving and loading event trees
+*
+*****************************************************************************/
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "PlaylistArchive.h"
+
+//! Deepest nesting of child events accepted when reading, to stop corrupt files recursing forever
+#define PLAYLISTARCHIVE_MAXDEPTH 64
+
+static const char g_archivemagic[4] = { 'T', 'P', 'L', 'A' };
+
+/**
+ * Open a new archive file and write the header
+ *
+ * @param filename File to create or overwrite
+ */
+PlaylistArchiveWriter::PlaylistArchiveWriter (std::string filename)
+{
+    m_failed = false;
+    m_file.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!m_file.is_open())
+    {
+        throw std::exception();
+    }
+
+    std::string header(g_archivemagic, 4);
+    encodeInt(PLAYLISTARCHIVE_VERSION, 2, header);
+    encodeInt(0, 2, header);
+    m_file.write(header.data(), header.size());
+
+    if (!m_file.good())
+    {
+        m_failed = true;
+        throw std::exception();
+    }
+}
+
+/**
+ * Closes the file without the end marker if close() was never called or failed,
+ * so an export abandoned partway cannot be read back as complete
+ */
+PlaylistArchiveWriter::~PlaylistArchiveWriter ()
+{
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+}
+
+/**
+ * Append one top-level event and its children to the archive
+ *
+ * @param event Event tree to write
+ */
+void PlaylistArchiveWriter::writeEvent (const ArchivedEvent& event)
+{
+    if (m_failed || !m_file.is_open())
+    {
+        throw std::exception();
+    }
+
+    m_buffer.clear();
+
+    // Leave space for the length and fill it in once the record is encoded
+    m_buffer.append(4, '\0');
+    encodeEvent(event, m_buffer);
+
+    uint32_t length = m_buffer.size() - 4;
+    for (int i = 0; i < 4; ++i)
+    {
+        m_buffer[i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+
+    m_file.write(m_buffer.data(), m_buffer.size());
+
+    if (!m_file.good())
+    {
+        m_failed = true;
+        throw std::exception();
+    }
+}
+
+/**
+ * Write the end marker and close the file, completing the archive. Safe to call
+ * more than once. If any earlier write failed the marker is left off, so the
+ * archive will not read back, and an exception is thrown.
+ */
+void PlaylistArchiveWriter::close ()
+{
+    if (!m_file.is_open())
+    {
+        if (m_failed)
+        {
+            throw std::exception();
+        }
+        return;
+    }
+
+    if (!m_failed)
+    {
+        std::string terminator;
+        encodeInt(0, 4, terminator);
+        m_file.write(terminator.data(), terminator.size());
+        m_file.flush();
+        m_failed = !m_file.good();
+    }
+
+    m_file.close();
+
+    if (m_failed || m_file.fail())
+    {
+        m_failed = true;
+        throw std::exception();
+    }
+}
+
+void PlaylistArchiveWriter::encodeEvent (const ArchivedEvent& event, std::string& buffer)
+{
+    const PlaylistEntry& entry = event.m_event;
+
+    encodeInt(static_cast<uint32_t>(entry.m_eventid), 4, buffer);
+    encodeInt(static_cast<uint8_t>(entry.m_eventtype), 1, buffer);
+    encodeInt(static_cast<int64_t>(entry.m_trigger), 8, buffer);
+    encodeString(entry.m_device, buffer);
+    encodeInt(static_cast<uint8_t>(entry.m_devicetype), 1, buffer);
+    encodeInt(static_cast<uint32_t>(entry.m_action), 4, buffer);
+    encodeInt(static_cast<uint32_t>(entry.m_duration), 4, buffer);
+    encodeString(entry.m_preprocessor, buffer);
+    encodeString(entry.m_description, buffer);
+
+    encodeInt(entry.m_extras.size(), 4, buffer);
+    for (const ExtraData::value_type& extra : entry.m_extras)
+    {
+        encodeString(extra.first, buffer);
+        encodeString(extra.second, buffer);
+    }
+
+    encodeInt(event.m_children.size(), 4, buffer);
+    for (const ArchivedEvent& child : event.m_children)
+    {
+        encodeEvent(child, buffer);
+    }
+}
+
+void PlaylistArchiveWriter::encodeInt (uint64_t value, int bytes, std::string& buffer)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void PlaylistArchiveWriter::encodeString (const std::string& value, std::string& buffer)
+{
+    encodeInt(value.size(), 4, buffer);
+    buffer.append(value);
+}
+
+/**
+ * Map an archive file into memory and check its header
+ *
+ * @param filename Archive to read
+ */
+PlaylistArchiveReader::PlaylistArchiveReader (std::string filename)
+{
+    m_pdata = NULL;
+    m_size = 0;
+
+    m_fd = open(filename.c_str(), O_RDONLY);
+    if (m_fd < 0)
+    {
+        throw std::exception();
+    }
+
+    struct stat filestat;
+    if (fstat(m_fd, &filestat) < 0 || filestat.st_size < 8)
+    {
+        ::close(m_fd);
+        throw std::exception();
+    }
+
+    m_size = filestat.st_size;
+    void* pmap = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (MAP_FAILED == pmap)
+    {
+        ::close(m_fd);
+        throw std::exception();
+    }
+
+    m_pdata = static_cast<const uint8_t*>(pmap);
+    m_pos = m_pdata;
+
+    // Check the header matches something we can read
+    const uint8_t* end = m_pdata + m_size;
+    bool magicok = std::equal(g_archivemagic, g_archivemagic + 4, reinterpret_cast<const char*>(m_pos));
+    m_pos += 4;
+    uint64_t version = decodeInt(m_pos, end, 2);
+    decodeInt(m_pos, end, 2);
+
+    if (!magicok || version != PLAYLISTARCHIVE_VERSION)
+    {
+        munmap(const_cast<uint8_t*>(m_pdata), m_size);
+        ::close(m_fd);
+        throw std::exception();
+    }
+}
+
+PlaylistArchiveReader::~PlaylistArchiveReader ()
+{
+    munmap(const_cast<uint8_t*>(m_pdata), m_size);
+    ::close(m_fd);
+}
+
+/**
+ * Read the next top-level event tree from the archive
+ *
+ * @param event Populated with the next event
+ * @return      False at the end of the archive
+ */
+bool PlaylistArchiveReader::readEvent (ArchivedEvent& event)
+{
+    const uint8_t* end = m_pdata + m_size;
+
+    uint64_t length = decodeInt(m_pos, end, 4);
+    if (0 == length)
+    {
+        return false;
+    }
+
+    if (length > static_cast<uint64_t>(end - m_pos))
+    {
+        throw std::exception();
+    }
+
+    // Decode strictly within this record so one bad record cannot run into the next
+    const uint8_t* recordend = m_pos + length;
+    event.m_children.clear();
+    decodeEvent(m_pos, recordend, event, 0);
+
+    m_pos = recordend;
+    return true;
+}
+
+void PlaylistArchiveReader::decodeEvent (const uint8_t*& pos, const uint8_t* end, ArchivedEvent& event, int depth)
+{
+    if (depth > PLAYLISTARCHIVE_MAXDEPTH)
+    {
+        throw std::exception();
+    }
+
+    PlaylistEntry& entry = event.m_event;
+
+    entry.m_eventid = static_cast<int32_t>(decodeInt(pos, end, 4));
+    entry.m_eventtype = static_cast<playlist_event_type_t>(decodeInt(pos, end, 1));
+    entry.m_trigger = static_cast<int64_t>(decodeInt(pos, end, 8));
+    entry.m_device = decodeString(pos, end);
+    entry.m_devicetype = static_cast<playlist_device_type_t>(decodeInt(pos, end, 1));
+    entry.m_action = static_cast<int32_t>(decodeInt(pos, end, 4));
+    entry.m_duration = static_cast<int32_t>(decodeInt(pos, end, 4));
+    entry.m_preprocessor = decodeString(pos, end);
+    entry.m_description = decodeString(pos, end);
+
+    entry.m_extras.clear();
+    uint64_t extrascount = decodeInt(pos, end, 4);
+    for (uint64_t i = 0; i < extrascount; ++i)
+    {
+        std::string key = decodeString(pos, end);
+        entry.m_extras[key] = decodeString(pos, end);
+    }
+
+    uint64_t childcount = decodeInt(pos, end, 4);
+    for (uint64_t i = 0; i < childcount; ++i)
+    {
+        ArchivedEvent child;
+        decodeEvent(pos, end, child, depth + 1);
+        event.m_children.push_back(child);
+    }
+}
+
+uint64_t PlaylistArchiveReader::decodeInt (const uint8_t*& pos, const uint8_t* end, int bytes)
+{
+    if (end - pos < bytes)
+    {
+        throw std::exception();
+    }
+
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        value |= static_cast<uint64_t>(pos[i]) << (8 * i);
+    }
+    pos += bytes;
+
+    return value;
+}
+
+std::string PlaylistArchiveReader::decodeString (const uint8_t*& pos, const uint8_t* end)
+{
+    uint64_t length = decodeInt(pos, end, 4);
+    if (length > static_cast<uint64_t>(end - pos))
+    {
+        throw std::exception();
+    }
+
+    std::string value(reinterpret_cast<const char*>(pos), length);
+    pos += length;
+    return value;
+}
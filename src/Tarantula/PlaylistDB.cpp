@@ -23,7 +23,13 @@
 *****************************************************************************/
 
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
 #include "PlaylistDB.h"
+#include "PlaylistArchive.h"
 #include "TarantulaCore.h"
 #include "Log.h"
 #include "Misc.h"
@@ -39,6 +45,7 @@ PlaylistEntry::PlaylistEntry ()
     m_eventtype = EVENT_FIXED;
     m_trigger = 0;
     m_device.clear();
+    m_deviceid = -1;
     m_duration = 0;
     m_parent = 0;
     m_action = 0;
@@ -46,6 +53,44 @@ PlaylistEntry::PlaylistEntry ()
     m_extras.clear();
 }
 
+/**
+ * A recurring event rule with no occurrences yet
+ */
+RecurringEntry::RecurringEntry ()
+{
+    m_ruleid = -1;
+    m_until = 0;
+    m_expandeduntil = 0;
+    m_exceptions.clear();
+}
+
+/**
+ * Find the occurrences of this rule in a range of time, skipping exceptions
+ * and anything past the end date
+ *
+ * @param from   Occurrences must be strictly after this time
+ * @param to     Occurrences must be at or before this time
+ * @param result Vector to append occurrence times to, in order
+ */
+void RecurringEntry::getOccurrences (time_t from, time_t to, std::vector<time_t>& result) const
+{
+    if (m_until > 0 && to > m_until)
+    {
+        to = m_until;
+    }
+
+    std::vector<time_t> occurrences;
+    m_rule.getOccurrences(from, to, occurrences);
+
+    for (time_t occurrence : occurrences)
+    {
+        if (0 == m_exceptions.count(occurrence))
+        {
+            result.push_back(occurrence);
+        }
+    }
+}
+
 /**
  * Constructor.
  * Generates a database structure and prepares queries for other functions
@@ -54,9 +99,14 @@ PlaylistEntry::PlaylistEntry ()
 PlaylistDB::PlaylistDB (std::string channel_name) :
         SQLiteDB(g_pbaseconfig->getDatabasePath())
 {
+	m_channame = channel_name;
+
 	// Identify db table names
 	std::string evt = "\"" + channel_name + "_events\"";
 	std::string edt = "\"" + channel_name + "_extradata\"";
+	std::string rct = "\"" + channel_name + "_recurrence\"";
+	std::string rxt = "\"" + channel_name + "_recurrence_extradata\"";
+	std::string rit = "\"" + channel_name + "_recurrence_instances\"";
 
     // Do the initial database setup
     oneTimeExec("CREATE TABLE IF NOT EXISTS " + evt + " (id INTEGER PRIMARY KEY AUTOINCREMENT, type INT, trigger INT64, "
@@ -64,6 +114,11 @@ PlaylistDB::PlaylistDB (std::string channel_name) :
     		"callback TEXT, description TEXT)");
     oneTimeExec("CREATE TABLE IF NOT EXISTS " + edt + " (eventid INT, key TEXT, value TEXT, processed INT)");
     oneTimeExec("CREATE INDEX IF NOT EXISTS \"" + channel_name + "_trigger_index\" ON " + evt + " (trigger)");
+    oneTimeExec("CREATE TABLE IF NOT EXISTS " + rct + " (id INTEGER PRIMARY KEY AUTOINCREMENT, rule TEXT, type INT, "
+            "device TEXT, devicetype INT, action INT, duration INT, callback TEXT, description TEXT, "
+            "exceptions TEXT, until INT64, expandeduntil INT64)");
+    oneTimeExec("CREATE TABLE IF NOT EXISTS " + rxt + " (ruleid INT, key TEXT, value TEXT)");
+    oneTimeExec("CREATE TABLE IF NOT EXISTS " + rit + " (ruleid INT, eventid INT, trigger INT64)");
 
     // Queries used by other functions
     m_addevent_query = prepare("INSERT INTO " + evt + " (type, trigger, device, devicetype, action, duration, "
@@ -81,6 +136,20 @@ PlaylistDB::PlaylistDB (std::string channel_name) :
             "WHERE parent = ? AND processed = 0 "
             "ORDER BY trigger ASC");
 
+    // Removal has to take children still waiting on an EventProcessor too
+    m_getremovechildren_query = prepare("SELECT id, type, trigger, device, devicetype, action, duration, "
+            "parent, callback, description "
+            "FROM " + evt + " "
+            "WHERE parent = ? AND processed IN (0, 2) "
+            "ORDER BY trigger ASC");
+
+    // Archives keep children which have already played, as the top-level export does
+    m_getarchivechildren_query = prepare("SELECT id, type, trigger, device, devicetype, action, duration, "
+            "parent, callback, description "
+            "FROM " + evt + " "
+            "WHERE parent = ? AND processed >= 0 "
+            "ORDER BY trigger ASC");
+
     m_getparentevent_query = prepare("SELECT ev.id FROM " + evt + " AS ev "
             "LEFT JOIN " + evt + " as cev ON ev.id = cev.parent "
             "WHERE cev.id = ? AND ev.processed >= 0");
@@ -97,8 +166,18 @@ PlaylistDB::PlaylistDB (std::string channel_name) :
             "id = ? AND processed >= 0; "
             "UPDATE " + edt + " SET processed = 1 WHERE eventid = ?");
 
+    // Pending events (processed = 2) are waiting on an EventProcessor so must not run yet
+    m_setpending_query = prepare("UPDATE " + evt + " SET processed = ?, lastupdate = strftime('%s', 'now') WHERE "
+            "id = ? AND processed IN (0, 2)");
+
     m_addextras_query = prepare("INSERT INTO " + edt + " VALUES (?,?,?,0)");
 
+    m_updateevent_query = prepare("UPDATE " + evt + " SET type = ?, trigger = ?, device = ?, devicetype = ?, "
+            "action = ?, duration = ?, callback = ?, description = ?, lastupdate = strftime('%s', 'now') "
+            "WHERE id = ? AND processed >= 0");
+
+    m_removeextras_query = prepare("DELETE FROM " + edt + " WHERE eventid = ?");
+
     m_getextras_query = prepare("SELECT key,value FROM " + edt + " WHERE eventid = ?");
 
     m_gethold_query = prepare("SELECT id FROM " + evt + " WHERE trigger <= ? AND processed = 0 AND type = ? "
@@ -112,14 +191,6 @@ PlaylistDB::PlaylistDB (std::string channel_name) :
     		"WHERE trigger >= ? AND trigger < ? AND parent = 0 AND events.processed >= 0 "
     		"ORDER BY trigger ASC, events.id ASC");
 
-    m_getcurrent_toplevel_query = prepare ("SELECT events.id, events.type, events.trigger, events.device, "
-    		"events.devicetype, events.action, events.duration, events.parent,  "
-    		"events.callback, events.description "
-    		"FROM " + evt + " AS events "
-    		"WHERE parent = 0 AND processed > 0 "
-            "AND (trigger + duration) < strftime('%s', 'now') "
-            "ORDER BY trigger DESC, duration ASC");
-
     m_getnext_toplevel_query = prepare ("SELECT events.id, events.type, events.trigger, events.device, "
     		"events.devicetype, events.action, events.duration, events.parent,  "
     		"events.callback, events.description "
@@ -138,12 +209,59 @@ PlaylistDB::PlaylistDB (std::string channel_name) :
             "ON extradata.eventid = events.id WHERE events.processed >= 0 AND events.lastupdate > ?");
 
     // Queries used by Shunt command
-    m_shunt_eventcount_query = prepare("SELECT trigger, duration FROM " + evt + " "
-    		"WHERE parent = 0 AND processed >= 0 AND trigger >= ? AND trigger < ? "
-    		"ORDER BY trigger ASC, duration DESC LIMIT 1");
-
     m_shunt_eventupdate_query = prepare("UPDATE " + evt + " SET trigger = trigger + ?, lastupdate = strftime('%s', 'now') "
             "WHERE trigger >= ? AND trigger < ?");
+
+    // Queries used by recurring events
+    m_addrecurrence_query = prepare("INSERT INTO " + rct + " (rule, type, device, devicetype, action, duration, "
+            "callback, description, exceptions, until, expandeduntil) VALUES (?,?,?,?,?,?,?,?,?,?,?)");
+
+    m_updaterecurrence_query = prepare("UPDATE " + rct + " SET rule = ?, type = ?, device = ?, devicetype = ?, "
+            "action = ?, duration = ?, callback = ?, description = ?, exceptions = ?, until = ?, "
+            "expandeduntil = ? WHERE id = ?");
+
+    m_removerecurrence_query = prepare("DELETE FROM " + rct + " WHERE id = ?");
+
+    m_getrecurrences_query = prepare("SELECT id, rule, type, device, devicetype, action, duration, callback, "
+            "description, exceptions, until, expandeduntil FROM " + rct);
+
+    m_setrecurrenceexpanded_query = prepare("UPDATE " + rct + " SET expandeduntil = ? WHERE id = ?");
+
+    m_addrecurrenceextras_query = prepare("INSERT INTO " + rxt + " VALUES (?,?,?)");
+
+    m_getrecurrenceextras_query = prepare("SELECT key, value FROM " + rxt + " WHERE ruleid = ?");
+
+    m_removerecurrenceextras_query = prepare("DELETE FROM " + rxt + " WHERE ruleid = ?");
+
+    m_addrecurrenceinstance_query = prepare("INSERT INTO " + rit + " VALUES (?,?,?)");
+
+    m_getrecurrenceinstances_query = prepare("SELECT eventid FROM " + rit + " "
+            "WHERE ruleid = ? AND trigger >= ? AND trigger < ?");
+
+    m_removerecurrenceinstances_query = prepare("DELETE FROM " + rit + " "
+            "WHERE ruleid = ? AND trigger >= ? AND trigger < ?");
+
+    // Processors which were still running when we last stopped will never finish
+    oneTimeExec("UPDATE " + evt + " SET processed = -1 WHERE processed = 2");
+
+    // Query used to rebuild the timeline
+    m_gettimeline_query = prepare("SELECT id, trigger, duration FROM " + evt + " "
+            "WHERE parent = 0 AND processed >= 0");
+
+    // Load existing top-level events into the timeline, skipping anything already finished
+    m_gettimeline_query->rmParams();
+    m_gettimeline_query->bindParams();
+    sqlite3_stmt *stmt = m_gettimeline_query->getStmt();
+    time_t now = time(NULL);
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        time_t trigger = sqlite3_column_int(stmt, 1);
+        time_t endtime = getEndTime(trigger, sqlite3_column_int(stmt, 2));
+        if (endtime > now)
+        {
+            m_timeline.insert(sqlite3_column_int(stmt, 0), trigger, endtime);
+        }
+    }
 }
 
 /**
@@ -172,9 +290,14 @@ int PlaylistDB::addEvent (PlaylistEntry *pobj)
     if (result == SQLITE_DONE)
     {
         eventid = getLastRowID();
+
+        if (0 == pobj->m_parent)
+        {
+            m_timeline.insert(eventid, pobj->m_trigger, getEndTime(pobj->m_trigger, pobj->m_duration));
+        }
+
         //Now store all the extradata stuff
-        for (std::map<std::string, std::string>::iterator it =
-                pobj->m_extras.begin(); it != pobj->m_extras.end(); it++)
+        for (ExtraData::iterator it = pobj->m_extras.begin(); it != pobj->m_extras.end(); it++)
         {
             m_addextras_query->rmParams();
             m_addextras_query->addParam(1, DBParam(eventid));
@@ -188,6 +311,61 @@ int PlaylistDB::addEvent (PlaylistEntry *pobj)
     return eventid;
 }
 
+/**
+ * Overwrite an existing event in place, keeping its ID and parent.
+ *
+ * @param pobj Event with m_eventid set to the event to change
+ * @return     False if the event does not exist or has been removed
+ */
+bool PlaylistDB::updateEvent (PlaylistEntry *pobj)
+{
+    PlaylistEntry existing;
+    if (!getEventDetails(pobj->m_eventid, existing))
+    {
+        return false;
+    }
+
+    m_updateevent_query->rmParams();
+    m_updateevent_query->addParam(1, DBParam(pobj->m_eventtype));
+    m_updateevent_query->addParam(2, DBParam(pobj->m_trigger));
+    m_updateevent_query->addParam(3, DBParam(pobj->m_device));
+    m_updateevent_query->addParam(4, DBParam(pobj->m_devicetype));
+    m_updateevent_query->addParam(5, DBParam(pobj->m_action));
+    m_updateevent_query->addParam(6, DBParam(pobj->m_duration));
+    m_updateevent_query->addParam(7, DBParam(pobj->m_preprocessor));
+    m_updateevent_query->addParam(8, DBParam(pobj->m_description));
+    m_updateevent_query->addParam(9, DBParam(pobj->m_eventid));
+    m_updateevent_query->bindParams();
+
+    if (SQLITE_DONE != sqlite3_step(m_updateevent_query->getStmt()))
+    {
+        return false;
+    }
+
+    m_removeextras_query->rmParams();
+    m_removeextras_query->addParam(1, DBParam(pobj->m_eventid));
+    m_removeextras_query->bindParams();
+    sqlite3_step(m_removeextras_query->getStmt());
+
+    for (ExtraData::value_type& extra : pobj->m_extras)
+    {
+        m_addextras_query->rmParams();
+        m_addextras_query->addParam(1, DBParam(pobj->m_eventid));
+        m_addextras_query->addParam(2, DBParam(extra.first));
+        m_addextras_query->addParam(3, DBParam(extra.second));
+        m_addextras_query->bindParams();
+        sqlite3_step(m_addextras_query->getStmt());
+    }
+
+    if (0 == existing.m_parent)
+    {
+        m_timeline.remove(pobj->m_eventid);
+        m_timeline.insert(pobj->m_eventid, pobj->m_trigger, getEndTime(pobj->m_trigger, pobj->m_duration));
+    }
+
+    return true;
+}
+
 /**
  * Extract event data from a SELECT * FROM events type query.
  *
@@ -202,6 +380,7 @@ void PlaylistDB::populateEvent (sqlite3_stmt *pstmt, PlaylistEntry *pple)
     pple->m_trigger = sqlite3_column_int(pstmt, 2);
     pple->m_device =
             std::string(reinterpret_cast<const char*>(sqlite3_column_text (pstmt, 3)));
+    pple->m_deviceid = g_deviceids.find(pple->m_device);
     pple->m_devicetype = static_cast<playlist_device_type_t>(sqlite3_column_int(
             pstmt, 4));
     pple->m_action = sqlite3_column_int(pstmt, 5);
@@ -279,17 +458,94 @@ std::vector<PlaylistEntry> PlaylistDB::getEventList (time_t starttime,
     m_geteventlist_query->addParam(2, DBParam(endtime));
     m_geteventlist_query->bindParams();
 
-    sqlite3_stmt *stmt = m_geteventlist_query->getStmt();
-    while (sqlite3_step(stmt) == SQLITE_ROW)
+    readEventRows(m_geteventlist_query->getStmt(), eventlist);
+
+    return eventlist;
+}
+
+/**
+ * Gets all top-level events in a time range along with all of their descendants.
+ * Each level of the tree is fetched in one go rather than one query per event.
+ *
+ * @param starttime Start of the time period to fetch events for
+ * @param length    Length of the time period to fetch events for
+ * @return          Top-level events, followed by their descendants a level at a time
+ */
+std::vector<PlaylistEntry> PlaylistDB::getEventForest (time_t starttime, int length)
+{
+    std::vector<PlaylistEntry> eventlist = getEventList(starttime, length);
+    getDescendants(eventlist);
+    return eventlist;
+}
+
+/**
+ * Append the unprocessed and pending descendants of some events, with extradata, fetching a
+ * whole level of the tree per query.
+ *
+ * @param events Events to find descendants of. Descendants are appended in
+ *               level order, sorted by trigger time within each level.
+ */
+void PlaylistDB::getDescendants (std::vector<PlaylistEntry>& events)
+{
+    // Keep IN lists well inside SQLite statement length limits
+    const size_t batchsize = 500;
+
+    size_t levelstart = 0;
+    size_t levelend = events.size();
+
+    while (levelstart < levelend)
     {
-    	// Extract extradata row
-    	const char* key = reinterpret_cast<const char*>(sqlite3_column_text (stmt, 10));
-    	const char* value = reinterpret_cast<const char*>(sqlite3_column_text (stmt, 11));
+        for (size_t batchstart = levelstart; batchstart < levelend; batchstart += batchsize)
+        {
+            std::string idlist;
+            for (size_t i = batchstart; i < std::min(batchstart + batchsize, levelend); ++i)
+            {
+                if (!idlist.empty())
+                {
+                    idlist += ",";
+                }
+                idlist += ConvertType::intToString(events[i].m_eventid);
+            }
+
+            // IDs are integers from the database, so building the list directly is safe
+            std::shared_ptr<DBQuery> childquery = prepare("SELECT events.id, events.type, events.trigger, "
+                    "events.device, events.devicetype, events.action, events.duration, events.parent, "
+                    "events.callback, events.description, extradata.key, extradata.value "
+                    "FROM \"" + m_channame + "_events\" AS events "
+                    "LEFT JOIN \"" + m_channame + "_extradata\" AS extradata "
+                    "ON extradata.eventid = events.id "
+                    "WHERE events.parent IN (" + idlist + ") AND events.processed IN (0, 2) "
+                    "ORDER BY events.trigger ASC, events.id ASC");
+
+            childquery->bindParams();
+            readEventRows(childquery->getStmt(), events);
+        }
 
+        levelstart = levelend;
+        levelend = events.size();
+    }
+}
+
+/**
+ * Read events from a query joining events to extradata, merging the extradata
+ * rows for each event. Rows for the same event must be adjacent.
+ *
+ * @param pstmt     Statement returning the event columns then key and value
+ * @param eventlist Vector to append events to
+ */
+void PlaylistDB::readEventRows (sqlite3_stmt *pstmt, std::vector<PlaylistEntry>& eventlist)
+{
+    size_t firstnew = eventlist.size();
+
+    while (sqlite3_step(pstmt) == SQLITE_ROW)
+    {
+    	// Extract extradata row
+    	const char* key = reinterpret_cast<const char*>(sqlite3_column_text (pstmt, 10));
+    	const char* value = reinterpret_cast<const char*>(sqlite3_column_text (pstmt, 11));
 
     	// Append to the last entry if ids match
-    	if (eventlist.size() > 0 &&
-    			sqlite3_column_int(stmt, 0) == eventlist.back().m_eventid)
+    	if (eventlist.size() > firstnew &&
+    			sqlite3_column_int(pstmt, 0) == eventlist.back().m_eventid)
     	{
     		if (key && value)
     		{
@@ -298,23 +554,15 @@ std::vector<PlaylistEntry> PlaylistDB::getEventList (time_t starttime,
     	}
     	else
     	{
-
-			PlaylistEntry ple;
-			populateEvent(stmt, &ple);
+			eventlist.emplace_back();
+			populateEvent(pstmt, &eventlist.back());
 
 			if (key && value)
 			{
-				ple.m_extras[key] = value;
+				eventlist.back().m_extras[key] = value;
 			}
-
-			eventlist.push_back(ple);
     	}
     }
-
-    // Now go and get the extradata array
-
-
-    return eventlist;
 }
 
 /**
@@ -324,12 +572,24 @@ std::vector<PlaylistEntry> PlaylistDB::getEventList (time_t starttime,
  * @return         The events with this parent
  */
 std::vector<PlaylistEntry> PlaylistDB::getChildEvents (int parentid)
+{
+    return readChildEvents(m_getchildevents_query, parentid);
+}
+
+/**
+ * Run one of the child event queries, filling in extradata for each child
+ *
+ * @param query    Query taking the parent ID as its only parameter
+ * @param parentid The parent event to search for children of
+ * @return         The events with this parent
+ */
+std::vector<PlaylistEntry> PlaylistDB::readChildEvents (std::shared_ptr<DBQuery> query, int parentid)
 {
     std::vector<PlaylistEntry> eventlist;
-    m_getchildevents_query->rmParams();
-    m_getchildevents_query->addParam(1, DBParam(parentid));
-    m_getchildevents_query->bindParams();
-    sqlite3_stmt *stmt = m_getchildevents_query->getStmt();
+    query->rmParams();
+    query->addParam(1, DBParam(parentid));
+    query->bindParams();
+    sqlite3_stmt *stmt = query->getStmt();
     while (sqlite3_step(stmt) == SQLITE_ROW)
     {
         PlaylistEntry ple;
@@ -405,6 +665,22 @@ void PlaylistDB::processEvent (int eventID)
     sqlite3_step(m_processevent_query->getStmt());
 }
 
+/**
+ * Hold an event back from running while an EventProcessor generates its contents.
+ * Pending events still show in event lists and on the timeline.
+ *
+ * @param eventID The ID of the event to mark
+ * @param pending True to hold the event back, false to let it run again
+ */
+void PlaylistDB::setEventPending (int eventID, bool pending)
+{
+    m_setpending_query->rmParams();
+    m_setpending_query->addParam(1, DBParam(pending ? 2 : 0));
+    m_setpending_query->addParam(2, DBParam(eventID));
+    m_setpending_query->bindParams();
+    sqlite3_step(m_setpending_query->getStmt());
+}
+
 /**
  * Removes event with the specified ID from the database, along with children (recursive)
  *
@@ -412,8 +688,8 @@ void PlaylistDB::processEvent (int eventID)
  */
 void PlaylistDB::removeEvent (int eventID)
 {
-    //Remove children recursively
-    std::vector<PlaylistEntry> children = getChildEvents(eventID);
+    //Remove children recursively, including any still waiting on an EventProcessor
+    std::vector<PlaylistEntry> children = readChildEvents(m_getremovechildren_query, eventID);
     for (PlaylistEntry child : children)
     {
         removeEvent(child.m_eventid);
@@ -424,6 +700,8 @@ void PlaylistDB::removeEvent (int eventID)
     m_removeevent_query->addParam(2, eventID);
     m_removeevent_query->bindParams();
     sqlite3_step(m_removeevent_query->getStmt());
+
+    m_timeline.remove(eventID);
 }
 
 /**
@@ -465,31 +743,30 @@ void PlaylistDB::shunt(time_t starttime, int shuntlength)
         searchdelay = shuntlength;
     }
 
-    // Increase to catch not-quite overlapping events
-    int fudgefactor = 5;
-
-    time_t startmark = starttime;
-    time_t endmark = starttime + searchdelay + fudgefactor;
+    time_t endmark = starttime + searchdelay;
 
-    // Find the edges of the time boundary to shunt
-    while (1)
+    // Find the edge of the block of connected events, walking forward from the start time.
+    // Anything starting before the current edge would be overlapped by the shunt so joins the block.
+    std::vector<TimelineInterval> following;
+    m_timeline.findOverlapping(starttime, std::numeric_limits<time_t>::max(), following);
+    for (const TimelineInterval& interval : following)
     {
-        m_shunt_eventcount_query->rmParams();
-        m_shunt_eventcount_query->addParam(1, DBParam(startmark));
-        m_shunt_eventcount_query->addParam(2, DBParam(endmark));
-        m_shunt_eventcount_query->bindParams();
+        if (interval.m_start < starttime)
+        {
+            continue;
+        }
 
-        sqlite3_stmt *stmt = m_shunt_eventcount_query->getStmt();
-        if (sqlite3_step(stmt) != SQLITE_ROW)
+        if (interval.m_start > endmark)
         {
             break;
         }
 
-        startmark = sqlite3_column_int(stmt, 0) + 1;
-        int newdelay = sqlite3_column_int(stmt, 1);
-        endmark = startmark + newdelay + searchdelay + fudgefactor;
+        endmark = std::max(endmark, interval.m_end + searchdelay);
     }
 
+    // Events are inclusive of the boundary
+    endmark += 1;
+
     // Apply the shunt
     m_shunt_eventupdate_query->rmParams();
     m_shunt_eventupdate_query->addParam(1, DBParam(shuntlength));
@@ -498,6 +775,72 @@ void PlaylistDB::shunt(time_t starttime, int shuntlength)
     m_shunt_eventupdate_query->bindParams();
     sqlite3_step(m_shunt_eventupdate_query->getStmt());
 
+    m_timeline.shift(starttime, endmark, shuntlength);
+}
+
+/**
+ * Make room for a top-level event according to a channel's overlap policy.
+ * Clashes are logged, and with OVERLAP_SHUNT later events are pushed back out of the way.
+ *
+ * @param start    Time the event is triggered
+ * @param end      Time the event finishes
+ * @param policy   What to do about events already in the way
+ * @param ignoreid Event ID to disregard, for an event being changed in place
+ * @return         False if the policy rejects the event
+ */
+bool PlaylistDB::applyOverlapPolicy (time_t start, time_t end, timeline_overlap_policy_t policy, int ignoreid)
+{
+    std::vector<TimelineInterval> clashes;
+    m_timeline.findOverlapping(start, end, clashes, ignoreid);
+
+    if (clashes.empty())
+    {
+        return true;
+    }
+
+    std::string clashtext = "New event at " + ConvertType::intToString(start) +
+            " overlaps " + ConvertType::intToString(clashes.size()) + " event(s), first is ID " +
+            ConvertType::intToString(clashes.front().m_eventid);
+
+    switch (policy)
+    {
+        case OVERLAP_WARN:
+        {
+            g_logger.warn("Channel " + m_channame, clashtext);
+            break;
+        }
+        case OVERLAP_REJECT:
+        {
+            g_logger.warn("Channel " + m_channame, clashtext + ", rejecting");
+            return false;
+        }
+        case OVERLAP_SHUNT:
+        {
+            // Only events starting after this one can be moved out of the way
+            time_t firststart = end;
+            for (const TimelineInterval& clash : clashes)
+            {
+                if (clash.m_start < start)
+                {
+                    g_logger.warn("Channel " + m_channame, clashtext + ", cannot shunt earlier event " +
+                            ConvertType::intToString(clash.m_eventid));
+                }
+                else
+                {
+                    firststart = std::min(firststart, clash.m_start);
+                }
+            }
+
+            if (firststart < end)
+            {
+                g_logger.info("Channel " + m_channame, clashtext + ", shunting");
+                shunt(firststart, end - firststart);
+            }
+            break;
+        }
+    }
+
+    return true;
 }
 
 /**
@@ -507,18 +850,16 @@ std::vector<PlaylistEntry> PlaylistDB::getExecutingEvents()
 {
 	std::vector<PlaylistEntry> eventlist;
 
-	m_getcurrent_toplevel_query->rmParams();
-	m_getcurrent_toplevel_query->bindParams();
+	std::vector<TimelineInterval> onair;
+	m_timeline.findAt(time(NULL), onair);
 
-	sqlite3_stmt* stmt = m_getcurrent_toplevel_query->getStmt();
-	while (SQLITE_ROW == sqlite3_step(stmt))
+	for (const TimelineInterval& interval : onair)
 	{
 		PlaylistEntry ple;
-		populateEvent(stmt, &ple);
-
-		getExtraData(&ple);
-
-		eventlist.push_back(ple);
+		if (getEventDetails(interval.m_eventid, ple))
+		{
+			eventlist.push_back(ple);
+		}
 	}
 
 	return eventlist;
@@ -548,3 +889,484 @@ PlaylistEntry PlaylistDB::getNextEvent()
 		throw std::exception();
 	}
 }
+
+/**
+ * Get the in-memory timeline of top-level events on this channel
+ */
+const EventTimeline& PlaylistDB::getTimeline ()
+{
+    return m_timeline;
+}
+
+/**
+ * Drop events which have finished from the timeline to keep it small
+ *
+ * @param cutoff Events ending at or before this time are dropped
+ */
+void PlaylistDB::pruneTimeline (time_t cutoff)
+{
+    m_timeline.pruneBefore(cutoff);
+}
+
+/**
+ * Work out when an event finishes, rounding part-seconds up so adjacent events do not overlap
+ *
+ * @param trigger  Event start time
+ * @param duration Event duration in frames
+ * @return         Time the event ends
+ */
+time_t PlaylistDB::getEndTime (time_t trigger, int duration)
+{
+    return trigger + static_cast<time_t>(std::ceil(duration / g_pbaseconfig->getFramerate()));
+}
+
+/**
+ * Save all top-level events in a time range, with their children and extradata, to a binary archive
+ *
+ * @param file      File to write the archive to
+ * @param starttime Start of the range to save
+ * @param length    Length of the range in seconds
+ * @return          Number of top-level events saved, or -1 if the file could not be written
+ */
+int PlaylistDB::exportRange (std::string file, time_t starttime, int length)
+{
+    std::vector<PlaylistEntry> events = getEventList(starttime, length);
+
+    try
+    {
+        PlaylistArchiveWriter writer(file);
+
+        // Write each tree as it is built so only one is held in memory at a time
+        for (PlaylistEntry& entry : events)
+        {
+            ArchivedEvent event;
+            event.m_event = entry;
+            archiveChildren(event);
+            writer.writeEvent(event);
+        }
+
+        writer.close();
+    }
+    catch (std::exception&)
+    {
+        g_logger.warn("PlaylistDB", "Unable to export playlist for " + m_channame + " to " + file);
+        return -1;
+    }
+
+    return events.size();
+}
+
+/**
+ * Load events from a binary archive created by exportRange. Events are given new IDs.
+ * Nothing is added unless the whole archive reads back, so a truncated or corrupt
+ * file cannot leave part of a schedule in the playlist.
+ *
+ * @param file       Archive to read
+ * @param timeoffset Seconds to move every timed event by, for example to reuse last week's schedule
+ * @return           Number of top-level events added, or -1 if the archive could not be read
+ */
+int PlaylistDB::importRange (std::string file, int timeoffset)
+{
+    std::vector<int> added;
+
+    // A single transaction saves SQLite syncing to disk after every row, and can be undone on failure
+    oneTimeExec("BEGIN TRANSACTION");
+
+    try
+    {
+        PlaylistArchiveReader reader(file);
+
+        ArchivedEvent event;
+        while (reader.readEvent(event))
+        {
+            int eventid = importArchivedEvent(event, 0, timeoffset);
+            if (eventid >= 0)
+            {
+                added.push_back(eventid);
+            }
+        }
+    }
+    catch (std::exception&)
+    {
+        oneTimeExec("ROLLBACK");
+
+        // The timeline is not part of the transaction, so take the new events back out by hand
+        for (int eventid : added)
+        {
+            m_timeline.remove(eventid);
+        }
+
+        g_logger.warn("PlaylistDB", "Unable to read playlist archive " + file + ", nothing imported");
+        return -1;
+    }
+
+    oneTimeExec("COMMIT");
+
+    return added.size();
+}
+
+/**
+ * Fill in the children of an archived event from the database, recursively,
+ * including any which have already played
+ *
+ * @param event Event with m_event already populated
+ */
+void PlaylistDB::archiveChildren (ArchivedEvent& event)
+{
+    std::vector<PlaylistEntry> children = readChildEvents(m_getarchivechildren_query, event.m_event.m_eventid);
+
+    for (PlaylistEntry& child : children)
+    {
+        ArchivedEvent archivedchild;
+        archivedchild.m_event = child;
+        archiveChildren(archivedchild);
+        event.m_children.push_back(archivedchild);
+    }
+}
+
+/**
+ * Add an archived event and all of its children to the database
+ *
+ * @param event      Event to add
+ * @param parent     ID of the new parent event, or 0 for a top-level event
+ * @param timeoffset Seconds to move timed events by
+ * @return           ID of the new event, or -1 if it could not be added
+ */
+int PlaylistDB::importArchivedEvent (ArchivedEvent& event, int parent, int timeoffset)
+{
+    PlaylistEntry& entry = event.m_event;
+
+    // Manual events trigger from something other than a time, so leave those alone
+    if (EVENT_MANUAL != entry.m_eventtype)
+    {
+        entry.m_trigger += timeoffset;
+    }
+    entry.m_parent = parent;
+
+    int eventid = addEvent(&entry);
+    if (eventid < 0)
+    {
+        return -1;
+    }
+
+    for (ArchivedEvent& child : event.m_children)
+    {
+        importArchivedEvent(child, eventid, timeoffset);
+    }
+
+    return eventid;
+}
+
+/**
+ * Store a new recurring event rule. Occurrences are added later by the channel.
+ *
+ * @param rule Rule to store. m_ruleid is set to the new ID.
+ * @return     ID of the new rule, or -1 on failure
+ */
+int PlaylistDB::addRecurrence (RecurringEntry& rule)
+{
+    std::stringstream exceptions;
+    for (time_t exception : rule.m_exceptions)
+    {
+        exceptions << exception << ",";
+    }
+
+    m_addrecurrence_query->rmParams();
+    m_addrecurrence_query->addParam(1, DBParam(rule.m_rule.getSpec()));
+    m_addrecurrence_query->addParam(2, DBParam(rule.m_template.m_eventtype));
+    m_addrecurrence_query->addParam(3, DBParam(rule.m_template.m_device));
+    m_addrecurrence_query->addParam(4, DBParam(rule.m_template.m_devicetype));
+    m_addrecurrence_query->addParam(5, DBParam(rule.m_template.m_action));
+    m_addrecurrence_query->addParam(6, DBParam(rule.m_template.m_duration));
+    m_addrecurrence_query->addParam(7, DBParam(rule.m_template.m_preprocessor));
+    m_addrecurrence_query->addParam(8, DBParam(rule.m_template.m_description));
+    m_addrecurrence_query->addParam(9, DBParam(exceptions.str()));
+    m_addrecurrence_query->addParam(10, DBParam(rule.m_until));
+    m_addrecurrence_query->addParam(11, DBParam(rule.m_expandeduntil));
+    m_addrecurrence_query->bindParams();
+
+    if (SQLITE_DONE != sqlite3_step(m_addrecurrence_query->getStmt()))
+    {
+        return -1;
+    }
+
+    rule.m_ruleid = getLastRowID();
+    writeRecurrenceExtras(rule);
+
+    return rule.m_ruleid;
+}
+
+/**
+ * Replace an existing recurring event rule. Future occurrences already in the
+ * playlist are removed so the channel regenerates them from the new rule.
+ *
+ * @param rule Rule to update, matched on m_ruleid
+ * @return     False if the update failed
+ */
+bool PlaylistDB::updateRecurrence (RecurringEntry& rule)
+{
+    time_t now = time(NULL);
+    removeRecurrenceInstances(rule.m_ruleid, now, std::numeric_limits<time_t>::max());
+    rule.m_expandeduntil = now;
+
+    if (!storeRecurrence(rule))
+    {
+        return false;
+    }
+
+    writeRecurrenceExtras(rule);
+    return true;
+}
+
+/**
+ * Delete a recurring event rule and any of its occurrences yet to run
+ *
+ * @param ruleid ID of the rule to remove
+ */
+void PlaylistDB::removeRecurrence (int ruleid)
+{
+    removeRecurrenceInstances(ruleid, time(NULL), std::numeric_limits<time_t>::max());
+
+    m_removerecurrenceextras_query->rmParams();
+    m_removerecurrenceextras_query->addParam(1, DBParam(ruleid));
+    m_removerecurrenceextras_query->bindParams();
+    sqlite3_step(m_removerecurrenceextras_query->getStmt());
+
+    m_removerecurrence_query->rmParams();
+    m_removerecurrence_query->addParam(1, DBParam(ruleid));
+    m_removerecurrence_query->bindParams();
+    sqlite3_step(m_removerecurrence_query->getStmt());
+
+    // Forget older instances too, they have played out already
+    m_removerecurrenceinstances_query->rmParams();
+    m_removerecurrenceinstances_query->addParam(1, DBParam(ruleid));
+    m_removerecurrenceinstances_query->addParam(2, DBParam(std::numeric_limits<time_t>::min()));
+    m_removerecurrenceinstances_query->addParam(3, DBParam(std::numeric_limits<time_t>::max()));
+    m_removerecurrenceinstances_query->bindParams();
+    sqlite3_step(m_removerecurrenceinstances_query->getStmt());
+}
+
+/**
+ * Skip a single occurrence of a recurring event, removing it from the playlist
+ * if it has already been added
+ *
+ * @param ruleid     ID of the rule to change
+ * @param occurrence Trigger time of the occurrence to skip
+ * @return           False if the rule was not found
+ */
+bool PlaylistDB::addRecurrenceException (int ruleid, time_t occurrence)
+{
+    std::vector<RecurringEntry> rules = getRecurrences();
+    for (RecurringEntry& rule : rules)
+    {
+        if (rule.m_ruleid != ruleid)
+        {
+            continue;
+        }
+
+        rule.m_exceptions.insert(occurrence);
+        storeRecurrence(rule);
+
+        // Take out the occurrence if it is already in the playlist
+        removeRecurrenceInstances(ruleid, occurrence, occurrence + 1);
+
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Get every recurring event rule on this channel
+ *
+ * @return Stored rules with their templates populated
+ */
+std::vector<RecurringEntry> PlaylistDB::getRecurrences ()
+{
+    std::vector<RecurringEntry> rules;
+
+    m_getrecurrences_query->rmParams();
+    m_getrecurrences_query->bindParams();
+
+    sqlite3_stmt *stmt = m_getrecurrences_query->getStmt();
+    while (SQLITE_ROW == sqlite3_step(stmt))
+    {
+        RecurringEntry rule;
+        rule.m_ruleid = sqlite3_column_int(stmt, 0);
+
+        std::string spec = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        try
+        {
+            rule.m_rule = RecurrenceRule(spec);
+        }
+        catch (std::exception&)
+        {
+            g_logger.warn("PlaylistDB" + ERROR_LOC, "Ignoring recurring event " +
+                    ConvertType::intToString(rule.m_ruleid) + " with bad rule " + spec);
+            continue;
+        }
+
+        rule.m_template.m_eventtype = static_cast<playlist_event_type_t>(sqlite3_column_int(stmt, 2));
+        rule.m_template.m_device = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+        rule.m_template.m_deviceid = g_deviceids.find(rule.m_template.m_device);
+        rule.m_template.m_devicetype = static_cast<playlist_device_type_t>(sqlite3_column_int(stmt, 4));
+        rule.m_template.m_action = sqlite3_column_int(stmt, 5);
+        rule.m_template.m_duration = sqlite3_column_int(stmt, 6);
+        rule.m_template.m_preprocessor = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+        rule.m_template.m_description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
+
+        std::stringstream exceptions(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 9)));
+        std::string exception;
+        while (std::getline(exceptions, exception, ','))
+        {
+            if (!exception.empty())
+            {
+                rule.m_exceptions.insert(std::stoll(exception));
+            }
+        }
+
+        rule.m_until = sqlite3_column_int64(stmt, 10);
+        rule.m_expandeduntil = sqlite3_column_int64(stmt, 11);
+
+        rules.push_back(rule);
+    }
+
+    // Extra data goes in afterwards as it uses a separate statement
+    for (RecurringEntry& rule : rules)
+    {
+        m_getrecurrenceextras_query->rmParams();
+        m_getrecurrenceextras_query->addParam(1, DBParam(rule.m_ruleid));
+        m_getrecurrenceextras_query->bindParams();
+
+        sqlite3_stmt *extrastmt = m_getrecurrenceextras_query->getStmt();
+        while (SQLITE_ROW == sqlite3_step(extrastmt))
+        {
+            rule.m_template.m_extras[reinterpret_cast<const char*>(sqlite3_column_text(extrastmt, 0))] =
+                    reinterpret_cast<const char*>(sqlite3_column_text(extrastmt, 1));
+        }
+    }
+
+    return rules;
+}
+
+/**
+ * Record that an event was created from a recurring rule, so it can be found again if the rule changes
+ *
+ * @param ruleid  ID of the rule the event came from
+ * @param eventid ID of the top-level event created
+ * @param trigger Trigger time of the created event
+ */
+void PlaylistDB::addRecurrenceInstance (int ruleid, int eventid, time_t trigger)
+{
+    m_addrecurrenceinstance_query->rmParams();
+    m_addrecurrenceinstance_query->addParam(1, DBParam(ruleid));
+    m_addrecurrenceinstance_query->addParam(2, DBParam(eventid));
+    m_addrecurrenceinstance_query->addParam(3, DBParam(trigger));
+    m_addrecurrenceinstance_query->bindParams();
+    sqlite3_step(m_addrecurrenceinstance_query->getStmt());
+}
+
+/**
+ * Mark how far ahead a recurring rule has been added to the playlist
+ *
+ * @param ruleid        ID of the rule
+ * @param expandeduntil Time up to which occurrences have been added
+ */
+void PlaylistDB::setRecurrenceExpanded (int ruleid, time_t expandeduntil)
+{
+    m_setrecurrenceexpanded_query->rmParams();
+    m_setrecurrenceexpanded_query->addParam(1, DBParam(expandeduntil));
+    m_setrecurrenceexpanded_query->addParam(2, DBParam(ruleid));
+    m_setrecurrenceexpanded_query->bindParams();
+    sqlite3_step(m_setrecurrenceexpanded_query->getStmt());
+}
+
+/**
+ * Remove the playlist events created by a recurring rule in a range of time
+ *
+ * @param ruleid ID of the rule
+ * @param from   Leave alone events triggered before this time
+ * @param to     Leave alone events triggered at or after this time
+ */
+void PlaylistDB::removeRecurrenceInstances (int ruleid, time_t from, time_t to)
+{
+    m_getrecurrenceinstances_query->rmParams();
+    m_getrecurrenceinstances_query->addParam(1, DBParam(ruleid));
+    m_getrecurrenceinstances_query->addParam(2, DBParam(from));
+    m_getrecurrenceinstances_query->addParam(3, DBParam(to));
+    m_getrecurrenceinstances_query->bindParams();
+
+    std::vector<int> instances;
+    sqlite3_stmt *stmt = m_getrecurrenceinstances_query->getStmt();
+    while (SQLITE_ROW == sqlite3_step(stmt))
+    {
+        instances.push_back(sqlite3_column_int(stmt, 0));
+    }
+
+    for (int eventid : instances)
+    {
+        removeEvent(eventid);
+    }
+
+    m_removerecurrenceinstances_query->rmParams();
+    m_removerecurrenceinstances_query->addParam(1, DBParam(ruleid));
+    m_removerecurrenceinstances_query->addParam(2, DBParam(from));
+    m_removerecurrenceinstances_query->addParam(3, DBParam(to));
+    m_removerecurrenceinstances_query->bindParams();
+    sqlite3_step(m_removerecurrenceinstances_query->getStmt());
+}
+
+/**
+ * Write the main fields of an existing recurring rule back to the database
+ *
+ * @param rule Rule to write, matched on m_ruleid
+ * @return     False if the update failed
+ */
+bool PlaylistDB::storeRecurrence (RecurringEntry& rule)
+{
+    std::stringstream exceptions;
+    for (time_t exception : rule.m_exceptions)
+    {
+        exceptions << exception << ",";
+    }
+
+    m_updaterecurrence_query->rmParams();
+    m_updaterecurrence_query->addParam(1, DBParam(rule.m_rule.getSpec()));
+    m_updaterecurrence_query->addParam(2, DBParam(rule.m_template.m_eventtype));
+    m_updaterecurrence_query->addParam(3, DBParam(rule.m_template.m_device));
+    m_updaterecurrence_query->addParam(4, DBParam(rule.m_template.m_devicetype));
+    m_updaterecurrence_query->addParam(5, DBParam(rule.m_template.m_action));
+    m_updaterecurrence_query->addParam(6, DBParam(rule.m_template.m_duration));
+    m_updaterecurrence_query->addParam(7, DBParam(rule.m_template.m_preprocessor));
+    m_updaterecurrence_query->addParam(8, DBParam(rule.m_template.m_description));
+    m_updaterecurrence_query->addParam(9, DBParam(exceptions.str()));
+    m_updaterecurrence_query->addParam(10, DBParam(rule.m_until));
+    m_updaterecurrence_query->addParam(11, DBParam(rule.m_expandeduntil));
+    m_updaterecurrence_query->addParam(12, DBParam(rule.m_ruleid));
+    m_updaterecurrence_query->bindParams();
+
+    return SQLITE_DONE == sqlite3_step(m_updaterecurrence_query->getStmt());
+}
+
+/**
+ * Replace the stored template extra data for a recurring rule
+ *
+ * @param rule Rule whose template extras should be written
+ */
+void PlaylistDB::writeRecurrenceExtras (RecurringEntry& rule)
+{
+    m_removerecurrenceextras_query->rmParams();
+    m_removerecurrenceextras_query->addParam(1, DBParam(rule.m_ruleid));
+    m_removerecurrenceextras_query->bindParams();
+    sqlite3_step(m_removerecurrenceextras_query->getStmt());
+
+    for (ExtraData::value_type& extra : rule.m_template.m_extras)
+    {
+        m_addrecurrenceextras_query->rmParams();
+        m_addrecurrenceextras_query->addParam(1, DBParam(rule.m_ruleid));
+        m_addrecurrenceextras_query->addParam(2, DBParam(extra.first));
+        m_addrecurrenceextras_query->addParam(3, DBParam(extra.second));
+        m_addrecurrenceextras_query->bindParams();
+        sqlite3_step(m_addrecurrenceextras_query->getStmt());
+    }
+}
@@ -0,0 +1,345 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : RecurrenceRule.cpp
+*   Version     : 1.0
+*   Description : Parses and expands rules for recurring playlist events
+*
+*****************************************************************************/
+
+
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "RecurrenceRule.h"
+
+/**
+ * Default constructor, a rule which never occurs
+ */
+RecurrenceRule::RecurrenceRule ()
+{
+    m_type = RECUR_DAILY;
+    m_second = 0;
+    m_daysrestricted = false;
+    m_weekdaysrestricted = false;
+}
+
+/**
+ * Parse a rule from its text specification
+ *
+ * @param spec Rule text, e.g. "daily 18:00", "weekly sat,sun 09:30:00" or "cron 0 6-23 * * 1-5"
+ */
+RecurrenceRule::RecurrenceRule (std::string spec)
+{
+    m_spec = spec;
+    m_second = 0;
+    m_daysrestricted = false;
+    m_weekdaysrestricted = false;
+
+    std::stringstream specstream(spec);
+    std::string type;
+    specstream >> type;
+
+    // Anything not restricted below matches every value
+    m_days.set();
+    m_months.set();
+    m_weekdays.set();
+
+    if (!type.compare("daily"))
+    {
+        m_type = RECUR_DAILY;
+
+        std::string timefield;
+        specstream >> timefield;
+
+        int hour, minute;
+        parseTime(timefield, hour, minute, m_second);
+        m_hours.set(hour);
+        m_minutes.set(minute);
+    }
+    else if (!type.compare("weekly"))
+    {
+        m_type = RECUR_WEEKLY;
+
+        std::string daysfield, timefield;
+        specstream >> daysfield >> timefield;
+
+        m_weekdays.reset();
+        std::stringstream daysstream(daysfield);
+        std::string day;
+        while (std::getline(daysstream, day, ','))
+        {
+            m_weekdays.set(parseWeekday(day));
+        }
+        m_weekdaysrestricted = true;
+
+        int hour, minute;
+        parseTime(timefield, hour, minute, m_second);
+        m_hours.set(hour);
+        m_minutes.set(minute);
+    }
+    else if (!type.compare("cron"))
+    {
+        m_type = RECUR_CRON;
+
+        std::string minutes, hours, days, months, weekdays;
+        specstream >> minutes >> hours >> days >> months >> weekdays;
+
+        if (weekdays.empty())
+        {
+            throw std::exception();
+        }
+
+        parseField(minutes, 0, 59, m_minutes);
+        parseField(hours, 0, 23, m_hours);
+
+        m_days.reset();
+        parseField(days, 1, 31, m_days);
+        m_daysrestricted = days.compare("*");
+
+        m_months.reset();
+        parseField(months, 1, 12, m_months);
+
+        m_weekdays.reset();
+        parseField(weekdays, 0, 7, m_weekdays);
+        m_weekdaysrestricted = weekdays.compare("*");
+
+        // Cron allows 7 for Sunday too
+        if (m_weekdays.test(7))
+        {
+            m_weekdays.set(0);
+        }
+    }
+    else
+    {
+        throw std::exception();
+    }
+
+    if (m_minutes.none() || m_hours.none())
+    {
+        throw std::exception();
+    }
+}
+
+/**
+ * @return The text specification this rule was created from
+ */
+std::string RecurrenceRule::getSpec () const
+{
+    return m_spec;
+}
+
+recurrence_type_t RecurrenceRule::getType () const
+{
+    return m_type;
+}
+
+/**
+ * Find every occurrence of this rule after one time and up to another
+ *
+ * @param from   Occurrences must be strictly after this time
+ * @param to     Occurrences must be at or before this time
+ * @param result Vector to append occurrence times to, in order
+ */
+void RecurrenceRule::getOccurrences (time_t from, time_t to, std::vector<time_t>& result) const
+{
+    if (to <= from || m_minutes.none())
+    {
+        return;
+    }
+
+    // Walk day by day in local time, working from midday so DST changes cannot skip a date
+    tm day;
+    localtime_r(&from, &day);
+    day.tm_hour = 12;
+    day.tm_min = 0;
+    day.tm_sec = 0;
+    day.tm_isdst = -1;
+    mktime(&day);
+
+    while (true)
+    {
+        tm dayend = day;
+        dayend.tm_hour = 0;
+        dayend.tm_isdst = -1;
+        if (mktime(&dayend) > to)
+        {
+            break;
+        }
+
+        if (matchesDay(day))
+        {
+            for (int hour = 0; hour < 24; ++hour)
+            {
+                if (!m_hours.test(hour))
+                {
+                    continue;
+                }
+
+                for (int minute = 0; minute < 60; ++minute)
+                {
+                    if (!m_minutes.test(minute))
+                    {
+                        continue;
+                    }
+
+                    tm occurrence = day;
+                    occurrence.tm_hour = hour;
+                    occurrence.tm_min = minute;
+                    occurrence.tm_sec = m_second;
+                    occurrence.tm_isdst = -1;
+
+                    time_t occurrencetime = mktime(&occurrence);
+
+                    // A time skipped by DST normalises onto the following hour, so drop it
+                    if (occurrence.tm_hour != hour)
+                    {
+                        continue;
+                    }
+
+                    if (occurrencetime > from && occurrencetime <= to)
+                    {
+                        result.push_back(occurrencetime);
+                    }
+                }
+            }
+        }
+
+        day.tm_mday += 1;
+        day.tm_hour = 12;
+        day.tm_isdst = -1;
+        mktime(&day);
+    }
+}
+
+/**
+ * Parse one cron field into a set of allowed values
+ *
+ * @param field Field text, a comma-separated list of *, N, N-M, with optional /step
+ * @param min   Lowest allowed value
+ * @param max   Highest allowed value
+ * @param bits  Set of values to populate
+ */
+void RecurrenceRule::parseField (std::string field, int min, int max, std::bitset<64>& bits)
+{
+    std::stringstream fieldstream(field);
+    std::string part;
+
+    while (std::getline(fieldstream, part, ','))
+    {
+        int step = 1;
+        size_t slash = part.find('/');
+        if (std::string::npos != slash)
+        {
+            step = std::stoi(part.substr(slash + 1));
+            part = part.substr(0, slash);
+        }
+
+        int first, last;
+        if (!part.compare("*"))
+        {
+            first = min;
+            last = max;
+        }
+        else
+        {
+            size_t dash = part.find('-');
+            first = std::stoi(part.substr(0, dash));
+            last = (std::string::npos == dash) ? first : std::stoi(part.substr(dash + 1));
+
+            // A bare number with a step runs to the end of the range
+            if (std::string::npos == dash && std::string::npos != slash)
+            {
+                last = max;
+            }
+        }
+
+        if (first < min || last > max || first > last || step < 1)
+        {
+            throw std::exception();
+        }
+
+        for (int i = first; i <= last; i += step)
+        {
+            bits.set(i);
+        }
+    }
+}
+
+/**
+ * Parse a time of day in the form HH:MM or HH:MM:SS
+ */
+void RecurrenceRule::parseTime (std::string field, int& hour, int& minute, int& second)
+{
+    hour = -1;
+    minute = -1;
+    second = 0;
+
+    if (sscanf(field.c_str(), "%d:%d:%d", &hour, &minute, &second) < 2)
+    {
+        throw std::exception();
+    }
+
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+    {
+        throw std::exception();
+    }
+}
+
+/**
+ * Convert a three-letter day name to a day number, Sunday being 0
+ */
+int RecurrenceRule::parseWeekday (std::string name)
+{
+    static const char* daynames[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    for (int i = 0; i < 7; ++i)
+    {
+        if (!name.compare(0, 3, daynames[i]))
+        {
+            return i;
+        }
+    }
+
+    throw std::exception();
+}
+
+/**
+ * Check whether any occurrences fall on the given local date
+ */
+bool RecurrenceRule::matchesDay (const tm& day) const
+{
+    if (!m_months.test(day.tm_mon + 1))
+    {
+        return false;
+    }
+
+    bool daymatch = m_days.test(day.tm_mday);
+    bool weekdaymatch = m_weekdays.test(day.tm_wday);
+
+    if (m_daysrestricted && m_weekdaysrestricted)
+    {
+        return daymatch || weekdaymatch;
+    }
+
+    return daymatch && weekdaymatch;
+}
@@ -55,10 +55,14 @@ std::vector<cbEndPlaying> g_endplayingcallbacks;
 std::vector<cbTick> g_tickcallbacks;
 std::vector<std::shared_ptr<Channel>> g_channels;
 std::map<std::string, std::shared_ptr<Device>> g_devices;
+NameRegistry g_channelids;
+NameRegistry g_deviceids;
+std::vector<std::shared_ptr<Device>> g_devicetable;
 std::vector<PluginStateData> g_plugins;
 //It doesn't work if I put these elsewhere, plugins unload each other ~SN
 std::vector<std::shared_ptr<MouseCatcherSourcePlugin>> g_mcsources;
 std::map<std::string, std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessors;
+std::vector<std::shared_ptr<MouseCatcherProcessorPlugin>> g_mcprocessortable;
 std::shared_ptr<BaseConfigLoader> g_pbaseconfig;
 std::shared_ptr<SQLiteDB> g_pcoredatabase;
 
@@ -115,6 +119,9 @@ int main (int argc, char *argv[])
 	return 1;
     }
 
+    g_async.setWorkerCount(g_pbaseconfig->getAsyncWorkers());
+    g_async.setDefaultTimeout(std::chrono::seconds(g_pbaseconfig->getAsyncJobTimeout()));
+
     // Load the core database
     // UNHAPPY NOTE: This MUST be run before any plugins try and use SQLite, or weird segfaults result
     g_pcoredatabase = std::make_shared<SQLiteDB>(g_pbaseconfig->getDatabasePath().c_str());
@@ -133,11 +140,19 @@ int main (int argc, char *argv[])
     {
         std::shared_ptr<Channel> pcl;
 
+        // Channel names key the playlist tables, so a second copy would share the first's playlist
+        if (g_channelids.find(thischannel.m_channame) > -1)
+        {
+            g_logger.warn("Initialisation", "Ignoring duplicate channel " + thischannel.m_channame);
+            continue;
+        }
+
         try
         {
             pcl = std::make_shared<Channel>(thischannel.m_channame, thischannel.m_xpname,
-                    thischannel.m_xpport);
+                    thischannel.m_xpport, thischannel.m_overlappolicy, thischannel.m_recurrencelookahead);
             g_channels.push_back(pcl);
+            pcl->m_channelid = g_channelids.intern(thischannel.m_channame);
         }
         catch (std::exception&)
         {
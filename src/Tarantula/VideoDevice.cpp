@@ -94,15 +94,15 @@ void VideoDevice::runDeviceEvent (std::shared_ptr<Device> pdevice, PlaylistEntry
 
     if (VIDEOACTION_LOAD == event.m_action)
     {
-        if (1 == event.m_extras.count("filename"))
+        if (1 == event.m_extras.count(EXTRA_FILENAME))
         {
             try
             {
-                g_logger.info(event.m_device, "Now loading " + event.m_extras["filename"]);
-                peventdevice->cue(event.m_extras["filename"]);
+                g_logger.info(event.m_device, "Now loading " + event.m_extras[EXTRA_FILENAME]);
+                peventdevice->cue(event.m_extras[EXTRA_FILENAME]);
             } catch (...)
             {
-                g_logger.error(event.m_device, "An error occurred cueing file " + event.m_extras["filename"]);
+                g_logger.error(event.m_device, "An error occurred cueing file " + event.m_extras[EXTRA_FILENAME]);
             }
         }
         else
@@ -113,16 +113,16 @@ void VideoDevice::runDeviceEvent (std::shared_ptr<Device> pdevice, PlaylistEntry
     }
     else if (VIDEOACTION_PLAY == event.m_action)
     {
-        if (1 == event.m_extras.count("filename"))
+        if (1 == event.m_extras.count(EXTRA_FILENAME))
         {
             try
             {
-                g_logger.info(event.m_device, "Now playing " + event.m_extras["filename"]);
-                peventdevice->immediatePlay(event.m_extras["filename"]);
+                g_logger.info(event.m_device, "Now playing " + event.m_extras[EXTRA_FILENAME]);
+                peventdevice->immediatePlay(event.m_extras[EXTRA_FILENAME]);
             } catch (...)
             {
                 g_logger.error(event.m_device,
-                        "An error occurred playing file " + event.m_extras["filename"]);
+                        "An error occurred playing file " + event.m_extras[EXTRA_FILENAME]);
             }
         }
         else
@@ -24,14 +24,59 @@
 
 
 #include "libCaspar/libCaspar.h"
+#include <cstring>
 #include <sstream>
 
+//! Command stubs in the same order as CasparCommandType, with a ? for each parameter
+static constexpr const char *g_commandtemplates[] = {
+    // Media commands
+    // Usually something like LOAD chan-layer clip transition duration auto
+    "LOAD ?-? ? ? ?\r\n",           // CASPAR_COMMAND_LOAD
+    "LOADBG ?-? ? ? ? ?\r\n",       // CASPAR_COMMAND_LOADBG
+    "PLAY ?-? ? ? ?\r\n",           // CASPAR_COMMAND_PLAY
+    "STOP ?-?\r\n",                 // CASPAR_COMMAND_STOP
+    "CLEAR ?-?\r\n",                // CASPAR_COMMAND_CLEAR
+    "CLEAR ?\r\n",                  // CASPAR_COMMAND_CLEAR_PRODUCER
+    "CALL ?-? SEEK ?\r\n",          // CASPAR_COMMAND_SEEK
+
+    // Data commands
+    "DATA STORE\r\n",               // CASPAR_COMMAND_DATA_STORE
+    "DATA RETRIEVE\r\n",            // CASPAR_COMMAND_DATA_RETRIEVE
+    "DATA LIST\r\n",                // CASPAR_COMMAND_DATA_LIST
+
+    // CG Commands
+    // Usually CG chan-layer COMMAND hostlayer template autoplay data
+    "CG ?-? ADD ? ? ? ?\r\n",       // CASPAR_COMMAND_CG_ADD
+    "CG ?-? REMOVE ?\r\n",          // CASPAR_COMMAND_CG_REMOVE
+    "CG ?-? CLEAR\r\n",             // CASPAR_COMMAND_CG_CLEAR
+    "CG ?-? PLAY ?\r\n",            // CASPAR_COMMAND_CG_PLAY
+    "CG ?-? STOP ?\r\n",            // CASPAR_COMMAND_CG_STOP
+    "CG ?-? NEXT ?\r\n",            // CASPAR_COMMAND_CG_NEXT
+    "CG GOTO\r\n",                  // CASPAR_COMMAND_CG_GOTO
+    "CG ?-? UPDATE ? ?\r\n",        // CASPAR_COMMAND_CG_UPDATE
+    "CG ?-? INVOKE ? ?\r\n",        // CASPAR_COMMAND_CG_INVOKE
+
+    // Statistics and Status
+    "CINF\r\n",                     // CASPAR_COMMAND_CINF
+    "CLS\r\n",                      // CASPAR_COMMAND_CLS
+    "TLS\r\n",                      // CASPAR_COMMAND_TLS
+    "VERSION\r\n",                  // CASPAR_COMMAND_VERSION
+    "INFO ?-?\r\n",                 // CASPAR_COMMAND_INFO
+    "INFO ?\r\n",                   // CASPAR_COMMAND_INFO_EXPANDED
+
+    // Misc Commands
+    "BYE\r\n"                       // CASPAR_COMMAND_BYE
+};
+
+static_assert(sizeof(g_commandtemplates) / sizeof(g_commandtemplates[0]) == CASPAR_COMMAND_BYE + 1,
+        "g_commandtemplates must have an entry for every CasparCommandType");
+
 /**
  * Form a stub command with no details
  */
 CasparCommand::CasparCommand ()
 {
-
+    m_ptemplate = "";
 }
 
 /**
@@ -81,169 +126,126 @@ void CasparCommand::clearParams ()
  */
 void CasparCommand::setType (CasparCommandType cct)
 {
-    m_commandquery = getCommandQuery(cct);
+    if (static_cast<size_t>(cct) < sizeof(g_commandtemplates) / sizeof(g_commandtemplates[0]))
+    {
+        m_ptemplate = g_commandtemplates[cct];
+    }
+    else
+    {
+        m_ptemplate = "FAIL\r\n";
+    }
 }
 
 /**
- * Form a complete command ready to send to CasparCG
+ * Append characters to a command, doubling any backslash unless it escapes a quote.
+ * As the character after a backslash may be in the next run appended, whether it
+ * needs doubling is held over in backslash until that character arrives.
  *
- * @return string The complete command string
+ * @param buffer    string The command being formed
+ * @param pdata     Characters to append
+ * @param length    Number of characters to append
+ * @param backslash True while a backslash is waiting on the next character
  */
-std::string CasparCommand::form ()
+static void appendEscaped (std::string& buffer, const char *pdata, size_t length, bool& backslash)
 {
-    int found = -1;
-    // Replace all ?s with entries in m_params
-    for (std::vector<std::string>::iterator it = m_params.begin();
-            it != m_params.end(); it++)
+    const char *pend = pdata + length;
+    while (pdata < pend)
     {
-        found = m_commandquery.find("?", found + 1);
-        if (found == static_cast<int>(std::string::npos))
+        if (backslash)
         {
-            break;
+            buffer.append('"' == *pdata ? "\\" : "\\\\");
+            backslash = false;
         }
 
-        m_commandquery.erase(found, 1);
-
-        if (it->find(' ', 0) != std::string::npos && it->substr(0, 1).compare("\""))
-        {
-            it->insert(0, "\"");
-            it->insert(it->size(), "\"");
+        const char *pslash = static_cast<const char *>(memchr(pdata, '\\', pend - pdata));
+        if (!pslash)
+        {
+            buffer.append(pdata, pend);
+            return;
         }
-        m_commandquery.insert(found, (*it));
-        found += (*it).length();
+
+        buffer.append(pdata, pslash);
+        backslash = true;
+        pdata = pslash + 1;
     }
+}
 
-    //Remove any remaining ?s
-    found = m_commandquery.find("?", found + 1);
-    while (found != static_cast<int>(std::string::npos))
+/**
+ * Form a complete command ready to send to CasparCG, appending it to a buffer.
+ * Each ? in the template is replaced by the next parameter, with parameters
+ * containing spaces quoted, and any ? left without a parameter dropped.
+ * Does not change the command, so can be called as often as needed.
+ *
+ * @param buffer string Buffer to append the command to
+ */
+void CasparCommand::form (std::string& buffer) const
+{
+    size_t length = strlen(m_ptemplate);
+    for (const std::string& param : m_params)
     {
-        m_commandquery.erase(found, 1);
-        found = m_commandquery.find("?", found + 1);
-    }
-
-    // Escape any backslashes
-    found = m_commandquery.find("\\", 0);
-    while (found != static_cast<int>(std::string::npos))
-    {
-        if (m_commandquery.substr(found, 2).compare("\\\""))
-        {
-            m_commandquery.erase(found, 1);
-            m_commandquery.insert(found, "\\\\");
-        }
-        found = m_commandquery.find("\\", found + 2);
+        length += param.size() + 2;
     }
+    buffer.reserve(buffer.size() + length);
+
+    std::vector<std::string>::const_iterator param = m_params.begin();
+    bool backslash = false;
+    const char *ptext = m_ptemplate;
+
+    while (*ptext)
+    {
+        const char *pmark = strchr(ptext, '?');
+        if (!pmark)
+        {
+            appendEscaped(buffer, ptext, strlen(ptext), backslash);
+            break;
+        }
+
+        appendEscaped(buffer, ptext, pmark - ptext, backslash);
+        ptext = pmark + 1;
+
+        if (param == m_params.end())
+        {
+            continue;
+        }
 
-    return m_commandquery;
+        bool quote = param->find(' ') != std::string::npos && (param->empty() || '"' != (*param)[0]);
+        if (quote)
+        {
+            appendEscaped(buffer, "\"", 1, backslash);
+        }
+        appendEscaped(buffer, param->data(), param->size(), backslash);
+        if (quote)
+        {
+            appendEscaped(buffer, "\"", 1, backslash);
+        }
+
+        ++param;
+    }
+
+    if (backslash)
+    {
+        buffer.append("\\\\");
+    }
 }
-
-/**
- * Get the function pointer to the response handler
- *
- * @return Function pointer to response handling function
+
+/**
+ * Form a complete command ready to send to CasparCG
+ *
+ * @return string The complete command string
  */
-ResponseHandler CasparCommand::getHandler ()
-{
-    return m_handler;
-}
-
+std::string CasparCommand::form () const
+{
+    std::string command;
+    form(command);
+    return command;
+}
+
 /**
- * Returns the command stub string equivalent to that command
+ * Get the function pointer to the response handler
  *
- * @param command CasparCommandType The command type to look up a string for
- * @return string The command stub for the input command type
+ * @return Function pointer to response handling function
  */
-std::string CasparCommand::getCommandQuery (CasparCommandType command)
+ResponseHandler CasparCommand::getHandler ()
 {
-    std::string ret = "FAIL\r\n";
-    switch (command)
-    {
-        //media commands
-        //Usually something like LOAD chan-layer clip transition duration auto?
-        case CASPAR_COMMAND_LOAD:
-            ret = "LOAD ?-? ? ? ?\r\n";
-            break;
-        case CASPAR_COMMAND_LOADBG:
-            ret = "LOADBG ?-? ? ? ? ?\r\n";
-            break;
-        case CASPAR_COMMAND_PLAY:
-            ret = "PLAY ?-? ? ? ?\r\n";
-            break;
-        case CASPAR_COMMAND_STOP:
-            ret = "STOP ?-?\r\n";
-            break;
-        case CASPAR_COMMAND_CLEAR:
-            ret = "CLEAR ?-?\r\n";
-            break;
-        case CASPAR_COMMAND_CLEAR_PRODUCER:
-            ret = "CLEAR ?\r\n";
-            break;
-        case CASPAR_COMMAND_SEEK:
-            ret = "CALL ?-? SEEK ?\r\n";
-            break;
-            //data commands
-        case CASPAR_COMMAND_DATA_STORE:
-            ret = "DATA STORE\r\n";
-            break;
-        case CASPAR_COMMAND_DATA_RETRIEVE:
-            ret = "DATA RETRIEVE\r\n";
-            break;
-        case CASPAR_COMMAND_DATA_LIST:
-            ret = "DATA LIST\r\n";
-            break;
-            //CG Commands
-            //Usually CG chan-layer COMMAND hostlayer template autoplay data
-        case CASPAR_COMMAND_CG_ADD:
-            ret = "CG ?-? ADD ? ? ? ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_REMOVE:
-            ret = "CG ?-? REMOVE ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_CLEAR:
-            ret = "CG ?-? CLEAR\r\n";
-            break;
-        case CASPAR_COMMAND_CG_PLAY:
-            ret = "CG ?-? PLAY ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_STOP:
-            ret = "CG ?-? STOP ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_NEXT:
-            ret = "CG ?-? NEXT ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_GOTO:
-            ret = "CG GOTO\r\n";
-            break;
-        case CASPAR_COMMAND_CG_UPDATE:
-            ret = "CG ?-? UPDATE ? ?\r\n";
-            break;
-        case CASPAR_COMMAND_CG_INVOKE:
-            ret = "CG ?-? INVOKE ? ?\r\n";
-            break;
-            //Statistics and Status
-        case CASPAR_COMMAND_CINF:
-            ret = "CINF\r\n";
-            break;
-        case CASPAR_COMMAND_CLS:
-            ret = "CLS\r\n";
-            break;
-        case CASPAR_COMMAND_TLS:
-            ret = "TLS\r\n";
-            break;
-        case CASPAR_COMMAND_VERSION:
-            ret = "VERSION\r\n";
-            break;
-        case CASPAR_COMMAND_INFO:
-            ret = "INFO ?-?\r\n";
-            break;
-        case CASPAR_COMMAND_INFO_EXPANDED:
-            ret = "INFO ?\r\n";
-            break;
-            //Misc Commands
-        case CASPAR_COMMAND_BYE:
-            ret = "BYE\r\n";
-            break;
-        default:
-            break;
-    }
-    return ret;
+    return m_handler;
 }
@@ -24,6 +24,7 @@
 
 
 #include <libCaspar/libCaspar.h>
+#include <cctype>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -61,6 +62,12 @@ CasparConnection::CasparConnection (std::string host, std::string port, long int
     m_connectstate = false;
     m_errorflag = false;
     m_badcommandflag = false;
+
+    m_urgentcount = 0;
+    m_pipelinedepth = CASPAR_DEFAULT_PIPELINE_DEPTH;
+    m_writing = false;
+    m_reading = false;
+    resetResponse();
 }
 
 CasparConnection::~CasparConnection ()
@@ -68,25 +75,6 @@ CasparConnection::~CasparConnection ()
 }
 
 
-/**
- * Read a line from the open socket to CasparCG
- *
- * @return String of data, or blank string for no data
- */
-std::string CasparConnection::receiveLine ()
-{
-    if (m_datalines.size() > 0)
-    {
-        std::string ret = m_datalines.back();
-        m_datalines.pop_back();
-        return ret;
-    }
-    else
-    {
-        return "";
-    }
-}
-
 /**
  * Check socket is still alive and progress waiting async operations
  *
@@ -96,6 +84,9 @@ bool CasparConnection::tick ()
 {
     if (m_socket.is_open())
     {
+        // Everything sent since the last tick goes out together
+        writeNext();
+
         m_io_service.poll();
         m_io_service.reset();
 
@@ -119,51 +110,235 @@ bool CasparConnection::tick ()
 
 /**
  * Timeout handler for run()
+ *
+ * @param err Set if the timer was cancelled because run() finished first
  */
-void CasparConnection::runTimeout ()
+void CasparConnection::runTimeout (const boost::system::error_code& err)
 {
-    m_io_service.stop();
+    if (!err)
+    {
+        m_io_service.stop();
+    }
 }
 
 /**
- * Keep running the io_service until we run out of work or timeout
+ * Keep running the io_service until every command is answered, we run out of work or timeout
  * @param timeout Time in milliseconds to run for. Defaults to 1000. -1 will run until work runs out
  */
 void CasparConnection::run (int timeout /* = 1000 */)
 {
+    // Declared out here as destroying the timer would cancel the wait straight away
+    boost::asio::deadline_timer tmr(m_io_service);
+
     if (timeout > -1)
     {
-        boost::asio::deadline_timer tmr(m_io_service);
         tmr.expires_from_now(boost::posix_time::milliseconds(timeout));
 
-        tmr.async_wait(boost::bind(&CasparConnection::runTimeout, this));
+        tmr.async_wait(boost::bind(&CasparConnection::runTimeout, this, boost::asio::placeholders::error));
     }
 
-    m_io_service.run();
+    writeNext();
+
+    while ((!m_connectstate || !isIdle()) && !m_errorflag)
+    {
+        if (0 == m_io_service.run_one())
+        {
+            break;
+        }
+    }
 
+    tmr.cancel();
+    m_io_service.poll();
     m_io_service.reset();
 }
 
+/**
+ * Make run() return early. Safe to call from any thread.
+ */
+void CasparConnection::stop ()
+{
+    m_io_service.stop();
+}
+
+/**
+ * Block until the connection opens or fails. Returns straight away if it is already open.
+ *
+ * @param timeout Longest time to wait in milliseconds
+ * @return        True if the connection is open
+ */
+bool CasparConnection::waitForConnect (int timeout)
+{
+    if (m_connectstate || m_errorflag)
+    {
+        return m_connectstate;
+    }
+
+    boost::asio::deadline_timer tmr(m_io_service);
+    tmr.expires_from_now(boost::posix_time::milliseconds(timeout));
+    tmr.async_wait(boost::bind(&CasparConnection::connectTimeout, this, boost::asio::placeholders::error));
+
+    // Only run until the connect finishes, so the cancelled timer is the only thing left
+    while (!m_connectstate && !m_errorflag)
+    {
+        if (0 == m_io_service.run_one())
+        {
+            break;
+        }
+    }
+
+    tmr.cancel();
+    m_io_service.poll();
+    m_io_service.reset();
+
+    return m_connectstate;
+}
+
+/**
+ * Timeout handler for waitForConnect()
+ *
+ * @param err Set if the timer was cancelled because the connect finished first
+ */
+void CasparConnection::connectTimeout (const boost::system::error_code& err)
+{
+    if (!err && !m_connectstate)
+    {
+        m_errorflag = true;
+
+        boost::system::error_code ignored;
+        m_socket.close(ignored);
+    }
+}
+
+/**
+ * @return True if no commands are waiting to be sent or for a response
+ */
+bool CasparConnection::isIdle ()
+{
+    return m_commandqueue.empty() && m_inflight.empty();
+}
+
+/**
+ * Drop any queued commands and close the socket. Commands hold their
+ * handlers, which often hold a pointer back to this connection, so
+ * clearing them lets an abandoned connection be freed.
+ */
+void CasparConnection::close ()
+{
+    m_commandqueue.clear();
+    m_inflight.clear();
+    m_urgentcount = 0;
+    m_recvdata.consume(m_recvdata.size());
+    resetResponse();
+
+    boost::system::error_code ignored;
+    m_socket.close(ignored);
+}
+
 /**
  * Send a CasparCommand to CasparCG
  *
  * @param cmd     A command to be executed
+ * @param urgent  Write ahead of any waiting non-urgent commands, such as status
+ *                queries, so time-critical playout is not held up behind them
+ *
+ * Commands are written on the next tick() or run(), so a burst of commands
+ * costs a single write.
  */
-void CasparConnection::sendCommand (CasparCommand cmd)
+void CasparConnection::sendCommand (CasparCommand cmd, bool urgent /* = false */)
+{
+    // Responses are matched to commands in the order they were written
+    if (urgent)
+    {
+        m_commandqueue.insert(m_commandqueue.begin() + m_urgentcount, cmd);
+        m_urgentcount++;
+    }
+    else
+    {
+        m_commandqueue.push_back(cmd);
+    }
+}
+
+/**
+ * Set how many commands may be written before their responses arrive. A depth of
+ * 1 waits for each response before writing the next command.
+ *
+ * @param depth Most commands awaiting a response at once
+ */
+void CasparConnection::setPipelineDepth (int depth)
 {
-    // Queue prevents multiple commands running in parallel and confusion of results
-    m_commandqueue.push(cmd);
+    m_pipelinedepth = depth > 0 ? depth : 1;
+}
 
-    // If this is the only command, send it
-    if (1 == m_commandqueue.size())
+/**
+ * Write as many waiting commands as the pipeline has room for in a single
+ * write, unless a write is already running or the connection is not open yet
+ */
+void CasparConnection::writeNext ()
+{
+    if (m_writing || !m_connectstate)
     {
-        const char *buffer = cmd.form().c_str();
+        return;
+    }
+
+    // Reused between writes, so only grows when a burst is bigger than any before
+    m_writebuffer.clear();
+
+    while (!m_commandqueue.empty() && m_inflight.size() < m_pipelinedepth)
+    {
+        m_inflight.push_back(m_commandqueue.front());
+        m_commandqueue.pop_front();
+        if (m_urgentcount > 0)
+        {
+            m_urgentcount--;
+        }
+
+        m_inflight.back().form(m_writebuffer);
+    }
+
+    if (m_writebuffer.empty())
+    {
+        return;
+    }
+
+    // The buffer must stay untouched until cb_write
+    m_writing = true;
+
+    boost::asio::async_write(m_socket, boost::asio::buffer(m_writebuffer),
+            boost::bind(&CasparConnection::cb_write, this, boost::asio::placeholders::error));
+}
+
+/**
+ * Start reading the response to the oldest command in flight, if not already doing so
+ */
+void CasparConnection::startRead ()
+{
+    if (m_reading || m_inflight.empty())
+    {
+        return;
+    }
+
+    m_reading = true;
+
+    readResponse();
+}
+
+/**
+ * Finish the oldest response if it is already buffered, otherwise read more from the socket
+ */
+void CasparConnection::readResponse ()
+{
+    if (parseResponse())
+    {
+        finishResponse();
+    }
+    else
+    {
+        m_socket.async_read_some(m_recvdata.prepare(CASPAR_READ_SIZE),
+                boost::bind(&CasparConnection::cb_read, this, boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+    }
+}
 
-        boost::asio::async_write(m_socket, boost::asio::buffer(buffer, strlen(buffer)),
-                boost::bind(&CasparConnection::cb_write, this, boost::asio::placeholders::error));
-    }
-}
-
 /**
  * Returns a string representing a response code
  *
@@ -232,6 +407,8 @@ void CasparConnection::cb_connect (const boost::system::error_code& err)
     if (!err)
     {
         m_connectstate = true;
+
+        writeNext();
     }
     else
     {
@@ -240,16 +417,18 @@ void CasparConnection::cb_connect (const boost::system::error_code& err)
 }
 
 /**
- * Callback after a write has completed, sets up a read
+ * Callback after a write has completed, starts reading responses and writes the next command
  *
  * @param err System error code if one ocurred
  */
 void CasparConnection::cb_write (const boost::system::error_code& err)
 {
+    m_writing = false;
+
     if (!err)
     {
-        boost::asio::async_read_until(m_socket, m_recvdata, "\n",
-                boost::bind(&CasparConnection::cb_firstread, this, boost::asio::placeholders::error));
+        startRead();
+        writeNext();
     }
     else
     {
@@ -258,46 +437,18 @@ void CasparConnection::cb_write (const boost::system::error_code& err)
 }
 
 /**
- * Handle reading the initial line of a response, work out if an error ocurred or further reads are needed
+ * Callback after more of a response arrives
  *
- * @param err System error code if one ocurred
+ * @param err    System error code if one ocurred
+ * @param length Number of bytes read
  */
-void CasparConnection::cb_firstread (const boost::system::error_code& err)
+void CasparConnection::cb_read (const boost::system::error_code& err, size_t length)
 {
     if (!err)
     {
-        std::istream is(&m_recvdata);
-        std::string line;
-        std::getline(is, line);
-
-        std::string respCode = line.substr(0, 3);
-        int responsecode = ConvertType::stringToInt(respCode.c_str());
-
-        // Check whether further data is expected
-        if (responsecode == E_COMMAND_NOT_UNDERSTOOD ||
-                responsecode == S_DATA_RETURNED ||
-                responsecode == S_COMMAND_EXECUTED_WITH_MANY_DATA ||
-                responsecode == S_COMMAND_EXECUTED_WITH_DATA)
-        {
-            // Store the first line
-            m_datalines.push_back(line);
-
+        m_recvdata.commit(length);
 
-            // Process additional data and kick off another read if needed
-            processData(is);
-        }
-        else if (responsecode != S_INFORMATION_RETURNED &&
-                    responsecode != S_COMMAND_EXECUTED)
-        {
-            // An error occurred, set the error flag
-            m_badcommandflag = true;
-
-            sendQueuedCommand();
-        }
-        else
-        {
-            sendQueuedCommand();
-        }
+        readResponse();
     }
     else
     {
@@ -306,89 +457,146 @@ void CasparConnection::cb_firstread (const boost::system::error_code& err)
 }
 
 /**
- * Read the remaining lines of data and call a handler function
+ * Scan newly arrived data for the end of the oldest response. Each byte is only
+ * looked at once however the response is split between reads, and lines are
+ * recorded by position rather than copied out of the buffer.
  *
- * @param err System error code if one ocurred
+ * @return True once the whole response is buffered
  */
-void CasparConnection::cb_doneread (const boost::system::error_code& err)
+bool CasparConnection::parseResponse ()
 {
-    if (!err)
-    {
-        // Grab all the data from the read buffer
-        std::istream is(&m_recvdata);
+    const char *data = boost::asio::buffer_cast<const char*>(m_recvdata.data());
+    size_t size = m_recvdata.size();
 
-        // Process the data
-        processData(is);
-    }
-    else
+    while (m_parsepos < size)
     {
-        m_errorflag = true;
+        const char *newline = static_cast<const char*>(memchr(data + m_parsepos, '\n', size - m_parsepos));
+        if (!newline)
+        {
+            m_parsepos = size;
+            return false;
+        }
+
+        size_t start = m_linestart;
+        size_t length = newline - (data + start);
+        m_linestart = (newline - data) + 1;
+        m_parsepos = m_linestart;
+
+        if (length > 0 && '\r' == data[start + length - 1])
+        {
+            length--;
+        }
+
+        if (!m_statusread)
+        {
+            m_statusread = true;
+            m_statusline = std::make_pair(start, length);
+
+            int responsecode = 0;
+            for (size_t i = 0; i < 3 && i < length && isdigit(data[start + i]); ++i)
+            {
+                responsecode = responsecode * 10 + (data[start + i] - '0');
+            }
+            m_response.m_code = responsecode;
+
+            // Check whether further data is expected
+            if (!hasData(responsecode))
+            {
+                return true;
+            }
+        }
+        else if (0 == length)
+        {
+            // A blank line marks the end of the data
+            return true;
+        }
+        else
+        {
+            m_lineoffsets.push_back(std::make_pair(start, length));
+        }
     }
+
+    return false;
 }
 
 /**
- * Process lines of incoming data and start another read if needed
- *
- * @param is Input stream of data for processing
+ * @param responsecode Code from the first line of a response
+ * @return             True if lines of data follow, ended by a blank line
  */
-void CasparConnection::processData (std::istream& is)
+bool CasparConnection::hasData (int responsecode)
 {
-    std::string line;
+    return E_COMMAND_NOT_UNDERSTOOD == responsecode ||
+            S_DATA_RETURNED == responsecode ||
+            S_COMMAND_EXECUTED_WITH_MANY_DATA == responsecode ||
+            S_COMMAND_EXECUTED_WITH_DATA == responsecode;
+}
 
-    // Append the first line to the preceeding
-    if (std::getline(is, line))
+/**
+ * Complete the oldest command in flight, then carry on with the next response and command
+ */
+void CasparConnection::finishResponse ()
+{
+    CasparCommand cmd = m_inflight.front();
+    m_inflight.pop_front();
+    m_reading = false;
+
+    int responsecode = m_response.m_code;
+
+    if (hasData(responsecode))
     {
-        // Append if line was incomplete
-        if (m_datalines.back().find("\r") == std::string::npos)
+        // Positions only become pointers now, as reading more can move the buffer
+        const char *data = boost::asio::buffer_cast<const char*>(m_recvdata.data());
+
+        m_response.m_status.m_pdata = data + m_statusline.first;
+        m_response.m_status.m_length = m_statusline.second;
+
+        m_response.m_lines.clear();
+        for (const std::pair<size_t, size_t>& line : m_lineoffsets)
         {
-            m_datalines.back() += line;
+            CasparLine thisline = {data + line.first, line.second};
+            m_response.m_lines.push_back(thisline);
+        }
+
+        if (m_lineoffsets.empty())
+        {
+            m_response.m_payload.m_pdata = data + m_linestart;
+            m_response.m_payload.m_length = 0;
         }
         else
         {
-            m_datalines.push_back(line);
+            m_response.m_payload.m_pdata = data + m_lineoffsets.front().first;
+            m_response.m_payload.m_length = m_lineoffsets.back().first + m_lineoffsets.back().second -
+                    m_lineoffsets.front().first;
         }
-    }
 
-    while (std::getline(is, line))
-    {
-        m_datalines.push_back(line);
+        ResponseHandler handler = cmd.getHandler();
+        if (handler)
+        {
+            handler(m_response);
+        }
     }
-
-    // If the last line was not a blank marking the end of data, kick off another read
-    if (m_datalines.back() != "\r")
+    else if (responsecode != S_INFORMATION_RETURNED && responsecode != S_COMMAND_EXECUTED)
     {
-        boost::asio::async_read_until(m_socket, m_recvdata, "\n",
-                boost::bind(&CasparConnection::cb_doneread, this, boost::asio::placeholders::error));
+        // An error occurred, set the error flag
+        m_badcommandflag = true;
     }
-    // Otherwise call the handler
-    else
-    {
-        ResponseHandler handler = m_commandqueue.front().getHandler();
 
-        handler(m_datalines);
+    m_recvdata.consume(m_linestart);
+    resetResponse();
 
-        sendQueuedCommand();
-    }
+    startRead();
+    writeNext();
 }
 
 /**
- * Clear out the buffers and send another command if one is ready
+ * Forget the response being parsed, ready to start on the next
  */
-void CasparConnection::sendQueuedCommand()
+void CasparConnection::resetResponse ()
 {
-    m_recvdata.consume(m_recvdata.size());
-
-    m_datalines.clear();
-
-    // Remove the command from the queue
-    m_commandqueue.pop();
-
-    // Send a new command
-    if (m_commandqueue.size() > 0)
-    {
-        const char *buffer = m_commandqueue.front().form().c_str();
-
-        boost::asio::async_write(m_socket, boost::asio::buffer(buffer, strlen(buffer)),
-                boost::bind(&CasparConnection::cb_write, this, boost::asio::placeholders::error));
-    }
+    m_parsepos = 0;
+    m_linestart = 0;
+    m_statusread = false;
+    m_response.m_code = 0;
+    m_response.m_lines.clear();
+    m_lineoffsets.clear();
 }
@@ -126,17 +126,22 @@ void CasparFlashCommand::formatAndAddTemplateData ()
 
     std::string xmldata = ss.str();
 
-    // Replace all the quotes with \"
-    int found = -2;
-    found = xmldata.find('"', found + 2);
-    while (found != static_cast<int>(std::string::npos))
+    // Wrap in quotes and replace all the quotes inside with \"
+    std::string param;
+    param.reserve(xmldata.size() + 2);
+    param += '"';
+    for (char c : xmldata)
     {
-        xmldata.insert(found, "\\");
-        found = xmldata.find('"', found + 2);
+        if ('"' == c)
+        {
+            param += '\\';
+        }
+        param += c;
     }
+    param += '"';
 
     // Add as a parameter
-    addParam("\"" + xmldata + "\"");
+    addParam(param);
 }
 
 /**
@@ -23,43 +23,301 @@
 *****************************************************************************/
 
 
-#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 
-#include "boost/algorithm/string/case_conv.hpp"
 #include "pugixml.hpp"
 #include "libCaspar/CasparQueryResponseProcessor.h"
 #include "Misc.h"
 
+//! Deepest INFO XML handled without falling back to building a DOM
+#define INFO_MAX_DEPTH 32
+
+//! Children of an INFO XML element whose text the streaming readers need
+enum InfoField
+{
+    INFO_TYPE,
+    INFO_INDEX,
+    INFO_FRAMESLEFT,
+    INFO_FILENAME,
+    INFO_NBFRAMES,
+    INFO_FIELDS
+};
+
+static const char *g_infofieldnames[INFO_FIELDS] = {"type", "index", "frames-left", "filename", "nb-frames"};
+
+/**
+ * An open element while streaming through INFO XML. Holds the text of any
+ * interesting children and up to two answers found further down, the first
+ * preferred over the second.
+ */
+struct InfoElement
+{
+    CasparLine m_name;
+    CasparLine m_text;
+    CasparLine m_fields[INFO_FIELDS];
+    bool m_hasfield[INFO_FIELDS];
+    CasparLine m_found[2];
+    CasparLine m_foundframes[2];
+    bool m_hasfound[2];
+};
+
+//! Called as each element closes with the open elements, the closing one at the top
+typedef std::function<void(InfoElement *pstack, int depth)> InfoVisitor;
+
+/**
+ * @param element Element to check
+ * @param name    Name to compare with
+ * @return        True if the element has that name
+ */
+static bool isNamed (const InfoElement& element, const char *name)
+{
+    return element.m_name == name;
+}
+
+/**
+ * @param element Element to check
+ * @param field   Which child to compare
+ * @param value   Text to compare with
+ * @return        True if the element has the child and its text matches
+ */
+static bool hasField (const InfoElement& element, InfoField field, const char *value)
+{
+    return element.m_hasfield[field] && element.m_fields[field] == value;
+}
+
+/**
+ * Read a number the same way pugixml's as_int() does
+ *
+ * @param text Characters to convert
+ * @param def  Value if there is no text at all
+ * @return     The number
+ */
+static int infoInt (const CasparLine& text, int def)
+{
+    if (!text.m_pdata)
+    {
+        return def;
+    }
+
+    char buffer[32];
+    size_t length = std::min(text.m_length, sizeof(buffer) - 1);
+    memcpy(buffer, text.m_pdata, length);
+    buffer[length] = '\0';
+
+    return static_cast<int>(strtol(buffer, NULL, 10));
+}
+
+/**
+ * Pass an element's text up to its parent if it is a field, then visit it
+ *
+ * @return False if the text needs entity decoding, which only the DOM parser does
+ */
+static bool closeInfoElement (InfoElement *pstack, int depth, InfoVisitor& visit)
+{
+    InfoElement& element = pstack[depth];
+
+    if (depth > 0)
+    {
+        InfoElement& parent = pstack[depth - 1];
+        for (int field = 0; field < INFO_FIELDS; ++field)
+        {
+            if (!parent.m_hasfield[field] && isNamed(element, g_infofieldnames[field]))
+            {
+                if (memchr(element.m_text.m_pdata, '&', element.m_text.m_length))
+                {
+                    return false;
+                }
+
+                parent.m_fields[field] = element.m_text;
+                parent.m_hasfield[field] = true;
+            }
+        }
+    }
+
+    visit(pstack, depth);
+    return true;
+}
+
+/**
+ * Walk through INFO XML in one pass without building a tree, calling a visitor
+ * as each element closes. Only the subset of XML CasparCG writes is handled.
+ *
+ * @param xml   Text of the XML document
+ * @param visit Function to call for each element
+ * @return      False if the document needs the full parser, or is not well formed
+ */
+static bool scanInfo (const CasparLine& xml, InfoVisitor visit)
+{
+    InfoElement stack[INFO_MAX_DEPTH];
+    int depth = -1;
+    bool gotroot = false;
+
+    const char *pos = xml.m_pdata;
+    const char *end = pos + xml.m_length;
+
+    while (pos < end)
+    {
+        const char *tag = static_cast<const char*>(memchr(pos, '<', end - pos));
+        if (!tag)
+        {
+            break;
+        }
+
+        // Text straight after a start tag belongs to that element
+        if (depth >= 0 && !stack[depth].m_text.m_pdata)
+        {
+            stack[depth].m_text.m_pdata = pos;
+            stack[depth].m_text.m_length = tag - pos;
+        }
+
+        pos = tag + 1;
+        if (pos >= end)
+        {
+            return false;
+        }
+
+        // Declarations and comments carry nothing we need, but CDATA would need decoding
+        if ('?' == *pos || '!' == *pos)
+        {
+            if (end - pos >= 8 && 0 == memcmp(pos, "![CDATA[", 8))
+            {
+                return false;
+            }
+
+            const char *close = NULL;
+            if (end - pos >= 3 && 0 == memcmp(pos, "!--", 3))
+            {
+                close = std::search(pos + 3, end, "-->", "-->" + 3);
+                close = (close == end) ? NULL : close + 2;
+            }
+            else
+            {
+                close = static_cast<const char*>(memchr(pos, '>', end - pos));
+            }
+
+            if (!close)
+            {
+                return false;
+            }
+
+            pos = close + 1;
+            continue;
+        }
+
+        bool closing = ('/' == *pos);
+        if (closing)
+        {
+            pos++;
+        }
+
+        CasparLine name;
+        name.m_pdata = pos;
+        while (pos < end && !isspace(*pos) && '>' != *pos && '/' != *pos)
+        {
+            pos++;
+        }
+        name.m_length = pos - name.m_pdata;
+
+        // Find the end of the tag, stepping over any quoted attribute values
+        char quote = '\0';
+        while (pos < end && (quote || '>' != *pos))
+        {
+            if (quote)
+            {
+                quote = (quote == *pos) ? '\0' : quote;
+            }
+            else if ('"' == *pos || '\'' == *pos)
+            {
+                quote = *pos;
+            }
+            pos++;
+        }
+
+        if (pos >= end || 0 == name.m_length)
+        {
+            return false;
+        }
+
+        bool selfclosing = !closing && '/' == pos[-1];
+        pos++;
+
+        if (closing)
+        {
+            if (depth < 0 || stack[depth].m_name.m_length != name.m_length ||
+                    0 != memcmp(stack[depth].m_name.m_pdata, name.m_pdata, name.m_length))
+            {
+                return false;
+            }
+
+            if (!closeInfoElement(stack, depth, visit))
+            {
+                return false;
+            }
+            depth--;
+        }
+        else
+        {
+            if (depth + 1 >= INFO_MAX_DEPTH || (depth < 0 && gotroot))
+            {
+                return false;
+            }
+
+            depth++;
+            gotroot = true;
+            stack[depth] = InfoElement();
+            stack[depth].m_name = name;
+
+            if (selfclosing)
+            {
+                stack[depth].m_text.m_pdata = pos;
+                if (!closeInfoElement(stack, depth, visit))
+                {
+                    return false;
+                }
+                depth--;
+            }
+        }
+    }
+
+    return gotroot && -1 == depth;
+}
+
 /**
  * Get a list of names and lengths of media files
  *
  * @param medialist Map of filenames and their lengths (in frames)
  * @param response  Lines of data returned from CasparCG
  */
-void CasparQueryResponseProcessor::getMediaList (std::vector<std::string>& response,
+void CasparQueryResponseProcessor::getMediaList (const CasparResponse& response,
         std::vector<std::string>& medialist)
 {
-    // Parse the response (skipping first line: return code and message and last line (blank)
-    for (std::vector<std::string>::iterator it = response.begin() + 1;
-            it != response.end() - 1; it++)
+    for (const CasparLine& line : response.getLines())
     {
         // Find out where media name ends
-        int nameend = (*it).find("\"", 1);
+        const char *nameend = NULL;
+        if (line.m_length > 1)
+        {
+            nameend = static_cast<const char*>(memchr(line.m_pdata + 1, '"', line.m_length - 1));
+        }
 
         // Maybe the parser failed somewhere...
-        if (nameend < 1)
+        if (!nameend)
         {
             continue;
         }
 
         // Extract character 1 (0 is ") up to next double quote as media name
-        std::string medianame = (*it).substr(1, nameend - 1);
+        std::string medianame(line.m_pdata + 1, nameend);
 
         // Check if we got an alpha channel
-        std::string alphabit = medianame.substr(medianame.size() - 2, 2);
-        boost::algorithm::to_lower(alphabit);
+        bool alpha = medianame.size() >= 2 && '_' == medianame[medianame.size() - 2] &&
+                'a' == tolower(medianame[medianame.size() - 1]);
 
-        if (alphabit.compare("_a"))
+        if (!alpha)
         {
             // Not an alpha channel for an existing list item, add to the list
             medialist.push_back(medianame);
@@ -74,17 +332,21 @@ void CasparQueryResponseProcessor::getMediaList (std::vector<std::string>& respo
  * @param response     Lines of data returned from CasparCG
  *
  */
-void CasparQueryResponseProcessor::getTemplateList (std::vector<std::string>& response,
+void CasparQueryResponseProcessor::getTemplateList (const CasparResponse& response,
         std::vector<std::string>& templatelist)
 {
-    // Parse the response (skipping first two lines: return code and message)
-    for (std::vector<std::string>::iterator it = response.begin() + 1;
-            it != response.end(); it++)
+    for (const CasparLine& line : response.getLines())
     {
-        std::string templatename = (*it).substr(1, (*it).find("\"", 1) - 1);
+        if (line.m_length < 2)
+        {
+            continue;
+        }
+
+        const char *nameend = static_cast<const char*>(memchr(line.m_pdata + 1, '"', line.m_length - 1));
+        std::string templatename(line.m_pdata + 1, nameend ? nameend : line.m_pdata + line.m_length);
 
         // Try and trim a leading backslash
-        if (templatename[0] == '\\')
+        if (!templatename.empty() && templatename[0] == '\\')
         {
             templatename.erase(0, 1);
         }
@@ -94,28 +356,170 @@ void CasparQueryResponseProcessor::getTemplateList (std::vector<std::string>& re
 }
 
 /**
- * Read the state of a channel and layer
+ * Read the state of a channel and layer. Streams through the XML for just the
+ * fields needed, and only builds a DOM for documents that cannot be streamed.
  *
  * @param response Data received from CasparCG
  * @param filename A string for the file name
  * @return         Number of frames to play, 0 for stopped, -1 for not playing
  */
-int CasparQueryResponseProcessor::readLayerStatus (std::vector<std::string>& response,
+int CasparQueryResponseProcessor::readLayerStatus (const CasparResponse& response,
         std::string& filename)
 {
-    std::stringstream ss;
+    CasparLine found[2];
+    CasparLine foundframes[2];
+    bool hasfound[2] = {false, false};
+
+    // Same as //layer/foreground/producer[type="ffmpeg-producer"], or separated-producer if none
+    bool streamed = scanInfo(response.getPayload(), [&] (InfoElement *pstack, int depth)
+    {
+        InfoElement& element = pstack[depth];
+
+        if (depth >= 2 && isNamed(element, "producer") && isNamed(pstack[depth - 1], "foreground") &&
+                isNamed(pstack[depth - 2], "layer"))
+        {
+            int kind = hasField(element, INFO_TYPE, "ffmpeg-producer") ? 0 :
+                    (hasField(element, INFO_TYPE, "separated-producer") ? 1 : -1);
+
+            InfoElement& layer = pstack[depth - 2];
+            if (kind >= 0 && !layer.m_hasfound[kind])
+            {
+                layer.m_found[kind] = element.m_fields[INFO_FILENAME];
+                layer.m_hasfound[kind] = true;
+            }
+        }
+        else if (isNamed(element, "layer"))
+        {
+            for (int kind = 0; kind < 2; ++kind)
+            {
+                if (element.m_hasfound[kind] && !hasfound[kind])
+                {
+                    found[kind] = element.m_found[kind];
+                    foundframes[kind] = element.m_fields[INFO_FRAMESLEFT];
+                    hasfound[kind] = true;
+                }
+            }
+        }
+    });
+
+    if (!streamed)
+    {
+        return readLayerStatusDOM(response, filename);
+    }
+
+    int kind = hasfound[0] ? 0 : (hasfound[1] ? 1 : -1);
+    if (-1 == kind)
+    {
+        filename = "";
+        return -1;
+    }
+
+    filename = found[kind].m_pdata ? found[kind].str() : "";
+
+    // Chop off the file path and extension
+    filename = filename.substr(0, filename.length() - 3);
+
+    return infoInt(foundframes[kind], -1);
+}
+
+/**
+ * Get the number of frames in a file selected by LOADBG X-Y filename followed
+ * by INFO X-Y. Streams through the XML like readLayerStatus().
+ *
+ * @param response Data received from CasparCG
+ * @param layer    Layer to read from (-1 implies only one layer present)
+ * @return		   Number of frames in file
+ */
+int CasparQueryResponseProcessor::readFileFrames(const CasparResponse& response, int layer /* = -1 */)
+{
+    CasparLine found[2];
+    bool hasfound[2] = {false, false};
 
-    for (unsigned int i = 1; i < response.size(); i++)
+    // Same as //layer[index=N]/background/producer/destination/producer[type="ffmpeg-producer"],
+    // or the ffmpeg producer filling a separated-producer there if none
+    bool streamed = scanInfo(response.getPayload(), [&] (InfoElement *pstack, int depth)
     {
-        ss << response[i];
+        InfoElement& element = pstack[depth];
+
+        if (depth >= 2 && isNamed(element, "producer") && isNamed(pstack[depth - 1], "fill") &&
+                isNamed(pstack[depth - 2], "producer") && hasField(element, INFO_TYPE, "ffmpeg-producer"))
+        {
+            // Held on the separated-producer until it closes and its own type is known
+            InfoElement& separated = pstack[depth - 2];
+            if (!separated.m_hasfound[1])
+            {
+                separated.m_found[1] = element.m_fields[INFO_NBFRAMES];
+                separated.m_hasfound[1] = true;
+            }
+        }
+
+        if (depth >= 4 && isNamed(element, "producer") && isNamed(pstack[depth - 1], "destination") &&
+                isNamed(pstack[depth - 2], "producer") && isNamed(pstack[depth - 3], "background") &&
+                isNamed(pstack[depth - 4], "layer"))
+        {
+            InfoElement& thislayer = pstack[depth - 4];
+
+            if (hasField(element, INFO_TYPE, "ffmpeg-producer") && !thislayer.m_hasfound[0])
+            {
+                thislayer.m_found[0] = element.m_fields[INFO_NBFRAMES];
+                thislayer.m_hasfound[0] = true;
+            }
+            else if (hasField(element, INFO_TYPE, "separated-producer") && element.m_hasfound[1] &&
+                    !thislayer.m_hasfound[1])
+            {
+                thislayer.m_found[1] = element.m_found[1];
+                thislayer.m_hasfound[1] = true;
+            }
+        }
+        else if (isNamed(element, "layer"))
+        {
+            if (-1 != layer && infoInt(element.m_fields[INFO_INDEX], -1) != layer)
+            {
+                return;
+            }
+
+            for (int kind = 0; kind < 2; ++kind)
+            {
+                if (element.m_hasfound[kind] && !hasfound[kind])
+                {
+                    found[kind] = element.m_found[kind];
+                    hasfound[kind] = true;
+                }
+            }
+        }
+    });
+
+    if (!streamed)
+    {
+        return readFileFramesDOM(response, layer);
     }
 
+    int kind = hasfound[0] ? 0 : (hasfound[1] ? 1 : -1);
+    if (-1 == kind)
+    {
+        return -1;
+    }
+
+    return infoInt(found[kind], -1);
+}
+
+/**
+ * Build a DOM to read the state of a layer, for responses readLayerStatus() cannot stream
+ *
+ * @param response Data received from CasparCG
+ * @param filename A string for the file name
+ * @return         Number of frames to play, 0 for stopped, -1 for not playing
+ */
+int CasparQueryResponseProcessor::readLayerStatusDOM (const CasparResponse& response,
+        std::string& filename)
+{
     // Some defaults
     int framesremaining = -1;
 
     // Load the XML parser
     pugi::xml_document xmldoc;
-    pugi::xml_parse_result parseresult = xmldoc.load(ss);
+    pugi::xml_parse_result parseresult = xmldoc.load_buffer(response.getPayload().m_pdata,
+            response.getPayload().m_length);
 
     if (pugi::status_ok == parseresult.status)
     {
@@ -151,27 +555,20 @@ int CasparQueryResponseProcessor::readLayerStatus (std::vector<std::string>& res
 }
 
 /**
- * Get the number of frames in a file selected by LOADBG X-Y filename followed
- * by INFO X-Y
+ * Build a DOM to read the frame count of a file, for responses readFileFrames() cannot stream
  *
  * @param response Data received from CasparCG
  * @param layer    Layer to read from (-1 implies only one layer present)
  * @return		   Number of frames in file
  */
-int CasparQueryResponseProcessor::readFileFrames(std::vector<std::string>& response, int layer /* = -1 */)
+int CasparQueryResponseProcessor::readFileFramesDOM(const CasparResponse& response, int layer)
 {
-	std::stringstream ss;
-
-	for (unsigned int i = 1; i < response.size(); i++)
-	{
-	    ss << response[i];
-	}
-
 	int frames = -1;
 
 	// Load the XML parser
 	pugi::xml_document xmldoc;
-	pugi::xml_parse_result parseresult = xmldoc.load(ss);
+	pugi::xml_parse_result parseresult = xmldoc.load_buffer(response.getPayload().m_pdata,
+	        response.getPayload().m_length);
 
 	if (pugi::status_ok == parseresult.status)
 	{
@@ -0,0 +1,92 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : CasparResponse.cpp
+*   Version     : 1.0
+*   Description : View of a response received from CasparCG
+*
+*****************************************************************************/
+
+
+#include <cstring>
+
+#include <libCaspar/CasparResponse.h>
+
+/**
+ * @return A copy of the characters, safe to keep after the handler returns
+ */
+std::string CasparLine::str () const
+{
+    return std::string(m_pdata, m_length);
+}
+
+/**
+ * Compare against a null-terminated string without copying
+ *
+ * @param text String to compare with
+ * @return     True if the characters match exactly
+ */
+bool CasparLine::operator== (const char *text) const
+{
+    return strlen(text) == m_length && 0 == memcmp(m_pdata, text, m_length);
+}
+
+bool CasparLine::operator!= (const char *text) const
+{
+    return !(*this == text);
+}
+
+CasparResponse::CasparResponse ()
+{
+    m_code = 0;
+    m_status.m_pdata = "";
+    m_status.m_length = 0;
+    m_payload = m_status;
+}
+
+/**
+ * @return The three-digit return code, such as 201
+ */
+int CasparResponse::getCode () const
+{
+    return m_code;
+}
+
+/**
+ * @return The first line, holding the return code and a message
+ */
+const CasparLine& CasparResponse::getStatus () const
+{
+    return m_status;
+}
+
+/**
+ * @return Each line of data, in the order received
+ */
+const std::vector<CasparLine>& CasparResponse::getLines () const
+{
+    return m_lines;
+}
+
+/**
+ * @return Every line of data as one block, for handing straight to a parser
+ */
+const CasparLine& CasparResponse::getPayload () const
+{
+    return m_payload;
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : CasparSharedConnection.cpp
+*   Version     : 1.0
+*   Description : Long-lived background connection shared between plugins
+*
+*****************************************************************************/
+
+
+#include <map>
+
+#include <libCaspar/libCaspar.h>
+
+//! Shared connections by "host:port". Held weakly so a server's connection closes once no plugin uses it.
+static std::map<std::string, std::weak_ptr<CasparSharedConnection>> g_sharedconnections;
+static std::mutex g_sharedconnections_lock;
+
+/**
+ * Find the background connection for a server, creating it if no plugin has one yet.
+ * Does not connect, so is safe to call from the tick.
+ *
+ * @param host The hostname/IP of the server
+ * @param port Port number to connect to
+ * @return     Connection shared with any other plugin using the same server
+ */
+std::shared_ptr<CasparSharedConnection> CasparSharedConnection::get (std::string host, std::string port)
+{
+    std::lock_guard<std::mutex> lock(g_sharedconnections_lock);
+
+    std::weak_ptr<CasparSharedConnection>& pweak = g_sharedconnections[host + ":" + port];
+    std::shared_ptr<CasparSharedConnection> pshared = pweak.lock();
+    if (!pshared)
+    {
+        pshared = std::make_shared<CasparSharedConnection>(host, port);
+        pweak = pshared;
+    }
+
+    return pshared;
+}
+
+/**
+ * Use get() rather than constructing these directly, or the connection will not be shared
+ *
+ * @param host The hostname/IP of the server
+ * @param port Port number to connect to
+ */
+CasparSharedConnection::CasparSharedConnection (std::string host, std::string port) :
+        m_host(host),
+        m_port(port)
+{
+}
+
+CasparSharedConnection::~CasparSharedConnection ()
+{
+    drop();
+}
+
+/**
+ * Run a batch of commands on the connection, opening it first if needed. Only
+ * one batch runs at a time, so callers on other threads wait their turn.
+ *
+ * If the batch fails on a connection left over from earlier, the server may
+ * simply have closed it while idle, so the batch is tried once more on a
+ * fresh connection.
+ *
+ * @param batch Function to send the commands and run them to completion.
+ *              Given the connection (which may still be connecting) and
+ *              should return false if anything went wrong. May be called twice.
+ * @return      True if the batch succeeded
+ */
+bool CasparSharedConnection::runBatch (CasparBatch batch)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    bool reused = static_cast<bool>(m_pconnection);
+
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (!m_pconnection)
+        {
+            try
+            {
+                m_pconnection = std::make_shared<CasparConnection>(m_host, m_port, 10);
+            }
+            catch (...)
+            {
+                return false;
+            }
+        }
+
+        bool success = false;
+        try
+        {
+            success = batch(m_pconnection);
+        }
+        catch (...)
+        {
+            success = false;
+        }
+
+        if (success && !m_pconnection->m_errorflag && m_pconnection->isIdle())
+        {
+            m_pconnection->m_badcommandflag = false;
+            return true;
+        }
+
+        drop();
+
+        if (!reused)
+        {
+            break;
+        }
+        reused = false;
+    }
+
+    return false;
+}
+
+/**
+ * Close the connection so the next batch opens a new one
+ */
+void CasparSharedConnection::drop ()
+{
+    if (m_pconnection)
+    {
+        m_pconnection->close();
+        m_pconnection.reset();
+    }
+}
@@ -33,11 +33,11 @@ using namespace std;
 
 shared_ptr<CasparConnection> caspCon;
 
-void runrandomvideo (std::vector<std::string>& resp);
-void domedialist (std::vector<std::string>& resp);
-void dotemplatelist (std::vector<std::string>& resp);
-void dolayerstatus (std::vector<std::string>& resp);
-void doframelist (std::string medianame, std::vector<std::string>& resp);
+void runrandomvideo (CasparResponse& resp);
+void domedialist (CasparResponse& resp);
+void dotemplatelist (CasparResponse& resp);
+void dolayerstatus (CasparResponse& resp);
+void doframelist (std::string medianame, CasparResponse& resp);
 
 int main(int argc,char *argv[]) {
     cout << "libCasparTestApp - Don't expect this to test everything - I'm too lasy for that!" <<endl;
@@ -163,7 +163,7 @@ int main(int argc,char *argv[]) {
     return 0;
 }
 
-void runrandomvideo (std::vector<std::string>& response)
+void runrandomvideo (CasparResponse& response)
 {
     CasparCommand cc(CASPAR_COMMAND_CLEAR_PRODUCER);
     cc.addParam("1");
@@ -190,7 +190,7 @@ void runrandomvideo (std::vector<std::string>& response)
 
 }
 
-void domedialist (std::vector<std::string>& resp)
+void domedialist (CasparResponse& resp)
 {
     std::vector<std::string> medianames;
     std::map<std::string, int> medialist;
@@ -217,12 +217,12 @@ void domedialist (std::vector<std::string>& resp)
 
 }
 
-void doframelist (std::string medianame, std::vector<std::string>& resp)
+void doframelist (std::string medianame, CasparResponse& resp)
 {
     cout << "Got item " << medianame << " with " << CasparQueryResponseProcessor::readFileFrames(resp) << " frames."<<endl;
 }
 
-void dotemplatelist (std::vector<std::string>& resp)
+void dotemplatelist (CasparResponse& resp)
 {
     std::vector<std::string> templatelist;
 
@@ -235,7 +235,7 @@ void dotemplatelist (std::vector<std::string>& resp)
     usleep(200);
 }
 
-void dolayerstatus (std::vector<std::string>& resp)
+void dolayerstatus (CasparResponse& resp)
 {
     std::string filename;
     int frames = CasparQueryResponseProcessor::readLayerStatus(resp, filename);
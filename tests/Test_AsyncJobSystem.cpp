@@ -0,0 +1,561 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_AsyncJobSystem.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_AsyncJobSystem.cpp - checks job ordering, strands, failures, timers, task chains and idle CPU
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AsyncJobSystem.h"
+#include "AsyncTask.h"
+#include "Log.h"
+
+char testname[] = "Async job priorities, strands, failures, timers, tasks, watchdog, metrics and idle CPU";
+
+Log g_logger;
+std::timed_mutex g_core_lock;
+
+static std::mutex g_ranlock;
+static std::vector<int> g_ran;
+static std::atomic<int> g_finished(0);
+
+static AsyncJobFunction recordJob (int id)
+{
+    return [id] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+    {
+        std::lock_guard<std::mutex> lock(g_ranlock);
+        g_ran.push_back(id);
+        g_finished++;
+    };
+}
+
+static bool waitForJobs (int count)
+{
+    for (int i = 0; i < 500 && g_finished < count; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return g_finished >= count;
+}
+
+//! CPU time used by the whole process so far, in milliseconds
+static long cpuTime ()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000 +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+/**
+ * Hold the only worker busy while jobs are queued, then check they run
+ * highest priority first and in submission order within a priority
+ */
+static int testPriorityOrder (AsyncJobSystem& jobs)
+{
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> started;
+
+    jobs.newAsyncJob([&started, released] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+    {
+        started.set_value();
+        released.wait();
+    }, nullptr, nullptr, 0, false);
+    started.get_future().wait();
+
+    const int priorities[] = {1, 5, 3, 5, 1, 9, 3};
+    const int expected[] = {5, 1, 3, 2, 6, 0, 4};
+    for (int i = 0; i < 7; ++i)
+    {
+        jobs.newAsyncJob(recordJob(i), nullptr, nullptr, priorities[i], false);
+    }
+
+    release.set_value();
+
+    if (!waitForJobs(7))
+    {
+        std::cout << std::endl << "Error: Jobs did not all run" << std::endl;
+        return 1;
+    }
+
+    for (int i = 0; i < 7; ++i)
+    {
+        if (g_ran[i] != expected[i])
+        {
+            std::cout << std::endl << "Error: Job " << g_ran[i] << " ran in position " << i << ", expected job " <<
+                    expected[i] << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * With finished jobs still waiting to be reaped by the tick, workers must sleep
+ */
+static int testIdleCPU (AsyncJobSystem& jobs)
+{
+    jobs.setWorkerCount(4);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        jobs.newAsyncJob(recordJob(i), nullptr, nullptr, 0, false);
+    }
+
+    if (!waitForJobs(15))
+    {
+        std::cout << std::endl << "Error: Jobs did not all run" << std::endl;
+        return 1;
+    }
+
+    long start = cpuTime();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    long used = cpuTime() - start;
+
+    std::cout << std::endl << "    CPU used in 500ms idle with " << jobs.getWorkerCount() << " workers: " << used <<
+            "ms" << std::endl;
+
+    jobs.completeAsyncJobs();
+
+    return used < 25 ? 0 : 1;
+}
+
+/**
+ * A job that throws is reported and released, and its callback never runs
+ */
+static int testFailedJob (AsyncJobSystem& jobs)
+{
+    bool calledback = false;
+
+    AsyncJobHandle failedjob = jobs.newAsyncJob(
+            [] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+                g_finished++;
+                throw std::exception();
+            },
+            [&calledback] (std::shared_ptr<void> data)
+            {
+                calledback = true;
+            }, nullptr, 0, true);
+
+    if (!waitForJobs(16))
+    {
+        std::cout << std::endl << "Error: Failing job did not run" << std::endl;
+        return 1;
+    }
+
+    if (!failedjob.waitFor(std::chrono::milliseconds(1000)) || JOB_FAILED != failedjob.getState())
+    {
+        std::cout << std::endl << "Error: Failed job did not finish" << std::endl;
+        return 1;
+    }
+
+    jobs.completeAsyncJobs();
+
+    if (calledback)
+    {
+        std::cout << std::endl << "Error: Failed job ran its callback" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Delayed jobs wait, interval jobs repeat at their interval until cancelled,
+ * and a job which cannot start before its deadline is dropped
+ */
+static int testTimedJobs ()
+{
+    AsyncJobSystem jobs;
+    std::atomic<int> runs(0);
+    AsyncJobFunction countrun = [&runs] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+    {
+        runs++;
+    };
+
+    // Delayed
+    AsyncJobClock::time_point start = AsyncJobClock::now();
+    AsyncJobHandle delayed = jobs.newTimedJob(countrun, nullptr, nullptr, 0, std::chrono::milliseconds(100));
+    delayed.wait();
+
+    if (AsyncJobClock::now() - start < std::chrono::milliseconds(100) || 1 != runs)
+    {
+        std::cout << std::endl << "Error: Delayed job ran early" << std::endl;
+        return 1;
+    }
+
+    // Interval, rescheduled by the tick after each run
+    runs = 0;
+    AsyncJobHandle repeating = jobs.newTimedJob(countrun, nullptr, nullptr, 0, std::chrono::milliseconds(50),
+            std::chrono::milliseconds(50));
+
+    start = AsyncJobClock::now();
+    while (AsyncJobClock::now() - start < std::chrono::milliseconds(520))
+    {
+        jobs.completeAsyncJobs();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    repeating.cancel();
+    jobs.completeAsyncJobs();
+
+    if (!repeating.waitFor(std::chrono::milliseconds(1000)))
+    {
+        std::cout << std::endl << "Error: Cancelled job did not finish" << std::endl;
+        return 1;
+    }
+
+    int counted = runs;
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    jobs.completeAsyncJobs();
+
+    if (counted < 8 || counted > 11 || runs != counted)
+    {
+        std::cout << std::endl << "Error: Interval job ran " << runs << " times, expected about 10" << std::endl;
+        return 1;
+    }
+
+    // Deadline missed while the only worker is busy
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    jobs.newAsyncJob([released] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+    {
+        released.wait();
+    }, nullptr, nullptr, 0, false);
+
+    runs = 0;
+    AsyncJobHandle late = jobs.newTimedJob(countrun, nullptr, nullptr, 0, std::chrono::milliseconds::zero(),
+            std::chrono::milliseconds::zero(), std::chrono::milliseconds(20));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release.set_value();
+
+    if (!late.waitFor(std::chrono::milliseconds(1000)) || JOB_EXPIRED != late.getState() || 0 != runs)
+    {
+        std::cout << std::endl << "Error: Job past its deadline was run" << std::endl;
+        return 1;
+    }
+
+    jobs.completeAsyncJobs();
+
+    return 0;
+}
+
+/**
+ * A chain of typed stages passes a move-only value through workers to the
+ * tick thread, and an exception skips the rest of a chain
+ */
+static int testTaskChain (AsyncJobSystem& jobs)
+{
+    int applied = 0;
+    std::thread::id appliedon;
+
+    AsyncTask<AsyncNothing> chain = makeAsyncTask(jobs, std::unique_ptr<int>(new int(20)), 0)
+    .then([] (std::unique_ptr<int> pvalue)
+            {
+                *pvalue += 1;
+                return pvalue;
+            })
+    .then([] (std::unique_ptr<int> pvalue)
+            {
+                return *pvalue * 2;
+            })
+    .then([&applied, &appliedon] (int value)
+            {
+                applied = value;
+                appliedon = std::this_thread::get_id();
+            }, ASYNC_ON_TICK);
+
+    // Stand in for the tick
+    for (int i = 0; i < 500 && !chain.isReady(); ++i)
+    {
+        jobs.completeAsyncJobs();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    if (!chain.isReady() || 42 != applied || std::this_thread::get_id() != appliedon)
+    {
+        std::cout << std::endl << "Error: Task chain gave " << applied << ", expected 42 on the tick" << std::endl;
+        return 1;
+    }
+
+    bool skipped = true;
+    AsyncTask<int> failing = runAsyncTask(jobs, [] () -> int { throw std::exception(); }, 0)
+    .then([&skipped] (int value)
+            {
+                skipped = false;
+                return value;
+            });
+
+    try
+    {
+        failing.get();
+        std::cout << std::endl << "Error: Failed task chain gave a result" << std::endl;
+        return 1;
+    }
+    catch (std::exception&)
+    {
+    }
+
+    return skipped ? 0 : 1;
+}
+
+/**
+ * Jobs on one strand never overlap and keep their order, while two strands
+ * still run alongside each other
+ */
+static int testStrands (AsyncJobSystem& jobs)
+{
+    const int jobsperstrand = 10;
+    std::atomic<int> inside[2];
+    std::atomic<int> overlaps(0);
+    std::atomic<int> together(0);
+    std::atomic<int> mosttogether(0);
+    std::atomic<int> done(0);
+    std::vector<int> order[2];
+
+    for (int s = 0; s < 2; ++s)
+    {
+        inside[s] = 0;
+    }
+
+    for (int i = 0; i < jobsperstrand; ++i)
+    {
+        for (int s = 0; s < 2; ++s)
+        {
+            // Vary priority so the pool would reorder these if the strand did not hold them back
+            jobs.newAsyncJob([&, s, i] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+                if (++inside[s] > 1)
+                {
+                    overlaps++;
+                }
+
+                int now = ++together;
+                int most = mosttogether;
+                while (now > most && !mosttogether.compare_exchange_weak(most, now))
+                {
+                }
+
+                order[s].push_back(i);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+                together--;
+                inside[s]--;
+                done++;
+            }, nullptr, nullptr, i, false, 0 == s ? "Strand A" : "Strand B");
+        }
+    }
+
+    for (int i = 0; i < 500 && done < 2 * jobsperstrand; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    jobs.completeAsyncJobs();
+
+    if (done < 2 * jobsperstrand || overlaps > 0)
+    {
+        std::cout << std::endl << "Error: Jobs on one strand overlapped" << std::endl;
+        return 1;
+    }
+
+    for (int s = 0; s < 2; ++s)
+    {
+        for (int i = 0; i < jobsperstrand; ++i)
+        {
+            if (order[s][i] != i)
+            {
+                std::cout << std::endl << "Error: Strand jobs ran out of order" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if (mosttogether < 2)
+    {
+        std::cout << std::endl << "Error: Separate strands did not run in parallel" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int testMetrics ()
+{
+    AsyncJobSystem jobs;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        jobs.newAsyncJob(
+                [i] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+                    if (0 == i)
+                    {
+                        throw std::exception();
+                    }
+                }, nullptr, nullptr, 0, false, "", "Test");
+    }
+
+    AsyncJobHandle last = jobs.newAsyncJob(
+            [] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+            }, nullptr, nullptr, 0, false);
+
+    // One worker, so everything in "Test" has finished once the last job has
+    last.waitFor(std::chrono::milliseconds(2000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::vector<AsyncJobMetrics> metrics = jobs.getMetrics();
+    if (metrics.size() != 2 || metrics[0].m_category != "Other" || metrics[1].m_category != "Test")
+    {
+        std::cout << std::endl << "Error: Job categories were not recorded" << std::endl;
+        return 1;
+    }
+
+    AsyncJobMetrics& test = metrics[1];
+    unsigned long waits = 0;
+    unsigned long runs = 0;
+    unsigned long slowruns = 0;
+    for (int bucket = 0; bucket < ASYNC_HISTOGRAM_BUCKETS; ++bucket)
+    {
+        waits += test.m_waithistogram[bucket];
+        runs += test.m_runhistogram[bucket];
+        if (AsyncJobSystem::getHistogramLimit(bucket) < 0 || AsyncJobSystem::getHistogramLimit(bucket) > 2)
+        {
+            slowruns += test.m_runhistogram[bucket];
+        }
+    }
+
+    if (8 != test.m_submitted || 7 != test.m_completed || 1 != test.m_failed || 0 != test.m_queued ||
+            0 != test.m_running || 8 != waits || 8 != runs || 8 != slowruns || 1 != metrics[0].m_completed)
+    {
+        std::cout << std::endl << "Error: Job metrics were wrong" << std::endl;
+        return 1;
+    }
+
+    jobs.completeAsyncJobs();
+    return 0;
+}
+
+static int testWatchdog ()
+{
+    AsyncJobSystem jobs;
+    jobs.setDefaultTimeout(std::chrono::milliseconds(200));
+
+    // A job which checks for cancellation should be stopped at its timeout
+    AsyncJobHandle politejob = jobs.newAsyncJob(
+            [] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+                while (!AsyncJobSystem::isJobCancelled())
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            }, nullptr, nullptr, 0, false);
+
+    if (!politejob.waitFor(std::chrono::milliseconds(2000)) || 1 != jobs.getTimedOutJobs())
+    {
+        std::cout << std::endl << "Error: Over-running job was not cancelled" << std::endl;
+        return 1;
+    }
+
+    // One which ignores it should lose its worker, without holding up the next job
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    AsyncJobHandle hungjob = jobs.newAsyncJob(
+            [released] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+                released.wait();
+            }, nullptr, nullptr, 0, false);
+
+    AsyncJobHandle nextjob = jobs.newAsyncJob(
+            [] (std::shared_ptr<void> data, std::timed_mutex& core_lock)
+            {
+            }, nullptr, nullptr, 0, false);
+
+    bool nextran = nextjob.waitFor(std::chrono::milliseconds(2000));
+
+    release.set_value();
+    hungjob.waitFor(std::chrono::milliseconds(1000));
+    jobs.completeAsyncJobs();
+
+    if (!nextran || 1 != jobs.getReplacedWorkers())
+    {
+        std::cout << std::endl << "Error: Hung job's worker was not replaced" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int runtest ()
+{
+    AsyncJobSystem jobs;
+
+    if (testPriorityOrder(jobs))
+    {
+        return 1;
+    }
+
+    if (testIdleCPU(jobs))
+    {
+        return 1;
+    }
+
+    if (testStrands(jobs))
+    {
+        return 1;
+    }
+
+    if (testFailedJob(jobs))
+    {
+        return 1;
+    }
+
+    if (testTimedJobs())
+    {
+        return 1;
+    }
+
+    if (testWatchdog())
+    {
+        return 1;
+    }
+
+    if (testMetrics())
+    {
+        return 1;
+    }
+
+    return testTaskChain(jobs);
+}
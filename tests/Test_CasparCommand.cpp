@@ -0,0 +1,198 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_CasparCommand.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_CasparCommand.cpp - checks and times forming AMCP commands
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "libCaspar/CasparCommand.h"
+
+char testname[] = "Caspar command forming";
+
+/*
+ * Copy of the old find/erase/insert CasparCommand::form(), which the single
+ * pass version must match character for character.
+ */
+static std::string formOld (std::string commandquery, std::vector<std::string> params)
+{
+    int found = -1;
+    for (std::vector<std::string>::iterator it = params.begin(); it != params.end(); it++)
+    {
+        found = commandquery.find("?", found + 1);
+        if (found == static_cast<int>(std::string::npos))
+        {
+            break;
+        }
+
+        commandquery.erase(found, 1);
+
+        if (it->find(' ', 0) != std::string::npos && it->substr(0, 1).compare("\""))
+        {
+            it->insert(0, "\"");
+            it->insert(it->size(), "\"");
+        }
+        commandquery.insert(found, (*it));
+        found += (*it).length();
+    }
+
+    found = commandquery.find("?", found + 1);
+    while (found != static_cast<int>(std::string::npos))
+    {
+        commandquery.erase(found, 1);
+        found = commandquery.find("?", found + 1);
+    }
+
+    found = commandquery.find("\\", 0);
+    while (found != static_cast<int>(std::string::npos))
+    {
+        if (commandquery.substr(found, 2).compare("\\\""))
+        {
+            commandquery.erase(found, 1);
+            commandquery.insert(found, "\\\\");
+        }
+        found = commandquery.find("\\", found + 2);
+    }
+
+    return commandquery;
+}
+
+struct FormCase
+{
+    CasparCommandType m_type;
+    std::string m_template;
+    std::vector<std::string> m_params;
+};
+
+static CasparCommand makeCommand (const FormCase& formcase)
+{
+    CasparCommand command(formcase.m_type);
+    for (const std::string& param : formcase.m_params)
+    {
+        command.addParam(param);
+    }
+    return command;
+}
+
+/**
+ * Same XML as CasparFlashCommand::formatAndAddTemplateData() produces, quotes
+ * already escaped, with a Windows path in every value to give backslashes to double.
+ */
+static std::string makeTemplateData (int fields)
+{
+    std::string data = "\"<templateData>";
+    for (int i = 0; i < fields; ++i)
+    {
+        std::string id = "f" + std::to_string(i);
+        data += "<componentData id=\\\"" + id + "\\\"><data id=\\\"" + id + "\\\" value=\\\"C:\\media\\stills\\" +
+                id + ".png &amp; some caption text\\\"/></componentData>";
+    }
+    data += "</templateData>\"";
+    return data;
+}
+
+static bool checkCase (const FormCase& formcase)
+{
+    CasparCommand command = makeCommand(formcase);
+    std::string expected = formOld(formcase.m_template, formcase.m_params);
+
+    std::string first = command.form();
+    std::string second = command.form();
+
+    // Appending must leave anything already in the buffer alone
+    std::string buffer = "PREVIOUS\r\n";
+    command.form(buffer);
+
+    if (first != expected || second != expected || buffer != "PREVIOUS\r\n" + expected)
+    {
+        std::cout << std::endl << "    Expected: " << expected << "    Got: " << first << "    Then: " << second;
+        return false;
+    }
+    return true;
+}
+
+int runtest ()
+{
+    std::vector<FormCase> cases = {
+        {CASPAR_COMMAND_LOAD, "LOAD ?-? ? ? ?\r\n", {"1", "10", "AMB", "MIX", "25"}},
+        {CASPAR_COMMAND_LOAD, "LOAD ?-? ? ? ?\r\n", {"1", "10", "my clip", "MIX", "25"}},
+        {CASPAR_COMMAND_LOAD, "LOAD ?-? ? ? ?\r\n", {"1", "10", "\"my clip\""}},
+        {CASPAR_COMMAND_PLAY, "PLAY ?-? ? ? ?\r\n", {"1", "10", "media\\clip"}},
+        {CASPAR_COMMAND_PLAY, "PLAY ?-? ? ? ?\r\n", {"1", "10", "my dir\\", "MIX"}},
+        {CASPAR_COMMAND_PLAY, "PLAY ?-? ? ? ?\r\n", {"1", "10", "dir\\", "MIX\\"}},
+        {CASPAR_COMMAND_PLAY, "PLAY ?-? ? ? ?\r\n", {"1", "10", "say \\\"hi\\\""}},
+        {CASPAR_COMMAND_PLAY, "PLAY ?-? ? ? ?\r\n", {"1", "", "", "x"}},
+        {CASPAR_COMMAND_INFO, "INFO ?-?\r\n", {"1"}},
+        {CASPAR_COMMAND_INFO, "INFO ?-?\r\n", {}},
+        {CASPAR_COMMAND_INFO_EXPANDED, "INFO ?\r\n", {"2"}},
+        {CASPAR_COMMAND_STOP, "STOP ?-?\r\n", {"1", "10", "extra", "more"}},
+        {CASPAR_COMMAND_CLS, "CLS\r\n", {}},
+        {CASPAR_COMMAND_BYE, "BYE\r\n", {}},
+        {static_cast<CasparCommandType>(CASPAR_COMMAND_BYE + 1), "FAIL\r\n", {"1"}},
+        {CASPAR_COMMAND_CG_ADD, "CG ?-? ADD ? ? ? ?\r\n", {"1", "20", "1", "lower third", "1", makeTemplateData(3)}}
+    };
+
+    for (const FormCase& formcase : cases)
+    {
+        if (!checkCase(formcase))
+        {
+            return 1;
+        }
+    }
+
+    // Time a CG ADD carrying a large data payload
+    FormCase bigadd = {CASPAR_COMMAND_CG_ADD, "CG ?-? ADD ? ? ? ?\r\n",
+            {"1", "20", "1", "lower third", "1", makeTemplateData(600)}};
+    if (!checkCase(bigadd))
+    {
+        return 1;
+    }
+
+    const int iterations = 50;
+    CasparCommand command = makeCommand(bigadd);
+    size_t total = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        total += formOld(bigadd.m_template, bigadd.m_params).size();
+    }
+    std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+    std::string buffer;
+    for (int i = 0; i < iterations; ++i)
+    {
+        buffer.clear();
+        command.form(buffer);
+        total -= buffer.size();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    double oldus = std::chrono::duration<double, std::micro>(middle - start).count() / iterations;
+    double newus = std::chrono::duration<double, std::micro>(end - middle).count() / iterations;
+
+    std::cout << std::endl << "    CG ADD with " << buffer.size() << " byte command: find/insert " << oldus <<
+            "us, single pass " << newus << "us" << std::endl;
+
+    return (0 == total && newus < oldus) ? 0 : 1;
+}
@@ -0,0 +1,434 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_CasparConnection.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_CasparConnection.cpp - talks AMCP to a fake CasparCG server on the loopback interface
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "libCaspar/libCaspar.h"
+
+char testname[] = "Caspar connection pipelining, response matching and parsing";
+
+//! Files in the fake media list
+#define CLS_FILES 3000
+
+//! INFO for a layer playing a file, laid out as CasparCG 2.0 sends it
+static const char *g_layerinfo =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+        "<layer>\r\n"
+        "   <auto_delta>null</auto_delta>\r\n"
+        "   <frame-number>100</frame-number>\r\n"
+        "   <nb_frames>1600</nb_frames>\r\n"
+        "   <frames-left>1500</frames-left>\r\n"
+        "   <foreground>\r\n"
+        "      <producer>\r\n"
+        "         <type>ffmpeg-producer</type>\r\n"
+        "         <filename>media/PROMO.mp4</filename>\r\n"
+        "         <width>1920</width>\r\n"
+        "         <height>1080</height>\r\n"
+        "      </producer>\r\n"
+        "   </foreground>\r\n"
+        "   <background>\r\n"
+        "      <producer>\r\n"
+        "         <type>empty-producer</type>\r\n"
+        "      </producer>\r\n"
+        "   </background>\r\n"
+        "</layer>\r\n";
+
+//! INFO for a channel with files loaded in the background of several layers
+static const char *g_channelinfo =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+        "<channel>\r\n"
+        "   <video-mode>1080i5000</video-mode>\r\n"
+        "   <stage>\r\n"
+        "      <layers>\r\n"
+        "         <layer>\r\n"
+        "            <index>10</index>\r\n"
+        "            <background>\r\n"
+        "               <producer>\r\n"
+        "                  <type>transition-producer</type>\r\n"
+        "                  <destination>\r\n"
+        "                     <producer>\r\n"
+        "                        <type>ffmpeg-producer</type>\r\n"
+        "                        <filename>media/FIRST.mov</filename>\r\n"
+        "                        <nb-frames>250</nb-frames>\r\n"
+        "                     </producer>\r\n"
+        "                  </destination>\r\n"
+        "               </producer>\r\n"
+        "            </background>\r\n"
+        "         </layer>\r\n"
+        "         <layer>\r\n"
+        "            <index>11</index>\r\n"
+        "            <background>\r\n"
+        "               <producer>\r\n"
+        "                  <type>transition-producer</type>\r\n"
+        "                  <destination>\r\n"
+        "                     <producer>\r\n"
+        "                        <type>separated-producer</type>\r\n"
+        "                        <fill>\r\n"
+        "                           <producer>\r\n"
+        "                              <type>ffmpeg-producer</type>\r\n"
+        "                              <nb-frames>500</nb-frames>\r\n"
+        "                           </producer>\r\n"
+        "                        </fill>\r\n"
+        "                        <key>\r\n"
+        "                           <producer>\r\n"
+        "                              <type>ffmpeg-producer</type>\r\n"
+        "                              <nb-frames>499</nb-frames>\r\n"
+        "                           </producer>\r\n"
+        "                        </key>\r\n"
+        "                     </producer>\r\n"
+        "                  </destination>\r\n"
+        "               </producer>\r\n"
+        "            </background>\r\n"
+        "         </layer>\r\n"
+        "      </layers>\r\n"
+        "   </stage>\r\n"
+        "</channel>\r\n";
+
+/**
+ * Accepts one connection and answers AMCP commands. Waits for a whole batch
+ * of commands before answering any, then sends all the answers in one write,
+ * so batches larger than one only complete if the client pipelines them.
+ */
+class FakeCaspar
+{
+public:
+    FakeCaspar (unsigned int batch) :
+            m_acceptor(m_io_service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+            m_socket(m_io_service),
+            m_batch(batch)
+    {
+        m_reads = 0;
+        m_port = std::to_string(m_acceptor.local_endpoint().port());
+        m_thread = std::thread(&FakeCaspar::serve, this);
+    }
+
+    ~FakeCaspar ()
+    {
+        m_thread.join();
+    }
+
+    std::string m_port;
+    std::vector<std::string> m_received;
+    std::atomic<int> m_reads; //!< Number of reads it took to receive the commands
+
+private:
+    void serve ()
+    {
+        boost::system::error_code err;
+        m_acceptor.accept(m_socket, err);
+
+        char chunk[4096];
+        std::string pending;
+        std::string replies;
+
+        while (!err)
+        {
+            size_t newline = pending.find("\r\n");
+            if (std::string::npos == newline)
+            {
+                size_t length = m_socket.read_some(boost::asio::buffer(chunk), err);
+                pending.append(chunk, length);
+                m_reads++;
+                continue;
+            }
+
+            std::string line = pending.substr(0, newline);
+            pending.erase(0, newline + 2);
+            m_received.push_back(line);
+
+            if (0 == line.find("CLS"))
+            {
+                // Far bigger than one read, with an alpha channel for every file
+                replies += "200 CLS OK\r\n";
+                for (int i = 0; i < CLS_FILES; ++i)
+                {
+                    replies += "\"CLIP_" + std::to_string(i) + "\"  MOVIE  1234567 20130101120000\r\n";
+                    replies += "\"CLIP_" + std::to_string(i) + "_A\"  MOVIE  1234567 20130101120000\r\n";
+                }
+                replies += "\r\n";
+            }
+            else if ("INFO 2-1" == line)
+            {
+                replies += "201 INFO OK\r\n" + std::string(g_layerinfo) + "\r\n";
+            }
+            else if ("INFO 2" == line || "INFO 3" == line)
+            {
+                // Channel 3 has an escaped filename, which is left to the DOM parser
+                std::string info = g_channelinfo;
+                if ("INFO 3" == line)
+                {
+                    info.replace(info.find("FIRST"), 5, "Q&amp;A");
+                }
+                replies += "201 INFO OK\r\n" + info + "\r\n";
+            }
+            else if (0 == line.find("INFO"))
+            {
+                replies += "201 INFO OK\r\n" + line + "\r\n\r\n";
+            }
+            else
+            {
+                replies += "202 " + line.substr(0, line.find(' ')) + " OK\r\n";
+            }
+
+            if (0 == m_received.size() % m_batch)
+            {
+                boost::asio::write(m_socket, boost::asio::buffer(replies), err);
+                replies.clear();
+            }
+        }
+    }
+
+    boost::asio::io_service m_io_service;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    boost::asio::ip::tcp::socket m_socket;
+    unsigned int m_batch;
+    std::thread m_thread;
+};
+
+static std::vector<std::string> g_answers;
+
+static void recordAnswer (CasparResponse& resp)
+{
+    if (!resp.getLines().empty())
+    {
+        g_answers.push_back(resp.getLines()[0].str());
+    }
+}
+
+static CasparCommand infoQuery (std::string layer)
+{
+    CasparCommand query(CASPAR_COMMAND_INFO, boost::bind(&recordAnswer, _1));
+    query.addParam("1");
+    query.addParam(layer);
+    return query;
+}
+
+static CasparCommand stopLayer (std::string layer)
+{
+    CasparCommand stop(CASPAR_COMMAND_STOP);
+    stop.addParam("1");
+    stop.addParam(layer);
+    return stop;
+}
+
+/**
+ * Three commands only get answered once all three have been written, and
+ * answers arriving together must each reach the right handler. Commands sent
+ * together should arrive in one write.
+ */
+static int testPipelining ()
+{
+    FakeCaspar server(3);
+    g_answers.clear();
+
+    {
+        CasparConnection con("127.0.0.1", server.m_port, 10);
+        con.waitForConnect(1000);
+
+        con.sendCommand(infoQuery("10"));
+        con.sendCommand(stopLayer("10"));
+        con.sendCommand(infoQuery("20"));
+        con.run(2000);
+
+        if (!con.isIdle() || con.m_errorflag || con.m_badcommandflag)
+        {
+            std::cout << std::endl << "    Pipelined commands did not complete" << std::endl;
+            return 1;
+        }
+
+        con.close();
+    }
+
+    if (2 != g_answers.size() || "INFO 1-10" != g_answers[0] || "INFO 1-20" != g_answers[1])
+    {
+        std::cout << std::endl << "    Pipelined answers reached the wrong handlers" << std::endl;
+        return 1;
+    }
+
+    // One read for the commands, and one more to see the connection close
+    if (server.m_reads > 2)
+    {
+        std::cout << std::endl << "    Commands took " << server.m_reads - 1 << " writes to send" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * With a depth of one, urgent commands overtake queued queries but not the one already written
+ */
+static int testUrgent ()
+{
+    FakeCaspar server(1);
+    g_answers.clear();
+
+    {
+        CasparConnection con("127.0.0.1", server.m_port, 10);
+        con.setPipelineDepth(1);
+        con.waitForConnect(1000);
+
+        con.sendCommand(infoQuery("10"));
+        con.tick();
+        con.sendCommand(infoQuery("20"));
+        con.sendCommand(stopLayer("10"), true);
+        con.run(2000);
+
+        if (!con.isIdle() || con.m_errorflag)
+        {
+            std::cout << std::endl << "    Urgent commands did not complete" << std::endl;
+            return 1;
+        }
+
+        con.close();
+    }
+
+    if (3 != server.m_received.size() || "INFO 1-10" != server.m_received[0] ||
+            "STOP 1-10" != server.m_received[1] || "INFO 1-20" != server.m_received[2])
+    {
+        std::cout << std::endl << "    Urgent command was not sent ahead of queued queries" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static std::vector<std::string> g_medialist;
+
+static void recordMediaList (CasparResponse& resp)
+{
+    CasparQueryResponseProcessor::getMediaList(resp, g_medialist);
+}
+
+/**
+ * A media list arriving over many reads is parsed into one response
+ */
+static int testLargeResponse ()
+{
+    FakeCaspar server(1);
+    g_medialist.clear();
+
+    {
+        CasparConnection con("127.0.0.1", server.m_port, 10);
+        con.waitForConnect(1000);
+
+        con.sendCommand(CasparCommand(CASPAR_COMMAND_CLS, boost::bind(&recordMediaList, _1)));
+        con.sendCommand(stopLayer("10"));
+        con.run(2000);
+
+        if (!con.isIdle() || con.m_errorflag || con.m_badcommandflag)
+        {
+            std::cout << std::endl << "    Media list did not complete" << std::endl;
+            return 1;
+        }
+
+        con.close();
+    }
+
+    if (CLS_FILES != g_medialist.size() || "CLIP_0" != g_medialist.front() ||
+            "CLIP_" + std::to_string(CLS_FILES - 1) != g_medialist.back())
+    {
+        std::cout << std::endl << "    Media list parsed to " << g_medialist.size() << " files" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int g_layerframes;
+static std::string g_layerfilename;
+static std::vector<int> g_fileframes;
+
+static void recordLayerStatus (CasparResponse& resp)
+{
+    g_layerframes = CasparQueryResponseProcessor::readLayerStatus(resp, g_layerfilename);
+}
+
+static void recordFileFrames (CasparResponse& resp)
+{
+    g_fileframes.push_back(CasparQueryResponseProcessor::readFileFrames(resp, 10));
+    g_fileframes.push_back(CasparQueryResponseProcessor::readFileFrames(resp, 11));
+    g_fileframes.push_back(CasparQueryResponseProcessor::readFileFrames(resp, 12));
+    g_fileframes.push_back(CasparQueryResponseProcessor::readFileFrames(resp));
+}
+
+/**
+ * Layer status and file lengths are read from INFO XML, whether streamed or through the DOM
+ */
+static int testInfo ()
+{
+    FakeCaspar server(1);
+    g_layerframes = 0;
+    g_fileframes.clear();
+
+    {
+        CasparConnection con("127.0.0.1", server.m_port, 10);
+        con.waitForConnect(1000);
+
+        CasparCommand layerquery(CASPAR_COMMAND_INFO, boost::bind(&recordLayerStatus, _1));
+        layerquery.addParam("2");
+        layerquery.addParam("1");
+        con.sendCommand(layerquery);
+
+        CasparCommand channelquery(CASPAR_COMMAND_INFO_EXPANDED, boost::bind(&recordFileFrames, _1));
+        channelquery.addParam("2");
+        con.sendCommand(channelquery);
+
+        CasparCommand escapedquery(CASPAR_COMMAND_INFO_EXPANDED, boost::bind(&recordFileFrames, _1));
+        escapedquery.addParam("3");
+        con.sendCommand(escapedquery);
+
+        con.run(2000);
+        con.close();
+    }
+
+    if (1500 != g_layerframes || "media/PROMO." != g_layerfilename)
+    {
+        std::cout << std::endl << "    Layer status read as " << g_layerframes << " frames of " <<
+                g_layerfilename << std::endl;
+        return 1;
+    }
+
+    // The second set of lengths came from the DOM parser, and must match the first
+    if (8 != g_fileframes.size() || 250 != g_fileframes[0] || 500 != g_fileframes[1] ||
+            -1 != g_fileframes[2] || 250 != g_fileframes[3] ||
+            !std::equal(g_fileframes.begin(), g_fileframes.begin() + 4, g_fileframes.begin() + 4))
+    {
+        std::cout << std::endl << "    File lengths read wrongly" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int runtest ()
+{
+    return testPipelining() || testUrgent() || testLargeResponse() || testInfo();
+}
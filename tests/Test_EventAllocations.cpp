@@ -0,0 +1,201 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_EventAllocations.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_EventAllocations.cpp - counts heap allocations per scheduled event
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include "MouseCatcherCommon.h"
+
+char testname[] = "Event pipeline allocations";
+
+static std::atomic<unsigned long> g_allocations(0);
+
+void* operator new (size_t size)
+{
+    g_allocations++;
+    void *p = malloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete (void *p) noexcept
+{
+    free(p);
+}
+
+/*
+ * The stages below copy the hand-offs an event makes between arriving from an
+ * EventSource and being run by a channel: EventProcessor job, processor call,
+ * walking the generated children, conversion to a playlist row and the channel
+ * tick loop. The "copying" versions use the old by-value signatures.
+ */
+
+//! Same data members as a PlaylistEntry
+struct Row
+{
+    int m_eventid = 0;
+    std::string m_device;
+    int m_deviceid = -1;
+    std::string m_description;
+    ExtraData m_extras;
+    std::string m_preprocessor;
+};
+
+static std::vector<Row> g_rows;
+
+static void processorByValue (MouseCatcherEvent originalEvent, MouseCatcherEvent& resultingEvent)
+{
+    resultingEvent = originalEvent;
+}
+
+static void processorByRef (MouseCatcherEvent& originalEvent, MouseCatcherEvent& resultingEvent)
+{
+    resultingEvent = originalEvent;
+}
+
+static void addRow (const MouseCatcherEvent& event)
+{
+    Row row;
+    row.m_device = event.m_targetdevice;
+    row.m_description = event.m_description;
+    row.m_extras = event.m_extradata;
+    row.m_preprocessor = event.m_preprocessor;
+    g_rows.push_back(row);
+}
+
+static void processCopying (MouseCatcherEvent event)
+{
+    addRow(event);
+    for (MouseCatcherEvent child : event.m_childevents)
+    {
+        processCopying(child);
+    }
+}
+
+static void processInPlace (MouseCatcherEvent& event)
+{
+    addRow(event);
+    for (MouseCatcherEvent& child : event.m_childevents)
+    {
+        processInPlace(child);
+    }
+}
+
+static void scheduleCopying (const MouseCatcherEvent& event)
+{
+    MouseCatcherEvent originalevent = event;
+
+    // Captured by value into the job
+    std::function<MouseCatcherEvent()> job = [originalevent] ()
+    {
+        MouseCatcherEvent resultingevent = originalevent;
+        processorByValue(originalevent, resultingevent);
+        return resultingevent;
+    };
+
+    MouseCatcherEvent result = job();
+    processCopying(result);
+
+    int ran = 0;
+    for (Row thisrow : g_rows)
+    {
+        ran += thisrow.m_eventid;
+    }
+}
+
+static void scheduleMoving (const MouseCatcherEvent& event)
+{
+    MouseCatcherEvent originalevent = event;
+
+    // Passed as the job's data
+    std::shared_ptr<MouseCatcherEvent> poriginal = std::make_shared<MouseCatcherEvent>(std::move(originalevent));
+    std::function<MouseCatcherEvent()> job = [poriginal] ()
+    {
+        MouseCatcherEvent resultingevent = *poriginal;
+        processorByRef(*poriginal, resultingevent);
+        return resultingevent;
+    };
+
+    MouseCatcherEvent result = job();
+    processInPlace(result);
+
+    int ran = 0;
+    for (Row& thisrow : g_rows)
+    {
+        ran += thisrow.m_eventid;
+    }
+}
+
+static MouseCatcherEvent makeShow (int children)
+{
+    MouseCatcherEvent show;
+    show.m_channel = "Channel 1";
+    show.m_targetdevice = "EventProcessor_Show";
+    show.m_description = "An evening programme with a long description";
+    show.m_extradata["filename"] = "a_reasonably_long_programme_file_name";
+
+    for (int i = 0; i < children; ++i)
+    {
+        MouseCatcherEvent child;
+        child.m_channel = show.m_channel;
+        child.m_targetdevice = "Caspar_Video_Server";
+        child.m_description = show.m_description;
+        child.m_extradata["filename"] = "continuity_item_file_name_number";
+        child.m_extradata["nowtext"] = "Now: An evening programme";
+        child.m_extradata["hostlayer"] = "20";
+        show.m_childevents.push_back(child);
+    }
+
+    return show;
+}
+
+static double countPerEvent (std::function<void(const MouseCatcherEvent&)> schedule, const MouseCatcherEvent& show,
+        int events)
+{
+    g_rows.clear();
+    g_rows.reserve(events);
+    unsigned long start = g_allocations;
+    schedule(show);
+    return static_cast<double>(g_allocations - start) / events;
+}
+
+int runtest ()
+{
+    const int children = 12;
+    MouseCatcherEvent show = makeShow(children);
+
+    double copying = countPerEvent(scheduleCopying, show, children + 1);
+    double moving = countPerEvent(scheduleMoving, show, children + 1);
+
+    std::cout << std::endl << "    Allocations per scheduled event: copying " << copying << ", moving " <<
+            moving << std::endl;
+
+    return moving < copying ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_EventTimeline.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_EventTimeline.cpp - checks the interval tree and channel overlap policies
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "BaseConfigLoader.h"
+#include "EventTimeline.h"
+#include "Log.h"
+#include "NameRegistry.h"
+#include "PlaylistDB.h"
+
+Log g_logger;
+NameRegistry g_deviceids;
+std::shared_ptr<BaseConfigLoader> g_pbaseconfig;
+
+char testname[] = "Event timeline and overlap policies";
+
+static bool fail (std::string message)
+{
+    std::cout << std::endl << "    " << message;
+    return false;
+}
+
+static std::vector<int> ids (const std::vector<TimelineInterval>& intervals)
+{
+    std::vector<int> result;
+    for (const TimelineInterval& interval : intervals)
+    {
+        result.push_back(interval.m_eventid);
+    }
+    return result;
+}
+
+static std::vector<int> overlapping (const EventTimeline& timeline, time_t start, time_t end, int ignoreid = -1)
+{
+    std::vector<TimelineInterval> result;
+    timeline.findOverlapping(start, end, result, ignoreid);
+    return ids(result);
+}
+
+static std::vector<int> at (const EventTimeline& timeline, time_t when)
+{
+    std::vector<TimelineInterval> result;
+    timeline.findAt(when, result);
+    return ids(result);
+}
+
+/**
+ * Sorted and unsorted inserts and removals, checking the tree after every change
+ */
+static bool testRebalancing ()
+{
+    EventTimeline timeline;
+
+    // Ascending starts make an unbalanced tree without rotations
+    for (int i = 1; i <= 200; ++i)
+    {
+        timeline.insert(i, i * 10, i * 10 + 15);
+        if (!timeline.verify())
+        {
+            return fail("Tree inconsistent after ascending insert " + std::to_string(i));
+        }
+    }
+
+    // Descending starts
+    for (int i = 400; i > 200; --i)
+    {
+        timeline.insert(i, i * 10, i * 10 + 15);
+        if (!timeline.verify())
+        {
+            return fail("Tree inconsistent after descending insert " + std::to_string(i));
+        }
+    }
+
+    if (400 != timeline.size())
+    {
+        return fail("Expected 400 events, have " + std::to_string(timeline.size()));
+    }
+
+    // Remove every other event, then the rest from the far end
+    for (int i = 2; i <= 400; i += 2)
+    {
+        if (!timeline.remove(i) || !timeline.verify())
+        {
+            return fail("Tree inconsistent after removing " + std::to_string(i));
+        }
+    }
+
+    if (timeline.remove(2))
+    {
+        return fail("Removed an event twice");
+    }
+
+    for (int i = 399; i > 0; i -= 2)
+    {
+        if (!timeline.remove(i) || !timeline.verify())
+        {
+            return fail("Tree inconsistent after removing " + std::to_string(i));
+        }
+    }
+
+    if (0 != timeline.size())
+    {
+        return fail("Timeline not empty after removing everything");
+    }
+
+    // Random inserts, moves and removes checked against a plain list
+    std::mt19937 random(1234);
+    std::map<int, std::pair<time_t, time_t>> reference;
+
+    for (int step = 0; step < 2000; ++step)
+    {
+        int eventid = random() % 300;
+        if (random() % 3)
+        {
+            time_t start = random() % 10000;
+            time_t end = start + random() % 200;
+            timeline.insert(eventid, start, end);
+            reference[eventid] = std::make_pair(start, end);
+        }
+        else
+        {
+            if (timeline.remove(eventid) != (reference.erase(eventid) > 0))
+            {
+                return fail("Remove disagreed about event " + std::to_string(eventid));
+            }
+        }
+
+        if (!timeline.verify())
+        {
+            return fail("Tree inconsistent after random step " + std::to_string(step));
+        }
+
+        // Compare a random range query
+        time_t start = random() % 10000;
+        time_t end = start + random() % 500;
+
+        std::map<std::pair<time_t, int>, int> expected;
+        for (const std::pair<const int, std::pair<time_t, time_t>>& entry : reference)
+        {
+            if (start < end && entry.second.first < end && entry.second.second > start &&
+                    entry.second.second > entry.second.first)
+            {
+                expected[std::make_pair(entry.second.first, entry.first)] = entry.first;
+            }
+        }
+
+        std::vector<int> expectedids;
+        for (const std::pair<const std::pair<time_t, int>, int>& entry : expected)
+        {
+            expectedids.push_back(entry.second);
+        }
+
+        if (overlapping(timeline, start, end) != expectedids ||
+                timeline.hasOverlap(start, end) != !expectedids.empty())
+        {
+            return fail("Range query wrong after random step " + std::to_string(step));
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Events cover [start, end), so touching events do not overlap
+ */
+static bool testBoundaries ()
+{
+    EventTimeline timeline;
+    timeline.insert(1, 100, 200);
+    timeline.insert(2, 200, 300);
+    timeline.insert(3, 150, 150);
+    timeline.insert(4, 0, 1000);
+
+    bool ok = true;
+
+    if (overlapping(timeline, 200, 250) != std::vector<int>({4, 2}))
+    {
+        ok = fail("Event ending at 200 should not overlap a range starting at 200");
+    }
+
+    if (overlapping(timeline, 199, 200) != std::vector<int>({4, 1}))
+    {
+        ok = fail("Last second of an event should overlap");
+    }
+
+    if (overlapping(timeline, 1000, 1100) != std::vector<int>())
+    {
+        ok = fail("Nothing should overlap after the end of the longest event");
+    }
+
+    if (overlapping(timeline, 0, 100, 4) != std::vector<int>())
+    {
+        ok = fail("Range ending at 100 should not overlap an event starting at 100");
+    }
+
+    if (overlapping(timeline, 0, 101, 4) != std::vector<int>({1}))
+    {
+        ok = fail("Range ending at 101 should overlap an event starting at 100");
+    }
+
+    if (overlapping(timeline, 140, 160, 4) != std::vector<int>({1}))
+    {
+        ok = fail("Zero-length events should never overlap");
+    }
+
+    if (overlapping(timeline, 150, 150) != std::vector<int>() || timeline.hasOverlap(150, 150))
+    {
+        ok = fail("Empty ranges should never overlap");
+    }
+
+    if (!timeline.hasOverlap(199, 200, 4) || timeline.hasOverlap(200, 201, 2) != true ||
+            timeline.hasOverlap(300, 400, 4))
+    {
+        ok = fail("hasOverlap disagrees with findOverlapping");
+    }
+
+    TimelineInterval interval;
+    if (!timeline.getInterval(2, interval) || 200 != interval.m_start || 300 != interval.m_end ||
+            timeline.getInterval(5, interval))
+    {
+        ok = fail("getInterval returned the wrong interval");
+    }
+
+    return ok;
+}
+
+static bool testFindAt ()
+{
+    EventTimeline timeline;
+    timeline.insert(1, 100, 200);
+    timeline.insert(2, 200, 300);
+    timeline.insert(3, 0, 1000);
+
+    bool ok = true;
+
+    if (at(timeline, 100) != std::vector<int>({3, 1}))
+    {
+        ok = fail("findAt should include an event starting that second");
+    }
+
+    if (at(timeline, 199) != std::vector<int>({3, 1}))
+    {
+        ok = fail("findAt should include an event in its last second");
+    }
+
+    if (at(timeline, 200) != std::vector<int>({3, 2}))
+    {
+        ok = fail("findAt should not include an event ending that second");
+    }
+
+    if (at(timeline, 1000) != std::vector<int>() || at(timeline, -1) != std::vector<int>())
+    {
+        ok = fail("findAt should find nothing outside every event");
+    }
+
+    return ok;
+}
+
+static bool checkGaps (std::string name, const EventTimeline& timeline, time_t start, time_t end, int mingap,
+        std::vector<std::pair<time_t, time_t>> expected)
+{
+    std::vector<TimelineGap> gaps;
+    timeline.findGaps(start, end, mingap, gaps);
+
+    std::vector<std::pair<time_t, time_t>> found;
+    for (const TimelineGap& gap : gaps)
+    {
+        found.push_back(std::make_pair(gap.m_start, gap.m_end));
+    }
+
+    if (found != expected)
+    {
+        return fail(name + ": wrong gaps, found " + std::to_string(found.size()));
+    }
+    return true;
+}
+
+static bool testGaps ()
+{
+    EventTimeline timeline;
+    timeline.insert(1, 100, 200);
+    timeline.insert(2, 150, 250);
+    timeline.insert(3, 300, 400);
+    timeline.insert(4, 320, 340);
+
+    bool ok = true;
+    ok &= checkGaps("All gaps", timeline, 0, 500, 0, {{0, 100}, {250, 300}, {400, 500}});
+    ok &= checkGaps("Long gaps", timeline, 0, 500, 60, {{0, 100}, {400, 500}});
+    ok &= checkGaps("Starting mid-event", timeline, 120, 350, 0, {{250, 300}});
+    ok &= checkGaps("Inside one event", timeline, 310, 330, 0, {});
+    ok &= checkGaps("Empty timeline", EventTimeline(), 0, 100, 0, {{0, 100}});
+    ok &= checkGaps("Empty range", timeline, 100, 100, 0, {});
+
+    // Shifting and pruning keep the tree in step
+    timeline.shift(300, 1000, 50);
+    ok &= checkGaps("After shift", timeline, 0, 500, 0, {{0, 100}, {250, 350}, {450, 500}});
+
+    timeline.pruneBefore(250);
+    if (2 != timeline.size() || !timeline.verify())
+    {
+        ok = fail("pruneBefore should leave only the shifted events");
+    }
+
+    return ok;
+}
+
+/**
+ * Top-level event on a playlist lasting a number of seconds
+ */
+static int addEvent (PlaylistDB& playlist, time_t trigger, int seconds)
+{
+    PlaylistEntry entry;
+    entry.m_device = "Video";
+    entry.m_devicetype = EVENTDEVICE_VIDEODEVICE;
+    entry.m_trigger = trigger;
+    entry.m_duration = seconds * 25;
+    return playlist.addEvent(&entry);
+}
+
+static bool checkStart (std::string name, PlaylistDB& playlist, int eventid, time_t expected)
+{
+    TimelineInterval interval;
+    PlaylistEntry entry;
+    if (!playlist.getTimeline().getInterval(eventid, interval) || !playlist.getEventDetails(eventid, entry) ||
+            interval.m_start != expected || entry.m_trigger != expected)
+    {
+        return fail(name + ": event " + std::to_string(eventid) + " should start at " + std::to_string(expected));
+    }
+    return true;
+}
+
+static bool testPolicies ()
+{
+    std::string configfile = "/tmp/Test_EventTimeline-" + std::to_string(getpid()) + ".xml";
+    {
+        std::ofstream config(configfile);
+        config << "<TarantulaConfig><System><Framerate>25</Framerate><Database>:memory:</Database></System>"
+                "<Plugins></Plugins><Channels></Channels></TarantulaConfig>";
+    }
+    g_pbaseconfig = std::make_shared<BaseConfigLoader>(configfile);
+    remove(configfile.c_str());
+
+    bool ok = true;
+    time_t now = time(NULL) + 3600;
+
+    PlaylistDB playlist("Policies");
+    int first = addEvent(playlist, now, 60);
+    int second = addEvent(playlist, now + 60, 60);
+    int later = addEvent(playlist, now + 600, 60);
+
+    // Warn lets the clash through and moves nothing
+    if (!playlist.applyOverlapPolicy(now + 30, now + 90, OVERLAP_WARN))
+    {
+        ok = fail("Warn policy should allow overlapping events");
+    }
+    ok &= checkStart("Warn", playlist, first, now);
+    ok &= checkStart("Warn", playlist, second, now + 60);
+
+    // Reject refuses clashes, but not touching events or an event clashing with itself
+    if (playlist.applyOverlapPolicy(now + 30, now + 90, OVERLAP_REJECT))
+    {
+        ok = fail("Reject policy should refuse overlapping events");
+    }
+    if (!playlist.applyOverlapPolicy(now + 120, now + 600, OVERLAP_REJECT))
+    {
+        ok = fail("Reject policy should allow an event filling a gap exactly");
+    }
+    if (!playlist.applyOverlapPolicy(now, now + 60, OVERLAP_REJECT, first))
+    {
+        ok = fail("Reject policy should ignore the event being changed");
+    }
+
+    // Shunt pushes the connected block back, leaving the later event alone
+    if (!playlist.applyOverlapPolicy(now - 30, now + 30, OVERLAP_SHUNT))
+    {
+        ok = fail("Shunt policy should allow overlapping events");
+    }
+    ok &= checkStart("Shunt", playlist, first, now + 30);
+    ok &= checkStart("Shunt", playlist, second, now + 90);
+    ok &= checkStart("Shunt", playlist, later, now + 600);
+
+    // Earlier events cannot be shunted out of the way
+    if (!playlist.applyOverlapPolicy(now + 60, now + 120, OVERLAP_SHUNT, second))
+    {
+        ok = fail("Shunt policy should still allow an event clashing with an earlier one");
+    }
+    ok &= checkStart("Shunt earlier", playlist, first, now + 30);
+    ok &= checkStart("Shunt earlier", playlist, second, now + 90);
+
+    if (!playlist.getTimeline().verify())
+    {
+        ok = fail("Tree inconsistent after shunts");
+    }
+
+    return ok;
+}
+
+int runtest ()
+{
+    bool ok = testRebalancing();
+    ok &= testBoundaries();
+    ok &= testFindAt();
+    ok &= testGaps();
+    ok &= testPolicies();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_PlaylistArchive.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_PlaylistArchive.cpp - exports a schedule to an archive and imports it again
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "BaseConfigLoader.h"
+#include "Log.h"
+#include "NameRegistry.h"
+#include "PlaylistArchive.h"
+#include "PlaylistDB.h"
+
+Log g_logger;
+NameRegistry g_deviceids;
+std::shared_ptr<BaseConfigLoader> g_pbaseconfig;
+
+char testname[] = "Playlist archive export and import";
+
+static std::string g_tempprefix = "/tmp/Test_PlaylistArchive-" + std::to_string(getpid());
+
+static PlaylistEntry makeEvent (std::string device, std::string description, time_t trigger, int duration)
+{
+    PlaylistEntry entry;
+    entry.m_device = device;
+    entry.m_devicetype = EVENTDEVICE_VIDEODEVICE;
+    entry.m_description = description;
+    entry.m_trigger = trigger;
+    entry.m_duration = duration;
+    entry.m_preprocessor = "";
+    return entry;
+}
+
+/**
+ * Add a show with two children, the second having a child of its own
+ */
+static void addShow (PlaylistDB& playlist, std::string name, time_t trigger)
+{
+    PlaylistEntry show = makeEvent("Show", name, trigger, 1500);
+    show.m_devicetype = EVENTDEVICE_PROCESSOR;
+    show.m_extras["filename"] = name + "_file";
+    show.m_extras["title"] = "Title with \"quotes\" & ampersands";
+    int showid = playlist.addEvent(&show);
+
+    PlaylistEntry video = makeEvent("Video", name + " video", trigger, 1500);
+    video.m_eventtype = EVENT_CHILD;
+    video.m_parent = showid;
+    video.m_action = 1;
+    video.m_extras["filename"] = name + "_video";
+    playlist.addEvent(&video);
+
+    PlaylistEntry graphic = makeEvent("CG", name + " graphic", trigger + 5, 250);
+    graphic.m_eventtype = EVENT_CHILD;
+    graphic.m_devicetype = EVENTDEVICE_CGDEVICE;
+    graphic.m_parent = showid;
+    graphic.m_preprocessor = "Channel::manualHoldRelease";
+    int graphicid = playlist.addEvent(&graphic);
+
+    PlaylistEntry update = makeEvent("CG", name + " update", trigger + 8, 0);
+    update.m_eventtype = EVENT_CHILD;
+    update.m_devicetype = EVENTDEVICE_CGDEVICE;
+    update.m_parent = graphicid;
+    update.m_extras["text"] = "";
+    playlist.addEvent(&update);
+}
+
+/**
+ * Compare an imported event tree against the original, recursing into children
+ */
+static bool compareTree (PlaylistDB& original, const PlaylistEntry& before, PlaylistDB& imported,
+        const PlaylistEntry& after, int timeoffset)
+{
+    bool same = before.m_eventtype == after.m_eventtype && before.m_trigger + timeoffset == after.m_trigger &&
+            before.m_device == after.m_device && before.m_devicetype == after.m_devicetype &&
+            before.m_action == after.m_action && before.m_duration == after.m_duration &&
+            before.m_preprocessor == after.m_preprocessor && before.m_description == after.m_description &&
+            before.m_extras.size() == after.m_extras.size();
+
+    for (const ExtraData::value_type& extra : before.m_extras)
+    {
+        same = same && after.m_extras.find(extra.first) != after.m_extras.end() &&
+                after.m_extras.find(extra.first)->second == extra.second;
+    }
+
+    if (!same)
+    {
+        std::cout << std::endl << "    Event \"" << before.m_description << "\" changed to \"" <<
+                after.m_description << "\"";
+        return false;
+    }
+
+    std::vector<PlaylistEntry> beforechildren = original.getChildEvents(before.m_eventid);
+    std::vector<PlaylistEntry> afterchildren = imported.getChildEvents(after.m_eventid);
+    if (beforechildren.size() != afterchildren.size())
+    {
+        std::cout << std::endl << "    Event \"" << before.m_description << "\" had " << beforechildren.size() <<
+                " children, now " << afterchildren.size();
+        return false;
+    }
+
+    for (size_t i = 0; i < beforechildren.size(); ++i)
+    {
+        if (!compareTree(original, beforechildren[i], imported, afterchildren[i], timeoffset))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Copy the start of a file to make a truncated version
+ */
+static std::string truncateFile (std::string source, size_t dropbytes)
+{
+    std::ifstream input(source, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    std::string target = source + ".truncated";
+    std::ofstream output(target, std::ios::binary | std::ios::trunc);
+    output.write(data.data(), data.size() > dropbytes ? data.size() - dropbytes : 0);
+
+    return target;
+}
+
+static bool checkCount (std::string name, PlaylistDB& playlist, time_t start, int length, size_t expected)
+{
+    size_t found = playlist.getEventList(start, length).size();
+    if (found != expected || playlist.getTimeline().size() != expected)
+    {
+        std::cout << std::endl << "    " << name << ": expected " << expected << " events, found " << found <<
+                " with " << playlist.getTimeline().size() << " on the timeline";
+        return false;
+    }
+    return true;
+}
+
+int runtest ()
+{
+    std::string configfile = g_tempprefix + ".xml";
+    std::string archivefile = g_tempprefix + ".tpla";
+
+    {
+        std::ofstream config(configfile);
+        config << "<TarantulaConfig><System><Framerate>25</Framerate><Database>:memory:</Database></System>"
+                "<Plugins></Plugins><Channels></Channels></TarantulaConfig>";
+    }
+    g_pbaseconfig = std::make_shared<BaseConfigLoader>(configfile);
+
+    bool ok = true;
+    time_t start = time(NULL) + 3600;
+    const int length = 3600;
+    const int weekoffset = 7 * 24 * 3600;
+
+    PlaylistDB original("Original");
+    addShow(original, "Morning", start);
+    addShow(original, "Afternoon", start + 600);
+    addShow(original, "Evening", start + 1200);
+
+    // Outside the range so should not be exported
+    addShow(original, "Tomorrow", start + 86400);
+
+    if (3 != original.exportRange(archivefile, start, length))
+    {
+        std::cout << std::endl << "    Export did not write 3 events";
+        ok = false;
+    }
+
+    // Round trip into an empty playlist a week later
+    PlaylistDB imported("Imported");
+    if (3 != imported.importRange(archivefile, weekoffset))
+    {
+        std::cout << std::endl << "    Import did not read 3 events";
+        ok = false;
+    }
+
+    std::vector<PlaylistEntry> before = original.getEventList(start, length);
+    std::vector<PlaylistEntry> after = imported.getEventList(start + weekoffset, length);
+    ok &= checkCount("Round trip", imported, start + weekoffset, length, 3);
+    for (size_t i = 0; i < before.size() && i < after.size(); ++i)
+    {
+        ok &= compareTree(original, before[i], imported, after[i], weekoffset);
+    }
+
+    // A show which has started playing keeps all of its children in the archive
+    PlaylistDB played("Played");
+    addShow(played, "Playing", start);
+    PlaylistEntry playingshow = played.getEventList(start, length).front();
+    std::vector<PlaylistEntry> playingchildren = played.getChildEvents(playingshow.m_eventid);
+    played.processEvent(playingshow.m_eventid);
+    played.processEvent(playingchildren.front().m_eventid);
+
+    if (1 != played.exportRange(archivefile, start, length))
+    {
+        std::cout << std::endl << "    Export of a playing show did not write 1 event";
+        ok = false;
+    }
+
+    // Compare against an unplayed copy, as the played one no longer lists its processed children
+    PlaylistDB reference("Reference");
+    addShow(reference, "Playing", start);
+    PlaylistDB restored("Restored");
+    if (1 != restored.importRange(archivefile, weekoffset))
+    {
+        std::cout << std::endl << "    Import of a playing show did not read 1 event";
+        ok = false;
+    }
+    else
+    {
+        ok &= compareTree(reference, reference.getEventList(start, length).front(), restored,
+                restored.getEventList(start + weekoffset, length).front(), weekoffset);
+    }
+
+    // Truncated files must not add anything, whether cut mid-record or just missing the end marker
+    PlaylistDB damaged("Damaged");
+    addShow(damaged, "Existing", start);
+
+    std::string truncated = truncateFile(archivefile, 100);
+    if (-1 != damaged.importRange(truncated, 0))
+    {
+        std::cout << std::endl << "    Import of a file cut mid-record did not fail";
+        ok = false;
+    }
+    ok &= checkCount("Cut mid-record", damaged, start, length, 1);
+    remove(truncated.c_str());
+
+    truncated = truncateFile(archivefile, 4);
+    if (-1 != damaged.importRange(truncated, 0))
+    {
+        std::cout << std::endl << "    Import of a file without the end marker did not fail";
+        ok = false;
+    }
+    ok &= checkCount("No end marker", damaged, start, length, 1);
+    remove(truncated.c_str());
+
+    // A writer abandoned without close() leaves an archive which does not read back
+    {
+        ArchivedEvent event;
+        event.m_event = makeEvent("Video", "Abandoned", start, 25);
+        PlaylistArchiveWriter writer(archivefile);
+        writer.writeEvent(event);
+    }
+    if (-1 != damaged.importRange(archivefile, 0))
+    {
+        std::cout << std::endl << "    Import of an abandoned export did not fail";
+        ok = false;
+    }
+    ok &= checkCount("Abandoned export", damaged, start, length, 1);
+
+    // Write errors must be reported, and an archive which could not be written is not complete
+    bool threw = false;
+    try
+    {
+        ArchivedEvent event;
+        event.m_event = makeEvent("Video", "Nowhere", start, 25);
+        PlaylistArchiveWriter writer("/dev/full");
+        writer.writeEvent(event);
+        writer.close();
+    }
+    catch (std::exception&)
+    {
+        threw = true;
+    }
+    if (!threw)
+    {
+        std::cout << std::endl << "    Writing to a full device did not fail";
+        ok = false;
+    }
+
+    if (-1 != original.exportRange("/nonexistent/directory/archive.tpla", start, length))
+    {
+        std::cout << std::endl << "    Export to a missing directory did not fail";
+        ok = false;
+    }
+
+    remove(archivefile.c_str());
+    remove(configfile.c_str());
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/******************************************************************************
+*   Copyright (C) 2011 - 2013  York Student Television
+*
+*   Tarantula is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   Tarantula is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with Tarantula.  If not, see <http://www.gnu.org/licenses/>.
+*
+*   Contact     : tarantula@ystv.co.uk
+*
+*   File Name   : Test_Recurrence.cpp
+*   Version     : 1.0
+*****************************************************************************/
+//Test_Recurrence.cpp - expands recurring event rules and checks the occurrences
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BaseConfigLoader.h"
+#include "Log.h"
+#include "NameRegistry.h"
+#include "PlaylistDB.h"
+#include "RecurrenceRule.h"
+
+Log g_logger;
+NameRegistry g_deviceids;
+std::shared_ptr<BaseConfigLoader> g_pbaseconfig;
+
+char testname[] = "Recurring event rules";
+
+/**
+ * Build a time from a local date and time of day
+ */
+static time_t localTime (int year, int month, int day, int hour, int minute, int second = 0)
+{
+    tm when = tm();
+    when.tm_year = year - 1900;
+    when.tm_mon = month - 1;
+    when.tm_mday = day;
+    when.tm_hour = hour;
+    when.tm_min = minute;
+    when.tm_sec = second;
+    when.tm_isdst = -1;
+    return mktime(&when);
+}
+
+static bool checkOccurrences (std::string name, const std::vector<time_t>& found, const std::vector<time_t>& expected)
+{
+    if (found == expected)
+    {
+        return true;
+    }
+
+    std::cout << std::endl << "    " << name << ": expected " << expected.size() << " occurrences, got " <<
+            found.size();
+    for (time_t occurrence : found)
+    {
+        char text[32];
+        tm local;
+        localtime_r(&occurrence, &local);
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+        std::cout << std::endl << "        " << text;
+    }
+    return false;
+}
+
+static bool checkRule (std::string spec, time_t from, time_t to, const std::vector<time_t>& expected)
+{
+    std::vector<time_t> found;
+    RecurrenceRule(spec).getOccurrences(from, to, found);
+    return checkOccurrences(spec, found, expected);
+}
+
+static bool checkInvalid (std::string spec)
+{
+    try
+    {
+        RecurrenceRule rule(spec);
+    }
+    catch (std::exception&)
+    {
+        return true;
+    }
+
+    std::cout << std::endl << "    \"" << spec << "\" should have been rejected";
+    return false;
+}
+
+int runtest ()
+{
+    // Fixed zone with UK rules, so the DST dates below hold wherever this runs
+    setenv("TZ", "GMT0BST,M3.5.0/1,M10.5.0", 1);
+    tzset();
+
+    bool ok = true;
+
+    // From is exclusive and to is inclusive
+    ok &= checkRule("daily 18:00", localTime(2026, 1, 1, 18, 0), localTime(2026, 1, 4, 18, 0),
+            {localTime(2026, 1, 2, 18, 0), localTime(2026, 1, 3, 18, 0), localTime(2026, 1, 4, 18, 0)});
+
+    ok &= checkRule("daily 06:15:30", localTime(2026, 1, 1, 0, 0), localTime(2026, 1, 2, 23, 59),
+            {localTime(2026, 1, 1, 6, 15, 30), localTime(2026, 1, 2, 6, 15, 30)});
+
+    ok &= checkRule("daily 18:00", localTime(2026, 1, 4, 0, 0), localTime(2026, 1, 1, 0, 0), {});
+
+    // 5th January 2026 is a Monday
+    ok &= checkRule("weekly mon,wed,fri 09:30", localTime(2026, 1, 4, 0, 0), localTime(2026, 1, 11, 0, 0),
+            {localTime(2026, 1, 5, 9, 30), localTime(2026, 1, 7, 9, 30), localTime(2026, 1, 9, 9, 30)});
+
+    ok &= checkRule("weekly Saturday,sun 23:59:59", localTime(2026, 1, 5, 0, 0), localTime(2026, 1, 12, 0, 0),
+            {localTime(2026, 1, 10, 23, 59, 59), localTime(2026, 1, 11, 23, 59, 59)});
+
+    ok &= checkRule("cron 0,30 6-7 * * 1-5", localTime(2026, 1, 3, 0, 0), localTime(2026, 1, 5, 23, 59),
+            {localTime(2026, 1, 5, 6, 0), localTime(2026, 1, 5, 6, 30), localTime(2026, 1, 5, 7, 0),
+                    localTime(2026, 1, 5, 7, 30)});
+
+    ok &= checkRule("cron */15 0 * * *", localTime(2026, 1, 1, 0, 0, 0) - 1, localTime(2026, 1, 1, 12, 0),
+            {localTime(2026, 1, 1, 0, 0), localTime(2026, 1, 1, 0, 15), localTime(2026, 1, 1, 0, 30),
+                    localTime(2026, 1, 1, 0, 45)});
+
+    // Both day fields restricted matches either, so the 1st (a Thursday) plus every Sunday
+    ok &= checkRule("cron 0 12 1 * 0", localTime(2026, 1, 1, 0, 0), localTime(2026, 1, 31, 0, 0),
+            {localTime(2026, 1, 1, 12, 0), localTime(2026, 1, 4, 12, 0), localTime(2026, 1, 11, 12, 0),
+                    localTime(2026, 1, 18, 12, 0), localTime(2026, 1, 25, 12, 0)});
+
+    // 7 is Sunday too, and months restrict the dates
+    ok &= checkRule("cron 0 12 * 2 7", localTime(2026, 1, 1, 0, 0), localTime(2026, 2, 10, 0, 0),
+            {localTime(2026, 2, 1, 12, 0), localTime(2026, 2, 8, 12, 0)});
+
+    // Clocks go forward at 01:00 on 29th March 2026, so 01:30 does not exist that day
+    ok &= checkRule("daily 01:30", localTime(2026, 3, 28, 0, 0), localTime(2026, 3, 31, 0, 0),
+            {localTime(2026, 3, 28, 1, 30), localTime(2026, 3, 30, 1, 30)});
+
+    // Either side of the change occurrences stay at the same local time, 23 hours apart
+    std::vector<time_t> spring;
+    RecurrenceRule("daily 18:00").getOccurrences(localTime(2026, 3, 28, 0, 0), localTime(2026, 3, 30, 0, 0), spring);
+    ok &= checkOccurrences("daily 18:00 over spring change", spring,
+            {localTime(2026, 3, 28, 18, 0), localTime(2026, 3, 29, 18, 0)});
+    if (2 == spring.size() && spring[1] - spring[0] != 23 * 3600)
+    {
+        std::cout << std::endl << "    Spring change should make a 23 hour day";
+        ok = false;
+    }
+
+    // Clocks go back at 02:00 on 25th October 2026, so 01:30 happens twice but should only be used once
+    std::vector<time_t> autumn;
+    RecurrenceRule("daily 01:30").getOccurrences(localTime(2026, 10, 24, 12, 0), localTime(2026, 10, 26, 12, 0),
+            autumn);
+    if (2 != autumn.size() || autumn[1] - autumn[0] < 24 * 3600)
+    {
+        std::cout << std::endl << "    daily 01:30 over autumn change: expected 2 occurrences a day or more apart, got " <<
+                autumn.size();
+        ok = false;
+    }
+
+    // Skipped occurrences and end dates
+    RecurringEntry entry;
+    entry.m_rule = RecurrenceRule("daily 18:00");
+    entry.m_exceptions.insert(localTime(2026, 1, 2, 18, 0));
+    entry.m_until = localTime(2026, 1, 4, 18, 0);
+
+    std::vector<time_t> found;
+    entry.getOccurrences(localTime(2026, 1, 1, 0, 0), localTime(2026, 1, 10, 0, 0), found);
+    ok &= checkOccurrences("daily 18:00 with a skip and end", found,
+            {localTime(2026, 1, 1, 18, 0), localTime(2026, 1, 3, 18, 0), localTime(2026, 1, 4, 18, 0)});
+
+    // A default rule never happens
+    found.clear();
+    RecurrenceRule().getOccurrences(localTime(2026, 1, 1, 0, 0), localTime(2026, 1, 10, 0, 0), found);
+    ok &= checkOccurrences("default rule", found, {});
+
+    ok &= checkInvalid("hourly 10:00");
+    ok &= checkInvalid("daily 25:00");
+    ok &= checkInvalid("daily noon");
+    ok &= checkInvalid("weekly xyz 10:00");
+    ok &= checkInvalid("cron 0 12 * *");
+    ok &= checkInvalid("cron 60 * * * *");
+    ok &= checkInvalid("cron 5-1 * * * *");
+    ok &= checkInvalid("cron */0 * * * *");
+
+    return ok ? 0 : 1;
+}